@@ -0,0 +1,40 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+/*
+ * A measurement of the benchmark app, see benchmark_app.cpp. Its
+ * parameters are passed to the constructor of the derived class.
+ */
+class Benchmark {
+public:
+    virtual ~Benchmark() {}
+
+    /* Name used in error messages, e.g. "outbox benchmark". */
+    virtual const char *name() const = 0;
+
+    /* Runs the measurement. Returns 0, or an error code if it failed or checked a wrong result. */
+    virtual int run() = 0;
+
+    /* Prints the result of the last run() to the console. */
+    virtual void print() const = 0;
+};
+
+#endif /* __BENCHMARK_H__ */
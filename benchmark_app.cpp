@@ -0,0 +1,123 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+/*
+ * Benchmark app, built instead of the sample when benchmark-app is true in
+ * mbed_app.json. It runs the benchmarks enabled in mbed_app.json one after
+ * the other and prints their results, without bringing up the network.
+ */
+
+#if MBED_CONF_APP_BENCHMARK_APP
+
+#include "mbed.h"
+#include "MQTT_server_setting.h"
+#include "benchmark.h"
+#include "loopback_broker.h"
+#include "mqtt_benchmark.h"
+#include "crypto_benchmark.h"
+#include "encoding_benchmark.h"
+#include "topic_benchmark.h"
+#include "twin_benchmark.h"
+#include "method_benchmark.h"
+#include "sensor_benchmark.h"
+#include "router_benchmark.h"
+#include "telemetry_batcher.h"
+#include "gateway_benchmark.h"
+#include "fleet_simulator.h"
+#include "outbox_benchmark.h"
+#include "session_pool.h"
+#include "session_pool_soak.h"
+
+#if MBED_CONF_APP_SESSION_POOL_SOAK_CYCLES > 0
+/* The soak test runs on a pool of the sample's geometry. */
+static constexpr SessionPoolClass sessionPoolClasses[] = MBED_CONF_APP_SESSION_POOL_CLASSES;
+static uint64_t sessionPoolArena[sessionPoolArenaSize(sessionPoolClasses) / sizeof(uint64_t)];
+#endif
+
+/*
+ * Runs `benchmark` and prints its result. Unused if no benchmark is enabled.
+ */
+MBED_UNUSED static void runBenchmark(Benchmark &&benchmark)
+{
+    int ret = benchmark.run();
+    if (ret != 0) {
+        printf("ERROR: %s failed with %d\r\n", benchmark.name(), ret);
+    }
+    benchmark.print();
+}
+
+int main(int argc, char* argv[])
+{
+    printf("Mbed to Azure IoT Hub: benchmarks\r\n\r\n");
+
+    /* Stands in for IoT Hub in the benchmarks that go through the MQTT client. */
+    LoopbackBroker broker(0, 0);
+
+#if MBED_CONF_APP_CRYPTO_BENCHMARK
+    /* First, so that the heap peak it reports belongs to the selected tls-profile. */
+    runBenchmark(CryptoBenchmark(SSL_CA_PEM, MBED_CONF_APP_CRYPTO_BENCHMARK_BYTES));
+#endif
+#if MBED_CONF_APP_BENCHMARK_MESSAGE_COUNT > 0
+    runBenchmark(MqttBenchmark(&broker, "devices/" DEVICE_ID "/messages/events/", MBED_CONF_APP_BENCHMARK_MESSAGE_COUNT,
+                               MBED_CONF_APP_BENCHMARK_PAYLOAD_SIZE));
+#endif
+#if MBED_CONF_APP_ENCODING_BENCHMARK_RECORDS > 0
+    runBenchmark(EncodingBenchmark(MBED_CONF_APP_ENCODING_BENCHMARK_RECORDS));
+#endif
+#if MBED_CONF_APP_TOPIC_BENCHMARK_ITERATIONS > 0
+    runBenchmark(TopicBenchmark(MBED_CONF_APP_TOPIC_BENCHMARK_ITERATIONS));
+#endif
+#if MBED_CONF_APP_TWIN_BENCHMARK_ITERATIONS > 0
+    runBenchmark(TwinBenchmark(MBED_CONF_APP_TWIN_BENCHMARK_ITERATIONS, &broker));
+#endif
+#if MBED_CONF_APP_METHOD_BENCHMARK_CALLS > 0
+    runBenchmark(MethodBenchmark(MBED_CONF_APP_METHOD_BENCHMARK_CALLS, MBED_CONF_APP_METHOD_RESPONSE_BUDGET_MS, &broker));
+#endif
+#if MBED_CONF_APP_SENSOR_BENCHMARK_SAMPLES > 0
+    runBenchmark(SensorBenchmark(MBED_CONF_APP_SENSOR_WINDOW_SAMPLES, MBED_CONF_APP_SENSOR_DECIMATION,
+                                 MBED_CONF_APP_SENSOR_BENCHMARK_SAMPLES));
+#endif
+#if MBED_CONF_APP_ROUTER_BENCHMARK_ITERATIONS > 0
+    runBenchmark(RouterBenchmark(MBED_CONF_APP_ROUTER_BENCHMARK_ITERATIONS));
+#endif
+#if MBED_CONF_APP_GATEWAY_BENCHMARK_RECORDS > 0
+    runBenchmark(GatewayBenchmark(MBED_CONF_APP_TELEMETRY_BATCH_FORMAT, MBED_CONF_APP_GATEWAY_QUANTUM,
+                                  MBED_CONF_APP_GATEWAY_BENCHMARK_RECORDS));
+#endif
+#if MBED_CONF_APP_FLEET_SIM_DEVICES > 0
+    runBenchmark(FleetSimulator(MBED_CONF_APP_FLEET_SIM_DEVICES, MBED_CONF_APP_FLEET_SIM_WORKERS,
+                                MBED_CONF_APP_FLEET_SIM_PUBLISH_PERIOD_MS, MBED_CONF_APP_FLEET_SIM_DURATION_MS,
+                                MBED_CONF_APP_FLEET_SIM_ACCEPT_RATE, MBED_CONF_APP_FLEET_SIM_SESSION_PUBLISHES,
+                                MBED_CONF_APP_RECONNECT_MIN_DELAY_MS, MBED_CONF_APP_RECONNECT_MAX_DELAY_MS));
+#endif
+#if MBED_CONF_APP_OUTBOX_BENCHMARK_RECORDS > 0
+    runBenchmark(OutboxBenchmark(MBED_CONF_APP_OUTBOX_BENCHMARK_RECORDS, &broker));
+#endif
+#if MBED_CONF_APP_SESSION_POOL_SOAK_CYCLES > 0
+    {
+        SessionPool pool(sessionPoolArena, sizeof(sessionPoolArena), sessionPoolClasses,
+                         sizeof(sessionPoolClasses) / sizeof(sessionPoolClasses[0]));
+        runBenchmark(SessionPoolSoak(&pool, MBED_CONF_APP_SESSION_POOL_SOAK_CYCLES, &broker));
+    }
+#endif
+
+    printf("Benchmarks done.\r\n");
+    return 0;
+}
+
+#endif /* MBED_CONF_APP_BENCHMARK_APP */
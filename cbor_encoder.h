@@ -0,0 +1,135 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __CBOR_ENCODER_H__
+#define __CBOR_ENCODER_H__
+
+#include "mbed.h"
+
+/* CBOR major types (RFC 7049), in the top three bits of the initial byte. */
+#define CBOR_MAJOR_UNSIGNED     0x00
+#define CBOR_MAJOR_NEGATIVE     0x20
+#define CBOR_MAJOR_BYTES        0x40
+#define CBOR_MAJOR_TEXT         0x60
+#define CBOR_MAJOR_ARRAY        0x80
+#define CBOR_MAJOR_MAP          0xA0
+
+/* Initial byte of an indefinite-length array, and the break that ends it. */
+#define CBOR_INDEFINITE_ARRAY   0x9F
+#define CBOR_BREAK              0xFF
+
+/*
+ * Writes CBOR data items straight into a caller-provided buffer, without
+ * allocating. Integers take the shortest encoding, e.g. one byte for 0..23.
+ * Items are only written if they fit completely; once one does not, the
+ * encoder is marked as overflowed and writes nothing more, so a sequence of
+ * calls can be checked once at the end.
+ */
+class CborEncoder {
+public:
+    CborEncoder(uint8_t *buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0), overflow(false)
+    {
+    }
+
+    void encodeUnsigned(uint32_t value) { putHead(CBOR_MAJOR_UNSIGNED, value); }
+
+    void encodeInt(int32_t value)
+    {
+        if (value < 0) {
+            // -1 - value without overflowing at INT32_MIN.
+            putHead(CBOR_MAJOR_NEGATIVE, (uint32_t)(-(value + 1)));
+        } else {
+            putHead(CBOR_MAJOR_UNSIGNED, (uint32_t)value);
+        }
+    }
+
+    void encodeText(const char *text, size_t textLength)
+    {
+        putHead(CBOR_MAJOR_TEXT, textLength);
+        putBytes(text, textLength);
+    }
+
+    void encodeText(const char *text) { encodeText(text, strlen(text)); }
+
+    void encodeBytes(const void *data, size_t dataLength)
+    {
+        putHead(CBOR_MAJOR_BYTES, dataLength);
+        putBytes(data, dataLength);
+    }
+
+    /* Starts an array of `count` items or a map of `count` key/value pairs, which follow. */
+    void encodeArray(size_t count) { putHead(CBOR_MAJOR_ARRAY, count); }
+    void encodeMap(size_t count) { putHead(CBOR_MAJOR_MAP, count); }
+
+    /* Starts an array of items up to encodeBreak(), for when the count is not known in advance. */
+    void encodeIndefiniteArray() { putByte(CBOR_INDEFINITE_ARRAY); }
+    void encodeBreak() { putByte(CBOR_BREAK); }
+
+    /* Bytes written so far. */
+    size_t size() const { return length; }
+
+    /* True if an item did not fit into the buffer. */
+    bool overflowed() const { return overflow; }
+
+private:
+    void putHead(uint8_t major, uint32_t value)
+    {
+        uint8_t head[5];
+        size_t n;
+        if (value < 24) {
+            head[0] = major | (uint8_t)value;
+            n = 1;
+        } else if (value <= 0xFF) {
+            head[0] = major | 24;
+            head[1] = (uint8_t)value;
+            n = 2;
+        } else if (value <= 0xFFFF) {
+            head[0] = major | 25;
+            head[1] = (uint8_t)(value >> 8);
+            head[2] = (uint8_t)value;
+            n = 3;
+        } else {
+            head[0] = major | 26;
+            head[1] = (uint8_t)(value >> 24);
+            head[2] = (uint8_t)(value >> 16);
+            head[3] = (uint8_t)(value >> 8);
+            head[4] = (uint8_t)value;
+            n = 5;
+        }
+        putBytes(head, n);
+    }
+
+    void putByte(uint8_t value) { putBytes(&value, 1); }
+
+    void putBytes(const void *data, size_t n)
+    {
+        if (overflow || length + n > capacity) {
+            overflow = true;
+            return;
+        }
+        memcpy(buffer + length, data, n);
+        length += n;
+    }
+
+    uint8_t *buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+};
+
+#endif /* __CBOR_ENCODER_H__ */
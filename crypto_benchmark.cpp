@@ -0,0 +1,210 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "crypto_benchmark.h"
+#include "mbedtls/config.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ecdh.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+
+/* Bytes processed per call in the throughput measurements, about one TLS record of MQTT traffic. */
+#define CRYPTO_BENCHMARK_CHUNK_SIZE  1024
+
+#ifndef TLS_PROFILE_NAME
+#define TLS_PROFILE_NAME "custom"
+#endif
+
+static uint8_t chunk[CRYPTO_BENCHMARK_CHUNK_SIZE];
+
+/* Bytes per second from a byte count and microseconds. */
+static unsigned long throughput(size_t bytes, uint32_t us)
+{
+    return us ? (unsigned long)((uint64_t)bytes * 1000000 / us) : 0;
+}
+
+CryptoBenchmark::CryptoBenchmark(const char *caPem, size_t bulkBytes)
+    : caPem(caPem), bulkBytes(bulkBytes), aesGcmUs(0), sha256Us(0), ecdheUs(0), rsaUs(0), rsaBits(0), heapPeak(0)
+{
+}
+
+int CryptoBenchmark::run()
+{
+    // The throughput loops process whole chunks.
+    bulkBytes = (bulkBytes + sizeof(chunk) - 1) / sizeof(chunk) * sizeof(chunk);
+    memset(chunk, 0xA5, sizeof(chunk));
+
+    int ret = runAesGcm(bulkBytes);
+    if (ret == 0) {
+        ret = runSha256(bulkBytes);
+    }
+    if (ret == 0) {
+        ret = runEcdhe();
+    }
+    if (ret == 0) {
+        ret = runRsa(caPem);
+    }
+
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    heapPeak = heap.max_size;
+    return ret;
+}
+
+int CryptoBenchmark::runAesGcm(size_t bulkBytes)
+{
+    static const uint8_t key[16] = { 0 };
+    uint8_t iv[12] = { 0 };
+    uint8_t tag[16];
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    int ret = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128);
+
+    Timer timer;
+    timer.start();
+    for (size_t done = 0; ret == 0 && done < bulkBytes; done += sizeof(chunk)) {
+        iv[0]++;
+        ret = mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, sizeof(chunk), iv, sizeof(iv),
+                                        NULL, 0, chunk, chunk, sizeof(tag), tag);
+    }
+    timer.stop();
+    aesGcmUs = timer.read_us();
+
+    mbedtls_gcm_free(&gcm);
+    return ret;
+}
+
+int CryptoBenchmark::runSha256(size_t bulkBytes)
+{
+    uint8_t digest[32];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+
+    Timer timer;
+    timer.start();
+    int ret = mbedtls_sha256_starts_ret(&sha, 0);
+    for (size_t done = 0; ret == 0 && done < bulkBytes; done += sizeof(chunk)) {
+        ret = mbedtls_sha256_update_ret(&sha, chunk, sizeof(chunk));
+    }
+    if (ret == 0) {
+        ret = mbedtls_sha256_finish_ret(&sha, digest);
+    }
+    timer.stop();
+    sha256Us = timer.read_us();
+
+    mbedtls_sha256_free(&sha);
+    return ret;
+}
+
+int CryptoBenchmark::runEcdhe()
+{
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d, peerD, z;
+    mbedtls_ecp_point q, peerQ;
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_mpi_init(&d);
+    mbedtls_mpi_init(&peerD);
+    mbedtls_mpi_init(&z);
+    mbedtls_ecp_point_init(&q);
+    mbedtls_ecp_point_init(&peerQ);
+
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                    (const unsigned char*)"crypto-benchmark", 16);
+    if (ret == 0) {
+        ret = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1);
+    }
+    // The server's share, not part of the measurement.
+    if (ret == 0) {
+        ret = mbedtls_ecdh_gen_public(&grp, &peerD, &peerQ, mbedtls_ctr_drbg_random, &drbg);
+    }
+    if (ret == 0) {
+        // What the client does in the handshake: generate its share, then the shared secret.
+        Timer timer;
+        timer.start();
+        ret = mbedtls_ecdh_gen_public(&grp, &d, &q, mbedtls_ctr_drbg_random, &drbg);
+        if (ret == 0) {
+            ret = mbedtls_ecdh_compute_shared(&grp, &z, &peerQ, &d, mbedtls_ctr_drbg_random, &drbg);
+        }
+        timer.stop();
+        ecdheUs = timer.read_us();
+    }
+
+    mbedtls_ecp_point_free(&peerQ);
+    mbedtls_ecp_point_free(&q);
+    mbedtls_mpi_free(&z);
+    mbedtls_mpi_free(&peerD);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&grp);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    return ret;
+}
+
+int CryptoBenchmark::runRsa(const char *caPem)
+{
+#if defined(MBEDTLS_RSA_C)
+    mbedtls_x509_crt ca;
+    mbedtls_x509_crt_init(&ca);
+    int ret = mbedtls_x509_crt_parse(&ca, (const unsigned char*)caPem, strlen(caPem) + 1);
+    if (ret == 0 && mbedtls_pk_get_type(&ca.pk) != MBEDTLS_PK_RSA) {
+        // Nothing to measure, e.g. with an ECDSA root CA.
+        mbedtls_x509_crt_free(&ca);
+        return 0;
+    }
+    if (ret == 0) {
+        mbedtls_rsa_context *rsa = mbedtls_pk_rsa(ca.pk);
+        const size_t len = mbedtls_rsa_get_len(rsa);
+        rsaBits = len * 8;
+        // Any input below the modulus will do, the result is not checked.
+        uint8_t input[MBEDTLS_MPI_MAX_SIZE] = { 0 };
+        uint8_t output[MBEDTLS_MPI_MAX_SIZE];
+        input[len - 1] = 2;
+
+        Timer timer;
+        timer.start();
+        ret = mbedtls_rsa_public(rsa, input, output);
+        timer.stop();
+        rsaUs = timer.read_us();
+    }
+    mbedtls_x509_crt_free(&ca);
+    return ret;
+#else
+    // RSA is compiled out, e.g. with tls-ecc-only.
+    return 0;
+#endif
+}
+
+void CryptoBenchmark::print() const
+{
+    printf("\r\n----- Crypto benchmark -----\r\n");
+    printf("TLS profile:      %s\r\n", TLS_PROFILE_NAME);
+    printf("AES-128-GCM:      %lu bytes/s\r\n", throughput(bulkBytes, aesGcmUs));
+    printf("SHA-256:          %lu bytes/s\r\n", throughput(bulkBytes, sha256Us));
+    printf("ECDHE P-256:      %lu us\r\n", (unsigned long)ecdheUs);
+    if (rsaBits > 0) {
+        printf("RSA-%u public:  %lu us\r\n", rsaBits, (unsigned long)rsaUs);
+    }
+    printf("Heap peak:        %lu bytes\r\n", (unsigned long)heapPeak);
+    printf("----------------------------\r\n\r\n");
+}
@@ -0,0 +1,64 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __CRYPTO_BENCHMARK_H__
+#define __CRYPTO_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+
+/*
+ * Measures the primitives behind the TLS connection to IoT Hub with the
+ * mbed TLS profile the firmware was built with (tls-profile in
+ * mbed_app.json): AES-128-GCM and SHA-256 throughput, the client side of an
+ * ECDHE P-256 key exchange, and an RSA public key operation with the root CA
+ * key, which stands in for verifying the server's RSA certificate chain.
+ * The RSA figure is skipped if the CA key is not RSA or RSA is compiled out.
+ *
+ * Run it before connecting so that the heap peak it reports belongs to the
+ * benchmark. The full handshake time is reported by the phase report and
+ * the MQTT benchmark.
+ */
+class CryptoBenchmark : public Benchmark {
+public:
+    /* Processes `bulkBytes` bytes for the throughput figures. `caPem` provides the RSA key. */
+    CryptoBenchmark(const char *caPem, size_t bulkBytes);
+
+    virtual const char *name() const { return "crypto benchmark"; }
+
+    /* Runs every measurement. Returns 0 or the first failing mbed TLS error code. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    int runAesGcm(size_t bulkBytes);
+    int runSha256(size_t bulkBytes);
+    int runEcdhe();
+    int runRsa(const char *caPem);
+
+    const char *caPem;
+    size_t bulkBytes;
+    uint32_t aesGcmUs;
+    uint32_t sha256Us;
+    uint32_t ecdheUs;
+    uint32_t rsaUs;
+    unsigned int rsaBits;
+    uint32_t heapPeak;
+};
+
+#endif /* __CRYPTO_BENCHMARK_H__ */
@@ -0,0 +1,226 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "deferred_log.h"
+
+/* Stack of the drain thread, which runs printf. */
+#define DEFERRED_LOG_STACK_SIZE  2048
+
+/* Starts every line of binary output, so the decoder can tell it from other console output. */
+#define DEFERRED_LOG_BINARY_MARKER  '~'
+
+#define LOG_FORMAT_STRING(id, format) format,
+static const char *const logFormats[] = {
+    LOG_FORMATS(LOG_FORMAT_STRING)
+};
+#undef LOG_FORMAT_STRING
+
+DeferredLog::DeferredLog()
+    : records(NULL), capacity(0), binary(false), started(false), thread(NULL), ready(0, 1),
+      head(0), tail(0), writeCount(0), dropCount(0), highWater(0)
+{
+}
+
+DeferredLog::DeferredLog(DeferredLogRecord *records, uint32_t capacity, bool binary)
+    : records(records), capacity(capacity), binary(binary), started(false), thread(NULL), ready(0, 1),
+      head(0), tail(0), writeCount(0), dropCount(0), highWater(0)
+{
+    MBED_ASSERT((capacity & (capacity - 1)) == 0);
+}
+
+DeferredLog *DeferredLog::immediate()
+{
+    static DeferredLog log;
+    return &log;
+}
+
+bool DeferredLog::start()
+{
+    if (started || capacity < 2) {
+        return started;
+    }
+    thread = new Thread(osPriorityLow, DEFERRED_LOG_STACK_SIZE, NULL, "log");
+    if (thread->start(callback(this, &DeferredLog::drain)) != osOK) {
+        delete thread;
+        thread = NULL;
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+void DeferredLog::append(LogFormat format, uint8_t argCount, uint32_t a0, uint32_t a1, uint32_t a2,
+                         const char *text, size_t length)
+{
+    writeCount++;
+    if (!started) {
+        const uint32_t args[DEFERRED_LOG_MAX_ARGS] = { a0, a1, a2 };
+        printText(format, argCount, args, text, (int)length);
+        return;
+    }
+
+    const uint32_t h = head;
+    const uint32_t next = (h + 1) & (capacity - 1);
+    if (next == core_util_atomic_load_u32(&tail)) {
+        core_util_atomic_incr_u32(&dropCount, 1);
+        return;
+    }
+    DeferredLogRecord &record = records[h];
+    record.timestamp = us_ticker_read();
+    record.format = (uint16_t)format;
+    record.argCount = argCount;
+    record.args[0] = a0;
+    record.args[1] = a1;
+    record.args[2] = a2;
+    if (length >= DEFERRED_LOG_TEXT_SIZE) {
+        length = DEFERRED_LOG_TEXT_SIZE - 1;
+    }
+    if (text) {
+        memcpy(record.text, text, length);
+    } else {
+        length = 0;
+    }
+    record.text[length] = '\0';
+    record.textLength = (uint8_t)length;
+    core_util_atomic_store_u32(&head, next);
+
+    const uint32_t used = (next - core_util_atomic_load_u32(&tail)) & (capacity - 1);
+    if (used > highWater) {
+        highWater = used;
+    }
+    // Wake the drain thread unless it is still busy with older records, it
+    // reads up to the new head before sleeping again.
+    if (core_util_atomic_load_u32(&tail) == h) {
+        ready.release();
+    }
+}
+
+void DeferredLog::drain()
+{
+    uint32_t reportedDrops = 0;
+    while (true) {
+        ready.acquire();
+        uint32_t t = tail;
+        while (t != core_util_atomic_load_u32(&head)) {
+            print(records[t]);
+            t = (t + 1) & (capacity - 1);
+            core_util_atomic_store_u32(&tail, t);
+        }
+        const uint32_t drops = core_util_atomic_load_u32(&dropCount);
+        if (drops != reportedDrops) {
+            DeferredLogRecord record;
+            record.timestamp = us_ticker_read();
+            record.format = LOG_DROPPED;
+            record.argCount = 1;
+            record.args[0] = drops - reportedDrops;
+            record.textLength = 0;
+            record.text[0] = '\0';
+            print(record);
+            reportedDrops = drops;
+        }
+    }
+}
+
+void DeferredLog::print(const DeferredLogRecord &record) const
+{
+    if (binary) {
+        printBinary(record);
+    } else {
+        printText((LogFormat)record.format, record.argCount, record.args, record.text, record.textLength);
+    }
+}
+
+/*
+ * Prints `record` as one line: the marker, then in hex the timestamp and
+ * format (little endian), argument count, text length, the arguments (little
+ * endian) and the text.
+ */
+void DeferredLog::printBinary(const DeferredLogRecord &record) const
+{
+    static const char hex[] = "0123456789abcdef";
+    uint8_t bytes[8 + 4 * DEFERRED_LOG_MAX_ARGS + DEFERRED_LOG_TEXT_SIZE];
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) {
+        bytes[n++] = (uint8_t)(record.timestamp >> (8 * i));
+    }
+    bytes[n++] = (uint8_t)record.format;
+    bytes[n++] = (uint8_t)(record.format >> 8);
+    bytes[n++] = record.argCount;
+    bytes[n++] = record.textLength;
+    for (uint8_t a = 0; a < record.argCount; a++) {
+        for (int i = 0; i < 4; i++) {
+            bytes[n++] = (uint8_t)(record.args[a] >> (8 * i));
+        }
+    }
+    memcpy(bytes + n, record.text, record.textLength);
+    n += record.textLength;
+
+    char line[1 + 2 * sizeof(bytes) + 3];
+    size_t length = 0;
+    line[length++] = DEFERRED_LOG_BINARY_MARKER;
+    for (size_t i = 0; i < n; i++) {
+        line[length++] = hex[bytes[i] >> 4];
+        line[length++] = hex[bytes[i] & 0x0F];
+    }
+    line[length++] = '\r';
+    line[length++] = '\n';
+    line[length] = '\0';
+    printf("%s", line);
+}
+
+void DeferredLog::printText(LogFormat format, uint8_t argCount, const uint32_t *args, const char *text, int length)
+{
+    if ((unsigned int)format >= LOG_FORMAT_COUNT) {
+        return;
+    }
+    const char *f = logFormats[format];
+    // A %s is the last conversion, after argCount integers.
+    const char *conversion = strstr(f, "%s");
+    if (!conversion) {
+        printf(f, (unsigned long)args[0], (unsigned long)args[1], (unsigned long)args[2]);
+        return;
+    }
+    if (!text) {
+        text = "";
+        length = 0;
+    }
+    // Printed through %.*s, the text need not be terminated.
+    char textFormat[96];
+    if ((size_t)(conversion - f) + strlen(conversion) + 2 >= sizeof(textFormat)) {
+        return;
+    }
+    snprintf(textFormat, sizeof(textFormat), "%.*s%%.*s%s", (int)(conversion - f), f, conversion + 2);
+    switch (argCount) {
+        case 0:
+            printf(textFormat, length, text);
+            break;
+        case 1:
+            printf(textFormat, (unsigned long)args[0], length, text);
+            break;
+        default:
+            printf(textFormat, (unsigned long)args[0], (unsigned long)args[1], length, text);
+            break;
+    }
+}
+
+void DeferredLog::printStats() const
+{
+    printf("Log: %lu records written, %lu dropped, ring high water %lu of %lu\r\n",
+           (unsigned long)writeCount, (unsigned long)core_util_atomic_load_u32(&dropCount),
+           (unsigned long)highWater, (unsigned long)(capacity > 0 ? capacity - 1 : 0));
+}
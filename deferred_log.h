@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __DEFERRED_LOG_H__
+#define __DEFERRED_LOG_H__
+
+#include "mbed.h"
+#include "log_formats.h"
+
+/* Integer arguments and text bytes, including the NUL, a record can hold. */
+#define DEFERRED_LOG_MAX_ARGS   3
+#define DEFERRED_LOG_TEXT_SIZE  44
+
+/* One log message as written on the hot path, formatted later. 64 bytes. */
+struct DeferredLogRecord {
+    uint32_t timestamp;     // us_ticker_read() at the time of the write.
+    uint16_t format;        // LogFormat
+    uint8_t argCount;
+    uint8_t textLength;     // Bytes in text, not counting the NUL.
+    uint32_t args[DEFERRED_LOG_MAX_ARGS];
+    char text[DEFERRED_LOG_TEXT_SIZE];
+};
+
+/*
+ * Console log which keeps printf off the hot path.
+ *
+ * write() only copies the format id, its arguments and a timestamp into a
+ * single-producer/single-consumer ring, the same way TelemetryQueue works,
+ * so it never blocks on the serial port. A low priority thread drains the
+ * ring whenever the main loop is idle, either formatting each record with
+ * printf or, in binary mode, printing it as one hex line for
+ * tools/decode_log.py, which takes a fraction of the bytes on the wire.
+ * Records are dropped and counted while the ring is full.
+ *
+ * Text arguments are copied and cut to DEFERRED_LOG_TEXT_SIZE - 1 bytes.
+ * Only one thread may write, the main loop. A log constructed without a
+ * ring, or not started, prints every message right away and in full.
+ */
+class DeferredLog {
+public:
+    /* A log which prints right away. */
+    DeferredLog();
+
+    /* A log deferred through `records`. `capacity` must be a power of two. */
+    DeferredLog(DeferredLogRecord *records, uint32_t capacity, bool binary);
+
+    /* Starts the drain thread. Returns false and keeps printing right away if it cannot start. */
+    bool start();
+
+    void write(LogFormat format)
+    {
+        append(format, 0, 0, 0, 0, NULL, 0);
+    }
+    void write(LogFormat format, uint32_t a0)
+    {
+        append(format, 1, a0, 0, 0, NULL, 0);
+    }
+    void write(LogFormat format, uint32_t a0, uint32_t a1)
+    {
+        append(format, 2, a0, a1, 0, NULL, 0);
+    }
+    void write(LogFormat format, uint32_t a0, uint32_t a1, uint32_t a2)
+    {
+        append(format, 3, a0, a1, a2, NULL, 0);
+    }
+
+    /* As write(), with `length` bytes of `text` for the %s at the end of the format. */
+    void writeText(LogFormat format, const char *text, size_t length)
+    {
+        append(format, 0, 0, 0, 0, text, length);
+    }
+    void writeText(LogFormat format, uint32_t a0, const char *text, size_t length)
+    {
+        append(format, 1, a0, 0, 0, text, length);
+    }
+    void writeText(LogFormat format, uint32_t a0, uint32_t a1, const char *text, size_t length)
+    {
+        append(format, 2, a0, a1, 0, text, length);
+    }
+
+    /* Prints records written and dropped and the ring's high water mark to the console. */
+    void printStats() const;
+
+    /* The log modules print through until they are given another one. Prints right away. */
+    static DeferredLog *immediate();
+
+private:
+    void append(LogFormat format, uint8_t argCount, uint32_t a0, uint32_t a1, uint32_t a2,
+                const char *text, size_t length);
+    void drain();
+    void print(const DeferredLogRecord &record) const;
+    void printBinary(const DeferredLogRecord &record) const;
+    static void printText(LogFormat format, uint8_t argCount, const uint32_t *args, const char *text, int length);
+
+    DeferredLogRecord *records;
+    uint32_t capacity;
+    bool binary;
+    bool started;
+    Thread *thread;
+    Semaphore ready;        // Released when a record is written into an empty ring.
+
+    volatile uint32_t head; // Written by the main loop only.
+    volatile uint32_t tail; // Written by the drain thread only.
+
+    // Statistics
+    uint32_t writeCount;
+    volatile uint32_t dropCount;
+    uint32_t highWater;
+};
+
+#endif /* __DEFERRED_LOG_H__ */
@@ -0,0 +1,688 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "device_twin.h"
+#include "topic_builder.h"
+
+/* Topics published by the device, the request id is appended as $rid. */
+static constexpr auto twinGetTopic = makeTopic("$iothub/twin/GET/?");
+static constexpr auto twinReportTopic = makeTopic("$iothub/twin/PATCH/properties/reported/?");
+/* Longest topic published: the PATCH topic, "$rid=" and a 32-bit request id. */
+#define DEVICE_TWIN_TOPIC_SIZE  (sizeof("$iothub/twin/PATCH/properties/reported/?$rid=") + 10)
+
+/* Time after which a GET or a PATCH without a response is taken as lost and sent again. */
+#define DEVICE_TWIN_RESPONSE_TIMEOUT_MS  30000
+
+#define TWIN_RESPONSE_PREFIX    "$iothub/twin/res/"
+#define TWIN_DESIRED_PREFIX     "$iothub/twin/PATCH/properties/desired/"
+
+/*
+ * Minimal JSON scanning. Values are not converted until a property of the
+ * table asks for them, everything else is skipped over without copying.
+ */
+static const char *skipSpace(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/* Skips the string starting at `p`, which points at the opening quote. Returns NULL if unterminated. */
+static const char *skipString(const char *p, const char *end)
+{
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+/* Skips any value including nested objects and arrays. Returns NULL if it is not valid. */
+static const char *skipValue(const char *p, const char *end)
+{
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        return skipString(p, end);
+    }
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (p < end) {
+            if (*p == '"') {
+                p = skipString(p, end);
+                if (!p) {
+                    return NULL;
+                }
+                continue;
+            }
+            if (*p == '{' || *p == '[') {
+                depth++;
+            } else if (*p == '}' || *p == ']') {
+                if (--depth == 0) {
+                    return p + 1;
+                }
+            }
+            p++;
+        }
+        return NULL;
+    }
+    // Number, true, false or null.
+    const char *start = p;
+    while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+        p++;
+    }
+    return (p > start) ? p : NULL;
+}
+
+/*
+ * Iterates over the members of the object at `p`. Each call returns true and
+ * the next key, without quotes, and value, or false at the end of the object
+ * or if the JSON is not valid, which `valid` tells apart.
+ */
+class JsonMembers {
+public:
+    JsonMembers(const char *p, const char *end) : p(skipSpace(p, end)), end(end), valid(true), first(true)
+    {
+        if (this->p >= end || *this->p != '{') {
+            valid = false;
+        } else {
+            this->p++;
+        }
+    }
+
+    bool next(const char *&key, size_t &keyLength, const char *&value, const char *&valueEnd)
+    {
+        if (!valid) {
+            return false;
+        }
+        p = skipSpace(p, end);
+        if (p < end && *p == '}') {
+            return false;
+        }
+        if (!first) {
+            if (p >= end || *p != ',') {
+                valid = false;
+                return false;
+            }
+            p = skipSpace(p + 1, end);
+        }
+        first = false;
+        const char *keyEnd = (p < end && *p == '"') ? skipString(p, end) : NULL;
+        if (!keyEnd) {
+            valid = false;
+            return false;
+        }
+        key = p + 1;
+        keyLength = keyEnd - 1 - key;
+        p = skipSpace(keyEnd, end);
+        if (p >= end || *p != ':') {
+            valid = false;
+            return false;
+        }
+        value = skipSpace(p + 1, end);
+        valueEnd = skipValue(value, end);
+        if (!valueEnd) {
+            valid = false;
+            return false;
+        }
+        p = valueEnd;
+        return true;
+    }
+
+    bool isValid() const { return valid; }
+
+private:
+    const char *p;
+    const char *end;
+    bool valid;
+    bool first;
+};
+
+static bool keyEquals(const char *key, size_t keyLength, const char *name)
+{
+    return strncmp(key, name, keyLength) == 0 && name[keyLength] == '\0';
+}
+
+/* Parses a JSON number as an integer, dropping any fraction. */
+static bool parseInt(const char *p, const char *end, int32_t &value)
+{
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') {
+        return false;
+    }
+    int64_t result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (result <= INT32_MAX) {
+            result = result * 10 + (*p - '0');
+        }
+    }
+    if (negative) {
+        result = -result;
+    }
+    value = (result > INT32_MAX) ? INT32_MAX : (result < INT32_MIN) ? INT32_MIN : (int32_t)result;
+    return true;
+}
+
+/* Copies the JSON string at `p` into `out`, resolving simple escapes and truncating to `size`. */
+static void copyString(const char *p, const char *end, char *out, size_t size)
+{
+    size_t n = 0;
+    for (p++; p < end - 1 && n + 1 < size; p++) {
+        char c = *p;
+        if (c == '\\' && p + 1 < end - 1) {
+            c = *++p;
+            if (c == 'n') {
+                c = '\n';
+            } else if (c == 't') {
+                c = '\t';
+            } else if (c == 'r') {
+                c = '\r';
+            } else if (c == 'u') {
+                // No Unicode support, keep a placeholder.
+                p += (end - 1 - p > 4) ? 4 : end - 2 - p;
+                c = '?';
+            }
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+}
+
+/* Appends `s` to the JSON text in `buffer` as a string. Returns false if it does not fit. */
+static bool appendJsonString(char *buffer, size_t size, size_t &length, const char *s)
+{
+    if (length + 1 >= size) {
+        return false;
+    }
+    buffer[length++] = '"';
+    for (; *s; s++) {
+        const bool escape = (*s == '"' || *s == '\\');
+        if ((unsigned char)*s < 0x20) {
+            continue;
+        }
+        if (length + (escape ? 2 : 1) + 1 >= size) {
+            return false;
+        }
+        if (escape) {
+            buffer[length++] = '\\';
+        }
+        buffer[length++] = *s;
+    }
+    buffer[length++] = '"';
+    return true;
+}
+
+/* Appends "name":value to the JSON text in `buffer`. Returns false if it does not fit. */
+static bool appendReported(char *buffer, size_t size, size_t &length, bool comma, const TwinProperty &property)
+{
+    if (comma) {
+        if (length + 1 >= size) {
+            return false;
+        }
+        buffer[length++] = ',';
+    }
+    if (!appendJsonString(buffer, size, length, property.name) || length + 1 >= size) {
+        return false;
+    }
+    buffer[length++] = ':';
+    if (property.present && property.type == TWIN_TYPE_STRING) {
+        return appendJsonString(buffer, size, length, property.text);
+    }
+    int n;
+    if (!property.present) {
+        // null removes the property from the twin.
+        n = snprintf(buffer + length, size - length, "null");
+    } else if (property.type == TWIN_TYPE_INT) {
+        n = snprintf(buffer + length, size - length, "%ld", (long)property.number);
+    } else {
+        n = snprintf(buffer + length, size - length, "%s", property.number ? "true" : "false");
+    }
+    if (n < 0 || length + n >= size) {
+        return false;
+    }
+    length += n;
+    return true;
+}
+
+/* Time left of `periodMs` started at `since`, at least 1 ms so that 0 can mean nothing is pending. */
+static uint32_t msLeft(uint64_t now, uint64_t since, uint32_t periodMs)
+{
+    return (now - since >= periodMs) ? 1 : (uint32_t)(periodMs - (now - since));
+}
+
+DeviceTwin::DeviceTwin(TwinProperty *desired, size_t desiredCount, TwinProperty *reported, size_t reportedCount,
+                       char *buffer, size_t bufferSize, uint32_t reportWindowMs)
+    : desired(desired), desiredCount(desiredCount), reported(reported), reportedCount(reportedCount),
+      buffer(buffer), bufferSize(bufferSize), reportWindowMs(reportWindowMs), client(NULL),
+      version(0), nextRid(1), getRid(0), getSentMs(0), patchRid(0), patchSentMs(0), dirtyMask(0), inFlightMask(0), firstDirtyMs(0),
+      twinsApplied(0), patchesApplied(0), patchesIgnored(0), reportWrites(0), reportsSent(0), reportErrors(0),
+      applyUsTotal(0), applyUsMax(0)
+{
+    MBED_ASSERT(desiredCount <= DEVICE_TWIN_MAX_PROPERTIES && reportedCount <= DEVICE_TWIN_MAX_PROPERTIES);
+}
+
+void DeviceTwin::setClient(MQTTClient *client)
+{
+    this->client = client;
+    // Responses to the old connection's requests will not come.
+    getRid = 0;
+    requeueInFlight();
+}
+
+void DeviceTwin::requeueInFlight()
+{
+    patchRid = 0;
+    if (inFlightMask) {
+        if (dirtyMask == 0) {
+            firstDirtyMs = Kernel::get_ms_count();
+        }
+        dirtyMask |= inFlightMask;
+        inFlightMask = 0;
+    }
+}
+
+int DeviceTwin::requestTwin()
+{
+    if (!client) {
+        return MQTT::FAILURE;
+    }
+    char topicBuffer[DEVICE_TWIN_TOPIC_SIZE];
+    TopicWriter topic(topicBuffer, sizeof(topicBuffer), twinGetTopic);
+    const uint32_t rid = nextRid++;
+    topic.property("$rid", rid);
+
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.id = 0;
+    message.payload = NULL;
+    message.payloadlen = 0;
+    int rc = client->publish(topic.c_str(), message);
+    if (rc == MQTT::SUCCESS) {
+        getRid = rid;
+        getSentMs = Kernel::get_ms_count();
+    }
+    return rc;
+}
+
+bool DeviceTwin::handleMessage(const char *topic, const char *payload, size_t payloadLength)
+{
+    if (strncmp(topic, TWIN_DESIRED_PREFIX, sizeof(TWIN_DESIRED_PREFIX) - 1) == 0) {
+        applyDesiredPatch(payload, payloadLength);
+        return true;
+    }
+    if (strncmp(topic, TWIN_RESPONSE_PREFIX, sizeof(TWIN_RESPONSE_PREFIX) - 1) == 0) {
+        handleResponse(topic, payload, payloadLength);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Response topic: $iothub/twin/res/{status}/?$rid={request id}[&$version={version}]
+ */
+void DeviceTwin::handleResponse(const char *topic, const char *payload, size_t payloadLength)
+{
+    const int status = atoi(topic + sizeof(TWIN_RESPONSE_PREFIX) - 1);
+    const char *ridText = strstr(topic, "$rid=");
+    const uint32_t rid = ridText ? (uint32_t)strtoul(ridText + 5, NULL, 10) : 0;
+    if (rid == 0) {
+        return;
+    }
+
+    if (rid == getRid) {
+        getRid = 0;
+        if (status == 200) {
+            if (applyTwin(payload, payloadLength) < 0) {
+                printf("WARNING: twin document is not valid JSON.\r\n");
+            }
+        } else {
+            printf("WARNING: twin request failed with status %d.\r\n", status);
+        }
+    } else if (rid == patchRid) {
+        if (status < 200 || status >= 300) {
+            printf("WARNING: reported properties rejected with status %d.\r\n", status);
+            reportErrors++;
+            // Sent again with the next PATCH.
+            requeueInFlight();
+        }
+        patchRid = 0;
+        inFlightMask = 0;
+    }
+}
+
+int DeviceTwin::applyTwin(const char *json, size_t length)
+{
+    // {"desired": {...}, "reported": {...}}
+    const char *end = json + length;
+    JsonMembers root(json, end);
+    const char *key;
+    const char *value;
+    const char *valueEnd;
+    size_t keyLength;
+    while (root.next(key, keyLength, value, valueEnd)) {
+        if (keyEquals(key, keyLength, "desired")) {
+            return applyDesired(value, valueEnd, true);
+        }
+    }
+    return root.isValid() ? applyDesired("{}", "{}" + 2, true) : -1;
+}
+
+int DeviceTwin::applyDesiredPatch(const char *json, size_t length)
+{
+    return applyDesired(json, json + length, false);
+}
+
+int DeviceTwin::applyDesired(const char *json, const char *end, bool full)
+{
+    Timer timer;
+    timer.start();
+
+    // Find the version first, a stale patch must not change anything.
+    uint32_t newVersion = 0;
+    const char *key;
+    const char *value;
+    const char *valueEnd;
+    size_t keyLength;
+    {
+        JsonMembers members(json, end);
+        while (members.next(key, keyLength, value, valueEnd)) {
+            if (keyEquals(key, keyLength, "$version")) {
+                int32_t v;
+                if (parseInt(value, valueEnd, v) && v > 0) {
+                    newVersion = (uint32_t)v;
+                }
+            }
+        }
+        if (!members.isValid()) {
+            return -1;
+        }
+    }
+    if (!full && newVersion != 0 && newVersion <= version) {
+        patchesIgnored++;
+        return 0;
+    }
+    const bool missedPatch = !full && version != 0 && newVersion > version + 1;
+
+    // A full twin replaces the table, properties it does not hold are absent.
+    uint32_t seenMask = 0;
+    uint32_t changedMask = 0;
+    JsonMembers members(json, end);
+    while (members.next(key, keyLength, value, valueEnd)) {
+        size_t i;
+        for (i = 0; i < desiredCount; i++) {
+            if (keyEquals(key, keyLength, desired[i].name)) {
+                break;
+            }
+        }
+        if (i == desiredCount) {
+            continue;
+        }
+        TwinProperty &property = desired[i];
+        seenMask |= 1UL << i;
+        if (*value == 'n') {
+            // null removes the property.
+            if (property.present) {
+                property.present = false;
+                changedMask |= 1UL << i;
+            }
+            continue;
+        }
+        int32_t number = 0;
+        if (property.type == TWIN_TYPE_INT) {
+            if (!parseInt(value, valueEnd, number)) {
+                printf("WARNING: desired property %s is not a number.\r\n", property.name);
+                continue;
+            }
+        } else if (property.type == TWIN_TYPE_BOOL) {
+            if (*value != 't' && *value != 'f') {
+                printf("WARNING: desired property %s is not a boolean.\r\n", property.name);
+                continue;
+            }
+            number = (*value == 't');
+        } else {
+            if (*value != '"') {
+                printf("WARNING: desired property %s is not a string.\r\n", property.name);
+                continue;
+            }
+            // Compare through a copy in the property's own buffer only if the text differs.
+            const size_t rawLength = valueEnd - value - 2;
+            if (property.present && memchr(value, '\\', valueEnd - value) == NULL
+                    && rawLength < property.textSize && strncmp(property.text, value + 1, rawLength) == 0
+                    && property.text[rawLength] == '\0') {
+                continue;
+            }
+            copyString(value, valueEnd, property.text, property.textSize);
+            property.present = true;
+            changedMask |= 1UL << i;
+            continue;
+        }
+        if (!property.present || property.number != number) {
+            property.number = number;
+            property.present = true;
+            changedMask |= 1UL << i;
+        }
+    }
+    if (full) {
+        for (size_t i = 0; i < desiredCount; i++) {
+            if (!(seenMask & (1UL << i)) && desired[i].present) {
+                desired[i].present = false;
+                changedMask |= 1UL << i;
+            }
+        }
+        twinsApplied++;
+    } else {
+        patchesApplied++;
+    }
+    if (newVersion != 0) {
+        version = newVersion;
+    }
+
+    timer.stop();
+    const uint32_t us = timer.read_us();
+    applyUsTotal += us;
+    if (us > applyUsMax) {
+        applyUsMax = us;
+    }
+
+    int changed = 0;
+    for (size_t i = 0; i < desiredCount; i++) {
+        if (changedMask & (1UL << i)) {
+            changed++;
+            if (desiredCallback) {
+                desiredCallback(i);
+            }
+        }
+    }
+    if (missedPatch) {
+        printf("WARNING: desired properties patch missed, fetching the twin.\r\n");
+        requestTwin();
+    }
+    return changed;
+}
+
+void DeviceTwin::markReported(size_t index)
+{
+    reportWrites++;
+    if (dirtyMask == 0) {
+        firstDirtyMs = Kernel::get_ms_count();
+    }
+    dirtyMask |= 1UL << index;
+}
+
+void DeviceTwin::reportInt(size_t index, int32_t value)
+{
+    MBED_ASSERT(index < reportedCount && reported[index].type == TWIN_TYPE_INT);
+    reported[index].number = value;
+    reported[index].present = true;
+    markReported(index);
+}
+
+void DeviceTwin::reportBool(size_t index, bool value)
+{
+    MBED_ASSERT(index < reportedCount && reported[index].type == TWIN_TYPE_BOOL);
+    reported[index].number = value;
+    reported[index].present = true;
+    markReported(index);
+}
+
+void DeviceTwin::reportString(size_t index, const char *value)
+{
+    MBED_ASSERT(index < reportedCount && reported[index].type == TWIN_TYPE_STRING);
+    TwinProperty &property = reported[index];
+    if (value) {
+        strncpy(property.text, value, property.textSize - 1);
+        property.text[property.textSize - 1] = '\0';
+    }
+    property.present = (value != NULL);
+    markReported(index);
+}
+
+int DeviceTwin::poll()
+{
+    const uint64_t now = Kernel::get_ms_count();
+    if (getRid != 0 && now - getSentMs >= DEVICE_TWIN_RESPONSE_TIMEOUT_MS) {
+        printf("WARNING: no response to the twin request, asking again.\r\n");
+        getRid = 0;
+        int rc = requestTwin();
+        if (rc != MQTT::SUCCESS) {
+            return rc;
+        }
+    }
+    // A PATCH without a response is sent again by flush(), even with nothing new to report.
+    const bool isResponseLate = patchRid != 0 && now - patchSentMs >= DEVICE_TWIN_RESPONSE_TIMEOUT_MS;
+    if (!isResponseLate && (dirtyMask == 0 || now - firstDirtyMs < reportWindowMs)) {
+        return MQTT::SUCCESS;
+    }
+    return flush();
+}
+
+uint32_t DeviceTwin::nextPollMs() const
+{
+    const uint64_t now = Kernel::get_ms_count();
+    uint32_t next = 0;
+    if (getRid != 0) {
+        next = msLeft(now, getSentMs, DEVICE_TWIN_RESPONSE_TIMEOUT_MS);
+    }
+    // Changes made while a PATCH is in flight wait for its response or its timeout.
+    uint32_t left = 0;
+    if (patchRid != 0) {
+        left = msLeft(now, patchSentMs, DEVICE_TWIN_RESPONSE_TIMEOUT_MS);
+    } else if (dirtyMask != 0) {
+        left = msLeft(now, firstDirtyMs, reportWindowMs);
+    }
+    if (left != 0 && (next == 0 || left < next)) {
+        next = left;
+    }
+    return next;
+}
+
+int DeviceTwin::flush()
+{
+    // One PATCH at a time, the next one waits for the response to this one.
+    if (patchRid != 0 && Kernel::get_ms_count() - patchSentMs >= DEVICE_TWIN_RESPONSE_TIMEOUT_MS) {
+        printf("WARNING: no response to reported properties, sending them again.\r\n");
+        reportErrors++;
+        requeueInFlight();
+    }
+    if (dirtyMask == 0 || patchRid != 0) {
+        return MQTT::SUCCESS;
+    }
+    if (!client) {
+        return MQTT::FAILURE;
+    }
+
+    // {"name":value,...}, null for a removed property.
+    size_t length = 0;
+    uint32_t sentMask = 0;
+    buffer[length++] = '{';
+    for (size_t i = 0; i < reportedCount; i++) {
+        if (!(dirtyMask & (1UL << i))) {
+            continue;
+        }
+        const size_t start = length;
+        // One byte is kept for the closing brace.
+        if (!appendReported(buffer, bufferSize - 1, length, sentMask != 0, reported[i])) {
+            length = start;
+            if (sentMask == 0) {
+                // It does not fit on its own either, so it is dropped and the others still go out.
+                printf("ERROR: reported property %s does not fit into the twin buffer.\r\n", reported[i].name);
+                reportErrors++;
+                dirtyMask &= ~(1UL << i);
+                continue;
+            }
+            // The rest goes out with the next PATCH.
+            break;
+        }
+        sentMask |= 1UL << i;
+    }
+    buffer[length++] = '}';
+    if (sentMask == 0) {
+        return MQTT::FAILURE;
+    }
+
+    char topicBuffer[DEVICE_TWIN_TOPIC_SIZE];
+    TopicWriter topic(topicBuffer, sizeof(topicBuffer), twinReportTopic);
+    const uint32_t rid = nextRid++;
+    topic.property("$rid", rid);
+
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.id = 0;
+    message.payload = (void*)buffer;
+    message.payloadlen = length;
+    int rc = client->publish(topic.c_str(), message);
+    if (rc != MQTT::SUCCESS) {
+        reportErrors++;
+        printf("ERROR: rc from reported properties publish is %d\r\n", rc);
+        return rc;
+    }
+    reportsSent++;
+    patchRid = rid;
+    patchSentMs = Kernel::get_ms_count();
+    inFlightMask = sentMask;
+    dirtyMask &= ~sentMask;
+    if (dirtyMask) {
+        firstDirtyMs = Kernel::get_ms_count();
+    }
+    return rc;
+}
+
+void DeviceTwin::printStats() const
+{
+    const uint32_t applied = twinsApplied + patchesApplied;
+    printf("Twin: desired version %lu, %lu twins and %lu patches applied, %lu stale patches, "
+           "apply avg %lu us max %lu us\r\n",
+           (unsigned long)version, (unsigned long)twinsApplied, (unsigned long)patchesApplied,
+           (unsigned long)patchesIgnored, applied ? (unsigned long)(applyUsTotal / applied) : 0UL,
+           (unsigned long)applyUsMax);
+    printf("Twin: %lu reported writes sent in %lu patches, %lu errors\r\n",
+           (unsigned long)reportWrites, (unsigned long)reportsSent, (unsigned long)reportErrors);
+}
@@ -0,0 +1,176 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __DEVICE_TWIN_H__
+#define __DEVICE_TWIN_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+
+/* Topics to subscribe for twin responses and desired property patches. */
+#define DEVICE_TWIN_RESPONSE_TOPIC  "$iothub/twin/res/#"
+#define DEVICE_TWIN_DESIRED_TOPIC   "$iothub/twin/PATCH/properties/desired/#"
+/* Common prefix of every twin topic, used to tell twin messages from others. */
+#define DEVICE_TWIN_TOPIC_PREFIX    "$iothub/twin/"
+
+/* Value types of a TwinProperty. */
+#define TWIN_TYPE_INT       1
+#define TWIN_TYPE_BOOL      2
+#define TWIN_TYPE_STRING    3
+
+/* Largest number of desired or reported properties in a table. */
+#define DEVICE_TWIN_MAX_PROPERTIES  32
+
+/*
+ * One top-level twin property in a table laid out by the application, e.g.
+ *
+ *     static char label[16];
+ *     static TwinProperty desired[] = {
+ *         TWIN_PROPERTY_INT("interval"),
+ *         TWIN_PROPERTY_STRING("label", label),
+ *     };
+ *
+ * and addressed by its index. Strings are stored in the caller's buffer,
+ * truncated to fit. Nested objects are not supported.
+ */
+struct TwinProperty {
+    const char *name;
+    uint8_t type;
+    char *text;         // Value of TWIN_TYPE_STRING, NUL-terminated.
+    uint16_t textSize;
+    int32_t number;     // Value of TWIN_TYPE_INT, 0 or 1 for TWIN_TYPE_BOOL.
+    bool present;       // False until the property has a value, and after it was set to null.
+};
+
+#define TWIN_PROPERTY_INT(name)             { name, TWIN_TYPE_INT, NULL, 0, 0, false }
+#define TWIN_PROPERTY_BOOL(name)            { name, TWIN_TYPE_BOOL, NULL, 0, 0, false }
+#define TWIN_PROPERTY_STRING(name, buffer)  { name, TWIN_TYPE_STRING, buffer, sizeof(buffer), 0, false }
+
+/*
+ * IoT Hub device twin over MQTT.
+ *
+ * The full twin is fetched with requestTwin() after connecting. After that
+ * the desired properties are kept up to date from the PATCH messages IoT Hub
+ * sends, each applied on its own to the desired table without touching
+ * properties it does not mention. Patches older than the twin are ignored,
+ * and the full twin is fetched again if one was missed.
+ *
+ * Reported properties are changed in the reported table with report*(), which
+ * only marks them. Every change made within the report window goes out as
+ * one PATCH holding the latest value of each property, when flush() or
+ * poll() is called after the window. poll() also sends a GET or a PATCH
+ * again when its response has not come within DEVICE_TWIN_RESPONSE_TIMEOUT_MS.
+ *
+ * handleMessage() and the report functions must be called from the thread
+ * that calls MQTTClient::yield().
+ */
+class DeviceTwin {
+public:
+    DeviceTwin(TwinProperty *desired, size_t desiredCount, TwinProperty *reported, size_t reportedCount,
+               char *buffer, size_t bufferSize, uint32_t reportWindowMs);
+
+    /*
+     * Publishes through `client` from now on, NULL while disconnected.
+     * Reported properties of a PATCH without a response are sent again.
+     */
+    void setClient(MQTTClient *client);
+
+    /* Asks for the full twin. Returns MQTT::SUCCESS or the return code of the publish. */
+    int requestTwin();
+
+    /* Called with the index of every desired property a twin or a patch changed. */
+    void onDesiredChange(Callback<void(size_t)> callback) { desiredCallback = callback; }
+
+    /*
+     * Handles a message received on one of the twin topics. Returns false if
+     * `topic` is not a twin topic.
+     */
+    bool handleMessage(const char *topic, const char *payload, size_t payloadLength);
+
+    /* Changes a reported property. The change is sent with the next PATCH. */
+    void reportInt(size_t index, int32_t value);
+    void reportBool(size_t index, bool value);
+    void reportString(size_t index, const char *value);
+
+    /* True if a reported property changed since the last PATCH. */
+    bool reportPending() const { return dirtyMask != 0; }
+
+    /* True while a PATCH waits for its response. */
+    bool reportInFlight() const { return patchRid != 0; }
+
+    /*
+     * Sends the changed reported properties if the report window has passed,
+     * and repeats a GET or a PATCH whose response is overdue.
+     */
+    int poll();
+
+    /* Time until poll() has something to do, 0 if nothing is pending. */
+    uint32_t nextPollMs() const;
+
+    /* Sends the changed reported properties. Returns MQTT::SUCCESS or the return code of the publish. */
+    int flush();
+
+    /*
+     * Applies the desired properties of a full twin document or of a patch.
+     * Return the number of properties changed, or -1 if the JSON is not valid.
+     */
+    int applyTwin(const char *json, size_t length);
+    int applyDesiredPatch(const char *json, size_t length);
+
+    uint32_t desiredVersion() const { return version; }
+
+    void printStats() const;
+
+private:
+    int applyDesired(const char *json, const char *end, bool full);
+    void markReported(size_t index);
+    void requeueInFlight();
+    void handleResponse(const char *topic, const char *payload, size_t payloadLength);
+
+    TwinProperty *desired;
+    size_t desiredCount;
+    TwinProperty *reported;
+    size_t reportedCount;
+    char *buffer;           // Holds the JSON of a reported PATCH.
+    size_t bufferSize;
+    uint32_t reportWindowMs;
+    MQTTClient *client;
+    Callback<void(size_t)> desiredCallback;
+
+    uint32_t version;       // $version of the desired properties applied last.
+    uint32_t nextRid;
+    uint32_t getRid;        // Request id of the outstanding GET, 0 if none.
+    uint64_t getSentMs;     // Kernel tick when the outstanding GET was sent.
+    uint32_t patchRid;      // Request id of the outstanding PATCH, 0 if none.
+    uint64_t patchSentMs;   // Kernel tick when the outstanding PATCH was sent.
+    uint32_t dirtyMask;     // Reported properties changed since the last PATCH.
+    uint32_t inFlightMask;  // Reported properties of the outstanding PATCH.
+    uint64_t firstDirtyMs;  // Kernel tick of the oldest unsent change.
+
+    // Statistics
+    uint32_t twinsApplied;
+    uint32_t patchesApplied;
+    uint32_t patchesIgnored;
+    uint32_t reportWrites;
+    uint32_t reportsSent;
+    uint32_t reportErrors;
+    uint32_t applyUsTotal;
+    uint32_t applyUsMax;
+};
+
+#endif /* __DEVICE_TWIN_H__ */
@@ -0,0 +1,155 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "direct_methods.h"
+#include "topic_builder.h"
+
+#define METHOD_REQUEST_PREFIX   "$iothub/methods/POST/"
+/* Longest request id echoed back. IoT Hub uses short hexadecimal ids. */
+#define METHOD_MAX_RID_LENGTH   32
+
+static constexpr auto methodResponseTopic = makeTopic("$iothub/methods/res/");
+/* Response topic with a three digit status, "$rid=" and the longest request id. */
+#define METHOD_RESPONSE_TOPIC_SIZE  (sizeof("$iothub/methods/res/000/?$rid=") + METHOD_MAX_RID_LENGTH)
+
+DirectMethods::DirectMethods(const DirectMethod *table, size_t count, char *response, size_t responseSize,
+                             uint32_t budgetMs)
+    : table(table), count(count), response(response), responseSize(responseSize), budgetUs(budgetMs * 1000),
+      client(NULL), log(DeferredLog::immediate()), calls(0), unknownCalls(0), overBudget(0), responseErrors(0), latencyUsTotal(0), latencyUsMax(0)
+{
+}
+
+DirectMethodHandler DirectMethods::find(const char *name, size_t nameLength) const
+{
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        int cmp = strncmp(table[mid].name, name, nameLength);
+        if (cmp == 0 && table[mid].name[nameLength] != '\0') {
+            // The table entry is longer, so it sorts after `name`.
+            cmp = 1;
+        }
+        if (cmp == 0) {
+            return table[mid].handler;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Request topic: $iothub/methods/POST/{name}/?$rid={request id}
+ */
+bool DirectMethods::handleMessage(const char *topic, const char *payload, size_t payloadLength, uint32_t receivedUs)
+{
+    if (strncmp(topic, METHOD_REQUEST_PREFIX, sizeof(METHOD_REQUEST_PREFIX) - 1) != 0) {
+        return false;
+    }
+    const char *name = topic + sizeof(METHOD_REQUEST_PREFIX) - 1;
+    const char *nameEnd = strchr(name, '/');
+    const char *rid = strstr(topic, "$rid=");
+    if (!nameEnd || !rid) {
+        printf("WARNING: malformed direct method topic %s\r\n", topic);
+        return true;
+    }
+    rid += 5;
+    const size_t ridLength = strcspn(rid, "&");
+    calls++;
+
+    int status;
+    size_t responseLength = 0;
+    const DirectMethodHandler handler = find(name, nameEnd - name);
+    if (!handler) {
+        unknownCalls++;
+        status = 404;
+        responseLength = snprintf(response, responseSize, "{\"error\":\"unknown method\"}");
+    } else if (us_ticker_read() - receivedUs > budgetUs) {
+        // The caller is better served by a quick failure than by a late answer.
+        overBudget++;
+        status = 504;
+        responseLength = snprintf(response, responseSize, "{\"error\":\"response budget exceeded\"}");
+    } else {
+        response[0] = '\0';
+        status = handler(payload, payloadLength, response, responseSize);
+        response[responseSize - 1] = '\0';
+        responseLength = strlen(response);
+    }
+    if (responseLength >= responseSize) {
+        responseLength = responseSize - 1;
+    }
+
+    respond(status, rid, ridLength, responseLength);
+    const uint32_t latency = us_ticker_read() - receivedUs;
+    latencyUsTotal += latency;
+    if (latency > latencyUsMax) {
+        latencyUsMax = latency;
+    }
+    if (handler && status != 504 && latency > budgetUs) {
+        overBudget++;
+        log->writeText(LOG_METHOD_OVER_BUDGET, latency, budgetUs, name, nameEnd - name);
+    } else {
+        log->writeText(LOG_METHOD_ANSWERED, (uint32_t)status, latency, name, nameEnd - name);
+    }
+    return true;
+}
+
+int DirectMethods::respond(int status, const char *rid, size_t ridLength, size_t responseLength)
+{
+    char ridText[METHOD_MAX_RID_LENGTH + 1];
+    if (!client || ridLength > METHOD_MAX_RID_LENGTH || status < 100 || status > 999) {
+        responseErrors++;
+        return MQTT::FAILURE;
+    }
+    memcpy(ridText, rid, ridLength);
+    ridText[ridLength] = '\0';
+    char topicBuffer[METHOD_RESPONSE_TOPIC_SIZE];
+    TopicWriter topic(topicBuffer, sizeof(topicBuffer), methodResponseTopic);
+    topic.level((uint32_t)status).query().property("$rid", ridText);
+
+    // IoT Hub needs a JSON body.
+    if (responseLength == 0) {
+        responseLength = snprintf(response, responseSize, "{}");
+    }
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.id = 0;
+    message.payload = (void*)response;
+    message.payloadlen = responseLength;
+    int rc = client->publish(topic.c_str(), message);
+    if (rc != MQTT::SUCCESS) {
+        responseErrors++;
+        printf("ERROR: rc from direct method response publish is %d\r\n", rc);
+    }
+    return rc;
+}
+
+void DirectMethods::printStats() const
+{
+    printf("Direct methods: %lu calls, %lu unknown, %lu over budget, %lu response errors, "
+           "latency avg %lu us max %lu us\r\n",
+           (unsigned long)calls, (unsigned long)unknownCalls, (unsigned long)overBudget,
+           (unsigned long)responseErrors, calls ? (unsigned long)(latencyUsTotal / calls) : 0UL,
+           (unsigned long)latencyUsMax);
+}
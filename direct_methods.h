@@ -0,0 +1,119 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __DIRECT_METHODS_H__
+#define __DIRECT_METHODS_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "deferred_log.h"
+
+/* Topic to subscribe for direct method requests. */
+#define DIRECT_METHODS_TOPIC    "$iothub/methods/POST/#"
+
+/*
+ * Handles one direct method call. `payload` is the request JSON, NUL-terminated.
+ * Writes the response JSON, NUL-terminated, into `response` of `responseSize`
+ * bytes and returns the status, e.g. 200. An empty response is sent as {}.
+ * Runs on the main loop, so it must return well within the response budget.
+ */
+typedef int (*DirectMethodHandler)(const char *payload, size_t payloadLength, char *response, size_t responseSize);
+
+struct DirectMethod {
+    const char *name;
+    DirectMethodHandler handler;
+};
+
+/* constexpr strcmp, for checking a handler table at compile time. */
+constexpr int directMethodCompare(const char *a, const char *b)
+{
+    return (*a != *b || *a == '\0') ? (unsigned char)*a - (unsigned char)*b : directMethodCompare(a + 1, b + 1);
+}
+
+/*
+ * True if the names in `table` are in strictly ascending strcmp() order, as
+ * DirectMethods needs them. Use it in a static_assert next to the table:
+ *
+ *     static constexpr DirectMethod methods[] = {
+ *         { "echo", handleEcho },
+ *         { "getStats", handleGetStats },
+ *     };
+ *     static_assert(isDirectMethodTableSorted(methods), "methods must be sorted by name");
+ */
+template<size_t N>
+constexpr bool isDirectMethodTableSorted(const DirectMethod (&table)[N], size_t i = 1)
+{
+    return i >= N || (directMethodCompare(table[i - 1].name, table[i].name) < 0 && isDirectMethodTableSorted(table, i + 1));
+}
+
+/*
+ * IoT Hub direct methods over MQTT.
+ *
+ * A request arrives on $iothub/methods/POST/{name}/?$rid={request id}. The
+ * handler is found by binary search in a table sorted by name at build time,
+ * called at once, and its response is published to
+ * $iothub/methods/res/{status}/?$rid={request id}. Unknown methods get 404.
+ *
+ * Every request has a response budget counted from when the message was
+ * received. A request that already waited longer than the budget is answered
+ * with 504 without calling its handler, and a handler that overruns the
+ * budget is reported, so a slow main loop shows up instead of silently
+ * delaying callers.
+ */
+class DirectMethods {
+public:
+    DirectMethods(const DirectMethod *table, size_t count, char *response, size_t responseSize, uint32_t budgetMs);
+
+    /* Publishes responses through `client` from now on, NULL while disconnected. */
+    void setClient(MQTTClient *client) { this->client = client; }
+
+    /* Logs every call through `log` instead of printing it right away. */
+    void setLog(DeferredLog *log) { this->log = log; }
+
+    /*
+     * Handles a message received at `receivedUs` (us_ticker_read()). Returns
+     * false if `topic` is not a direct method topic.
+     */
+    bool handleMessage(const char *topic, const char *payload, size_t payloadLength, uint32_t receivedUs);
+
+    /* Handler for `name` of `nameLength` characters, NULL if the table has none. */
+    DirectMethodHandler find(const char *name, size_t nameLength) const;
+
+    void printStats() const;
+
+private:
+    int respond(int status, const char *rid, size_t ridLength, size_t responseLength);
+
+    const DirectMethod *table;
+    size_t count;
+    char *response;
+    size_t responseSize;
+    uint32_t budgetUs;
+    MQTTClient *client;
+    DeferredLog *log;
+
+    // Statistics
+    uint32_t calls;
+    uint32_t unknownCalls;
+    uint32_t overBudget;
+    uint32_t responseErrors;
+    uint64_t latencyUsTotal;    // Received to response published.
+    uint32_t latencyUsMax;
+};
+
+#endif /* __DIRECT_METHODS_H__ */
@@ -0,0 +1,103 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "encoding_benchmark.h"
+#include "telemetry_batcher.h"
+
+/* Batch payload capacity, about what fits into one PUBLISH of MQTT_MAX_PACKET_SIZE. */
+#define ENCODING_BENCHMARK_BATCH_SIZE  960
+
+static const int formats[] = {
+    TELEMETRY_BATCH_FORMAT_JSON,
+    TELEMETRY_BATCH_FORMAT_BINARY,
+    TELEMETRY_BATCH_FORMAT_CBOR,
+};
+
+static const char *const formatNames[] = {
+    "JSON",
+    "binary",
+    "CBOR",
+};
+
+static char batch[ENCODING_BENCHMARK_BATCH_SIZE];
+
+EncodingBenchmark::EncodingBenchmark(uint32_t records)
+    : records(records)
+{
+    memset(results, 0, sizeof(results));
+}
+
+int EncodingBenchmark::run()
+{
+    for (int i = 0; i < FORMAT_COUNT; i++) {
+        results[i] = measure(formats[i], records);
+    }
+    return 0;
+}
+
+EncodingBenchmark::Result EncodingBenchmark::measure(int format, uint32_t records)
+{
+    Result result = { 0, 0, 0 };
+    // Button events shortly after boot, values as a typical sensor.
+    TelemetryRecord record;
+    record.timestamp = 5000000;
+    record.source = TELEMETRY_SOURCE_BUTTON;
+
+    size_t length = 0;
+    unsigned int count = 0;
+    Timer timer;
+    timer.start();
+    for (uint32_t i = 0; i < records; i++) {
+        record.sequence = i;
+        record.timestamp += 250000;
+        record.value = (int32_t)(i % 2000) - 1000;
+        size_t newLength = TelemetryBatcher::encodeRecord(format, record, count, batch, length, sizeof(batch));
+        if (newLength == 0) {
+            // Batch full, complete it and start the next one.
+            result.payloadBytes += TelemetryBatcher::encodeEnd(format, batch, length);
+            result.batches++;
+            length = 0;
+            count = 0;
+            newLength = TelemetryBatcher::encodeRecord(format, record, count, batch, length, sizeof(batch));
+        }
+        length = newLength;
+        count++;
+    }
+    if (count > 0) {
+        result.payloadBytes += TelemetryBatcher::encodeEnd(format, batch, length);
+        result.batches++;
+    }
+    timer.stop();
+    result.encodeUs = timer.read_us();
+    return result;
+}
+
+void EncodingBenchmark::print() const
+{
+    printf("\r\n----- Encoding benchmark -----\r\n");
+    printf("Records:    %lu\r\n", (unsigned long)records);
+    printf("Format      bytes/record  ns/record  batches\r\n");
+    for (int i = 0; i < FORMAT_COUNT; i++) {
+        const Result &r = results[i];
+        const unsigned long bytesX100 = records ? (unsigned long)((uint64_t)r.payloadBytes * 100 / records) : 0UL;
+        printf("%-10s  %9lu.%02lu  %9lu  %7lu\r\n", formatNames[i], bytesX100 / 100, bytesX100 % 100,
+               records ? (unsigned long)((uint64_t)r.encodeUs * 1000 / records) : 0UL,
+               (unsigned long)r.batches);
+    }
+    printf("------------------------------\r\n\r\n");
+}
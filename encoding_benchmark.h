@@ -0,0 +1,55 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __ENCODING_BENCHMARK_H__
+#define __ENCODING_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+
+/*
+ * Compares the telemetry batch formats: payload bytes per record and time to
+ * encode a record, for the same synthetic records in each format. Records
+ * are packed into batches of MQTT packet size as the batcher does, so the
+ * per-batch framing is included.
+ */
+class EncodingBenchmark : public Benchmark {
+public:
+    /* Encodes `records` records in every format. */
+    EncodingBenchmark(uint32_t records);
+
+    virtual const char *name() const { return "encoding benchmark"; }
+    virtual int run();
+    virtual void print() const;
+
+private:
+    enum { FORMAT_COUNT = 3 };
+
+    struct Result {
+        uint32_t encodeUs;
+        uint32_t payloadBytes;
+        uint32_t batches;
+    };
+
+    Result measure(int format, uint32_t records);
+
+    uint32_t records;
+    Result results[FORMAT_COUNT];
+};
+
+#endif /* __ENCODING_BENCHMARK_H__ */
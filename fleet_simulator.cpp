@@ -0,0 +1,308 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "fleet_simulator.h"
+#include "telemetry_batcher.h"
+
+/* Messages the devices received from the broker, on all workers. */
+static volatile uint32_t messagesReceived = 0;
+
+/* One simulated device and the worker whose EventQueue runs its timer. */
+struct FleetSimulator::Device {
+    Device()
+        : simulator(NULL), queue(NULL), client(NULL), backoff(0, 0), connects(0), firstConnectUs(0), dueUs(0),
+          sequence(0), publishErrors(0)
+    {
+    }
+
+    FleetSimulator *simulator;
+    EventQueue *queue;
+    LoopbackSocket socket;
+    MQTTClient *client;     // NULL while disconnected.
+    ReconnectBackoff backoff;
+    char id[12];
+    char topic[48];
+    char filter[48];
+    uint32_t connects;
+    uint32_t firstConnectUs;
+    uint32_t dueUs;         // When the next publish is due.
+    uint32_t sequence;
+    uint32_t publishErrors;
+};
+
+struct FleetWorker {
+    Thread *thread;
+    EventQueue *queue;
+    uint32_t durationMs;
+};
+
+static void dispatchWorker(FleetWorker *worker)
+{
+    worker->queue->dispatch(worker->durationMs);
+}
+
+FleetSimulator::FleetSimulator(size_t devices, size_t workers, uint32_t publishPeriodMs, uint32_t durationMs,
+                               uint32_t acceptPerSecond, uint32_t sessionPublishes, uint32_t reconnectMinMs,
+                               uint32_t reconnectMaxMs)
+    : broker(acceptPerSecond, sessionPublishes), devices(devices), workers(workers), publishPeriodMs(publishPeriodMs),
+      durationMs(durationMs), acceptPerSecond(acceptPerSecond), sessionPublishes(sessionPublishes),
+      reconnectMinMs(reconnectMinMs), reconnectMaxMs(reconnectMaxMs), resultCount(0)
+{
+}
+
+int FleetSimulator::run()
+{
+    resultCount = 0;
+    int ret = 0;
+    const size_t deviceCounts[] = { devices / 4, devices / 2, devices };
+    const size_t maxWorkers = (workers < FLEET_MAX_WORKERS) ? workers : FLEET_MAX_WORKERS;
+    for (size_t c = 0; c < sizeof(deviceCounts) / sizeof(deviceCounts[0]); c++) {
+        if (deviceCounts[c] == 0 || (c > 0 && deviceCounts[c] == deviceCounts[c - 1])) {
+            continue;
+        }
+        // Doubling, and the largest count last if it is not a power of two.
+        for (size_t w = 1; w <= maxWorkers && resultCount < FLEET_MAX_RUNS;
+                w = (w < maxWorkers && w * 2 > maxWorkers) ? maxWorkers : w * 2) {
+            if (runOnce(deviceCounts[c], w, results[resultCount]) != 0) {
+                ret = -1;
+                continue;
+            }
+            resultCount++;
+        }
+    }
+    return ret;
+}
+
+int FleetSimulator::runOnce(size_t deviceCount, size_t workerCount, Result &result)
+{
+    // Room for the latency of every publish a device can make in the run.
+    const size_t sampleCapacity = deviceCount * (durationMs / publishPeriodMs + 1);
+    uint32_t *samples = new uint32_t[sampleCapacity];
+    broker.setLatencySamples(samples, sampleCapacity);
+
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    const uint32_t heapBefore = heap.current_size;
+
+    Device *devices = new Device[deviceCount];
+    FleetWorker workers[FLEET_MAX_WORKERS];
+    const size_t devicesPerWorker = (deviceCount + workerCount - 1) / workerCount;
+    for (size_t w = 0; w < workerCount; w++) {
+        // One pending timer per device.
+        workers[w].queue = new EventQueue((devicesPerWorker + 2) * EVENTS_EVENT_SIZE);
+        workers[w].thread = new Thread(osPriorityNormal, FLEET_WORKER_STACK_SIZE, NULL, "fleet");
+        workers[w].durationMs = durationMs;
+    }
+    broker.clearStats();
+    messagesReceived = 0;
+
+    // Every device connects right away, the connect storm of a fleet coming back at once.
+    const uint32_t startUs = us_ticker_read();
+    for (size_t i = 0; i < deviceCount; i++) {
+        Device &device = devices[i];
+        device.simulator = this;
+        device.queue = workers[i % workerCount].queue;
+        device.backoff = ReconnectBackoff(reconnectMinMs, reconnectMaxMs);
+        snprintf(device.id, sizeof(device.id), "sim-%04u", (unsigned int)i);
+        snprintf(device.topic, sizeof(device.topic), "devices/%s/messages/events/", device.id);
+        snprintf(device.filter, sizeof(device.filter), "devices/%s/messages/devicebound/#", device.id);
+        device.queue->call(step, &device);
+    }
+    int ret = 0;
+    size_t started = 0;
+    for (size_t w = 0; w < workerCount; w++) {
+        if (workers[w].thread->start(callback(dispatchWorker, &workers[w])) != osOK) {
+            printf("ERROR: could not start fleet worker %u.\r\n", (unsigned int)w);
+            ret = -1;
+            break;
+        }
+        started++;
+    }
+    for (size_t w = 0; w < started; w++) {
+        workers[w].thread->join();
+    }
+
+    // The clients of connected devices still count.
+    mbed_stats_heap_get(&heap);
+    result.devices = deviceCount;
+    result.workers = workerCount;
+    result.heapPerDevice = (heap.current_size - heapBefore) / deviceCount;
+    result.connectedMs = 0;
+    result.reconnects = 0;
+    result.publishErrors = 0;
+    result.isAllConnected = true;
+    for (size_t i = 0; i < deviceCount; i++) {
+        const Device &device = devices[i];
+        if (device.connects == 0) {
+            result.isAllConnected = false;
+        } else {
+            result.reconnects += device.connects - 1;
+            const uint32_t connectedMs = (device.firstConnectUs - startUs) / 1000;
+            if (connectedMs > result.connectedMs) {
+                result.connectedMs = connectedMs;
+            }
+        }
+        result.publishErrors += device.publishErrors;
+    }
+    result.refused = broker.refused();
+    result.publishes = broker.publishes();
+    result.messagesReceived = messagesReceived;
+    result.p50Us = broker.latencyPercentileUs(50);
+    result.p99Us = broker.latencyPercentileUs(99);
+    result.maxUs = broker.latencyMaxUs();
+    if (broker.latencyCount() > sampleCapacity) {
+        printf("WARNING: percentiles of the first %u of %lu publishes only.\r\n", (unsigned int)sampleCapacity,
+               (unsigned long)broker.latencyCount());
+    }
+    broker.setLatencySamples(NULL, 0);
+
+    for (size_t i = 0; i < deviceCount; i++) {
+        disconnect(&devices[i]);
+    }
+    for (size_t w = 0; w < workerCount; w++) {
+        delete workers[w].thread;
+        delete workers[w].queue;
+    }
+    delete[] devices;
+    delete[] samples;
+    return ret;
+}
+
+/*
+ * Runs on the device's worker whenever its timer is due: connects if
+ * needed, publishes the record that was due and reads what the broker sent.
+ */
+void FleetSimulator::step(Device *device)
+{
+    if (!device->client) {
+        if (!connect(device)) {
+            device->queue->call_in(device->backoff.nextDelayMs(), step, device);
+            return;
+        }
+        device->backoff.reset();
+        device->dueUs = us_ticker_read();
+    }
+
+    // The record is stamped with the time it was due, so a late worker shows up as latency.
+    TelemetryRecord record;
+    record.timestamp = device->dueUs;
+    record.sequence = device->sequence++;
+    record.value = (int32_t)record.sequence;
+    record.source = TELEMETRY_SOURCE_BUTTON;
+    char payload[1 + TELEMETRY_BINARY_RECORD_SIZE];
+    size_t length = TelemetryBatcher::encodeRecord(TELEMETRY_BATCH_FORMAT_BINARY, record, 0, payload, 0, sizeof(payload));
+    length = TelemetryBatcher::encodeEnd(TELEMETRY_BATCH_FORMAT_BINARY, payload, length);
+
+    MQTT::Message message;
+    message.qos = MQTT::QOS0;
+    message.retained = false;
+    message.dup = false;
+    message.id = 0;
+    message.payload = (void*)payload;
+    message.payloadlen = length;
+    int rc = device->client->publish(device->topic, message);
+    if (rc != MQTT::SUCCESS) {
+        device->publishErrors++;
+    } else if (device->socket.pending() > 0) {
+        // yield() reads nothing with a timeout of 0, and spends the whole timeout otherwise, so only when
+        // the broker sent something.
+        rc = device->client->yield(1);
+    }
+    if (rc != MQTT::SUCCESS || !device->client->isConnected()) {
+        // Lost, e.g. closed by the broker. Reconnect after the backoff as main.cpp does.
+        disconnect(device);
+        device->queue->call_in(device->backoff.nextDelayMs(), step, device);
+        return;
+    }
+
+    device->dueUs += device->simulator->publishPeriodMs * 1000;
+    // Rounded up, a step run before its record is due would make its latency wrap.
+    const int32_t waitUs = (int32_t)(device->dueUs - us_ticker_read());
+    device->queue->call_in(waitUs > 0 ? (waitUs + 999) / 1000 : 0, step, device);
+}
+
+bool FleetSimulator::connect(Device *device)
+{
+    device->socket.connectBroker(&device->simulator->broker);
+    device->client = new MQTTClient(&device->socket);
+
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = device->id;
+    data.cleansession = 1;
+    if (device->client->connect(data) != MQTT::SUCCESS
+            || device->client->subscribe(device->filter, MQTT::QOS0, handleMessage) != MQTT::SUCCESS) {
+        disconnect(device);
+        return false;
+    }
+    if (device->connects++ == 0) {
+        device->firstConnectUs = us_ticker_read();
+    }
+    return true;
+}
+
+void FleetSimulator::disconnect(Device *device)
+{
+    if (device->client) {
+        if (device->socket.isOpen()) {
+            device->client->disconnect();
+        }
+        delete device->client;
+        device->client = NULL;
+    }
+    device->socket.close();
+}
+
+void FleetSimulator::handleMessage(MQTT::MessageData &md)
+{
+    core_util_atomic_incr_u32(&messagesReceived, 1);
+}
+
+void FleetSimulator::print() const
+{
+    printf("\r\n----- Fleet simulator -----\r\n");
+    printf("Publish:  every %lu ms, %lu ms per run\r\n", (unsigned long)publishPeriodMs, (unsigned long)durationMs);
+    if (acceptPerSecond > 0) {
+        printf("Broker:   accepts %lu connects/s", (unsigned long)acceptPerSecond);
+    } else {
+        printf("Broker:   accepts every connect");
+    }
+    if (sessionPublishes > 0) {
+        printf(", closes sessions after %lu publishes\r\n", (unsigned long)sessionPublishes);
+    } else {
+        printf(", keeps sessions open\r\n");
+    }
+    printf("Devices  Workers  Storm ms  Refused  Reconnects  Publish/s  Lost  Received  p50 us  p99 us  Max us  Heap/device\r\n");
+    for (size_t i = 0; i < resultCount; i++) {
+        const Result &r = results[i];
+        char storm[12];
+        if (r.isAllConnected) {
+            snprintf(storm, sizeof(storm), "%lu", (unsigned long)r.connectedMs);
+        } else {
+            snprintf(storm, sizeof(storm), "-");
+        }
+        printf("%7u  %7u  %8s  %7lu  %10lu  %9lu  %4lu  %8lu  %6lu  %6lu  %6lu  %11lu\r\n",
+               (unsigned int)r.devices, (unsigned int)r.workers, storm, (unsigned long)r.refused,
+               (unsigned long)r.reconnects,
+               durationMs ? (unsigned long)((uint64_t)r.publishes * 1000 / durationMs) : 0UL,
+               (unsigned long)r.publishErrors, (unsigned long)r.messagesReceived, (unsigned long)r.p50Us,
+               (unsigned long)r.p99Us, (unsigned long)r.maxUs, (unsigned long)r.heapPerDevice);
+    }
+    printf("---------------------------\r\n\r\n");
+}
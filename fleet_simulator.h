@@ -0,0 +1,114 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __FLEET_SIMULATOR_H__
+#define __FLEET_SIMULATOR_H__
+
+#include "mbed.h"
+#include "mbed_events.h"
+#include "benchmark.h"
+#include "MQTTClientMbedOs.h"
+#include "loopback_broker.h"
+#include "reconnect_backoff.h"
+
+/* Most worker threads of one run. The host build allows more. */
+#ifndef FLEET_MAX_WORKERS
+#define FLEET_MAX_WORKERS           4
+#endif
+/* Stack of each worker thread, enough for MQTTClient's connect. */
+#define FLEET_WORKER_STACK_SIZE     3072
+/* Rows of the result table: a quarter, half and all of the devices, on 1, 2 and 4 workers. */
+#ifndef FLEET_MAX_RUNS
+#define FLEET_MAX_RUNS              9
+#endif
+
+/*
+ * Runs many simulated devices on the board against a LoopbackBroker to see
+ * how the client code behaves as the fleet grows.
+ *
+ * Each device goes through steps modelled on main.cpp with its own MQTTClient:
+ * connect, subscribe its devicebound topic, then publish a binary telemetry
+ * batch and yield every `publishPeriodMs`, and reconnect after a
+ * ReconnectBackoff delay whenever the connection is refused or lost. The
+ * devices are spread over a pool of worker threads, each dispatching the
+ * timers of its devices from an EventQueue. All devices start at once, so
+ * every run begins with a connect storm.
+ *
+ * A publish is timed from when its device's timer was due until the broker
+ * has it, so the latency includes the time the device waited for its
+ * worker. run() repeats the simulation for a quarter, half and all of the
+ * devices on 1, 2, 4 and so on workers, up to `workers`.
+ *
+ * On the board the device count is bounded by its RAM and the workers share
+ * one core. The host build runs thousands of devices on as many workers as
+ * the host has cores. Either way the devices run a loop of their own, not
+ * main.cpp's session code, so changes there are not covered.
+ */
+class FleetSimulator : public Benchmark {
+public:
+    /* Runs the simulation for up to `devices` devices and `workers` workers. */
+    FleetSimulator(size_t devices, size_t workers, uint32_t publishPeriodMs, uint32_t durationMs,
+                   uint32_t acceptPerSecond, uint32_t sessionPublishes, uint32_t reconnectMinMs, uint32_t reconnectMaxMs);
+
+    virtual const char *name() const { return "fleet simulator"; }
+
+    /* Returns -1 if a run could not start, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    struct Device;
+
+    struct Result {
+        size_t devices;
+        size_t workers;
+        bool isAllConnected;    // Every device was connected at least once.
+        uint32_t connectedMs;   // Until the last of them was connected.
+        uint32_t refused;
+        uint32_t reconnects;
+        uint32_t publishes;
+        uint32_t publishErrors;
+        uint32_t messagesReceived;
+        uint32_t p50Us;
+        uint32_t p99Us;
+        uint32_t maxUs;
+        uint32_t heapPerDevice;
+    };
+
+    int runOnce(size_t devices, size_t workers, Result &result);
+
+    static void step(Device *device);
+    static bool connect(Device *device);
+    static void disconnect(Device *device);
+    static void handleMessage(MQTT::MessageData &md);
+
+    LoopbackBroker broker;
+    size_t devices;
+    size_t workers;
+    uint32_t publishPeriodMs;
+    uint32_t durationMs;
+    uint32_t acceptPerSecond;
+    uint32_t sessionPublishes;
+    uint32_t reconnectMinMs;
+    uint32_t reconnectMaxMs;
+    Result results[FLEET_MAX_RUNS];
+    size_t resultCount;
+};
+
+#endif /* __FLEET_SIMULATOR_H__ */
@@ -0,0 +1,137 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "gateway.h"
+#include "telemetry_batcher.h"
+
+Gateway::Gateway(GatewayLeaf *leaves, size_t maxLeaves, char *buffer, size_t capacity, int format, uint32_t quantum)
+    : leaves(leaves), maxLeaves(maxLeaves), leafCount(0), nextLeaf(0), buffer(buffer), capacity(capacity),
+      format(format), quantum(quantum > 0 ? quantum : 1), log(DeferredLog::immediate())
+{
+}
+
+int Gateway::addLeaf(const char *deviceId, const char *topicProperties)
+{
+    const size_t idLength = strlen(deviceId);
+    if (leafCount >= maxLeaves || idLength == 0 || idLength > GATEWAY_MAX_ID_LENGTH) {
+        return -1;
+    }
+    GatewayLeaf &leaf = leaves[leafCount];
+    int n = snprintf(leaf.eventsTopic, sizeof(leaf.eventsTopic), "devices/%s/messages/events/%s",
+                     deviceId, topicProperties);
+    if (n < 0 || (size_t)n >= sizeof(leaf.eventsTopic)) {
+        return -1;
+    }
+    snprintf(leaf.deviceboundFilter, sizeof(leaf.deviceboundFilter), "devices/%s/messages/devicebound/#", deviceId);
+    leaf.deviceId = deviceId;
+    leaf.idLength = idLength;
+    leaf.publishes = 0;
+    leaf.recordsSent = 0;
+    leaf.messagesReceived = 0;
+    leaf.publishErrors = 0;
+    return (int)leafCount++;
+}
+
+int Gateway::publishTurn()
+{
+    if (leafCount == 0) {
+        return MQTT::SUCCESS;
+    }
+    const size_t first = nextLeaf;
+    nextLeaf = (nextLeaf + 1) % leafCount;
+    for (size_t n = 0; n < leafCount; n++) {
+        GatewayLeaf &leaf = leaves[(first + n) % leafCount];
+        // Records stay queued until they fit into the message.
+        TelemetryRecord record;
+        size_t length = 0;
+        unsigned int records = 0;
+        while (records < quantum && leaf.queue.peek(record)) {
+            const size_t newLength = TelemetryBatcher::encodeRecord(format, record, records, buffer, length, capacity);
+            if (newLength == 0) {
+                if (records == 0) {
+                    // Too large for an empty message, it would hold up the leaf's queue for good.
+                    leaf.queue.pop(record);
+                    leaf.publishErrors++;
+                    continue;
+                }
+                break;
+            }
+            leaf.queue.pop(record);
+            length = newLength;
+            records++;
+        }
+        if (records == 0) {
+            continue;
+        }
+        length = TelemetryBatcher::encodeEnd(format, buffer, length);
+        const int rc = publisher ? publisher(leaf.eventsTopic, buffer, length) : (int)MQTT::FAILURE;
+        if (rc != MQTT::SUCCESS) {
+            leaf.publishErrors++;
+            return rc;
+        }
+        leaf.publishes++;
+        leaf.recordsSent += records;
+    }
+    return MQTT::SUCCESS;
+}
+
+bool Gateway::pending() const
+{
+    for (size_t i = 0; i < leafCount; i++) {
+        if (!leaves[i].queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Gateway::handleMessage(const char *topic, const char *payload, size_t payloadLength)
+{
+    // devices/{id}/messages/devicebound/...
+    static const char prefix[] = "devices/";
+    static const char suffix[] = "/messages/devicebound/";
+    if (strncmp(topic, prefix, sizeof(prefix) - 1) != 0) {
+        return false;
+    }
+    const char *id = topic + sizeof(prefix) - 1;
+    const char *end = strchr(id, '/');
+    if (!end || strncmp(end, suffix, sizeof(suffix) - 1) != 0) {
+        return false;
+    }
+    const size_t idLength = end - id;
+    for (size_t i = 0; i < leafCount; i++) {
+        GatewayLeaf &leaf = leaves[i];
+        if (leaf.idLength == idLength && memcmp(leaf.deviceId, id, idLength) == 0) {
+            leaf.messagesReceived++;
+            log->writeText(LOG_LEAF_MESSAGE_ARRIVED, i, payloadLength, payload, payloadLength);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Gateway::printStats() const
+{
+    for (size_t i = 0; i < leafCount; i++) {
+        const GatewayLeaf &leaf = leaves[i];
+        printf("Leaf %s: %lu messages, %lu records, %lu dropped, %lu received, %lu errors\r\n", leaf.deviceId,
+               (unsigned long)leaf.publishes, (unsigned long)leaf.recordsSent, (unsigned long)leaf.queue.overflows(),
+               (unsigned long)leaf.messagesReceived, (unsigned long)leaf.publishErrors);
+    }
+}
@@ -0,0 +1,130 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __GATEWAY_H__
+#define __GATEWAY_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "telemetry_queue.h"
+#include "deferred_log.h"
+
+/* Longest leaf device id. */
+#define GATEWAY_MAX_ID_LENGTH       32
+/* Telemetry records a leaf can queue while waiting for its turn. Must be a power of two. */
+#define GATEWAY_QUEUE_CAPACITY      8
+/* Room for devices/{id}/messages/events/ and the property bag. */
+#define GATEWAY_TOPIC_SIZE          128
+/* Room for devices/{id}/messages/devicebound/#. */
+#define GATEWAY_FILTER_SIZE         (8 + GATEWAY_MAX_ID_LENGTH + 24)
+
+/* One leaf device identity and its telemetry waiting to be published. */
+struct GatewayLeaf {
+    const char *deviceId;
+    size_t idLength;
+    TelemetryQueue<GATEWAY_QUEUE_CAPACITY> queue;
+    char eventsTopic[GATEWAY_TOPIC_SIZE];
+    char deviceboundFilter[GATEWAY_FILTER_SIZE];
+
+    // Statistics
+    uint32_t publishes;
+    uint32_t recordsSent;
+    uint32_t messagesReceived;
+    uint32_t publishErrors;
+};
+
+/* Publishes `length` bytes of `payload` to `topic`. Returns MQTT::SUCCESS or an error. */
+typedef Callback<int(const char *topic, const char *payload, size_t length)> GatewayPublisher;
+
+/*
+ * Carries the telemetry and cloud-to-device messages of several leaf devices
+ * over the one authenticated connection of the gateway, instead of a TLS
+ * session per device.
+ *
+ * Each leaf publishes to devices/{id}/messages/events/ and receives on
+ * devices/{id}/messages/devicebound/#, the topics an IoT Edge style
+ * gateway forwards for its child devices. The received messages reach
+ * handleMessage() through the topic router, which finds the leaf by the
+ * device id level.
+ *
+ * Every leaf has its own queue, so one leaf cannot fill up the others'
+ * room. publishTurn() visits the leaves round robin and publishes at most
+ * `quantum` records of each leaf as one message per turn, so a busy leaf
+ * delays the others by one message at most. The payload buffer is shared,
+ * only one message is built at a time.
+ */
+class Gateway {
+public:
+    /* Up to `maxLeaves` leaves in `leaves`, batches of `format` built in `buffer` of `capacity` bytes. */
+    Gateway(GatewayLeaf *leaves, size_t maxLeaves, char *buffer, size_t capacity, int format, uint32_t quantum);
+
+    /*
+     * Adds a leaf with `deviceId`, which must stay valid. Its telemetry topic
+     * gets the property bag `topicProperties`, e.g. "$.ct=application%2Fjson".
+     * Returns the index of the leaf, -1 if it does not fit.
+     */
+    int addLeaf(const char *deviceId, const char *topicProperties);
+
+    size_t count() const { return leafCount; }
+    const char *deviceId(size_t leaf) const { return leaves[leaf].deviceId; }
+    /* Topic filter to subscribe for the messages to `leaf`. */
+    const char *deviceboundFilter(size_t leaf) const { return leaves[leaf].deviceboundFilter; }
+
+    /* Queues a record for `leaf`. Each leaf may have one producer, which may be an interrupt. */
+    bool push(size_t leaf, uint16_t source, int32_t value) { return leaves[leaf].queue.push(source, value); }
+
+    /* Publishes through `publisher` from now on. */
+    void setPublisher(GatewayPublisher publisher) { this->publisher = publisher; }
+
+    /* Logs received messages through `log` instead of printing them right away. */
+    void setLog(DeferredLog *log) { this->log = log; }
+
+    /*
+     * Publishes one message for each leaf with queued records, starting after
+     * the leaf served first last time. A record too large for the message
+     * buffer is dropped and counted as a publish error. Returns MQTT::SUCCESS
+     * or the return code of a failed publish, which ends the turn.
+     */
+    int publishTurn();
+
+    /* True if any leaf has queued records. */
+    bool pending() const;
+
+    /* Handles a message received on a leaf's topic. Returns false if `topic` is not one. */
+    bool handleMessage(const char *topic, const char *payload, size_t payloadLength);
+
+    /* Bytes taken by the gateway and its leaves. */
+    size_t stateBytes() const { return sizeof(*this) + leafCount * sizeof(GatewayLeaf); }
+
+    void printStats() const;
+
+private:
+    GatewayLeaf *leaves;
+    size_t maxLeaves;
+    size_t leafCount;
+    size_t nextLeaf;
+    char *buffer;
+    size_t capacity;
+    int format;
+    uint32_t quantum;
+    GatewayPublisher publisher;
+    DeferredLog *log;
+};
+
+#endif /* __GATEWAY_H__ */
@@ -0,0 +1,109 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "gateway_benchmark.h"
+#include "gateway.h"
+
+/* Payload buffer of the measured gateway, as in main.cpp. */
+#define GATEWAY_BENCHMARK_BUFFER_SIZE   (1024 - 5 - 2 - GATEWAY_TOPIC_SIZE)
+
+static const char *const leafIds[GATEWAY_BENCHMARK_MAX_LEAVES] = {
+    "leaf-00", "leaf-01", "leaf-02", "leaf-03", "leaf-04", "leaf-05", "leaf-06", "leaf-07",
+    "leaf-08", "leaf-09", "leaf-10", "leaf-11", "leaf-12", "leaf-13", "leaf-14", "leaf-15",
+};
+
+/* What the counting sink received. */
+static uint32_t sinkMessages;
+static uint32_t sinkBytes;
+
+static int countMessage(const char *topic, const char *payload, size_t length)
+{
+    sinkMessages++;
+    // PUBLISH fixed header, topic with its length, payload.
+    sinkBytes += 2 + 2 + strlen(topic) + length;
+    return MQTT::SUCCESS;
+}
+
+GatewayBenchmark::GatewayBenchmark(int format, uint32_t quantum, uint32_t records)
+    : format(format), quantum(quantum), records(records)
+{
+    memset(stateBytes, 0, sizeof(stateBytes));
+    memset(messages, 0, sizeof(messages));
+    memset(wireBytes, 0, sizeof(wireBytes));
+    memset(elapsedUs, 0, sizeof(elapsedUs));
+}
+
+int GatewayBenchmark::run()
+{
+    static GatewayLeaf leaves[GATEWAY_BENCHMARK_MAX_LEAVES];
+    static char buffer[GATEWAY_BENCHMARK_BUFFER_SIZE];
+    bool isLost = false;
+
+    for (int step = 0; step < STEPS; step++) {
+        const size_t leafCount = (size_t)1 << step;
+        Gateway gateway(leaves, GATEWAY_BENCHMARK_MAX_LEAVES, buffer, sizeof(buffer), format, quantum);
+        for (size_t i = 0; i < leafCount; i++) {
+            gateway.addLeaf(leafIds[i], "$.ct=application%2Fjson");
+        }
+        gateway.setPublisher(countMessage);
+        sinkMessages = 0;
+        sinkBytes = 0;
+
+        // Each leaf fills its queue, then one turn publishes for all of them.
+        Timer timer;
+        timer.start();
+        for (uint32_t sent = 0; sent < records; sent += GATEWAY_QUEUE_CAPACITY - 1) {
+            for (size_t i = 0; i < leafCount; i++) {
+                for (uint32_t r = sent; r < records && r < sent + GATEWAY_QUEUE_CAPACITY - 1; r++) {
+                    gateway.push(i, TELEMETRY_SOURCE_BUTTON, (int32_t)r);
+                }
+            }
+            while (gateway.pending()) {
+                gateway.publishTurn();
+            }
+        }
+        timer.stop();
+
+        stateBytes[step] = gateway.stateBytes();
+        messages[step] = sinkMessages;
+        wireBytes[step] = sinkBytes;
+        elapsedUs[step] = timer.read_us();
+        uint32_t sent = 0;
+        for (size_t i = 0; i < leafCount; i++) {
+            sent += leaves[i].recordsSent;
+        }
+        isLost = isLost || sent != records * leafCount;
+    }
+    return isLost ? -1 : 0;
+}
+
+void GatewayBenchmark::print() const
+{
+    printf("\r\n----- Gateway benchmark -----\r\n");
+    printf("Records:  %lu per leaf, up to %lu per message\r\n", (unsigned long)records, (unsigned long)quantum);
+    printf("Leaves  State bytes  Messages  Records/s  Bytes/record\r\n");
+    for (int step = 0; step < STEPS; step++) {
+        const uint32_t total = records << step;
+        printf("%6u  %11lu  %8lu  %9lu  %12lu\r\n", 1u << step, (unsigned long)stateBytes[step],
+               (unsigned long)messages[step],
+               elapsedUs[step] ? (unsigned long)((uint64_t)total * 1000000 / elapsedUs[step]) : 0UL,
+               total ? (unsigned long)(wireBytes[step] / total) : 0UL);
+    }
+    printf("-----------------------------\r\n\r\n");
+}
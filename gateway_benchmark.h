@@ -0,0 +1,60 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __GATEWAY_BENCHMARK_H__
+#define __GATEWAY_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+
+/* Largest number of leaf devices measured. */
+#define GATEWAY_BENCHMARK_MAX_LEAVES    16
+
+/*
+ * Measures the gateway with 1, 2, 4, 8 and 16 leaf devices: the memory the
+ * leaves take and how many records per second the round robin scheduler
+ * encodes into messages. Messages go to a counting sink instead of the
+ * connection, so the figures show the cost on the device, not the network.
+ */
+class GatewayBenchmark : public Benchmark {
+public:
+    /* Publishes `records` records of every leaf at each leaf count. */
+    GatewayBenchmark(int format, uint32_t quantum, uint32_t records);
+
+    virtual const char *name() const { return "gateway benchmark"; }
+
+    /* Returns -1 if records were lost, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    enum {
+        STEPS = 5,
+    };
+
+    int format;
+    uint32_t quantum;
+    uint32_t records;
+    size_t stateBytes[STEPS];
+    uint32_t messages[STEPS];
+    uint32_t wireBytes[STEPS];
+    uint32_t elapsedUs[STEPS];
+};
+
+#endif /* __GATEWAY_BENCHMARK_H__ */
@@ -0,0 +1,57 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+/*
+ * Fleet simulator of the host build: runs thousands of simulated devices
+ * against a LoopbackBroker on up to as many worker threads as the host has
+ * cores, see FleetSimulator.
+ *
+ *   fleet_simulator [devices] [workers] [duration ms] [publish period ms] [accept rate] [session publishes]
+ */
+
+#include <unistd.h>
+#include "mbed.h"
+#include "fleet_simulator.h"
+
+#define HOST_FLEET_DEVICES          4000
+
+int main(int argc, char *argv[])
+{
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    const size_t devices = (argc > 1) ? (size_t)atoi(argv[1]) : HOST_FLEET_DEVICES;
+    const size_t workers = (argc > 2) ? (size_t)atoi(argv[2]) : (size_t)(cores > 0 ? cores : 1);
+    const uint32_t durationMs = (argc > 3) ? (uint32_t)atoi(argv[3]) : MBED_CONF_APP_FLEET_SIM_DURATION_MS;
+    const uint32_t publishPeriodMs = (argc > 4) ? (uint32_t)atoi(argv[4]) : MBED_CONF_APP_FLEET_SIM_PUBLISH_PERIOD_MS;
+    const uint32_t acceptRate = (argc > 5) ? (uint32_t)atoi(argv[5]) : MBED_CONF_APP_FLEET_SIM_ACCEPT_RATE;
+    const uint32_t sessionPublishes = (argc > 6) ? (uint32_t)atoi(argv[6]) : MBED_CONF_APP_FLEET_SIM_SESSION_PUBLISHES;
+
+    if (workers > FLEET_MAX_WORKERS) {
+        printf("WARNING: %u workers at most.\r\n", (unsigned int)FLEET_MAX_WORKERS);
+    }
+    printf("Cores:    %ld\r\n", cores);
+
+    FleetSimulator simulator(devices, workers, publishPeriodMs, durationMs, acceptRate, sessionPublishes,
+                             MBED_CONF_APP_RECONNECT_MIN_DELAY_MS, MBED_CONF_APP_RECONNECT_MAX_DELAY_MS);
+    const int ret = simulator.run();
+    if (ret != 0) {
+        printf("ERROR: fleet simulator failed, %d.\r\n", ret);
+    }
+    simulator.print();
+    return ret == 0 ? 0 : 1;
+}
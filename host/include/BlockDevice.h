@@ -0,0 +1,56 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __HOST_BLOCK_DEVICE_H__
+#define __HOST_BLOCK_DEVICE_H__
+
+#include "mbed.h"
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+enum bd_error {
+    BD_ERROR_OK                 = 0,
+    BD_ERROR_DEVICE_ERROR       = -4001,
+};
+
+/* The BlockDevice interface of mbed OS. There is no default instance on the host. */
+class BlockDevice {
+public:
+    virtual ~BlockDevice() {}
+
+    virtual int init() = 0;
+    virtual int deinit() = 0;
+    virtual int sync() { return 0; }
+
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size) = 0;
+    virtual int erase(bd_addr_t addr, bd_size_t size) { return 0; }
+
+    virtual bd_size_t get_read_size() const = 0;
+    virtual bd_size_t get_program_size() const = 0;
+    virtual bd_size_t get_erase_size() const { return get_program_size(); }
+    virtual bd_size_t get_erase_size(bd_addr_t addr) const { return get_erase_size(); }
+    /* Value of an erased byte, or -1 if erased contents are undefined. */
+    virtual int get_erase_value() const { return -1; }
+    virtual bd_size_t size() const = 0;
+    virtual const char *get_type() const = 0;
+};
+
+#endif /* __HOST_BLOCK_DEVICE_H__ */
@@ -0,0 +1,122 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __HOST_MQTT_CLIENT_MBED_OS_H__
+#define __HOST_MQTT_CLIENT_MBED_OS_H__
+
+/*
+ * MQTTClient of mbed-mqtt for the host: the Paho embedded C++ client over a
+ * TCPSocket, which here is a POSIX socket or a class derived from it. Only
+ * the TCPSocket constructor is offered, the one the sample uses.
+ */
+
+#include "mbed.h"
+#include "TCPSocket.h"
+
+#ifndef MBED_CONF_MBED_MQTT_MAX_PACKET_SIZE
+#define MBED_CONF_MBED_MQTT_MAX_PACKET_SIZE     1024
+#endif
+#ifndef MBED_CONF_MBED_MQTT_MAX_CONNECTIONS
+#define MBED_CONF_MBED_MQTT_MAX_CONNECTIONS     5
+#endif
+
+/* Timer of the Paho client, as in mbed-mqtt's MQTTmbed.h. */
+class Countdown {
+public:
+    Countdown() : interval_end_ms(0) { t.start(); }
+    Countdown(int ms) { t.start(); countdown_ms(ms); }
+
+    bool expired() { return t.read_ms() >= (int)interval_end_ms; }
+    void countdown_ms(unsigned long ms)
+    {
+        t.stop();
+        interval_end_ms = ms;
+        t.reset();
+        t.start();
+    }
+    void countdown(int seconds) { countdown_ms((unsigned long)seconds * 1000L); }
+    int left_ms() { return interval_end_ms - t.read_ms(); }
+
+private:
+    Timer t;
+    unsigned long interval_end_ms;
+};
+
+#include "MQTTClient.h"
+
+/* Network of the Paho client, as in mbed-mqtt. */
+class MQTTNetworkMbedOs {
+public:
+    MQTTNetworkMbedOs(Socket *socket) : socket(socket) {}
+
+    int read(unsigned char *buffer, int len, int timeout)
+    {
+        socket->set_timeout(timeout);
+        nsapi_size_or_error_t rc = socket->recv(buffer, len);
+        if (rc == NSAPI_ERROR_WOULD_BLOCK) {
+            // MQTTClient.readPacket() requires 0 on time out and no data.
+            return 0;
+        }
+        if (rc == 0) {
+            // The socket was closed.
+            return -1;
+        }
+        return rc;
+    }
+
+    int write(unsigned char *buffer, int len, int timeout)
+    {
+        socket->set_timeout(timeout);
+        nsapi_size_or_error_t rc = socket->send(buffer, len);
+        return rc == NSAPI_ERROR_WOULD_BLOCK ? 0 : rc;
+    }
+
+private:
+    Socket *socket;
+};
+
+class MQTTClient {
+public:
+    typedef void (*messageHandler)(MQTT::MessageData &);
+
+    MQTTClient(TCPSocket *socket) : network(socket), client(network) {}
+
+    int connect(MQTTPacket_connectData &options) { return client.connect(options); }
+    int publish(const char *topicName, MQTT::Message &message) { return client.publish(topicName, message); }
+    int subscribe(const char *topicFilter, enum MQTT::QoS qos, messageHandler handler)
+    {
+        return client.subscribe(topicFilter, qos, handler);
+    }
+    int unsubscribe(const char *topicFilter) { return client.unsubscribe(topicFilter); }
+    int yield(unsigned long timeout_ms = 1000L) { return client.yield(timeout_ms); }
+    int disconnect() { return client.disconnect(); }
+    bool isConnected() { return client.isConnected(); }
+    int setMessageHandler(const char *topicFilter, messageHandler handler)
+    {
+        return client.setMessageHandler(topicFilter, handler);
+    }
+    void setDefaultMessageHandler(messageHandler handler) { client.setDefaultMessageHandler(handler); }
+
+private:
+    MQTTNetworkMbedOs network;
+    MQTT::Client<MQTTNetworkMbedOs, Countdown, MBED_CONF_MBED_MQTT_MAX_PACKET_SIZE,
+                 MBED_CONF_MBED_MQTT_MAX_CONNECTIONS> client;
+};
+
+#endif /* __HOST_MQTT_CLIENT_MBED_OS_H__ */
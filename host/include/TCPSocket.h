@@ -0,0 +1,126 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __HOST_TCP_SOCKET_H__
+#define __HOST_TCP_SOCKET_H__
+
+#include "mbed.h"
+
+typedef int nsapi_error_t;
+typedef unsigned int nsapi_size_t;
+typedef signed int nsapi_size_or_error_t;
+
+enum nsapi_error {
+    NSAPI_ERROR_OK                  =  0,
+    NSAPI_ERROR_WOULD_BLOCK         = -3001,
+    NSAPI_ERROR_UNSUPPORTED         = -3002,
+    NSAPI_ERROR_PARAMETER           = -3003,
+    NSAPI_ERROR_NO_CONNECTION       = -3004,
+    NSAPI_ERROR_NO_SOCKET           = -3005,
+    NSAPI_ERROR_NO_ADDRESS          = -3006,
+    NSAPI_ERROR_NO_MEMORY           = -3007,
+    NSAPI_ERROR_DNS_FAILURE         = -3009,
+    NSAPI_ERROR_AUTH_FAILURE        = -3011,
+    NSAPI_ERROR_DEVICE_ERROR        = -3012,
+    NSAPI_ERROR_IS_CONNECTED        = -3015,
+    NSAPI_ERROR_CONNECTION_LOST     = -3016,
+    NSAPI_ERROR_CONNECTION_TIMEOUT  = -3017,
+};
+
+typedef enum nsapi_connection_status {
+    NSAPI_STATUS_LOCAL_UP           = 0,
+    NSAPI_STATUS_GLOBAL_UP          = 1,
+    NSAPI_STATUS_DISCONNECTED       = 2,
+    NSAPI_STATUS_CONNECTING         = 3,
+} nsapi_connection_status_t;
+
+/* Numeric IPv4 or IPv6 address and port. */
+class SocketAddress {
+public:
+    SocketAddress(const char *addr = NULL, uint16_t port = 0);
+
+    bool set_ip_address(const char *addr);
+    const char *get_ip_address() const { return ip[0] ? ip : NULL; }
+    void set_port(uint16_t port) { this->port = port; }
+    uint16_t get_port() const { return port; }
+
+    explicit operator bool() const { return ip[0] != '\0'; }
+
+private:
+    char ip[48];
+    uint16_t port;
+};
+
+/* The host's own network stack, always up. */
+class NetworkInterface {
+public:
+    static NetworkInterface *get_default_instance();
+
+    nsapi_error_t connect() { return NSAPI_ERROR_OK; }
+    nsapi_error_t disconnect() { return NSAPI_ERROR_OK; }
+    nsapi_connection_status_t get_connection_status() const { return NSAPI_STATUS_GLOBAL_UP; }
+    const char *get_ip_address() { return "127.0.0.1"; }
+
+    /* Resolves `host` with getaddrinfo(), the first address returned wins. */
+    nsapi_error_t gethostbyname(const char *host, SocketAddress *address);
+};
+
+class Socket {
+public:
+    virtual ~Socket() {}
+
+    virtual nsapi_error_t close() = 0;
+    virtual nsapi_error_t connect(const SocketAddress &address) = 0;
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size) = 0;
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size) = 0;
+    virtual void set_blocking(bool blocking) = 0;
+    virtual void set_timeout(int timeout) = 0;
+    virtual void sigio(mbed::Callback<void()> func) = 0;
+};
+
+/*
+ * TCPSocket of mbed OS on a POSIX socket. A timeout of -1 blocks, 0 makes
+ * send() and recv() return NSAPI_ERROR_WOULD_BLOCK right away when they
+ * cannot go on. The callback given to sigio() is never called on the host.
+ */
+class TCPSocket : public Socket {
+public:
+    TCPSocket();
+    virtual ~TCPSocket();
+
+    nsapi_error_t open(NetworkInterface *stack);
+
+    virtual nsapi_error_t close();
+    virtual nsapi_error_t connect(const SocketAddress &address);
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+    virtual void set_blocking(bool blocking) { timeout = blocking ? -1 : 0; }
+    virtual void set_timeout(int timeout) { this->timeout = timeout; }
+    virtual void sigio(mbed::Callback<void()> func) {}
+
+private:
+    /* Waits up to the timeout for `events` on the socket. Returns false on a timeout. */
+    bool waitFor(short events);
+
+    int fd;
+    bool isOpen;
+    int timeout;
+};
+
+#endif /* __HOST_TCP_SOCKET_H__ */
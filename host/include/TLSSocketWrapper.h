@@ -0,0 +1,95 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __HOST_TLS_SOCKET_WRAPPER_H__
+#define __HOST_TLS_SOCKET_WRAPPER_H__
+
+#include "mbed.h"
+#include "TCPSocket.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+/*
+ * TLSSocketWrapper of mbed OS on the mbed TLS of the host.
+ *
+ * As on the board, the transport is switched to non-blocking mode right
+ * after mbedtls_ssl_setup(), then the wrapper's own timeout is passed on to
+ * it, so a blocking wrapper blocks in the transport's recv() and send()
+ * instead of waiting for its sigio events.
+ */
+class TLSSocketWrapper : public Socket {
+public:
+    enum control_transport {
+        TRANSPORT_KEEP,
+        TRANSPORT_CONNECT_AND_CLOSE,
+        TRANSPORT_CONNECT,
+        TRANSPORT_CLOSE,
+    };
+
+    TLSSocketWrapper(Socket *transport, const char *hostname = NULL,
+                     control_transport control = TRANSPORT_CONNECT_AND_CLOSE);
+    virtual ~TLSSocketWrapper();
+
+    void set_hostname(const char *hostname);
+
+    nsapi_error_t set_root_ca_cert(const void *root_ca, size_t len);
+    nsapi_error_t set_root_ca_cert(const char *root_ca_pem);
+    nsapi_error_t set_client_cert_key(const void *client_cert, size_t client_cert_len,
+                                      const void *client_private_key, size_t client_private_key_len);
+    nsapi_error_t set_client_cert_key(const char *client_cert_pem, const char *client_private_key_pem);
+
+    mbedtls_x509_crt *get_ca_chain() { return caChain; }
+    void set_ca_chain(mbedtls_x509_crt *crt);
+    mbedtls_ssl_config *get_ssl_config() const;
+    mbedtls_ssl_context *get_ssl_context() const { return (mbedtls_ssl_context *)&ssl; }
+
+    /* Runs the handshake, connecting the transport to `address` first if it controls the connect. */
+    virtual nsapi_error_t connect(const SocketAddress &address);
+    virtual nsapi_error_t close();
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+    virtual void set_blocking(bool blocking) { set_timeout(blocking ? -1 : 0); }
+    virtual void set_timeout(int timeout);
+    virtual void sigio(mbed::Callback<void()> func) { transport->sigio(func); }
+
+private:
+    static int sslSend(void *context, const unsigned char *buf, size_t len);
+    static int sslRecv(void *context, unsigned char *buf, size_t len);
+
+    Socket *transport;
+    control_transport control;
+    char *hostname;
+    int timeout;
+    bool isHandshakeDone;
+    bool isSeeded;
+
+    mbedtls_ssl_context ssl;
+    mutable mbedtls_ssl_config *sslConfig;  // Created with the defaults on first use, as on the board.
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctrDrbg;
+    mbedtls_x509_crt *caChain;
+    bool isCaChainOwned;
+    mbedtls_x509_crt *clientCert;
+    mbedtls_pk_context clientKey;
+};
+
+#endif /* __HOST_TLS_SOCKET_WRAPPER_H__ */
@@ -0,0 +1,383 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __HOST_MBED_H__
+#define __HOST_MBED_H__
+
+/*
+ * The part of the mbed OS API used by the code the host build compiles,
+ * implemented on POSIX, see CMakeLists.txt. Threads are std::threads, time
+ * is read from CLOCK_MONOTONIC and the heap statistics come from glibc.
+ *
+ * Differences to a board that show up in the figures: Thread ignores the
+ * stack size, there are no stack statistics, and the heap statistics
+ * count every allocation of the process.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#define MBED_ASSERT(expr)               assert(expr)
+#define MBED_STATIC_ASSERT(expr, msg)   static_assert(expr, msg)
+#define MBED_UNUSED                     __attribute__((unused))
+
+/* ---------------------------------------------------------------- Callback */
+
+namespace mbed {
+
+template <typename F>
+class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+public:
+    Callback() {}
+    Callback(std::nullptr_t) {}
+    Callback(R (*func)(Args...))
+    {
+        if (func) {
+            fn = func;
+        }
+    }
+    template <typename T, typename U>
+    Callback(U *obj, R (T::*method)(Args...))
+        : fn([obj, method](Args... args) { return (obj->*method)(args...); })
+    {
+    }
+    template <typename T, typename U>
+    Callback(const U *obj, R (T::*method)(Args...) const)
+        : fn([obj, method](Args... args) { return (obj->*method)(args...); })
+    {
+    }
+    template <typename T, typename U>
+    Callback(R (*func)(T *, Args...), U *arg)
+        : fn([func, arg](Args... args) { return func(arg, args...); })
+    {
+    }
+
+    R call(Args... args) const { return fn(args...); }
+    R operator()(Args... args) const { return fn(args...); }
+    explicit operator bool() const { return (bool)fn; }
+
+private:
+    std::function<R(Args...)> fn;
+};
+
+template <typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(Args...))
+{
+    return Callback<R(Args...)>(func);
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U *obj, R (T::*method)(Args...))
+{
+    return Callback<R(Args...)>(obj, method);
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(const U *obj, R (T::*method)(Args...) const)
+{
+    return Callback<R(Args...)>(obj, method);
+}
+
+template <typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(T *, Args...), U *arg)
+{
+    return Callback<R(Args...)>(func, arg);
+}
+
+} // namespace mbed
+
+using mbed::Callback;
+using mbed::callback;
+
+/* -------------------------------------------------------------------- Time */
+
+/* Microseconds since an arbitrary point, wrapping at 32 bits as on a board. */
+uint32_t us_ticker_read();
+
+namespace Kernel {
+/* Milliseconds since the process started. */
+uint64_t get_ms_count();
+}
+
+typedef int64_t us_timestamp_t;
+
+class Timer {
+public:
+    Timer();
+
+    void start();
+    void stop();
+    void reset();
+
+    int read_us();
+    int read_ms();
+    float read();
+    us_timestamp_t read_high_resolution_us();
+
+private:
+    bool running;
+    uint64_t startNs;
+    uint64_t elapsedNs;
+};
+
+/* ----------------------------------------------------------------- Threads */
+
+typedef enum {
+    osPriorityIdle = 1,
+    osPriorityLow = 8,
+    osPriorityBelowNormal = 16,
+    osPriorityNormal = 24,
+    osPriorityAboveNormal = 32,
+    osPriorityHigh = 40,
+    osPriorityRealtime = 48,
+} osPriority;
+
+typedef int32_t osStatus;
+#define osOK                0
+#define osErrorResource     -3
+#define osErrorParameter    -4
+
+#ifndef OS_STACK_SIZE
+#define OS_STACK_SIZE       4096
+#endif
+
+namespace rtos {
+
+/* Recursive, as the mutex of mbed OS. */
+class Mutex {
+public:
+    void lock() { mutex.lock(); }
+    bool trylock() { return mutex.try_lock(); }
+    void unlock() { mutex.unlock(); }
+
+private:
+    std::recursive_mutex mutex;
+};
+
+/*
+ * A thread of the board never ends, e.g. the one of DeferredLog waits on its
+ * semaphore for good. When the host program exits, the semaphore of such a
+ * thread is left behind instead of destroyed under the waiting thread.
+ */
+class Semaphore {
+public:
+    Semaphore(int32_t count = 0, uint16_t max_count = 0xFFFF) : state(new State(count, max_count)) {}
+
+    ~Semaphore()
+    {
+        bool isWaitedOn;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            isWaitedOn = state->waiters > 0;
+        }
+        if (!isWaitedOn) {
+            delete state;
+        }
+    }
+
+    void acquire()
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->waiters++;
+        state->available.wait(lock, [this]() { return state->count > 0; });
+        state->waiters--;
+        state->count--;
+    }
+
+    bool try_acquire_for(uint32_t millisec)
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->waiters++;
+        const bool isAcquired = state->available.wait_for(lock, std::chrono::milliseconds(millisec),
+                                                          [this]() { return state->count > 0; });
+        state->waiters--;
+        if (isAcquired) {
+            state->count--;
+        }
+        return isAcquired;
+    }
+
+    osStatus release()
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->count >= state->maxCount) {
+            return osErrorResource;
+        }
+        state->count++;
+        state->available.notify_one();
+        return osOK;
+    }
+
+private:
+    struct State {
+        State(int32_t count, int32_t maxCount) : count(count), maxCount(maxCount), waiters(0) {}
+
+        std::mutex mutex;
+        std::condition_variable available;
+        int32_t count;
+        int32_t maxCount;
+        uint32_t waiters;
+    };
+
+    State *state;
+};
+
+/* The priority and the stack size are not applied on the host. */
+class Thread {
+public:
+    Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = OS_STACK_SIZE,
+           unsigned char *stack_mem = NULL, const char *name = NULL);
+    ~Thread();
+
+    osStatus start(mbed::Callback<void()> task);
+    osStatus join();
+    const char *get_name() const { return name; }
+
+private:
+    std::thread thread;
+    const char *name;
+};
+
+namespace ThisThread {
+void sleep_for(uint32_t millisec);
+void *get_id();
+}
+
+} // namespace rtos
+
+using namespace rtos;
+
+/* ----------------------------------------------------------------- Atomics */
+
+typedef struct {
+    uint8_t _flag;
+} core_util_atomic_flag;
+
+#define CORE_UTIL_ATOMIC_FLAG_INIT { 0 }
+
+inline bool core_util_atomic_flag_test_and_set(volatile core_util_atomic_flag *flag)
+{
+    return __atomic_test_and_set(&flag->_flag, __ATOMIC_SEQ_CST);
+}
+
+inline void core_util_atomic_flag_clear(volatile core_util_atomic_flag *flag)
+{
+    __atomic_clear(&flag->_flag, __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_load_u32(const volatile uint32_t *valuePtr)
+{
+    return __atomic_load_n(valuePtr, __ATOMIC_SEQ_CST);
+}
+
+inline void core_util_atomic_store_u32(volatile uint32_t *valuePtr, uint32_t desiredValue)
+{
+    __atomic_store_n(valuePtr, desiredValue, __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_exchange_u32(volatile uint32_t *valuePtr, uint32_t desiredValue)
+{
+    return __atomic_exchange_n(valuePtr, desiredValue, __ATOMIC_SEQ_CST);
+}
+
+inline bool core_util_atomic_cas_u32(volatile uint32_t *ptr, uint32_t *expectedCurrentValue, uint32_t desiredValue)
+{
+    return __atomic_compare_exchange_n(ptr, expectedCurrentValue, desiredValue, false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_incr_u32(volatile uint32_t *valuePtr, uint32_t delta)
+{
+    return __atomic_add_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+inline uint32_t core_util_atomic_decr_u32(volatile uint32_t *valuePtr, uint32_t delta)
+{
+    return __atomic_sub_fetch(valuePtr, delta, __ATOMIC_SEQ_CST);
+}
+
+/* One lock for the whole process, there are no interrupts to hold off. */
+void core_util_critical_section_enter();
+void core_util_critical_section_exit();
+
+/* -------------------------------------------------------------- Statistics */
+
+typedef struct {
+    uint32_t current_size;
+    uint32_t max_size;
+    uint32_t total_size;
+    uint32_t reserved_size;
+    uint32_t alloc_cnt;
+    uint32_t alloc_fail_cnt;
+    uint32_t overhead_size;
+} mbed_stats_heap_t;
+
+/* current_size is the heap in use by the process, max_size the most seen by earlier calls. */
+void mbed_stats_heap_get(mbed_stats_heap_t *stats);
+
+typedef struct {
+    uint32_t thread_id;
+    uint32_t max_size;
+    uint32_t reserved_size;
+    uint32_t stack_cnt;
+} mbed_stats_stack_t;
+
+/* Stacks are not painted on the host, so this reports none. */
+size_t mbed_stats_stack_get_each(mbed_stats_stack_t *stats, size_t count);
+
+/* --------------------------------------------------------------------- CRC */
+
+typedef enum crc_polynomial {
+    POLY_32BIT_ANSI = 0x04C11DB7,
+} crc_polynomial_t;
+
+/* Only the reflected CRC-32 of POLY_32BIT_ANSI, as mbed OS computes it. */
+template <uint32_t polynomial = POLY_32BIT_ANSI, uint8_t width = 32>
+class MbedCRC {
+public:
+    MBED_STATIC_ASSERT(polynomial == POLY_32BIT_ANSI && width == 32, "only CRC-32 is implemented on the host");
+
+    int32_t compute(const void *buffer, unsigned long size, uint32_t *crc)
+    {
+        uint32_t value = 0xFFFFFFFF;
+        for (unsigned long i = 0; i < size; i++) {
+            value ^= ((const uint8_t *)buffer)[i];
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value >> 1) ^ (0xEDB88320 & (0 - (value & 1)));
+            }
+        }
+        *crc = ~value;
+        return 0;
+    }
+};
+
+#endif /* __HOST_MBED_H__ */
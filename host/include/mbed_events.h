@@ -0,0 +1,112 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __HOST_MBED_EVENTS_H__
+#define __HOST_MBED_EVENTS_H__
+
+#include "mbed.h"
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <tuple>
+
+/* Only sizes the queue on a board, the host allocates each event as it is posted. */
+#define EVENTS_EVENT_SIZE   64
+
+namespace events {
+
+/*
+ * EventQueue of mbed OS on a mutex and a condition variable. Events may be
+ * posted from any thread and run on the thread that dispatches the queue,
+ * in the order they are due.
+ */
+class EventQueue {
+public:
+    EventQueue(unsigned size = 32 * EVENTS_EVENT_SIZE, unsigned char *buffer = NULL);
+
+    /* Runs the events due for `ms` milliseconds, or until break_dispatch() if negative. */
+    void dispatch(int ms = -1);
+    void dispatch_forever() { dispatch(-1); }
+    void break_dispatch();
+
+    /* Returns false if the event already ran or was cancelled. */
+    bool cancel(int id);
+
+    template <typename F, typename... Args>
+    int call(F f, Args... args)
+    {
+        return post(0, 0, std::bind(f, args...));
+    }
+
+    template <typename T, typename R, typename... BoundArgs, typename... Args>
+    int call(T *obj, R (T::*method)(BoundArgs...), Args... args)
+    {
+        return post(0, 0, std::bind(method, obj, args...));
+    }
+
+    template <typename F, typename... Args>
+    int call_in(int ms, F f, Args... args)
+    {
+        return post(ms, 0, std::bind(f, args...));
+    }
+
+    template <typename T, typename R, typename... BoundArgs, typename... Args>
+    int call_in(int ms, T *obj, R (T::*method)(BoundArgs...), Args... args)
+    {
+        return post(ms, 0, std::bind(method, obj, args...));
+    }
+
+    template <typename F, typename... Args>
+    int call_every(int ms, F f, Args... args)
+    {
+        return post(ms, ms, std::bind(f, args...));
+    }
+
+    template <typename T, typename R, typename... BoundArgs, typename... Args>
+    int call_every(int ms, T *obj, R (T::*method)(BoundArgs...), Args... args)
+    {
+        return post(ms, ms, std::bind(method, obj, args...));
+    }
+
+private:
+    // Due time, then the order the events were posted in, then the id.
+    typedef std::tuple<uint64_t, uint64_t, int> Slot;
+
+    struct Event {
+        Slot slot;
+        int periodMs;       // 0 for a one-shot event.
+        std::function<void()> func;
+    };
+
+    int post(int delayMs, int periodMs, std::function<void()> func);
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::map<int, Event> events;
+    std::set<Slot> schedule;
+    int lastId;
+    uint64_t posted;
+    bool isBreakRequested;
+};
+
+} // namespace events
+
+using events::EventQueue;
+
+#endif /* __HOST_MBED_EVENTS_H__ */
@@ -0,0 +1,253 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "mbed.h"
+#include "mbed_events.h"
+#include <limits.h>
+#include <malloc.h>
+#include <chrono>
+
+static uint64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+/* The host's boot is the start of the process. */
+static const uint64_t startNs = monotonicNs();
+
+uint32_t us_ticker_read()
+{
+    return (uint32_t)((monotonicNs() - startNs) / 1000);
+}
+
+uint64_t Kernel::get_ms_count()
+{
+    return (monotonicNs() - startNs) / 1000000;
+}
+
+/* ------------------------------------------------------------------- Timer */
+
+Timer::Timer() : running(false), startNs(0), elapsedNs(0)
+{
+}
+
+void Timer::start()
+{
+    if (!running) {
+        startNs = monotonicNs();
+        running = true;
+    }
+}
+
+void Timer::stop()
+{
+    if (running) {
+        elapsedNs += monotonicNs() - startNs;
+        running = false;
+    }
+}
+
+void Timer::reset()
+{
+    elapsedNs = 0;
+    startNs = monotonicNs();
+}
+
+us_timestamp_t Timer::read_high_resolution_us()
+{
+    return (elapsedNs + (running ? monotonicNs() - startNs : 0)) / 1000;
+}
+
+int Timer::read_us()
+{
+    return (int)read_high_resolution_us();
+}
+
+int Timer::read_ms()
+{
+    return (int)(read_high_resolution_us() / 1000);
+}
+
+float Timer::read()
+{
+    return read_high_resolution_us() / 1000000.0f;
+}
+
+/* ----------------------------------------------------------------- Threads */
+
+Thread::Thread(osPriority priority, uint32_t stack_size, unsigned char *stack_mem, const char *name) : name(name)
+{
+}
+
+Thread::~Thread()
+{
+    // A std::thread cannot be terminated, one still running is left to end with the process.
+    if (thread.joinable()) {
+        thread.detach();
+    }
+}
+
+osStatus Thread::start(mbed::Callback<void()> task)
+{
+    if (thread.joinable() || !task) {
+        return osErrorParameter;
+    }
+    thread = std::thread([task]() { task(); });
+    return osOK;
+}
+
+osStatus Thread::join()
+{
+    if (!thread.joinable()) {
+        return osErrorResource;
+    }
+    thread.join();
+    return osOK;
+}
+
+void ThisThread::sleep_for(uint32_t millisec)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(millisec));
+}
+
+void *ThisThread::get_id()
+{
+    static thread_local char id;
+    return &id;
+}
+
+static std::recursive_mutex criticalSection;
+
+void core_util_critical_section_enter()
+{
+    criticalSection.lock();
+}
+
+void core_util_critical_section_exit()
+{
+    criticalSection.unlock();
+}
+
+/* -------------------------------------------------------------- Statistics */
+
+void mbed_stats_heap_get(mbed_stats_heap_t *stats)
+{
+    static uint32_t maxSize;
+    const struct mallinfo2 info = mallinfo2();
+    memset(stats, 0, sizeof(*stats));
+    stats->current_size = (uint32_t)info.uordblks;
+    stats->reserved_size = (uint32_t)info.arena;
+    core_util_critical_section_enter();
+    if (stats->current_size > maxSize) {
+        maxSize = stats->current_size;
+    }
+    stats->max_size = maxSize;
+    core_util_critical_section_exit();
+}
+
+size_t mbed_stats_stack_get_each(mbed_stats_stack_t *stats, size_t count)
+{
+    return 0;
+}
+
+/* -------------------------------------------------------------- EventQueue */
+
+namespace events {
+
+EventQueue::EventQueue(unsigned size, unsigned char *buffer) : lastId(0), posted(0), isBreakRequested(false)
+{
+}
+
+int EventQueue::post(int delayMs, int periodMs, std::function<void()> func)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lastId = lastId == INT_MAX ? 1 : lastId + 1;
+    Event &event = events[lastId];
+    event.slot = Slot(monotonicNs() / 1000 + (uint64_t)(delayMs > 0 ? delayMs : 0) * 1000, posted++, lastId);
+    event.periodMs = periodMs;
+    event.func = func;
+    schedule.insert(event.slot);
+    wakeup.notify_all();
+    return lastId;
+}
+
+bool EventQueue::cancel(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<int, Event>::iterator event = events.find(id);
+    if (event == events.end()) {
+        return false;
+    }
+    schedule.erase(event->second.slot);
+    events.erase(event);
+    return true;
+}
+
+void EventQueue::break_dispatch()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    isBreakRequested = true;
+    wakeup.notify_all();
+}
+
+void EventQueue::dispatch(int ms)
+{
+    const uint64_t deadlineUs = ms < 0 ? UINT64_MAX : monotonicNs() / 1000 + (uint64_t)ms * 1000;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!isBreakRequested) {
+        const uint64_t nowUs = monotonicNs() / 1000;
+        if (!schedule.empty() && std::get<0>(*schedule.begin()) <= nowUs) {
+            const int id = std::get<2>(*schedule.begin());
+            schedule.erase(schedule.begin());
+            Event &event = events[id];
+            std::function<void()> func = event.func;
+            if (event.periodMs > 0) {
+                event.slot = Slot(std::get<0>(event.slot) + (uint64_t)event.periodMs * 1000, posted++, id);
+                schedule.insert(event.slot);
+            } else {
+                events.erase(id);
+            }
+            lock.unlock();
+            func();
+            lock.lock();
+            // As on mbed OS, an overloaded queue still returns at the deadline.
+            if (monotonicNs() / 1000 >= deadlineUs) {
+                return;
+            }
+            continue;
+        }
+        if (nowUs >= deadlineUs) {
+            return;
+        }
+        uint64_t waitUntilUs = deadlineUs;
+        if (!schedule.empty() && std::get<0>(*schedule.begin()) < waitUntilUs) {
+            waitUntilUs = std::get<0>(*schedule.begin());
+        }
+        if (waitUntilUs == UINT64_MAX) {
+            wakeup.wait(lock);
+        } else {
+            wakeup.wait_for(lock, std::chrono::microseconds(waitUntilUs - nowUs));
+        }
+    }
+    isBreakRequested = false;
+}
+
+} // namespace events
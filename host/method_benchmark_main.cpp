@@ -0,0 +1,47 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+/*
+ * Direct method benchmark of the host build: times echo method calls from
+ * the moment a LoopbackBroker sends the request until it has the response,
+ * see MethodBenchmark.
+ *
+ *   method_benchmark [calls] [response budget ms]
+ */
+
+#include "mbed.h"
+#include "loopback_broker.h"
+#include "method_benchmark.h"
+
+#define HOST_METHOD_BENCHMARK_CALLS     1000
+
+int main(int argc, char *argv[])
+{
+    const uint32_t calls = (argc > 1) ? (uint32_t)atoi(argv[1]) : HOST_METHOD_BENCHMARK_CALLS;
+    const uint32_t budgetMs = (argc > 2) ? (uint32_t)atoi(argv[2]) : MBED_CONF_APP_METHOD_RESPONSE_BUDGET_MS;
+
+    LoopbackBroker broker(0, 0);
+    MethodBenchmark benchmark(calls, budgetMs, &broker);
+    const int ret = benchmark.run();
+    if (ret != 0) {
+        printf("ERROR: method benchmark failed, %d.\r\n", ret);
+    }
+    benchmark.print();
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+/*
+ * MQTT benchmark of the host build, on a TLS connection to a local broker,
+ * e.g. mosquitto, see README.md. Times the TCP connect, the TLS handshake and
+ * the MQTT connect, then publishes at QoS0, at QoS1 through Qos1Publisher,
+ * and to a topic the client subscribed to for round trips. The connect
+ * phases and the benchmark are also recorded by a PhaseProfiler, whose
+ * report and timeline follow the results; the benchmark is one run of
+ * PHASE_PUBLISH.
+ *
+ *   mqtt_benchmark <host> <port> <CA PEM file> [messages] [payload bytes]
+ */
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "mqtt_tap_socket.h"
+#include "qos1_publisher.h"
+#include "mqtt_benchmark.h"
+#include "phase_profiler.h"
+
+#define HOST_BENCHMARK_CLIENT_ID    "host-benchmark"
+#define HOST_BENCHMARK_TOPIC        "devices/" HOST_BENCHMARK_CLIENT_ID "/messages/events/"
+#define HOST_BENCHMARK_MESSAGES     1000
+
+/* Reads the whole file at `path` into a NUL-terminated buffer to be freed by the caller. */
+static char *readFile(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = (size >= 0) ? (char *)malloc(size + 1) : NULL;
+    if (data && fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    if (data) {
+        data[size] = '\0';
+    }
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        printf("usage: %s <host> <port> <CA PEM file> [messages] [payload bytes]\r\n", argv[0]);
+        return 2;
+    }
+    const char *host = argv[1];
+    const uint16_t port = (uint16_t)atoi(argv[2]);
+    const unsigned int count = (argc > 4) ? (unsigned int)atoi(argv[4]) : HOST_BENCHMARK_MESSAGES;
+    const size_t payloadSize = (argc > 5) ? (size_t)atoi(argv[5]) : MBED_CONF_APP_BENCHMARK_PAYLOAD_SIZE;
+
+    char *caPem = readFile(argv[3]);
+    if (!caPem) {
+        printf("ERROR: could not read %s.\r\n", argv[3]);
+        return 1;
+    }
+
+    PhaseProfiler profiler;
+    NetworkInterface *network = NetworkInterface::get_default_instance();
+    MqttTapSocket socket;
+    profiler.begin(PHASE_SOCKET_OPEN);
+    nsapi_error_t ret = socket.open(network);
+    profiler.end(PHASE_SOCKET_OPEN);
+    if (ret == NSAPI_ERROR_OK) {
+        profiler.begin(PHASE_CA_LOAD);
+        ret = socket.set_root_ca_cert(caPem);
+        profiler.end(PHASE_CA_LOAD);
+    }
+    if (ret != NSAPI_ERROR_OK) {
+        printf("ERROR: could not set up the socket, %d.\r\n", ret);
+        return 1;
+    }
+
+    SocketAddress address;
+    profiler.begin(PHASE_DNS_LOOKUP);
+    ret = network->gethostbyname(host, &address);
+    profiler.end(PHASE_DNS_LOOKUP);
+    if (ret != NSAPI_ERROR_OK) {
+        printf("ERROR: could not resolve %s.\r\n", host);
+        return 1;
+    }
+    address.set_port(port);
+
+    Timer timer;
+    timer.start();
+    profiler.begin(PHASE_TCP_CONNECT);
+    ret = socket.connectTransport(address);
+    profiler.end(PHASE_TCP_CONNECT);
+    const uint32_t tcpConnectUs = timer.read_us();
+    if (ret != NSAPI_ERROR_OK) {
+        printf("ERROR: could not connect to %s:%u, %d.\r\n", host, port, ret);
+        return 1;
+    }
+    timer.reset();
+    profiler.begin(PHASE_TLS_HANDSHAKE);
+    ret = socket.handshake(host);
+    profiler.end(PHASE_TLS_HANDSHAKE);
+    const uint32_t handshakeUs = timer.read_us();
+    if (ret != NSAPI_ERROR_OK) {
+        printf("ERROR: TLS handshake with %s failed, %d.\r\n", host, ret);
+        return 1;
+    }
+    printf("TCP connect:      %lu us\r\n", (unsigned long)tcpConnectUs);
+    printf("TLS handshake:    %lu us\r\n", (unsigned long)handshakeUs);
+
+    MQTTClient client(&socket);
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = (char *)HOST_BENCHMARK_CLIENT_ID;
+    data.cleansession = 1;
+    timer.reset();
+    profiler.begin(PHASE_MQTT_CONNECT);
+    int rc = client.connect(data);
+    profiler.end(PHASE_MQTT_CONNECT);
+    const uint32_t mqttConnectUs = timer.read_us();
+    if (rc != MQTT::SUCCESS) {
+        printf("ERROR: MQTT connect failed, %d.\r\n", rc);
+        return 1;
+    }
+
+    Qos1Publisher publisher(MBED_CONF_APP_QOS1_ACK_TIMEOUT_MS, MBED_CONF_APP_QOS1_MAX_RETRIES);
+    publisher.attach(&client, &socket);
+
+    MqttBenchmark benchmark(&client, HOST_BENCHMARK_TOPIC, count, payloadSize);
+    benchmark.setTlsConnectTime(tcpConnectUs + handshakeUs);
+    benchmark.setMqttConnectTime(mqttConnectUs);
+    benchmark.setQos1Publisher(&publisher);
+    benchmark.setRoundTrip(true);
+    profiler.begin(PHASE_PUBLISH);
+    rc = benchmark.run();
+    profiler.end(PHASE_PUBLISH);
+    if (rc != MQTT::SUCCESS) {
+        printf("ERROR: rc from MQTT publish during benchmark is %d\r\n", rc);
+    }
+    benchmark.print();
+    profiler.printReport();
+    profiler.printTimeline();
+
+    client.disconnect();
+    socket.close();
+    free(caPem);
+    return rc == MQTT::SUCCESS ? 0 : 1;
+}
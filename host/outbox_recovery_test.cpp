@@ -0,0 +1,254 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+/*
+ * Host test of TelemetryOutbox recovery: records are appended, partly read
+ * and acknowledged, then the board "resets", i.e. a new outbox is opened on
+ * the same device, and the unacknowledged records must come back in order.
+ *
+ * The device behaves like NOR flash: erased bytes read 0xFF and programming
+ * can only clear bits. A power cut can be set to stop a program part way.
+ */
+
+#include "mbed.h"
+#include "BlockDevice.h"
+#include "telemetry_outbox.h"
+
+#define TEST_BLOCK_SIZE     512
+#define TEST_BLOCK_COUNT    4
+#define TEST_PROGRAM_SIZE   32
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("FAIL: %s:%d: %s\r\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+class FlashBlockDevice : public BlockDevice {
+public:
+    FlashBlockDevice() : powerCutBytes(-1), overwrites(0)
+    {
+        memset(data, 0xFF, sizeof(data));
+    }
+
+    /* Makes the next program() write only `bytes` bytes and fail, -1 for no power cut. */
+    void cutPowerAfter(int bytes) { powerCutBytes = bytes; }
+
+    /* Bytes programmed over bits that were already cleared. */
+    uint32_t overwriteCount() const { return overwrites; }
+
+    virtual int init() { return 0; }
+    virtual int deinit() { return 0; }
+
+    virtual int read(void *buffer, bd_addr_t addr, bd_size_t size)
+    {
+        if (addr + size > sizeof(data)) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+        memcpy(buffer, data + addr, size);
+        return 0;
+    }
+
+    virtual int program(const void *buffer, bd_addr_t addr, bd_size_t size)
+    {
+        if (addr % TEST_PROGRAM_SIZE || size % TEST_PROGRAM_SIZE || addr + size > sizeof(data)) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+        bd_size_t length = size;
+        if (powerCutBytes >= 0 && (bd_size_t)powerCutBytes < size) {
+            length = powerCutBytes;
+        }
+        const uint8_t *bytes = (const uint8_t *)buffer;
+        for (bd_size_t i = 0; i < length; i++) {
+            if (data[addr + i] != 0xFF) {
+                overwrites++;
+            }
+            data[addr + i] &= bytes[i];
+        }
+        if (length < size) {
+            powerCutBytes = -1;
+            return BD_ERROR_DEVICE_ERROR;
+        }
+        return 0;
+    }
+
+    virtual int erase(bd_addr_t addr, bd_size_t size)
+    {
+        if (addr % TEST_BLOCK_SIZE || size % TEST_BLOCK_SIZE || addr + size > sizeof(data)) {
+            return BD_ERROR_DEVICE_ERROR;
+        }
+        memset(data + addr, 0xFF, size);
+        return 0;
+    }
+
+    virtual bd_size_t get_read_size() const { return 1; }
+    virtual bd_size_t get_program_size() const { return TEST_PROGRAM_SIZE; }
+    virtual bd_size_t get_erase_size() const { return TEST_BLOCK_SIZE; }
+    virtual int get_erase_value() const { return 0xFF; }
+    virtual bd_size_t size() const { return sizeof(data); }
+    virtual const char *get_type() const { return "FLASH"; }
+
+private:
+    uint8_t data[TEST_BLOCK_SIZE * TEST_BLOCK_COUNT];
+    int powerCutBytes;
+    uint32_t overwrites;
+};
+
+/* Record number `n`, so that a replayed record can be told apart from any other. */
+static TelemetryRecord makeRecord(uint32_t n)
+{
+    TelemetryRecord record;
+    record.timestamp = 1000 + n;
+    record.sequence = n;
+    record.value = -(int32_t)n * 7;
+    record.source = (uint16_t)(n % 5 + 1);
+    return record;
+}
+
+static bool isRecord(const TelemetryRecord &record, uint32_t n)
+{
+    const TelemetryRecord expected = makeRecord(n);
+    return record.timestamp == expected.timestamp && record.sequence == expected.sequence
+           && record.value == expected.value && record.source == expected.source;
+}
+
+/* Reads every record left and checks they are `first`, `first` + 1, ... up to `last`. */
+static void checkReplay(TelemetryOutbox &outbox, uint32_t first, uint32_t last)
+{
+    TelemetryRecord record;
+    uint32_t n = first;
+    while (outbox.readNext(record)) {
+        CHECK(n <= last);
+        CHECK(isRecord(record, n));
+        n++;
+    }
+    CHECK(n == last + 1);
+}
+
+static void testReplayAfterReset()
+{
+    FlashBlockDevice flash;
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        for (uint32_t n = 1; n <= 40; n++) {
+            CHECK(outbox.append(makeRecord(n)) == 0);
+        }
+        TelemetryRecord record;
+        for (uint32_t n = 1; n <= 25; n++) {
+            CHECK(outbox.readNext(record) && isRecord(record, n));
+        }
+        // Only the first 15 were delivered before the reset.
+        CHECK(outbox.acknowledge(15) == 0);
+        CHECK(outbox.pending() == 25);
+    }
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        CHECK(outbox.pending() == 25);
+        checkReplay(outbox, 16, 40);
+        CHECK(outbox.acknowledge() == 0);
+        CHECK(outbox.empty());
+    }
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        CHECK(outbox.empty());
+        TelemetryRecord record;
+        CHECK(!outbox.readNext(record));
+        // Numbering carries on where it left off.
+        CHECK(outbox.append(makeRecord(41)) == 0);
+        checkReplay(outbox, 41, 41);
+    }
+    CHECK(flash.overwriteCount() == 0);
+}
+
+static void testTornWrite()
+{
+    FlashBlockDevice flash;
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        for (uint32_t n = 1; n <= 10; n++) {
+            CHECK(outbox.append(makeRecord(n)) == 0);
+        }
+        TelemetryRecord record;
+        for (uint32_t n = 1; n <= 4; n++) {
+            CHECK(outbox.readNext(record));
+        }
+        CHECK(outbox.acknowledge() == 0);
+        flash.cutPowerAfter(12);
+        CHECK(outbox.append(makeRecord(11)) != 0);
+    }
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        CHECK(outbox.pending() == 6);
+        checkReplay(outbox, 5, 10);
+        // The torn slot is skipped, not programmed over.
+        CHECK(outbox.append(makeRecord(11)) == 0);
+    }
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        CHECK(outbox.pending() == 7);
+        checkReplay(outbox, 5, 11);
+    }
+    CHECK(flash.overwriteCount() == 0);
+}
+
+static void testReplayAfterWrap()
+{
+    FlashBlockDevice flash;
+    const uint32_t count = 100;     // More than the ring holds, the oldest are dropped.
+    uint32_t pending;
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        for (uint32_t n = 1; n <= count; n++) {
+            CHECK(outbox.append(makeRecord(n)) == 0);
+        }
+        pending = outbox.pending();
+        CHECK(pending > 0 && pending < count);
+    }
+    {
+        TelemetryOutbox outbox(&flash);
+        CHECK(outbox.init() == 0);
+        CHECK(outbox.pending() == pending);
+        checkReplay(outbox, count - pending + 1, count);
+    }
+    CHECK(flash.overwriteCount() == 0);
+}
+
+int main()
+{
+    testReplayAfterReset();
+    testTornWrite();
+    testReplayAfterWrap();
+    if (failures) {
+        printf("%d outbox recovery checks failed.\r\n", failures);
+        return 1;
+    }
+    printf("Outbox recovery checks passed.\r\n");
+    return 0;
+}
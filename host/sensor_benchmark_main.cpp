@@ -0,0 +1,46 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+/*
+ * Sensor benchmark of the host build: feeds synthetic streams through the
+ * WindowAggregator of the sensor pipeline and checks every summary, see
+ * SensorBenchmark.
+ *
+ *   sensor_benchmark [samples per stream] [window samples] [decimation]
+ */
+
+#include "mbed.h"
+#include "sensor_benchmark.h"
+
+#define HOST_SENSOR_BENCHMARK_SAMPLES   1000000
+
+int main(int argc, char *argv[])
+{
+    const uint32_t samples = (argc > 1) ? (uint32_t)atoi(argv[1]) : HOST_SENSOR_BENCHMARK_SAMPLES;
+    const uint32_t windowSamples = (argc > 2) ? (uint32_t)atoi(argv[2]) : MBED_CONF_APP_SENSOR_WINDOW_SAMPLES;
+    const uint32_t decimation = (argc > 3) ? (uint32_t)atoi(argv[3]) : MBED_CONF_APP_SENSOR_DECIMATION;
+
+    SensorBenchmark benchmark(windowSamples, decimation, samples);
+    const int ret = benchmark.run();
+    if (ret != 0) {
+        printf("ERROR: sensor benchmark failed, %d.\r\n", ret);
+    }
+    benchmark.print();
+    return ret == 0 ? 0 : 1;
+}
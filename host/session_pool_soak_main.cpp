@@ -0,0 +1,52 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+/*
+ * Session pool soak test of the host build: runs connect/disconnect cycles
+ * against a LoopbackBroker on a pool of the sample's geometry and on the
+ * heap, see SessionPoolSoak.
+ *
+ *   session_pool_soak [cycles]
+ */
+
+#include "mbed.h"
+#include "loopback_broker.h"
+#include "session_pool.h"
+#include "session_pool_soak.h"
+
+#define HOST_SESSION_POOL_SOAK_CYCLES   10000
+
+static constexpr SessionPoolClass sessionPoolClasses[] = MBED_CONF_APP_SESSION_POOL_CLASSES;
+static uint64_t sessionPoolArena[sessionPoolArenaSize(sessionPoolClasses) / sizeof(uint64_t)];
+
+int main(int argc, char *argv[])
+{
+    const uint32_t cycles = (argc > 1) ? (uint32_t)atoi(argv[1]) : HOST_SESSION_POOL_SOAK_CYCLES;
+
+    LoopbackBroker broker(0, 0);
+    SessionPool pool(sessionPoolArena, sizeof(sessionPoolArena), sessionPoolClasses,
+                     sizeof(sessionPoolClasses) / sizeof(sessionPoolClasses[0]));
+    SessionPoolSoak soak(&pool, cycles, &broker);
+    const int ret = soak.run();
+    if (ret != 0) {
+        printf("ERROR: session pool soak test failed, %d.\r\n", ret);
+    }
+    soak.print();
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "TCPSocket.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+SocketAddress::SocketAddress(const char *addr, uint16_t port) : port(port)
+{
+    ip[0] = '\0';
+    if (addr) {
+        set_ip_address(addr);
+    }
+}
+
+bool SocketAddress::set_ip_address(const char *addr)
+{
+    uint8_t bytes[16];
+    if (strlen(addr) >= sizeof(ip)
+            || (inet_pton(AF_INET, addr, bytes) != 1 && inet_pton(AF_INET6, addr, bytes) != 1)) {
+        ip[0] = '\0';
+        return false;
+    }
+    strcpy(ip, addr);
+    return true;
+}
+
+NetworkInterface *NetworkInterface::get_default_instance()
+{
+    static NetworkInterface host;
+    return &host;
+}
+
+nsapi_error_t NetworkInterface::gethostbyname(const char *host, SocketAddress *address)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0) {
+        return NSAPI_ERROR_DNS_FAILURE;
+    }
+    char ip[INET6_ADDRSTRLEN];
+    const void *raw = result->ai_family == AF_INET
+                      ? (const void *)&((struct sockaddr_in *)result->ai_addr)->sin_addr
+                      : (const void *)&((struct sockaddr_in6 *)result->ai_addr)->sin6_addr;
+    const bool isConverted = inet_ntop(result->ai_family, raw, ip, sizeof(ip)) != NULL;
+    freeaddrinfo(result);
+    if (!isConverted || !address->set_ip_address(ip)) {
+        return NSAPI_ERROR_DNS_FAILURE;
+    }
+    return NSAPI_ERROR_OK;
+}
+
+TCPSocket::TCPSocket() : fd(-1), isOpen(false), timeout(-1)
+{
+}
+
+TCPSocket::~TCPSocket()
+{
+    close();
+}
+
+nsapi_error_t TCPSocket::open(NetworkInterface *stack)
+{
+    if (isOpen) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    isOpen = true;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TCPSocket::close()
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    isOpen = false;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TCPSocket::connect(const SocketAddress &address)
+{
+    if (!isOpen) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    if (fd >= 0) {
+        return NSAPI_ERROR_IS_CONNECTED;
+    }
+    if (!address) {
+        return NSAPI_ERROR_NO_ADDRESS;
+    }
+
+    struct sockaddr_storage peer;
+    socklen_t peerLength;
+    memset(&peer, 0, sizeof(peer));
+    struct sockaddr_in *v4 = (struct sockaddr_in *)&peer;
+    struct sockaddr_in6 *v6 = (struct sockaddr_in6 *)&peer;
+    if (inet_pton(AF_INET, address.get_ip_address(), &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        v4->sin_port = htons(address.get_port());
+        peerLength = sizeof(*v4);
+    } else {
+        inet_pton(AF_INET6, address.get_ip_address(), &v6->sin6_addr);
+        v6->sin6_family = AF_INET6;
+        v6->sin6_port = htons(address.get_port());
+        peerLength = sizeof(*v6);
+    }
+
+    fd = socket(peer.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return NSAPI_ERROR_NO_SOCKET;
+    }
+    if (::connect(fd, (struct sockaddr *)&peer, peerLength) != 0) {
+        ::close(fd);
+        fd = -1;
+        return errno == ETIMEDOUT ? NSAPI_ERROR_CONNECTION_TIMEOUT : NSAPI_ERROR_NO_CONNECTION;
+    }
+    // As lwIP sends small MQTT packets right away, so does the host.
+    const int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return NSAPI_ERROR_OK;
+}
+
+bool TCPSocket::waitFor(short events)
+{
+    struct pollfd entry = { fd, events, 0 };
+    int result;
+    do {
+        result = poll(&entry, 1, timeout);
+    } while (result < 0 && errno == EINTR);
+    return result > 0;
+}
+
+nsapi_size_or_error_t TCPSocket::send(const void *data, nsapi_size_t size)
+{
+    if (fd < 0) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    nsapi_size_t sent = 0;
+    while (sent < size) {
+        if (!waitFor(POLLOUT)) {
+            break;
+        }
+        const ssize_t result = ::send(fd, (const uint8_t *)data + sent, size - sent, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return NSAPI_ERROR_CONNECTION_LOST;
+        }
+        sent += result;
+    }
+    return sent > 0 || size == 0 ? (nsapi_size_or_error_t)sent : NSAPI_ERROR_WOULD_BLOCK;
+}
+
+nsapi_size_or_error_t TCPSocket::recv(void *data, nsapi_size_t size)
+{
+    if (fd < 0) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    if (!waitFor(POLLIN)) {
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    ssize_t result;
+    do {
+        result = ::recv(fd, data, size, 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        return errno == EAGAIN ? NSAPI_ERROR_WOULD_BLOCK : NSAPI_ERROR_CONNECTION_LOST;
+    }
+    return (nsapi_size_or_error_t)result;
+}
@@ -0,0 +1,239 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "TLSSocketWrapper.h"
+
+/* Personalization string of the DRBG, as on the board. */
+#define DRBG_PERS "mbed TLS client"
+
+TLSSocketWrapper::TLSSocketWrapper(Socket *transport, const char *hostname, control_transport control)
+    : transport(transport), control(control), hostname(NULL), timeout(-1), isHandshakeDone(false), isSeeded(false),
+      sslConfig(NULL), caChain(NULL), isCaChainOwned(false), clientCert(NULL)
+{
+    mbedtls_ssl_init(&ssl);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctrDrbg);
+    mbedtls_pk_init(&clientKey);
+    if (hostname) {
+        set_hostname(hostname);
+    }
+}
+
+TLSSocketWrapper::~TLSSocketWrapper()
+{
+    close();
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ctr_drbg_free(&ctrDrbg);
+    mbedtls_entropy_free(&entropy);
+    mbedtls_pk_free(&clientKey);
+    if (clientCert) {
+        mbedtls_x509_crt_free(clientCert);
+        delete clientCert;
+    }
+    if (isCaChainOwned) {
+        mbedtls_x509_crt_free(caChain);
+        delete caChain;
+    }
+    if (sslConfig) {
+        mbedtls_ssl_config_free(sslConfig);
+        delete sslConfig;
+    }
+    free(hostname);
+}
+
+void TLSSocketWrapper::set_hostname(const char *hostname)
+{
+    free(this->hostname);
+    this->hostname = hostname ? strdup(hostname) : NULL;
+}
+
+mbedtls_ssl_config *TLSSocketWrapper::get_ssl_config() const
+{
+    if (!sslConfig) {
+        sslConfig = new mbedtls_ssl_config;
+        mbedtls_ssl_config_init(sslConfig);
+        mbedtls_ssl_config_defaults(sslConfig, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT);
+        mbedtls_ssl_conf_authmode(sslConfig, MBEDTLS_SSL_VERIFY_REQUIRED);
+    }
+    return sslConfig;
+}
+
+void TLSSocketWrapper::set_ca_chain(mbedtls_x509_crt *crt)
+{
+    if (isCaChainOwned && caChain != crt) {
+        mbedtls_x509_crt_free(caChain);
+        delete caChain;
+    }
+    caChain = crt;
+    isCaChainOwned = false;
+    mbedtls_ssl_conf_ca_chain(get_ssl_config(), crt, NULL);
+}
+
+nsapi_error_t TLSSocketWrapper::set_root_ca_cert(const void *root_ca, size_t len)
+{
+    mbedtls_x509_crt *crt = new mbedtls_x509_crt;
+    mbedtls_x509_crt_init(crt);
+    if (mbedtls_x509_crt_parse(crt, (const unsigned char *)root_ca, len) != 0) {
+        mbedtls_x509_crt_free(crt);
+        delete crt;
+        return NSAPI_ERROR_PARAMETER;
+    }
+    set_ca_chain(crt);
+    isCaChainOwned = true;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TLSSocketWrapper::set_root_ca_cert(const char *root_ca_pem)
+{
+    // The PEM parser wants the terminating NUL counted.
+    return set_root_ca_cert(root_ca_pem, strlen(root_ca_pem) + 1);
+}
+
+nsapi_error_t TLSSocketWrapper::set_client_cert_key(const void *client_cert, size_t client_cert_len,
+                                                    const void *client_private_key, size_t client_private_key_len)
+{
+    if (!clientCert) {
+        clientCert = new mbedtls_x509_crt;
+        mbedtls_x509_crt_init(clientCert);
+    }
+    if (mbedtls_x509_crt_parse(clientCert, (const unsigned char *)client_cert, client_cert_len) != 0
+            || mbedtls_pk_parse_key(&clientKey, (const unsigned char *)client_private_key, client_private_key_len,
+                                    NULL, 0) != 0
+            || mbedtls_ssl_conf_own_cert(get_ssl_config(), clientCert, &clientKey) != 0) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TLSSocketWrapper::set_client_cert_key(const char *client_cert_pem, const char *client_private_key_pem)
+{
+    return set_client_cert_key(client_cert_pem, strlen(client_cert_pem) + 1, client_private_key_pem,
+                               strlen(client_private_key_pem) + 1);
+}
+
+int TLSSocketWrapper::sslSend(void *context, const unsigned char *buf, size_t len)
+{
+    TLSSocketWrapper *wrapper = (TLSSocketWrapper *)context;
+    const nsapi_size_or_error_t sent = wrapper->transport->send(buf, len);
+    if (sent == NSAPI_ERROR_WOULD_BLOCK) {
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    return sent < 0 ? -1 : sent;
+}
+
+int TLSSocketWrapper::sslRecv(void *context, unsigned char *buf, size_t len)
+{
+    TLSSocketWrapper *wrapper = (TLSSocketWrapper *)context;
+    const nsapi_size_or_error_t received = wrapper->transport->recv(buf, len);
+    if (received == NSAPI_ERROR_WOULD_BLOCK) {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    return received < 0 ? -1 : received;
+}
+
+nsapi_error_t TLSSocketWrapper::connect(const SocketAddress &address)
+{
+    if (isHandshakeDone) {
+        return NSAPI_ERROR_IS_CONNECTED;
+    }
+    if (control == TRANSPORT_CONNECT || control == TRANSPORT_CONNECT_AND_CLOSE) {
+        const nsapi_error_t ret = transport->connect(address);
+        if (ret != NSAPI_ERROR_OK && ret != NSAPI_ERROR_IS_CONNECTED) {
+            return ret;
+        }
+    }
+
+    if (!isSeeded) {
+        if (mbedtls_ctr_drbg_seed(&ctrDrbg, mbedtls_entropy_func, &entropy, (const unsigned char *)DRBG_PERS,
+                                  sizeof(DRBG_PERS)) != 0) {
+            return NSAPI_ERROR_PARAMETER;
+        }
+        isSeeded = true;
+    }
+    mbedtls_ssl_conf_rng(get_ssl_config(), mbedtls_ctr_drbg_random, &ctrDrbg);
+    // A fresh context for every handshake, whatever became of the last one.
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_init(&ssl);
+    if (mbedtls_ssl_setup(&ssl, get_ssl_config()) != 0
+            || (hostname && mbedtls_ssl_set_hostname(&ssl, hostname) != 0)) {
+        return NSAPI_ERROR_PARAMETER;
+    }
+    // Where the board's wrapper makes the transport non-blocking, see the class comment.
+    transport->set_blocking(false);
+    transport->set_timeout(timeout);
+    mbedtls_ssl_set_bio(&ssl, this, sslSend, sslRecv, NULL);
+
+    const int ret = mbedtls_ssl_handshake(&ssl);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return NSAPI_ERROR_CONNECTION_TIMEOUT;
+    }
+    if (ret != 0) {
+        printf("ERROR: TLS handshake failed, mbed TLS error -0x%04X.\r\n", (unsigned int)-ret);
+        return NSAPI_ERROR_AUTH_FAILURE;
+    }
+    isHandshakeDone = true;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_error_t TLSSocketWrapper::close()
+{
+    if (isHandshakeDone) {
+        mbedtls_ssl_close_notify(&ssl);
+        isHandshakeDone = false;
+    }
+    nsapi_error_t ret = NSAPI_ERROR_OK;
+    if (control == TRANSPORT_CLOSE || control == TRANSPORT_CONNECT_AND_CLOSE) {
+        ret = transport->close();
+    }
+    return ret;
+}
+
+void TLSSocketWrapper::set_timeout(int timeout)
+{
+    this->timeout = timeout;
+    transport->set_timeout(timeout);
+}
+
+nsapi_size_or_error_t TLSSocketWrapper::send(const void *data, nsapi_size_t size)
+{
+    if (!isHandshakeDone) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    const int ret = mbedtls_ssl_write(&ssl, (const unsigned char *)data, size);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    return ret < 0 ? NSAPI_ERROR_DEVICE_ERROR : ret;
+}
+
+nsapi_size_or_error_t TLSSocketWrapper::recv(void *data, nsapi_size_t size)
+{
+    if (!isHandshakeDone) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    const int ret = mbedtls_ssl_read(&ssl, (unsigned char *)data, size);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return NSAPI_ERROR_WOULD_BLOCK;
+    }
+    if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return 0;
+    }
+    return ret < 0 ? NSAPI_ERROR_DEVICE_ERROR : ret;
+}
@@ -0,0 +1,152 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __INBOUND_MESSAGE_POOL_H__
+#define __INBOUND_MESSAGE_POOL_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+
+/*
+ * A received message held in a pool slot. The topic, which carries the IoT Hub
+ * property bag, and the payload are stored back to back in `data`, each
+ * terminated by '\0', so they can be used in place until the slot is released.
+ */
+template<size_t SlotSize>
+struct InboundMessage {
+    uint16_t topicLength;
+    uint16_t payloadLength;
+    uint32_t receivedUs;    // us_ticker_read() when the message was stored.
+    char data[SlotSize];
+
+    const char *topic() const { return data; }
+    const char *payload() const { return data + topicLength + 1; }
+};
+
+/*
+ * Fixed-size pool of InboundMessage slots plus a FIFO of the filled ones.
+ *
+ * store() is called from the MQTT message handler and copies the topic and
+ * payload out of the client's read buffer, which is reused for the next
+ * packet, straight into a free slot. The application takes slots in arrival
+ * order with acquire(), reads them in place and hands them back with
+ * release(). Both sides run on the thread that calls MQTTClient::yield(),
+ * so no locking is done.
+ */
+template<size_t Slots, size_t SlotSize>
+class InboundMessagePool {
+public:
+    typedef InboundMessage<SlotSize> Message;
+
+    InboundMessagePool()
+        : freeCount(Slots), queueHead(0), queueTail(0), inUseCount(0),
+          droppedCount(0), oversizeCount(0), highWaterMark(0)
+    {
+        MBED_STATIC_ASSERT(Slots > 0 && Slots < 256, "InboundMessagePool supports 1 to 255 slots");
+        MBED_STATIC_ASSERT(SlotSize <= 0xFFFF, "InboundMessagePool slot size must fit in 16 bits");
+        for (size_t i = 0; i < Slots; i++) {
+            freeList[i] = (uint8_t)i;
+        }
+    }
+
+    /*
+     * Copies the message into a free slot and queues it. Returns false if the
+     * topic and payload do not fit into one slot or no slot is free.
+     */
+    bool store(MQTT::MessageData &md)
+    {
+        const char *topic = md.topicName.lenstring.data;
+        size_t topicLength = md.topicName.lenstring.len;
+        if (md.topicName.cstring) {
+            topic = md.topicName.cstring;
+            topicLength = strlen(topic);
+        }
+        const size_t payloadLength = md.message.payloadlen;
+        if (topicLength + 1 + payloadLength + 1 > SlotSize) {
+            oversizeCount++;
+            return false;
+        }
+        if (freeCount == 0) {
+            droppedCount++;
+            return false;
+        }
+
+        const uint8_t index = freeList[--freeCount];
+        Message &slot = slots[index];
+        slot.topicLength = topicLength;
+        slot.payloadLength = payloadLength;
+        slot.receivedUs = us_ticker_read();
+        memcpy(slot.data, topic, topicLength);
+        slot.data[topicLength] = '\0';
+        memcpy(slot.data + topicLength + 1, md.message.payload, payloadLength);
+        slot.data[topicLength + 1 + payloadLength] = '\0';
+
+        queue[queueHead] = index;
+        queueHead = (queueHead + 1) % (Slots + 1);
+        if (++inUseCount > highWaterMark) {
+            highWaterMark = inUseCount;
+        }
+        return true;
+    }
+
+    /* Takes the oldest queued message, or returns NULL if none is queued. */
+    Message *acquire()
+    {
+        if (queueTail == queueHead) {
+            return NULL;
+        }
+        Message *message = &slots[queue[queueTail]];
+        queueTail = (queueTail + 1) % (Slots + 1);
+        return message;
+    }
+
+    /* Returns a slot taken with acquire() to the pool. */
+    void release(Message *message)
+    {
+        freeList[freeCount++] = (uint8_t)(message - slots);
+        inUseCount--;
+    }
+
+    /* Messages dropped because every slot was in use. */
+    uint32_t drops() const { return droppedCount; }
+    /* Messages rejected because they do not fit into a slot. */
+    uint32_t oversizeRejections() const { return oversizeCount; }
+    /* Largest number of slots in use at the same time. */
+    size_t highWater() const { return highWaterMark; }
+
+    void printStats() const
+    {
+        printf("Inbound pool: %u/%u slots high water, %lu dropped, %lu oversize\r\n",
+               (unsigned int)highWaterMark, (unsigned int)Slots,
+               (unsigned long)droppedCount, (unsigned long)oversizeCount);
+    }
+
+private:
+    Message slots[Slots];
+    uint8_t freeList[Slots];
+    uint8_t queue[Slots + 1];
+    size_t freeCount;
+    size_t queueHead;
+    size_t queueTail;
+    size_t inUseCount;
+    uint32_t droppedCount;
+    uint32_t oversizeCount;
+    size_t highWaterMark;
+};
+
+#endif /* __INBOUND_MESSAGE_POOL_H__ */
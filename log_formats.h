@@ -0,0 +1,51 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __LOG_FORMATS_H__
+#define __LOG_FORMATS_H__
+
+/*
+ * Messages written through DeferredLog, see deferred_log.h. A record holds
+ * the index of its format in this list, so tools/decode_log.py reads this
+ * file to decode binary log output. Append new formats at the end to keep
+ * old logs decodable.
+ *
+ * Integer conversions take 32-bit values (%d, %u, %ld, %lu), at most
+ * DEFERRED_LOG_MAX_ARGS of them. A %s, if any, must be the last conversion.
+ */
+#define LOG_FORMATS(X) \
+    X(LOG_DROPPED,              "WARNING: %lu log records dropped.\r\n") \
+    X(LOG_PUBLISHING,           "\r\nPublishing %lu record(s), %lu bytes, first record %lu\r\n") \
+    X(LOG_PUBLISHED,            "Message published.\r\n") \
+    X(LOG_PUBLISH_ERROR,        "ERROR: rc from MQTT publish is %d\r\n") \
+    X(LOG_MESSAGE_ARRIVED,      "\r\nMessage arrived, %lu bytes:\r\n%s\r\n") \
+    X(LOG_MESSAGE_DROPPED,      "WARNING: inbound message of %lu bytes dropped.\r\n") \
+    X(LOG_MESSAGE_UNROUTED,     "WARNING: no handler for a message of %lu bytes.\r\n") \
+    X(LOG_METHOD_DROPPED,       "WARNING: direct method request of %lu bytes dropped.\r\n") \
+    X(LOG_METHOD_ANSWERED,      "Direct method answered with %d after %lu us: %s\r\n") \
+    X(LOG_METHOD_OVER_BUDGET,   "WARNING: direct method answered after %lu us, budget is %lu us: %s\r\n") \
+    X(LOG_LEAF_MESSAGE_ARRIVED, "\r\nMessage for leaf %lu arrived, %lu bytes:\r\n%s\r\n")
+
+#define LOG_FORMAT_ENUM(id, format) id,
+enum LogFormat {
+    LOG_FORMATS(LOG_FORMAT_ENUM)
+    LOG_FORMAT_COUNT
+};
+#undef LOG_FORMAT_ENUM
+
+#endif /* __LOG_FORMATS_H__ */
@@ -0,0 +1,363 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include <stdlib.h>
+#include "loopback_broker.h"
+#include "telemetry_batcher.h"
+
+/* Control packet type in the upper nibble of the fixed header. */
+#define MQTT_PACKET_TYPE_CONNECT        1
+#define MQTT_PACKET_TYPE_PUBLISH        3
+#define MQTT_PACKET_TYPE_SUBSCRIBE      8
+#define MQTT_PACKET_TYPE_UNSUBSCRIBE    10
+#define MQTT_PACKET_TYPE_PINGREQ        12
+#define MQTT_PACKET_TYPE_DISCONNECT     14
+
+/* CONNACK return code refusing a connect while the broker is busy. */
+#define MQTT_CONNACK_SERVER_UNAVAILABLE 3
+
+LoopbackSocket::LoopbackSocket()
+    : broker(NULL), open(false), isSessionUp(false), sessionPublishes(0), rxHead(0), rxLength(0),
+      state(STATE_HEADER), header(0), remaining(0), multiplier(1), bodyLength(0), packetId(0)
+{
+    clientId[0] = '\0';
+}
+
+nsapi_error_t LoopbackSocket::connectBroker(LoopbackBroker *broker)
+{
+    this->broker = broker;
+    open = true;
+    isSessionUp = false;
+    sessionPublishes = 0;
+    clientId[0] = '\0';
+    rxHead = 0;
+    rxLength = 0;
+    state = STATE_HEADER;
+    return NSAPI_ERROR_OK;
+}
+
+nsapi_size_or_error_t LoopbackSocket::send(const void *data, nsapi_size_t size)
+{
+    if (!open) {
+        return NSAPI_ERROR_NO_CONNECTION;
+    }
+    parse((const uint8_t*)data, size);
+    return size;
+}
+
+nsapi_size_or_error_t LoopbackSocket::recv(void *data, nsapi_size_t size)
+{
+    if (rxLength == 0) {
+        // A closed connection reads as the end of the stream once drained.
+        return open ? NSAPI_ERROR_WOULD_BLOCK : 0;
+    }
+    size_t n = (size < rxLength) ? size : rxLength;
+    for (size_t i = 0; i < n; i++) {
+        ((uint8_t*)data)[i] = rx[(rxHead + i) % LOOPBACK_RX_SIZE];
+    }
+    rxHead = (rxHead + n) % LOOPBACK_RX_SIZE;
+    rxLength -= n;
+    return n;
+}
+
+nsapi_error_t LoopbackSocket::close()
+{
+    open = false;
+    isSessionUp = false;
+    rxLength = 0;
+    return NSAPI_ERROR_OK;
+}
+
+bool LoopbackSocket::publish(const char *topic, const char *payload, size_t length)
+{
+    const size_t topicLength = strlen(topic);
+    size_t remaining = 2 + topicLength + length;
+    uint8_t header[7];
+    size_t headerLength = 0;
+    header[headerLength++] = 0x30;
+    do {
+        const uint8_t b = remaining % 128;
+        remaining /= 128;
+        header[headerLength++] = (remaining > 0) ? (b | 0x80) : b;
+    } while (remaining > 0);
+    header[headerLength++] = (uint8_t)(topicLength >> 8);
+    header[headerLength++] = (uint8_t)topicLength;
+    // All or nothing, the client must not read half a packet.
+    if (!open || rxLength + headerLength + topicLength + length > LOOPBACK_RX_SIZE) {
+        return false;
+    }
+    return deliver(header, headerLength) && deliver((const uint8_t*)topic, topicLength)
+           && deliver((const uint8_t*)payload, length);
+}
+
+bool LoopbackSocket::deliver(const uint8_t *data, size_t length)
+{
+    if (rxLength + length > LOOPBACK_RX_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        rx[(rxHead + rxLength + i) % LOOPBACK_RX_SIZE] = data[i];
+    }
+    rxLength += length;
+    return true;
+}
+
+void LoopbackSocket::parse(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length && open; i++) {
+        const uint8_t b = data[i];
+        switch (state) {
+            case STATE_HEADER:
+                header = b;
+                remaining = 0;
+                multiplier = 1;
+                state = STATE_LENGTH;
+                break;
+            case STATE_LENGTH:
+                remaining += (b & 0x7F) * multiplier;
+                multiplier *= 128;
+                if ((b & 0x80) == 0) {
+                    bodyLength = 0;
+                    if (remaining > 0) {
+                        state = STATE_BODY;
+                    } else {
+                        state = STATE_HEADER;
+                        broker->handlePacket(this, header, body, 0, 0);
+                    }
+                }
+                break;
+            case STATE_BODY:
+                if (bodyLength < LOOPBACK_PACKET_PREFIX) {
+                    body[bodyLength] = b;
+                }
+                if ((header >> 4) == MQTT_PACKET_TYPE_PUBLISH && (header & 0x06) != 0 && bodyLength >= 2) {
+                    // The packet id follows the topic, which may be longer than the prefix.
+                    const uint32_t idOffset = 2 + ((body[0] << 8) | body[1]);
+                    if (bodyLength == idOffset || bodyLength == idOffset + 1) {
+                        packetId = (uint16_t)((packetId << 8) | b);
+                    }
+                }
+                bodyLength++;
+                if (--remaining == 0) {
+                    state = STATE_HEADER;
+                    const size_t kept = (bodyLength < LOOPBACK_PACKET_PREFIX) ? bodyLength : LOOPBACK_PACKET_PREFIX;
+                    broker->handlePacket(this, header, body, kept, bodyLength);
+                }
+                break;
+        }
+    }
+}
+
+LoopbackBroker::LoopbackBroker(uint32_t acceptPerSecond, uint32_t sessionPublishes)
+    : acceptPerSecond(acceptPerSecond), sessionPublishes(sessionPublishes), latencySamples(NULL), latencyCapacity(0)
+{
+    clearStats();
+}
+
+void LoopbackBroker::clearStats()
+{
+    mutex.lock();
+    // Start with a full burst, as a broker that was idle.
+    acceptCredit = (uint64_t)(1 + acceptPerSecond / 10) * 1000000;
+    lastAcceptUs = us_ticker_read();
+    connectCount = 0;
+    refusedCount = 0;
+    publishCount = 0;
+    publishByteCount = 0;
+    messageCount = 0;
+    latencyMax = 0;
+    latencyTotal = 0;
+    mutex.unlock();
+}
+
+void LoopbackBroker::setLatencySamples(uint32_t *samples, size_t capacity)
+{
+    mutex.lock();
+    latencySamples = samples;
+    latencyCapacity = samples ? capacity : 0;
+    latencyTotal = 0;
+    mutex.unlock();
+}
+
+static int compareSample(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+uint32_t LoopbackBroker::latencyPercentileUs(unsigned int percent)
+{
+    mutex.lock();
+    const size_t count = latencyTotal < latencyCapacity ? latencyTotal : latencyCapacity;
+    uint32_t latency = 0;
+    if (count > 0) {
+        qsort(latencySamples, count, sizeof(latencySamples[0]), compareSample);
+        const size_t rank = (count * percent + 99) / 100;
+        latency = latencySamples[rank > 0 ? rank - 1 : 0];
+    }
+    mutex.unlock();
+    return latency;
+}
+
+bool LoopbackBroker::acceptConnect()
+{
+    if (acceptPerSecond == 0) {
+        return true;
+    }
+    // Token bucket refilled at acceptPerSecond, holding a tenth of a second's worth.
+    const uint32_t now = us_ticker_read();
+    const uint64_t burst = (uint64_t)(1 + acceptPerSecond / 10) * 1000000;
+    acceptCredit += (uint64_t)(now - lastAcceptUs) * acceptPerSecond;
+    lastAcceptUs = now;
+    if (acceptCredit > burst) {
+        acceptCredit = burst;
+    }
+    if (acceptCredit < 1000000) {
+        return false;
+    }
+    acceptCredit -= 1000000;
+    return true;
+}
+
+void LoopbackBroker::handlePacket(LoopbackSocket *client, uint8_t header, const uint8_t *body, size_t length,
+                                  size_t totalLength)
+{
+    const uint8_t type = header >> 4;
+    if (type == MQTT_PACKET_TYPE_CONNECT) {
+        // Protocol name, level, flags and keepalive come before the client id.
+        const size_t idOffset = (length >= 2) ? 2 + ((body[0] << 8) | body[1]) + 4 : length;
+        if (idOffset + 2 <= length) {
+            size_t idLength = (body[idOffset] << 8) | body[idOffset + 1];
+            if (idLength > length - idOffset - 2) {
+                idLength = length - idOffset - 2;
+            }
+            if (idLength >= sizeof(client->clientId)) {
+                idLength = sizeof(client->clientId) - 1;
+            }
+            memcpy(client->clientId, body + idOffset + 2, idLength);
+            client->clientId[idLength] = '\0';
+        }
+        mutex.lock();
+        const bool isAccepted = !client->isSessionUp && acceptConnect();
+        if (isAccepted) {
+            connectCount++;
+        } else {
+            refusedCount++;
+        }
+        mutex.unlock();
+        const uint8_t connack[] = { 0x20, 2, 0, (uint8_t)(isAccepted ? 0 : MQTT_CONNACK_SERVER_UNAVAILABLE) };
+        client->deliver(connack, sizeof(connack));
+        // The broker closes the connection after refusing it.
+        client->isSessionUp = isAccepted;
+        client->open = isAccepted;
+        return;
+    }
+    if (!client->isSessionUp) {
+        // Nothing but CONNECT is allowed before the session is up.
+        client->open = false;
+        return;
+    }
+
+    switch (type) {
+        case MQTT_PACKET_TYPE_PUBLISH: {
+            const uint32_t now = us_ticker_read();
+            const unsigned int qos = (header >> 1) & 3;
+            const size_t topicLength = (length >= 2) ? (body[0] << 8) | body[1] : 0;
+            const size_t payloadOffset = 2 + topicLength + (qos > 0 ? 2 : 0);
+            mutex.lock();
+            publishCount++;
+            publishByteCount += totalLength + 2;
+            if (payloadOffset + 5 <= length && body[payloadOffset] == TELEMETRY_BINARY_VERSION) {
+                const uint8_t *ts = body + payloadOffset + 1;
+                const uint32_t latency = now - (ts[0] | (ts[1] << 8) | (ts[2] << 16) | ((uint32_t)ts[3] << 24));
+                if (latencyTotal < latencyCapacity) {
+                    latencySamples[latencyTotal] = latency;
+                }
+                latencyTotal++;
+                if (latency > latencyMax) {
+                    latencyMax = latency;
+                }
+            }
+            mutex.unlock();
+            if (qos > 0 && payloadOffset <= totalLength) {
+                const uint8_t puback[] = { 0x40, 2, (uint8_t)(client->packetId >> 8), (uint8_t)client->packetId };
+                client->deliver(puback, sizeof(puback));
+            }
+            if (publishHandler) {
+                // The topic as far as it is in the prefix.
+                char topic[LOOPBACK_PACKET_PREFIX];
+                size_t kept = (length > 2) ? length - 2 : 0;
+                if (kept > topicLength) {
+                    kept = topicLength;
+                }
+                memcpy(topic, body + 2, kept);
+                topic[kept] = '\0';
+                publishHandler(client, topic);
+            }
+            client->sessionPublishes++;
+            if (client->sessionPublishes % LOOPBACK_C2D_INTERVAL == 0) {
+                sendMessage(client);
+            }
+            if (sessionPublishes > 0 && client->sessionPublishes >= sessionPublishes) {
+                client->isSessionUp = false;
+                client->open = false;
+            }
+            break;
+        }
+        case MQTT_PACKET_TYPE_SUBSCRIBE:
+        case MQTT_PACKET_TYPE_UNSUBSCRIBE: {
+            if (length < 2) {
+                client->open = false;
+                break;
+            }
+            // Granted QoS0 for the one filter the simulated clients subscribe at a time.
+            const uint8_t suback[] = { 0x90, 3, body[0], body[1], 0 };
+            const uint8_t unsuback[] = { 0xB0, 2, body[0], body[1] };
+            if (type == MQTT_PACKET_TYPE_SUBSCRIBE) {
+                client->deliver(suback, sizeof(suback));
+            } else {
+                client->deliver(unsuback, sizeof(unsuback));
+            }
+            break;
+        }
+        case MQTT_PACKET_TYPE_PINGREQ: {
+            const uint8_t pingresp[] = { 0xD0, 0 };
+            client->deliver(pingresp, sizeof(pingresp));
+            break;
+        }
+        case MQTT_PACKET_TYPE_DISCONNECT:
+            client->isSessionUp = false;
+            client->open = false;
+            break;
+        default:
+            break;
+    }
+}
+
+void LoopbackBroker::sendMessage(LoopbackSocket *client)
+{
+    char topic[8 + LOOPBACK_CLIENT_ID_SIZE + 22];
+    snprintf(topic, sizeof(topic), "devices/%s/messages/devicebound/", client->clientId);
+    if (client->publish(topic, "{}", 2)) {
+        mutex.lock();
+        messageCount++;
+        mutex.unlock();
+    }
+}
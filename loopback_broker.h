@@ -0,0 +1,189 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __LOOPBACK_BROKER_H__
+#define __LOOPBACK_BROKER_H__
+
+#include "mbed.h"
+#include "TCPSocket.h"
+
+/* Bytes of each client packet the broker looks at, enough for a CONNECT or a telemetry PUBLISH. */
+#define LOOPBACK_PACKET_PREFIX      96
+/* Bytes of broker packets waiting to be read by one client. */
+#define LOOPBACK_RX_SIZE            256
+/* Longest client id the broker keeps for the devicebound topic. */
+#define LOOPBACK_CLIENT_ID_SIZE     24
+/* Every this many publishes of a session, the broker sends a message back to the client. */
+#define LOOPBACK_C2D_INTERVAL       16
+
+class LoopbackBroker;
+class LoopbackSocket;
+
+/* Called with the topic of every PUBLISH a client sends, e.g. to answer twin and method requests. */
+typedef mbed::Callback<void(LoopbackSocket *client, const char *topic)> LoopbackPublishHandler;
+
+/*
+ * In-memory connection from an MQTTClient to a LoopbackBroker, used in
+ * place of a TCPSocket. Everything the client sends is handled by the broker
+ * right away, on the client's thread, and the broker's answers wait in the
+ * socket until the client reads them. recv() never blocks: with nothing to
+ * read it returns NSAPI_ERROR_WOULD_BLOCK, which MQTTClient takes as a
+ * timeout, and 0 once the broker closed the connection.
+ *
+ * Like MqttTapSocket, it derives from TCPSocket because MQTTClient takes no
+ * other socket. The inherited socket is never opened.
+ */
+class LoopbackSocket : public TCPSocket {
+public:
+    LoopbackSocket();
+
+    /* Opens a new connection to `broker`, dropping what is left of the last one. */
+    nsapi_error_t connectBroker(LoopbackBroker *broker);
+
+    /* True until the client or the broker closed the connection. */
+    bool isOpen() const { return open; }
+
+    /* Bytes from the broker waiting to be read. */
+    size_t pending() const { return rxLength; }
+
+    /*
+     * Sends a QoS0 PUBLISH from the broker to the client, e.g. a twin patch
+     * or a method request. Returns false if it does not fit into what is
+     * left of the LOOPBACK_RX_SIZE bytes waiting to be read.
+     */
+    bool publish(const char *topic, const char *payload, size_t length);
+
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+    virtual void set_blocking(bool blocking) {}
+    virtual void set_timeout(int timeout) {}
+    virtual void sigio(mbed::Callback<void()> func) {}
+    virtual nsapi_error_t close();
+
+private:
+    friend class LoopbackBroker;
+
+    enum ParserState {
+        STATE_HEADER,
+        STATE_LENGTH,
+        STATE_BODY,
+    };
+
+    /* Queues `length` bytes for the client to read. Returns false if they do not fit. */
+    bool deliver(const uint8_t *data, size_t length);
+    void parse(const uint8_t *data, size_t length);
+
+    LoopbackBroker *broker;
+    bool open;
+
+    // Broker side of the connection.
+    bool isSessionUp;       // CONNECT accepted.
+    uint32_t sessionPublishes;
+    char clientId[LOOPBACK_CLIENT_ID_SIZE];
+
+    uint8_t rx[LOOPBACK_RX_SIZE];
+    size_t rxHead;
+    size_t rxLength;
+
+    ParserState state;
+    uint8_t header;         // First byte of the current packet.
+    uint32_t remaining;     // Body bytes left in the current packet.
+    uint32_t multiplier;    // Weight of the next remaining length byte.
+    uint32_t bodyLength;    // Body bytes of the current packet so far.
+    uint16_t packetId;      // Of a QoS1 PUBLISH, read even when it lies beyond the prefix.
+    uint8_t body[LOOPBACK_PACKET_PREFIX];
+};
+
+/*
+ * Stand-in for the MQTT broker, for running many simulated clients on one
+ * board without a network.
+ *
+ * It accepts CONNECT at up to `acceptPerSecond` per second, 0 for no limit,
+ * and refuses the rest with "server unavailable" as an overloaded broker
+ * would during a connect storm. It answers SUBSCRIBE, UNSUBSCRIBE and
+ * PINGREQ, sends a message to devices/{client id}/messages/devicebound/
+ * every LOOPBACK_C2D_INTERVAL publishes and closes a session after
+ * `sessionPublishes` publishes, 0 for never, so the clients go through
+ * their reconnect path.
+ *
+ * A PUBLISH whose payload is a binary telemetry batch is timed from the
+ * timestamp of its first record until the broker has it. Any number of
+ * threads may use the broker, its counters are kept under a mutex.
+ */
+class LoopbackBroker {
+public:
+    LoopbackBroker(uint32_t acceptPerSecond, uint32_t sessionPublishes);
+
+    void clearStats();
+
+    /*
+     * Calls `handler` with the topic of every PUBLISH, truncated to
+     * LOOPBACK_PACKET_PREFIX bytes, on the thread of the client that sent
+     * it. An empty callback removes the handler.
+     */
+    void onPublish(LoopbackPublishHandler handler) { publishHandler = handler; }
+
+    uint32_t connects() const { return connectCount; }
+    uint32_t refused() const { return refusedCount; }
+    uint32_t publishes() const { return publishCount; }
+    uint32_t publishBytes() const { return publishByteCount; }
+    uint32_t messagesSent() const { return messageCount; }
+
+    /*
+     * Keeps the latency of up to `capacity` publishes in `samples`, which
+     * must stay valid until it is replaced, for latencyPercentileUs(). The
+     * count of timed publishes starts over.
+     */
+    void setLatencySamples(uint32_t *samples, size_t capacity);
+
+    /* The `percent` percentile of the kept publish latencies, sorting them. 0 if none were kept. */
+    uint32_t latencyPercentileUs(unsigned int percent);
+    uint32_t latencyMaxUs() const { return latencyMax; }
+    /* Timed publishes, of which the first latencySampleCapacity ones are kept. */
+    uint32_t latencyCount() const { return latencyTotal; }
+    size_t latencySampleCapacity() const { return latencyCapacity; }
+
+private:
+    friend class LoopbackSocket;
+
+    /* Handles a client packet whose first LOOPBACK_PACKET_PREFIX body bytes are in `body`. */
+    void handlePacket(LoopbackSocket *client, uint8_t header, const uint8_t *body, size_t length, size_t totalLength);
+    bool acceptConnect();
+    void sendMessage(LoopbackSocket *client);
+
+    Mutex mutex;
+    LoopbackPublishHandler publishHandler;
+    uint32_t acceptPerSecond;
+    uint32_t sessionPublishes;
+    uint64_t acceptCredit;  // Connects allowed now, times 1000000.
+    uint32_t lastAcceptUs;
+
+    // Statistics
+    uint32_t connectCount;
+    uint32_t refusedCount;
+    uint32_t publishCount;
+    uint32_t publishByteCount;
+    uint32_t messageCount;
+    uint32_t latencyMax;
+    uint32_t latencyTotal;
+    uint32_t *latencySamples;
+    size_t latencyCapacity;
+};
+
+#endif /* __LOOPBACK_BROKER_H__ */
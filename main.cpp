@@ -16,39 +16,295 @@
 // limitations under the License.
 // ----------------------------------------------------------------------------
 
-#define MQTTCLIENT_QOS1 0
-#define MQTTCLIENT_QOS2 0
+#if !MBED_CONF_APP_BENCHMARK_APP
 
 #include "mbed.h"
 #include "TLSSocket.h"
+#include "mqtt_tap_socket.h"
 #include "MQTTClientMbedOs.h"
 #include "MQTT_server_setting.h"
+#include "trust_store_der.h"
 #include "mbed-trace/mbed_trace.h"
 #include "mbed_events.h"
-#include "NTPClient.h"
 #include "mbedtls/error.h"
+#include "mqtt_benchmark.h"
+#include "telemetry_queue.h"
+#include "telemetry_batcher.h"
+#include "inbound_message_pool.h"
+#include "tls_session_cache.h"
+#include "reconnect_backoff.h"
+#include "sas_token.h"
+#include "phase_profiler.h"
+#include "telemetry_outbox.h"
+#include "topic_builder.h"
+#include "device_twin.h"
+#include "direct_methods.h"
+#include "topic_router.h"
+#include "deferred_log.h"
+#include "startup_cache.h"
+#include "time_sync.h"
+#include "sensor_pipeline.h"
+#include "session_pool.h"
+#include "gateway.h"
+#include "SlicingBlockDevice.h"
 
 #define MQTT_MAX_CONNECTIONS     5
 #define MQTT_MAX_PACKET_SIZE  1024
 
+#if MBED_CONF_APP_GATEWAY
+/* Leaf devices whose telemetry and messages the gateway carries, see gateway.h */
+static const char *const gatewayLeafIds[] = MBED_CONF_APP_GATEWAY_LEAVES;
+#define GATEWAY_LEAF_COUNT       (sizeof(gatewayLeafIds) / sizeof(gatewayLeafIds[0]))
+static GatewayLeaf gatewayLeaves[GATEWAY_LEAF_COUNT];
+#else
+#define GATEWAY_LEAF_COUNT       0
+#endif
+
+/* Trie nodes and level text of the subscribed topic filters, see topic_router.h */
+#define TOPIC_ROUTER_NODES       (24 + 4 * GATEWAY_LEAF_COUNT)
+#define TOPIC_ROUTER_ARENA_SIZE  (64 + sizeof(DEVICE_ID) + GATEWAY_LEAF_COUNT * (19 + GATEWAY_MAX_ID_LENGTH))
+
+/* Topic filters subscribed in every session, and room for them as SUBSCRIBE packets. */
+#define SUBSCRIBED_TOPICS_MAX      (4 + GATEWAY_LEAF_COUNT)
+#define SUBSCRIBE_PACKETS_SIZE     (192 + sizeof(DEVICE_ID) + GATEWAY_LEAF_COUNT * (7 + GATEWAY_FILTER_SIZE))
+/* Packet ids of the SUBSCRIBEs sent along with CONNECT, clear of the ids MQTTClient counts up from 1. */
+#define SUBSCRIBE_PACKET_ID_BASE   0xFF00
+/* Longest a connect attempt waits for NTP before the TLS handshake, retried after the backoff. */
+#define TIME_WAIT_MS               30000
+
 #define TIME_JWT_EXP      (60*60*24)  // 24 hours (MAX)
 
+/* Stored telemetry is replayed in steps of this interval, outbox-replay-rate records per second. */
+#define OUTBOX_REPLAY_INTERVAL_MS  100
+
 // LED on/off - This could be different among boards
 #define LED_ON  0
 #define LED_OFF 1
 
-/* Flag to be set when a message needs to be published, i.e. BUTTON is pushed. */
-static volatile bool isPublish = false;
-/* Flag to be set when received a message from the server. */
-static volatile bool isMessageArrived = false;
-/* Buffer size for a receiving message. */
-const int MESSAGE_BUFFER_SIZE = 1024;
-/* Buffer for a receiving message. */
-char messageBuffer[MESSAGE_BUFFER_SIZE];
+/* Telemetry records waiting to be published, filled from interrupt context, e.g. BUTTON is pushed. */
+static TelemetryQueue<MBED_CONF_APP_TELEMETRY_QUEUE_CAPACITY> telemetryQueue;
+/* Messages received from the server, waiting to be handled by the main loop. */
+typedef InboundMessagePool<MBED_CONF_APP_INBOUND_POOL_SLOTS, MBED_CONF_APP_INBOUND_SLOT_SIZE> MessagePool;
+static MessagePool messagePool;
+/* Hands every received message to the handlers of the filters its topic matches. */
+static TopicRouter<TOPIC_ROUTER_NODES, TOPIC_ROUTER_ARENA_SIZE> topicRouter;
+
+// Generates topic names from user's setting in MQTT_server_setting.h
+//devices/{device_id}/messages/events/
+static const char *mqtt_topic_pub = "devices/" DEVICE_ID "/messages/events/";
+// Telemetry batches declare their content type, e.g. devices/{device_id}/messages/events/$.ct=application%2Fcbor
+static constexpr auto mqtt_topic_telemetry = makeTopic("devices/" DEVICE_ID "/messages/events/")
+#if MBED_CONF_APP_TELEMETRY_BATCH_FORMAT == TELEMETRY_BATCH_FORMAT_JSON
+        .property("$.ct", TELEMETRY_BATCH_CONTENT_TYPE_JSON)
+        .property("$.ce", TELEMETRY_BATCH_CONTENT_ENCODING_JSON);
+#elif MBED_CONF_APP_TELEMETRY_BATCH_FORMAT == TELEMETRY_BATCH_FORMAT_CBOR
+        .property("$.ct", TELEMETRY_BATCH_CONTENT_TYPE_CBOR);
+#else
+        .property("$.ct", TELEMETRY_BATCH_CONTENT_TYPE_BINARY);
+#endif
+static const char *mqtt_topic_sub = "devices/" DEVICE_ID "/messages/devicebound/#";
+
+static NetworkInterface *network = NULL;
+static MqttTapSocket *socket = NULL;
+static MQTTClient *mqttClient = NULL;
+/* Topic filters routed by topicRouter, all subscribed in every session. */
+static const char *subscribedTopics[SUBSCRIBED_TOPICS_MAX];
+static size_t subscribedTopicCount = 0;
+/* Number of subscribedTopics subscribed in the current session. */
+static size_t subscribedCount = 0;
+#if MBED_CONF_APP_PIPELINED_SUBSCRIBE
+/* SUBSCRIBE packets sent right behind CONNECT, and the SUBACKs still expected for them. */
+static uint8_t subscribePackets[SUBSCRIBE_PACKETS_SIZE];
+static size_t pendingSubacks = 0;
+#endif
+/* Broker address of the last successful connect, resolved again when connecting to it fails. */
+static SocketAddress brokerAddress;
+static bool isBrokerAddressKnown = false;
+/* Broker address and RTC drift kept for the next boot, NULL if startup-cache is false. */
+static StartupCache *startupCache = NULL;
+/* Sets the RTC over NTP alongside the first connect. */
+static TimeSync *timeSync = NULL;
+/* TLS session of the last connection, resumed when reconnecting. */
+static TlsSessionCache tlsSessionCache;
+/* Timings and keepalive interval of the last connect. */
+static uint32_t tlsConnectUs = 0;
+static uint32_t mqttConnectUs = 0;
+static unsigned short keepAliveInterval = 0;
+/* Generates the MQTT password from DEVICE_KEY, NULL if MQTT_SERVER_PASSWORD is used as is. */
+static SasToken *sasToken = NULL;
+/* Set when the main loop ended to connect again with a new SAS token. */
+static bool isTokenRenewalRequested = false;
+/* Time, heap and stack usage of each phase, see phase_profiler.h */
+static PhaseProfiler profiler;
+/* Certificates parsed in place from the DER arrays in trust_store_der.h */
+static TrustStore trustStore;
+/* Telemetry produced while disconnected, replayed after reconnecting. NULL if outbox-enabled is false. */
+static TelemetryOutbox *outbox = NULL;
+#if MBED_CONF_APP_OUTBOX_ENABLED
+/* Records of the batch being built, stored in the outbox if its publish fails. */
+static TelemetryRecord batchRecords[MQTT_MAX_PACKET_SIZE / TELEMETRY_BINARY_RECORD_SIZE];
+#endif
+/* Set while replayOutbox() publishes, its records are in the outbox already. */
+static bool isReplaying = false;
+/* Outbox id of the last record added to the batcher by replayOutbox(). */
+static uint32_t replayLastId = 0;
+#if MBED_CONF_APP_OUTBOX_ENABLED && MBED_CONF_APP_PUBLISH_QOS1
+/* A replayed batch waiting for its PUBACK before its records are acknowledged in the outbox. */
+struct ReplayedBatch {
+    uint16_t packetId;
+    bool isAcked;
+    uint32_t lastId;    // Outbox id of the last record in the batch.
+};
+/* Replayed batches in publish order, at most one per slot of the QoS1 window. */
+static ReplayedBatch replayedBatches[MBED_CONF_APP_QOS1_WINDOW];
+static size_t replayedCount = 0;
+/* Set when a replayed batch was given up, its records are replayed again. */
+static bool isReplayRewindNeeded = false;
+#endif
+/* Direct method dispatcher, NULL if direct-methods is false. */
+static DirectMethods *directMethods = NULL;
+#if MBED_CONF_APP_DIRECT_METHODS
+/* Holds a direct method request while its handler runs, it does not wait in messagePool. */
+static InboundMessagePool<1, MBED_CONF_APP_INBOUND_SLOT_SIZE> methodRequestPool;
+#endif
+/* Console output of the hot path. Printed right away unless deferred-log is true. */
+static DeferredLog *consoleLog = DeferredLog::immediate();
+/* Memory of mbed TLS and the client objects of a session, NULL if session-pool is false. */
+static SessionPool *sessionPool = NULL;
+#if MBED_CONF_APP_SESSION_POOL
+static constexpr SessionPoolClass sessionPoolClasses[] = MBED_CONF_APP_SESSION_POOL_CLASSES;
+static uint64_t sessionPoolArena[sessionPoolArenaSize(sessionPoolClasses) / sizeof(uint64_t)];
+#endif
+/* Telemetry and messages of the leaf devices, NULL if gateway is false. */
+static Gateway *gateway = NULL;
+/* Sensor sampling and window aggregation, NULL if sensor-sampling is false. */
+static SensorPipeline *sensorPipeline = NULL;
+#if MBED_CONF_APP_SENSOR_SAMPLING
+/* ADC of the sampled sensor, read through the HAL since AnalogIn locks a mutex. */
+static analogin_t sensorAdc;
+/* The two blocks the Ticker fills in turn. */
+static int32_t sensorBlocks[2 * MBED_CONF_APP_SENSOR_BLOCK_SAMPLES];
+#endif
+/* Device twin, NULL if device-twin is false. */
+static DeviceTwin *twin = NULL;
+/* Twin properties of the sample, laid out at build time and addressed by index. */
+enum {
+    DESIRED_TELEMETRY_MAX_AGE_MS,
+};
+static TwinProperty desiredProperties[] = {
+    TWIN_PROPERTY_INT("telemetryMaxAgeMs"),
+};
+enum {
+    REPORTED_TELEMETRY_MAX_AGE_MS,
+    REPORTED_BUTTON_PRESSES,
+};
+static TwinProperty reportedProperties[] = {
+    TWIN_PROPERTY_INT("telemetryMaxAgeMs"),
+    TWIN_PROPERTY_INT("buttonPresses"),
+};
+
+static TelemetryBatcher *batcher = NULL;
+static Qos1Publisher *qos1Publisher = NULL;
+
+static DigitalOut led_red(LED1, LED_OFF);
+static DigitalOut led_green(LED2, LED_OFF);
+static DigitalOut led_blue(LED3, LED_OFF);
+
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+/* Runs the main loop. Socket, button and timer events are posted here. */
+static EventQueue eventQueue(32 * EVENTS_EVENT_SIZE);
+/* Set while an event for the socket or the telemetry queue is waiting in eventQueue. */
+static core_util_atomic_flag isReadPosted = CORE_UTIL_ATOMIC_FLAG_INIT;
+static core_util_atomic_flag isPublishPosted = CORE_UTIL_ATOMIC_FLAG_INIT;
+/* Event which publishes the current batch at its age deadline, 0 if not scheduled. */
+static int batchDeadlineEvent = 0;
+/* Event which resends overdue QoS1 packets, 0 if not scheduled. */
+static int retransmitEvent = 0;
+/* Event which replays the next records from the outbox, 0 if not scheduled. */
+static int outboxReplayEvent = 0;
+/* Event which sends the changed reported twin properties or repeats an unanswered twin request, 0 if not scheduled. */
+static int twinReportEvent = 0;
+/* Kernel tick at which twinReportEvent fires. */
+static uint64_t twinReportDueMs = 0;
+/* Event which checks whether the SAS token is due for renewal, 0 if not scheduled. */
+static int renewalEvent = 0;
+#endif
+
+/* Main loop wake-ups, and time from a telemetry event until the main loop picks its record up. */
+static uint32_t loopWakeups = 0;
+static uint64_t loopStartMs = 0;
+static uint64_t pickupLatencySumUs = 0;
+static uint32_t pickupLatencyMaxUs = 0;
+static uint32_t pickupCount = 0;
+/* Time spent handling received messages and telemetry, the steps which print to the console. */
+static uint64_t loopBusySumUs = 0;
+static uint32_t loopBusyMaxUs = 0;
 
 // Function prototypes
+void routeMqttMessage(MQTT::MessageData& md);
 void handleMqttMessage(MQTT::MessageData& md);
 void handleButtonRise();
+#if MBED_CONF_APP_SENSOR_SAMPLING
+static int32_t readSensor();
+static void handleSensorSummary(const SensorSummary &summary);
+#endif
+void handleMethodMessage(MQTT::MessageData& md);
+static int handleEchoMethod(const char *payload, size_t payloadLength, char *response, size_t responseSize);
+static int handleGetStatsMethod(const char *payload, size_t payloadLength, char *response, size_t responseSize);
+static int connectSession();
+static void closeSession();
+template<typename T, typename... Args>
+static T *createSessionObject(Args&&... args);
+template<typename T>
+static void destroySessionObject(T *object);
+static void runMainLoop();
+static bool serviceClient(unsigned long timeout);
+static void handleInboundMessages();
+static void publishTelemetry();
+static void reportLoopStats(bool force);
+static void addBusyTime(uint32_t startUs);
+static bool isTokenRenewalDue();
+static void storeRecord(const TelemetryRecord &record);
+static void storeTelemetry();
+#if MBED_CONF_APP_OUTBOX_ENABLED
+static void storeFailedBatch(const TelemetryRecord *records, unsigned int count);
+#endif
+static void replayOutbox();
+#if MBED_CONF_APP_OUTBOX_ENABLED && MBED_CONF_APP_PUBLISH_QOS1
+static void handleBatchPublished(uint16_t packetId);
+static void handleDelivery(uint16_t packetId, bool isAcked);
+#endif
+static void waitDisconnected(uint32_t delayMs);
+#if MBED_CONF_APP_DEVICE_TWIN
+static void handleDesiredChange(size_t index);
+#endif
+static bool addSubscription(const char *topicFilter, MQTTClient::messageHandler handler);
+static size_t serializeSubscribes(uint8_t *buffer, size_t size);
+static void handleSuback(uint16_t packetId, uint8_t returnCode);
+#if MBED_CONF_APP_GATEWAY
+static int publishLeafTelemetry(const char *topic, const char *payload, size_t length);
+#endif
+static void reportFirstPublish();
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+static void handleSocketSigio();
+static void handleSocketReadable();
+static void handleKeepalive();
+static void handleTelemetryQueued();
+static void handleBatchDeadline();
+static void scheduleRetransmit();
+static void handleRetransmit();
+static void handleTokenRenewal();
+static void handleOutboxReplay();
+static void scheduleTwinReport();
+static void handleTwinReport();
+#endif
+
+/* Direct methods of the sample, sorted by name. */
+static constexpr DirectMethod directMethodTable[] = {
+    { "echo", handleEchoMethod },
+    { "getStats", handleGetStatsMethod },
+};
+static_assert(isDirectMethodTableSorted(directMethodTable), "directMethodTable must be sorted by name");
 
 int main(int argc, char* argv[])
 {
@@ -56,12 +312,6 @@ int main(int argc, char* argv[])
 
     const float version = 1.0;
 
-    NetworkInterface* network = NULL;
-
-    DigitalOut led_red(LED1, LED_OFF);
-    DigitalOut led_green(LED2, LED_OFF);
-    DigitalOut led_blue(LED3, LED_OFF);
-
     printf("Mbed to Azure IoT Hub: version is %.2f\r\n", version);
     printf("\r\n");
 
@@ -81,197 +331,1404 @@ int main(int argc, char* argv[])
     }
 
     nsapi_error_t net_status = NSAPI_ERROR_NO_CONNECTION;
+    profiler.begin(PHASE_NETWORK_CONNECT);
     while ((net_status = network->connect()) != NSAPI_ERROR_OK) {
         printf("Unable to connect to network (%d). Retrying...\r\n", net_status);
     }
+    profiler.end(PHASE_NETWORK_CONNECT);
 
     printf("Connected to the network successfully. IP address: %s\r\n", network->get_ip_address());
     printf("\r\n");
 
-    // sync the real time clock (RTC)
+#if MBED_CONF_APP_STARTUP_CACHE
+    /* The broker address and RTC drift of the last run are kept in a slice of the default block device. */
+    BlockDevice *cacheStorage = BlockDevice::get_default_instance();
+    if (!cacheStorage) {
+        printf("WARNING: no block device, the startup cache is disabled.\r\n");
+    } else {
+        static SlicingBlockDevice cacheDevice(cacheStorage, MBED_CONF_APP_STARTUP_CACHE_OFFSET,
+                                              MBED_CONF_APP_STARTUP_CACHE_OFFSET + MBED_CONF_APP_STARTUP_CACHE_SIZE);
+        static StartupCache cache(&cacheDevice);
+        int ret = cache.load();
+        if (ret != 0 && ret != -1) {
+            printf("WARNING: startup cache load failed (%d), the cache is disabled.\r\n", ret);
+        } else {
+            startupCache = &cache;
+            if (cache.brokerAddress(MQTT_SERVER_HOST_NAME, brokerAddress)) {
+                isBrokerAddressKnown = true;
+                printf("Broker address from the last run: %s\r\n", brokerAddress.get_ip_address());
+            }
+        }
+    }
+#endif
+
+    // sync the real time clock (RTC) alongside the DNS lookup and the TCP connect
+    static TimeSync ntpTimeSync(network, "time.google.com", &profiler);
+    timeSync = &ntpTimeSync;
+    if (startupCache && timeSync->restore(*startupCache)) {
+        const time_t now = time(NULL);
+        printf("Time restored from the RTC: %s", ctime(&now));
+    }
+    if (!timeSync->start()) {
+        printf("ERROR: could not start the NTP thread.\r\n");
+        return -1;
+    }
+
+    /* Parse the certificates once, connections only reference them. */
+#ifdef HAVE_SSL_CA_DER
     {
-        NTPClient ntp(network);
-        ntp.set_server("time.google.com", 123);
-        time_t now = ntp.get_timestamp();
-        if (now <= 0) {
-            printf("Failed to retrieve the time from time.google.com:123\r\n");
-            return 1;
+        int ret = trustStore.loadCaChain(SSL_CA_DER, sizeof(SSL_CA_DER) / sizeof(SSL_CA_DER[0]));
+        if (ret != 0) {
+            printf("ERROR: could not parse the CA certificates (%d).\r\n", ret);
+            return -1;
+        }
+    }
+#endif
+#if IOTHUB_AUTH_METHOD == IOTHUB_AUTH_CLIENT_SIDE_CERT && defined(HAVE_SSL_CLIENT_CERT_DER) && defined(HAVE_SSL_CLIENT_PRIVATE_KEY_DER)
+    {
+        int ret = trustStore.loadClientCertKey(SSL_CLIENT_CERT_DER, sizeof(SSL_CLIENT_CERT_DER) / sizeof(SSL_CLIENT_CERT_DER[0]),
+                                               SSL_CLIENT_PRIVATE_KEY_DER[0]);
+        if (ret != 0) {
+            printf("ERROR: could not parse the client certificate or key (%d).\r\n", ret);
+            return -1;
+        }
+    }
+#endif
+
+#ifdef DEVICE_KEY
+    static SasToken deviceSasToken(MQTT_SERVER_HOST_NAME, DEVICE_ID);
+    {
+        int ret = deviceSasToken.setKey(DEVICE_KEY);
+        if (ret != 0) {
+            printf("ERROR: DEVICE_KEY is not a valid base64 device key (%d).\r\n", ret);
+            return -1;
+        }
+        sasToken = &deviceSasToken;
+    }
+#endif
+
+    // Enable button 1 for publishing a message.
+    InterruptIn btn1(BUTTON1);
+    btn1.rise(handleButtonRise);
+
+#if MBED_CONF_APP_SENSOR_SAMPLING
+    /* Sample the sensor and publish a summary of each window instead of every sample. */
+    analogin_init(&sensorAdc, MBED_CONF_APP_SENSOR_PIN);
+    static SensorPipeline pipeline(readSensor, sensorBlocks, MBED_CONF_APP_SENSOR_BLOCK_SAMPLES,
+                                   MBED_CONF_APP_SENSOR_WINDOW_SAMPLES, MBED_CONF_APP_SENSOR_DECIMATION);
+    pipeline.setSummaryHandler(handleSensorSummary);
+    if (pipeline.start(MBED_CONF_APP_SENSOR_PERIOD_US)) {
+        sensorPipeline = &pipeline;
+        printf("Sampling the sensor every %d us, one summary per %d samples.\r\n",
+               MBED_CONF_APP_SENSOR_PERIOD_US, MBED_CONF_APP_SENSOR_WINDOW_SAMPLES);
+    } else {
+        printf("WARNING: could not start the sensor pipeline thread, the sensor is not sampled.\r\n");
+    }
+#endif
+
+    /* Telemetry records are coalesced into one PUBLISH of up to MQTT_MAX_PACKET_SIZE. */
+    // Leave room for the PUBLISH fixed header, the topic name and its length and the packet id.
+    static char batchBuffer[MQTT_MAX_PACKET_SIZE];
+#if MBED_CONF_APP_TELEMETRY_MESSAGE_ID
+    static char telemetryTopic[mqtt_topic_telemetry.size() + TELEMETRY_MESSAGE_ID_PROPERTY_SIZE + 1];
+    const size_t telemetryTopicLength = sizeof(telemetryTopic) - 1;
+#else
+    const size_t telemetryTopicLength = mqtt_topic_telemetry.size();
+#endif
+    TelemetryBatcher telemetryBatcher(NULL, mqtt_topic_telemetry.c_str(), batchBuffer,
+                                      MQTT_MAX_PACKET_SIZE - 5 - 2 - telemetryTopicLength - 2,
+                                      MBED_CONF_APP_TELEMETRY_BATCH_FORMAT, MBED_CONF_APP_TELEMETRY_BATCH_MAX_AGE_MS);
+    batcher = &telemetryBatcher;
+#if MBED_CONF_APP_TELEMETRY_MESSAGE_ID
+    batcher->enableMessageId(telemetryTopic, sizeof(telemetryTopic));
+#endif
+    batcher->setProfiler(&profiler);
+#if MBED_CONF_APP_PUBLISH_QOS1
+    /* Batches are published at QoS1 with several PUBLISHes waiting for their PUBACK. */
+    Qos1Publisher publisher(MBED_CONF_APP_QOS1_ACK_TIMEOUT_MS, MBED_CONF_APP_QOS1_MAX_RETRIES);
+    qos1Publisher = &publisher;
+    batcher->setQos1Publisher(qos1Publisher);
+#endif
+#if MBED_CONF_APP_DEVICE_TWIN
+    /* Reported property changes within the window are sent as one PATCH. */
+    static char twinBuffer[MBED_CONF_APP_TWIN_REPORT_BUFFER_SIZE];
+    static DeviceTwin deviceTwin(desiredProperties, sizeof(desiredProperties) / sizeof(desiredProperties[0]),
+                                 reportedProperties, sizeof(reportedProperties) / sizeof(reportedProperties[0]),
+                                 twinBuffer, sizeof(twinBuffer), MBED_CONF_APP_TWIN_REPORT_WINDOW_MS);
+    twin = &deviceTwin;
+    twin->onDesiredChange(handleDesiredChange);
+    twin->reportInt(REPORTED_TELEMETRY_MAX_AGE_MS, batcher->maxAge());
+#endif
+#if MBED_CONF_APP_DIRECT_METHODS
+    static char methodResponse[MBED_CONF_APP_METHOD_RESPONSE_SIZE];
+    static DirectMethods methods(directMethodTable, sizeof(directMethodTable) / sizeof(directMethodTable[0]),
+                                 methodResponse, sizeof(methodResponse), MBED_CONF_APP_METHOD_RESPONSE_BUDGET_MS);
+    directMethods = &methods;
+#endif
+#if MBED_CONF_APP_DEFERRED_LOG
+    /* Publishes and received messages are printed by a low priority thread. */
+    static DeferredLogRecord logRecords[MBED_CONF_APP_DEFERRED_LOG_RECORDS];
+    static DeferredLog deferredLog(logRecords, MBED_CONF_APP_DEFERRED_LOG_RECORDS, MBED_CONF_APP_DEFERRED_LOG_BINARY);
+    if (deferredLog.start()) {
+        consoleLog = &deferredLog;
+    } else {
+        printf("WARNING: could not start the log thread, printing from the main loop.\r\n");
+    }
+#endif
+    batcher->setLog(consoleLog);
+    if (directMethods) {
+        directMethods->setLog(consoleLog);
+    }
+    printf("Telemetry is published to the topic %s\r\n", mqtt_topic_telemetry.c_str());
+#if MBED_CONF_APP_GATEWAY
+    /* The leaves publish one batch each per turn, built in a buffer of their own. */
+    static char gatewayBuffer[MQTT_MAX_PACKET_SIZE];
+    static Gateway leafGateway(gatewayLeaves, GATEWAY_LEAF_COUNT, gatewayBuffer,
+                               MQTT_MAX_PACKET_SIZE - 5 - 2 - GATEWAY_TOPIC_SIZE - 2,
+                               MBED_CONF_APP_TELEMETRY_BATCH_FORMAT, MBED_CONF_APP_GATEWAY_QUANTUM);
+    // The leaves' topics carry the same properties as the gateway's own.
+    const char *leafTopicProperties = mqtt_topic_telemetry.c_str() + sizeof("devices/" DEVICE_ID "/messages/events/") - 1;
+    for (size_t i = 0; i < GATEWAY_LEAF_COUNT; i++) {
+        if (leafGateway.addLeaf(gatewayLeafIds[i], leafTopicProperties) < 0) {
+            printf("ERROR: leaf device id %s is longer than %d characters.\r\n", gatewayLeafIds[i], GATEWAY_MAX_ID_LENGTH);
+            return -1;
+        }
+    }
+    leafGateway.setPublisher(publishLeafTelemetry);
+    leafGateway.setLog(consoleLog);
+    gateway = &leafGateway;
+    printf("Gateway for %u leaf devices, %u bytes of state.\r\n", (unsigned int)gateway->count(),
+           (unsigned int)gateway->stateBytes());
+#endif
+    /* Route the subscribed topics. They are subscribed without a handler of their own. */
+    bool isRouted = addSubscription(mqtt_topic_sub, handleMqttMessage);
+    if (twin) {
+        isRouted = isRouted && addSubscription(DEVICE_TWIN_RESPONSE_TOPIC, handleMqttMessage)
+                   && addSubscription(DEVICE_TWIN_DESIRED_TOPIC, handleMqttMessage);
+    }
+    if (directMethods) {
+        isRouted = isRouted && addSubscription(DIRECT_METHODS_TOPIC, handleMethodMessage);
+    }
+    for (size_t i = 0; gateway && i < gateway->count(); i++) {
+        isRouted = isRouted && addSubscription(gateway->deviceboundFilter(i), handleMqttMessage);
+    }
+    if (!isRouted) {
+        printf("ERROR: topic router is full, increase TOPIC_ROUTER_NODES or TOPIC_ROUTER_ARENA_SIZE.\r\n");
+        return -1;
+    }
+#if MBED_CONF_APP_OUTBOX_ENABLED
+    /* Telemetry produced while disconnected is kept in a slice of the default block device. */
+    BlockDevice *storage = BlockDevice::get_default_instance();
+    if (!storage) {
+        printf("WARNING: no block device, telemetry produced while disconnected is lost.\r\n");
+    } else {
+        static SlicingBlockDevice outboxDevice(storage, MBED_CONF_APP_OUTBOX_OFFSET,
+                                               MBED_CONF_APP_OUTBOX_OFFSET + MBED_CONF_APP_OUTBOX_SIZE);
+        static TelemetryOutbox telemetryOutbox(&outboxDevice);
+        int ret = telemetryOutbox.init();
+        if (ret != 0) {
+            printf("WARNING: outbox init failed (%d), telemetry produced while disconnected is lost.\r\n", ret);
+        } else {
+            outbox = &telemetryOutbox;
+            // A batch lost with a dying connection is kept as well.
+            batcher->onPublishFailed(batchRecords, sizeof(batchRecords) / sizeof(batchRecords[0]), storeFailedBatch);
+#if MBED_CONF_APP_PUBLISH_QOS1
+            // Replayed records are acknowledged once their PUBACK arrived.
+            batcher->onPublished(handleBatchPublished);
+            qos1Publisher->onDelivery(handleDelivery);
+#endif
+            printf("Outbox: %lu records pending from before the reset.\r\n", (unsigned long)outbox->pending());
+        }
+    }
+#endif
+
+#if MBED_CONF_APP_SESSION_POOL
+    /* Everything parsed so far stays on the heap, connections use the pool from here on. */
+    static SessionPool pool(sessionPoolArena, sizeof(sessionPoolArena), sessionPoolClasses,
+                            sizeof(sessionPoolClasses) / sizeof(sessionPoolClasses[0]));
+    if (pool.attachMbedTls()) {
+        sessionPool = &pool;
+        printf("Session pool: %lu bytes for mbed TLS and the client objects.\r\n", (unsigned long)sizeof(sessionPoolArena));
+    } else {
+        printf("WARNING: mbed TLS lacks MBEDTLS_PLATFORM_MEMORY, the session pool is not used.\r\n");
+    }
+#endif
+
+    /* Connects, runs the main loop until the connection is lost and reconnects after a backoff. */
+    ReconnectBackoff backoff(MBED_CONF_APP_RECONNECT_MIN_DELAY_MS, MBED_CONF_APP_RECONNECT_MAX_DELAY_MS);
+    bool isFirstSession = true;
+    Timer renewalTimer;
+    while (1) {
+        if (connectSession() != MQTT::SUCCESS) {
+            closeSession();
+            const uint32_t delay = backoff.nextDelayMs();
+            printf("Reconnecting in %lu ms (attempt %u) ...\r\n", (unsigned long)delay, backoff.attempts());
+            waitDisconnected(delay);
+            continue;
+        }
+        backoff.reset();
+        if (startupCache) {
+            // Lets the next boot skip the DNS lookup and start TLS on the RTC.
+            startupCache->setBrokerAddress(MQTT_SERVER_HOST_NAME, brokerAddress);
+            timeSync->store(*startupCache);
+            int ret = startupCache->save();
+            if (ret != 0) {
+                printf("WARNING: startup cache save failed (%d).\r\n", ret);
+            }
+        }
+        if (isTokenRenewalRequested) {
+            isTokenRenewalRequested = false;
+            renewalTimer.stop();
+            printf("SAS token renewed, the connection was down for %lu ms.\r\n", (unsigned long)renewalTimer.read_ms());
+        }
+
+        // Network initialization done. Turn off the green LED
+        led_green = LED_OFF;
+        led_red = LED_OFF;
+
+        batcher->setClient(mqttClient);
+        if (directMethods) {
+            directMethods->setClient(mqttClient);
+        }
+        if (twin) {
+            twin->setClient(mqttClient);
+            // Desired properties may have changed while disconnected.
+            int rc = twin->requestTwin();
+            if (rc != MQTT::SUCCESS) {
+                printf("ERROR: rc from twin request is %d\r\n", rc);
+            }
+        }
+        if (qos1Publisher) {
+            qos1Publisher->attach(mqttClient, socket);
+            // Packets of the previous connection never got their PUBACK.
+            qos1Publisher->retransmitAll();
+        }
+
+        if (isFirstSession) {
+            isFirstSession = false;
+#if MBED_CONF_APP_BENCHMARK_MESSAGE_COUNT > 0
+            /* Measure publish throughput and latency before entering the main loop. */
+            MqttBenchmark benchmark(mqttClient, mqtt_topic_pub, MBED_CONF_APP_BENCHMARK_MESSAGE_COUNT,
+                                    MBED_CONF_APP_BENCHMARK_PAYLOAD_SIZE);
+            benchmark.setTlsConnectTime(tlsConnectUs);
+            benchmark.setMqttConnectTime(mqttConnectUs);
+            if (sasToken) {
+                benchmark.setSasSignTime(sasToken->signTimeUs());
+            }
+            int rc = benchmark.run();
+            if (rc != MQTT::SUCCESS) {
+                printf("ERROR: rc from MQTT publish during benchmark is %d\r\n", rc);
+            }
+            benchmark.print();
+#endif
+            profiler.printReport();
+            profiler.printTimeline();
+            printf("To send a packet, push the button 1 on your board.\r\n");
+            loopStartMs = Kernel::get_ms_count();
+        }
+
+        runMainLoop();
+
+        if (isTokenRenewalRequested) {
+            // Planned reconnect. Skip the statistics and go straight back.
+            printf("SAS token expires soon, reconnecting with a new token.\r\n");
+            renewalTimer.reset();
+            renewalTimer.start();
+            closeSession();
+            continue;
+        }
+
+        printf("The client has disconnected.\r\n");
+        if (outbox) {
+            // Keep what was queued for the lost connection.
+            storeTelemetry();
+            outbox->printStats();
+        }
+        reportLoopStats(true);
+        batcher->printStats();
+        if (qos1Publisher) {
+            qos1Publisher->printStats();
+        }
+        if (twin) {
+            twin->printStats();
+        }
+        if (directMethods) {
+            directMethods->printStats();
+        }
+        if (sensorPipeline) {
+            sensorPipeline->printStats();
+        }
+        if (gateway) {
+            gateway->printStats();
+        }
+        messagePool.printStats();
+        if (sessionPool) {
+            sessionPool->printStats();
+        }
+        consoleLog->printStats();
+        profiler.printReport();
+
+        // Turn on the red LED while the connection is down.
+        led_red = LED_ON;
+        led_green = LED_ON;
+        closeSession();
+    }
+}
+
+/*
+ * Establishes the TLS and MQTT connection and subscribes the topic. Reuses the
+ * network interface, reconnecting it only if it went down, and resumes the
+ * previous TLS session if the server still knows it. Returns MQTT::SUCCESS or
+ * an error; closeSession() cleans up either way.
+ */
+static int connectSession()
+{
+    if (network->get_connection_status() != NSAPI_STATUS_GLOBAL_UP) {
+        printf("Reconnecting network interface...\r\n");
+        nsapi_error_t net_status = network->connect();
+        if (net_status != NSAPI_ERROR_OK && net_status != NSAPI_ERROR_IS_CONNECTED) {
+            printf("Unable to connect to network (%d).\r\n", net_status);
+            return MQTT::FAILURE;
         }
-        set_time(now);
-        printf("Time is now %s", ctime(&now));
     }
 
     /* Establish a network connection. */
-    TLSSocket *socket = new TLSSocket; // Allocate on heap to avoid stack overflow.
+    socket = createSessionObject<MqttTapSocket>(); // Not on the stack, it is too large.
+    if (!socket) {
+        printf("ERROR: out of memory for the socket.\r\n");
+        return MQTT::FAILURE;
+    }
+    socket->setSessionCache(&tlsSessionCache);
+    Timer connectTimer;
     printf("Connecting to host %s:%d ...\r\n", MQTT_SERVER_HOST_NAME, MQTT_SERVER_PORT);
     {
+        profiler.begin(PHASE_SOCKET_OPEN);
         nsapi_error_t ret = socket->open(network);
+        profiler.end(PHASE_SOCKET_OPEN);
         if (ret != NSAPI_ERROR_OK) {
             printf("Could not open socket! Returned %d\n", ret);
-            return -1;
+            return MQTT::FAILURE;
         }
+        profiler.begin(PHASE_CA_LOAD);
+#ifdef HAVE_SSL_CA_DER
+        socket->set_ca_chain(trustStore.caChain());
+#else
         ret = socket->set_root_ca_cert(SSL_CA_PEM);
         if (ret != NSAPI_ERROR_OK) {
             printf("Could not set ca cert! Returned %d\n", ret);
-            return -1;
+            profiler.end(PHASE_CA_LOAD);
+            return MQTT::FAILURE;
         }
+#endif
 #if IOTHUB_AUTH_METHOD == IOTHUB_AUTH_CLIENT_SIDE_CERT
+#if defined(HAVE_SSL_CLIENT_CERT_DER) && defined(HAVE_SSL_CLIENT_PRIVATE_KEY_DER)
+        ret = socket->set_own_cert_key(trustStore.clientCert(), trustStore.clientKey());
+#else
         ret = socket->set_client_cert_key(SSL_CLIENT_CERT_PEM, SSL_CLIENT_PRIVATE_KEY_PEM);
+#endif
         if (ret != NSAPI_ERROR_OK) {
             printf("Could not set keys! Returned %d\n", ret);
-            return -1;
+            profiler.end(PHASE_CA_LOAD);
+            return MQTT::FAILURE;
         }
 #endif
-        ret = socket->connect(MQTT_SERVER_HOST_NAME, MQTT_SERVER_PORT);
+        profiler.end(PHASE_CA_LOAD);
+        /* Skip the DNS lookup if the address of the last connect is known. */
+        if (!isBrokerAddressKnown) {
+            profiler.begin(PHASE_DNS_LOOKUP);
+            ret = network->gethostbyname(MQTT_SERVER_HOST_NAME, &brokerAddress);
+            profiler.end(PHASE_DNS_LOOKUP);
+            if (ret != NSAPI_ERROR_OK) {
+                printf("Could not resolve %s! Returned %d\n", MQTT_SERVER_HOST_NAME, ret);
+                return MQTT::FAILURE;
+            }
+            brokerAddress.set_port(MQTT_SERVER_PORT);
+            isBrokerAddressKnown = true;
+        }
+        profiler.begin(PHASE_TCP_CONNECT);
+        connectTimer.start();
+        ret = socket->connectTransport(brokerAddress);
+        connectTimer.stop();
+        profiler.end(PHASE_TCP_CONNECT);
+        if (ret != NSAPI_ERROR_OK) {
+            printf("Could not connect to %s! Returned %d\n", brokerAddress.get_ip_address(), ret);
+            // The broker may have moved, resolve it again next time.
+            isBrokerAddressKnown = false;
+            return MQTT::FAILURE;
+        }
+        /* The certificates are checked against the time, NTP may still be running. */
+        profiler.begin(PHASE_TIME_WAIT);
+        const bool isTimeValid = timeSync->waitValid(TIME_WAIT_MS);
+        profiler.end(PHASE_TIME_WAIT);
+        if (!isTimeValid) {
+            printf("ERROR: no time from NTP after %d ms.\r\n", TIME_WAIT_MS);
+            return MQTT::FAILURE;
+        }
+        profiler.begin(PHASE_TLS_HANDSHAKE);
+        connectTimer.start();
+        ret = socket->handshake(MQTT_SERVER_HOST_NAME);
+        connectTimer.stop();
+        profiler.end(PHASE_TLS_HANDSHAKE);
+        tlsConnectUs = connectTimer.read_us();
         if (ret != NSAPI_ERROR_OK) {
             printf("Could not connect! Returned %d\n", ret);
-            return -1;
+            // The server may have dropped the session, do a full handshake next time.
+            tlsSessionCache.clear();
+            return MQTT::FAILURE;
         }
     }
-    printf("Connection established.\r\n");
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    printf("Connection established, %s handshake took %lu us. Heap in use %lu bytes, peak %lu bytes.\r\n",
+           socket->isSessionResumed() ? "resumed" : "full", (unsigned long)tlsConnectUs,
+           (unsigned long)heap.current_size, (unsigned long)heap.max_size);
     printf("\r\n");
 
     // Generate username from host name and client id.
     const char *username = MQTT_SERVER_HOST_NAME "/" DEVICE_ID "/api-version=2016-11-14";
+    const char *password = MQTT_SERVER_PASSWORD;
+    if (sasToken) {
+        const time_t now = time(NULL);
+        if (now + MBED_CONF_APP_SAS_TOKEN_RENEW_MARGIN_S >= sasToken->expiry()) {
+            int ret = sasToken->generate(now + TIME_JWT_EXP);
+            if (ret != 0) {
+                printf("ERROR: failed to generate SAS token (%d).\r\n", ret);
+                return MQTT::FAILURE;
+            }
+            const time_t expiry = sasToken->expiry();
+            printf("SAS token signed in %lu us, valid until %s", (unsigned long)sasToken->signTimeUs(), ctime(&expiry));
+        }
+        password = sasToken->token();
+    }
 
     /* Establish a MQTT connection. */
-    MQTTClient* mqttClient = new MQTTClient(socket);
+    mqttClient = createSessionObject<MQTTClient>(socket);
+    if (!mqttClient) {
+        printf("ERROR: out of memory for the MQTT client.\r\n");
+        return MQTT::FAILURE;
+    }
+    mqttClient->setDefaultMessageHandler(routeMqttMessage);
     printf("MQTT client is connecting to the service ...\r\n");
     {
         MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
         data.MQTTVersion = 4; // 3 = 3.1 4 = 3.1.1
         data.clientID.cstring = (char*)DEVICE_ID;
         data.username.cstring = (char*)username;
-        data.password.cstring = (char*)MQTT_SERVER_PASSWORD;
+        data.password.cstring = (char*)password;
+        keepAliveInterval = data.keepAliveInterval;
 
+#if MBED_CONF_APP_PIPELINED_SUBSCRIBE
+        /* The SUBSCRIBEs go out right behind CONNECT instead of after the CONNACK. */
+        const size_t subscribeLength = serializeSubscribes(subscribePackets, sizeof(subscribePackets));
+        if (subscribeLength > 0) {
+            pendingSubacks = subscribedTopicCount;
+            socket->setSubackHandler(handleSuback);
+            socket->sendAfterConnect(subscribePackets, subscribeLength);
+            profiler.begin(PHASE_SUBSCRIBE);
+        }
+#endif
+        profiler.begin(PHASE_MQTT_CONNECT);
+        connectTimer.reset();
+        connectTimer.start();
         int rc = mqttClient->connect(data);
+        connectTimer.stop();
+        profiler.end(PHASE_MQTT_CONNECT);
+        mqttConnectUs = connectTimer.read_us();
         if (rc != MQTT::SUCCESS) {
             printf("ERROR: rc from MQTT connect is %d\r\n", rc);
-            return -1;
+#if MBED_CONF_APP_PIPELINED_SUBSCRIBE
+            if (pendingSubacks > 0) {
+                // No SUBACK follows a failed CONNECT.
+                pendingSubacks = 0;
+                profiler.end(PHASE_SUBSCRIBE);
+            }
+#endif
+            return rc;
         }
     }
-    printf("Client connected.\r\n");
+    printf("Client connected, MQTT connect took %lu us.\r\n", (unsigned long)mqttConnectUs);
     printf("\r\n");
 
-    // Network initialization done. Turn off the green LED
-    led_green = LED_OFF;
+    /* Subscribe the topics. */
+    if (socket->afterConnectSent()) {
+        // The SUBACKs are read by the main loop, see handleSuback().
+        subscribedCount = subscribedTopicCount;
+        printf("Client has sent %u subscriptions along with CONNECT.\r\n", (unsigned)subscribedCount);
+    } else {
+#if MBED_CONF_APP_PIPELINED_SUBSCRIBE
+        pendingSubacks = 0;
+#endif
+        profiler.begin(PHASE_SUBSCRIBE);
+        for (size_t i = 0; i < subscribedTopicCount; i++) {
+            printf("Client is trying to subscribe a topic \"%s\".\r\n", subscribedTopics[i]);
+            int rc = mqttClient->subscribe(subscribedTopics[i], MQTT::QOS0, NULL);
+            if (rc != MQTT::SUCCESS) {
+                printf("ERROR: rc from MQTT subscribe is %d\r\n", rc);
+                profiler.end(PHASE_SUBSCRIBE);
+                return rc;
+            }
+            subscribedCount++;
+        }
+        profiler.end(PHASE_SUBSCRIBE);
+        printf("Client has subscribed %u topics.\r\n", (unsigned)subscribedCount);
+    }
+    printf("\r\n");
 
+    return MQTT::SUCCESS;
+}
 
-    // Generates topic names from user's setting in MQTT_server_setting.h
-    //devices/{device_id}/messages/events/
-    const char *mqtt_topic_pub = "devices/" DEVICE_ID "/messages/events/";
-    const char *mqtt_topic_sub = "devices/" DEVICE_ID "/messages/devicebound/#";
+/*
+ * Routes `topicFilter` to `handler` and subscribes it in every session.
+ * Returns false if there is no room for it.
+ */
+static bool addSubscription(const char *topicFilter, MQTTClient::messageHandler handler)
+{
+    if (subscribedTopicCount >= SUBSCRIBED_TOPICS_MAX || !topicRouter.add(topicFilter, handler)) {
+        return false;
+    }
+    subscribedTopics[subscribedTopicCount++] = topicFilter;
+    return true;
+}
 
-    /* Subscribe a topic. */
-    bool isSubscribed = false;
-    printf("Client is trying to subscribe a topic \"%s\".\r\n", mqtt_topic_sub);
-    {
-        int rc = mqttClient->subscribe(mqtt_topic_sub, MQTT::QOS0, handleMqttMessage);
-        if (rc != MQTT::SUCCESS) {
-            printf("ERROR: rc from MQTT subscribe is %d\r\n", rc);
-            return -1;
+/*
+ * Serializes a SUBSCRIBE packet for each of subscribedTopics into `buffer`,
+ * with packet ids from SUBSCRIBE_PACKET_ID_BASE. Returns the length, 0 if
+ * they do not fit.
+ */
+static size_t serializeSubscribes(uint8_t *buffer, size_t size)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < subscribedTopicCount; i++) {
+        MQTTString topic = MQTTString_initializer;
+        topic.cstring = (char*)subscribedTopics[i];
+        int qos = MQTT::QOS0;
+        const int len = MQTTSerialize_subscribe(buffer + length, size - length, 0, SUBSCRIBE_PACKET_ID_BASE + i,
+                                                1, &topic, &qos);
+        if (len <= 0) {
+            return 0;
         }
-        isSubscribed = true;
+        length += len;
     }
-    printf("Client has subscribed a topic \"%s\".\r\n", mqtt_topic_sub);
-    printf("\r\n");
+    return length;
+}
 
-    // Enable button 1 for publishing a message.
-    InterruptIn btn1(BUTTON1);
-    btn1.rise(handleButtonRise);
+/*
+ * Called by the socket for every SUBACK. Reports rejected subscriptions and
+ * ends PHASE_SUBSCRIBE once those sent along with CONNECT are all answered.
+ */
+static void handleSuback(uint16_t packetId, uint8_t returnCode)
+{
+#if MBED_CONF_APP_PIPELINED_SUBSCRIBE
+    const uint16_t index = packetId - SUBSCRIBE_PACKET_ID_BASE;
+    if (packetId < SUBSCRIBE_PACKET_ID_BASE || index >= subscribedTopicCount || pendingSubacks == 0) {
+        return;
+    }
+    if (returnCode == 0x80) {
+        printf("ERROR: the server rejected the subscription of \"%s\".\r\n", subscribedTopics[index]);
+    }
+    if (--pendingSubacks == 0) {
+        profiler.end(PHASE_SUBSCRIBE);
+    }
+#else
+    (void)packetId;
+    (void)returnCode;
+#endif
+}
 
-    printf("To send a packet, push the button 1 on your board.\r\n");
+/*
+ * Tears down the MQTT client and the socket of the current connection.
+ */
+static void closeSession()
+{
+    if(mqttClient) {
+        for(size_t i = 0; i < subscribedCount && mqttClient->isConnected(); i++) {
+            mqttClient->unsubscribe(subscribedTopics[i]);
+        }
+        if(mqttClient->isConnected())
+            mqttClient->disconnect();
+        destroySessionObject(mqttClient);
+        mqttClient = NULL;
+    }
+    subscribedCount = 0;
+    batcher->setClient(NULL);
+    if(directMethods) {
+        directMethods->setClient(NULL);
+    }
+    if(twin) {
+        twin->setClient(NULL);
+    }
+    if(qos1Publisher) {
+        qos1Publisher->attach(NULL, NULL);
+    }
+    if(socket) {
+        socket->close();
+        destroySessionObject(socket);
+        socket = NULL;
+    }
+#if MBED_CONF_APP_SESSION_POOL_RESET
+    if(sessionPool) {
+        // Blocks leaked by the session go as well, so they cannot pile up over reconnects.
+        const uint32_t leaked = sessionPool->reset();
+        if(leaked > 0) {
+            printf("WARNING: %lu session pool blocks were still allocated after the session.\r\n", (unsigned long)leaked);
+        }
+    }
+#endif
+}
 
+/*
+ * Constructs an object of the session in the session pool, or on the heap
+ * without one.
+ */
+template<typename T, typename... Args>
+static T *createSessionObject(Args&&... args)
+{
+    return sessionPool ? sessionPool->create<T>(args...) : new T(args...);
+}
+
+template<typename T>
+static void destroySessionObject(T *object)
+{
+    if (sessionPool) {
+        sessionPool->destroy(object);
+    } else {
+        delete object;
+    }
+}
+
+/*
+ * Runs until the client is disconnected.
+ */
+static void runMainLoop()
+{
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+    /* Main loop - sleeps until the socket, the button or a timer posts an event. */
+    // Keepalive only sends PINGREQ once its interval has elapsed, so check it
+    // four times per interval to stay well within 1.5 times the interval.
+    const int keepaliveEvent = eventQueue.call_every(keepAliveInterval * 1000 / 4, handleKeepalive);
+    if (sasToken) {
+        renewalEvent = eventQueue.call_in(MBED_CONF_APP_SAS_TOKEN_CHECK_INTERVAL_MS, handleTokenRenewal);
+    }
+    core_util_atomic_flag_clear(&isReadPosted);
+    socket->sigio(handleSocketSigio);
+    // Data may have arrived before the sigio callback was attached.
+    handleSocketSigio();
+    // Records may have been queued while disconnected.
+    if ((!telemetryQueue.empty() || (gateway && gateway->pending()))
+            && !core_util_atomic_flag_test_and_set(&isPublishPosted)) {
+        eventQueue.call(handleTelemetryQueued);
+    }
+    // Records are stored only while disconnected, or behind other stored ones.
+    if (outbox && !outbox->empty() && outboxReplayEvent == 0) {
+        outboxReplayEvent = eventQueue.call(handleOutboxReplay);
+    }
+    // A batch or QoS1 packets may be left over from the last session.
+    if (!batcher->empty()) {
+        batchDeadlineEvent = eventQueue.call_in(batcher->maxAge(), handleBatchDeadline);
+    }
+    scheduleRetransmit();
+    // The twin was requested on connect and its response may not come.
+    scheduleTwinReport();
+    eventQueue.dispatch_forever();
+    if (outboxReplayEvent) {
+        eventQueue.cancel(outboxReplayEvent);
+        outboxReplayEvent = 0;
+    }
+    eventQueue.cancel(keepaliveEvent);
+    if (twinReportEvent) {
+        eventQueue.cancel(twinReportEvent);
+        twinReportEvent = 0;
+    }
+    // Timers re-arm themselves, cancel the latest event of each so none fires into the next session.
+    if (renewalEvent) {
+        eventQueue.cancel(renewalEvent);
+        renewalEvent = 0;
+    }
+    if (batchDeadlineEvent) {
+        eventQueue.cancel(batchDeadlineEvent);
+        batchDeadlineEvent = 0;
+    }
+    if (retransmitEvent) {
+        eventQueue.cancel(retransmitEvent);
+        retransmitEvent = 0;
+    }
+    socket->sigio(Callback<void()>());
+#else
     /* Main loop */
+    uint64_t lastReplayMs = 0;
     while(1) {
-        /* Client is disconnected. */
-        if(!mqttClient->isConnected()){
+        loopWakeups++;
+        /* Waits a message and handles keepalive. */
+        if(!serviceClient(100)) {
             break;
         }
-        /* Waits a message and handles keepalive. */
-        if(mqttClient->yield(100) != MQTT::SUCCESS) {
+        publishTelemetry();
+        /* Publish the batch once its oldest record reaches the age deadline. */
+        if(!batcher->empty()) {
+            const uint32_t startUs = us_ticker_read();
+            led_blue = LED_ON;
+            batcher->poll();
+            led_blue = LED_OFF;
+            addBusyTime(startUs);
+            reportFirstPublish();
+        }
+        /* Resend QoS1 packets whose PUBACK is overdue. */
+        if(qos1Publisher) {
+            qos1Publisher->poll();
+        }
+        /* Send the reported twin properties changed within the report window. */
+        if(twin) {
+            twin->poll();
+        }
+        /* Replay stored telemetry at the replay rate. */
+        if(outbox && !outbox->empty() && Kernel::get_ms_count() - lastReplayMs >= OUTBOX_REPLAY_INTERVAL_MS) {
+            lastReplayMs = Kernel::get_ms_count();
+            replayOutbox();
+        }
+        reportLoopStats(false);
+        if(isTokenRenewalDue()) {
+            isTokenRenewalRequested = true;
             break;
         }
-        /* Received a message. */
-        if(isMessageArrived) {
-            isMessageArrived = false;
-            printf("\r\nMessage arrived:\r\n%s\r\n", messageBuffer);
+    }
+#endif
+}
+
+/*
+ * Callback function called by the client for every message arrived from
+ * server. Hands it to the handlers of the matching topic filters.
+ */
+void routeMqttMessage(MQTT::MessageData& md)
+{
+    if (topicRouter.dispatch(md) == 0) {
+        consoleLog->write(LOG_MESSAGE_UNROUTED, md.message.payloadlen);
+    }
+}
+
+/*
+ * Handles a devicebound or twin message routed by routeMqttMessage().
+ */
+void handleMqttMessage(MQTT::MessageData& md)
+{
+    // Keep the topic and payload in a pool slot until the main loop handles them.
+    if (!messagePool.store(md)) {
+        consoleLog->write(LOG_MESSAGE_DROPPED, md.message.payloadlen);
+    }
+}
+
+/*
+ * Handles a direct method request routed by routeMqttMessage().
+ * Runs the handler and publishes its response right away, from within the
+ * client's yield(), instead of waiting for the main loop.
+ */
+void handleMethodMessage(MQTT::MessageData& md)
+{
+#if MBED_CONF_APP_DIRECT_METHODS
+    // Copied once to terminate the topic and payload. The slot is free again on return.
+    if (!methodRequestPool.store(md)) {
+        consoleLog->write(LOG_METHOD_DROPPED, md.message.payloadlen);
+        return;
+    }
+    InboundMessagePool<1, MBED_CONF_APP_INBOUND_SLOT_SIZE>::Message *request = methodRequestPool.acquire();
+    directMethods->handleMessage(request->topic(), request->payload(), request->payloadLength, request->receivedUs);
+    methodRequestPool.release(request);
+#endif
+}
+
+/*
+ * Direct method "echo": responds with the request payload, e.g. to measure the round trip.
+ */
+static int handleEchoMethod(const char *payload, size_t payloadLength, char *response, size_t responseSize)
+{
+    if (payloadLength >= responseSize) {
+        snprintf(response, responseSize, "{\"error\":\"payload too large\"}");
+        return 413;
+    }
+    memcpy(response, payload, payloadLength);
+    response[payloadLength] = '\0';
+    return 200;
+}
+
+/*
+ * Direct method "getStats": responds with uptime, main loop wake-ups and heap usage.
+ */
+static int handleGetStatsMethod(const char *payload, size_t payloadLength, char *response, size_t responseSize)
+{
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    snprintf(response, responseSize, "{\"uptimeMs\":%llu,\"loopWakeups\":%lu,\"heapCurrent\":%lu,\"heapPeak\":%lu}",
+             (unsigned long long)Kernel::get_ms_count(), (unsigned long)loopWakeups,
+             (unsigned long)heap.current_size, (unsigned long)heap.max_size);
+    return 200;
+}
+
+/*
+ * Callback function called when button is pushed.
+ */
+void handleButtonRise() {
+    telemetryQueue.push(TELEMETRY_SOURCE_BUTTON, 1);
+    // Every leaf reports the push as well.
+    for (size_t i = 0; gateway && i < gateway->count(); i++) {
+        gateway->push(i, TELEMETRY_SOURCE_BUTTON, 1);
+    }
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+    if (!core_util_atomic_flag_test_and_set(&isPublishPosted)) {
+        eventQueue.call(handleTelemetryQueued);
+    }
+#endif
+}
+
+#if MBED_CONF_APP_SENSOR_SAMPLING
+/*
+ * Reads the sensor, from the Ticker interrupt of the sensor pipeline.
+ */
+static int32_t readSensor()
+{
+    return analogin_read_u16(&sensorAdc);
+}
+
+/*
+ * Called on the sensor pipeline thread for every window. Queues the summary
+ * as four records. The queue has a single producer, so the button interrupt
+ * is held off meanwhile.
+ */
+static void handleSensorSummary(const SensorSummary &summary)
+{
+    core_util_critical_section_enter();
+    telemetryQueue.push(TELEMETRY_SOURCE_SENSOR_MIN, summary.min);
+    telemetryQueue.push(TELEMETRY_SOURCE_SENSOR_MAX, summary.max);
+    telemetryQueue.push(TELEMETRY_SOURCE_SENSOR_MEAN, summary.mean);
+    telemetryQueue.push(TELEMETRY_SOURCE_SENSOR_COUNT, (int32_t)summary.count);
+    core_util_critical_section_exit();
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+    if (!core_util_atomic_flag_test_and_set(&isPublishPosted)) {
+        eventQueue.call(handleTelemetryQueued);
+    }
+#endif
+}
+#endif
+
+/*
+ * Reads pending packets and handles keepalive. Returns false once the client
+ * has disconnected.
+ */
+static bool serviceClient(unsigned long timeout)
+{
+    /* Client is disconnected. */
+    if (!mqttClient->isConnected()) {
+        return false;
+    }
+    if (mqttClient->yield(timeout) != MQTT::SUCCESS) {
+        return false;
+    }
+    handleInboundMessages();
+    return true;
+}
+
+/*
+ * Prints the messages received from the server and returns their slots to the pool.
+ */
+static void handleInboundMessages()
+{
+    const uint32_t startUs = us_ticker_read();
+    MessagePool::Message *inbound;
+    while ((inbound = messagePool.acquire()) != NULL) {
+        if (twin && twin->handleMessage(inbound->topic(), inbound->payload(), inbound->payloadLength)) {
+            messagePool.release(inbound);
+            continue;
+        }
+        if (gateway && gateway->handleMessage(inbound->topic(), inbound->payload(), inbound->payloadLength)) {
+            messagePool.release(inbound);
+            continue;
         }
-        /* Button is pushed - publish a message. */
-        if(isPublish) {
-            isPublish = false;
-            static unsigned int id = 0;
-            static unsigned int count = 0;
+        consoleLog->writeText(LOG_MESSAGE_ARRIVED, inbound->payloadLength, inbound->payload(), inbound->payloadLength);
+        messagePool.release(inbound);
+    }
+    addBusyTime(startUs);
+}
 
+/*
+ * Moves queued telemetry records into the batch, e.g. button is pushed.
+ */
+static void publishTelemetry()
+{
+    const uint32_t startUs = us_ticker_read();
+    TelemetryRecord record;
+    while (telemetryQueue.pop(record)) {
+        const uint32_t latency = us_ticker_read() - record.timestamp;
+        pickupLatencySumUs += latency;
+        if (latency > pickupLatencyMaxUs) {
+            pickupLatencyMaxUs = latency;
+        }
+        pickupCount++;
+        if (twin && record.source == TELEMETRY_SOURCE_BUTTON) {
+            // Changes within the report window go out as one PATCH.
+            static int32_t buttonPresses = 0;
+            twin->reportInt(REPORTED_BUTTON_PRESSES, ++buttonPresses);
+        }
+
+        if (outbox && !outbox->empty()) {
+            // Stored records are still being replayed, queue behind them to keep the order.
+            storeRecord(record);
+        } else {
             // When sending a message, blue LED lights.
             led_blue = LED_ON;
+            batcher->add(record);
+            led_blue = LED_OFF;
+        }
+#if !MBED_CONF_APP_TELEMETRY_DRAIN_ALL
+        // Only one record per iteration, the rest waits for the next wake-up.
+        break;
+#endif
+    }
+    /* Report records lost because the queue was full. */
+    static uint32_t reportedOverflows = 0;
+    const uint32_t overflows = telemetryQueue.overflows();
+    if (overflows != reportedOverflows) {
+        printf("WARNING: %lu telemetry records dropped, queue full.\r\n", (unsigned long)(overflows - reportedOverflows));
+        reportedOverflows = overflows;
+    }
+    if (gateway && mqttClient) {
+        // One message per leaf, the rest waits for the next turn.
+        int rc = gateway->publishTurn();
+        if (rc != MQTT::SUCCESS) {
+            consoleLog->write(LOG_PUBLISH_ERROR, (uint32_t)rc);
+        }
+    }
+    addBusyTime(startUs);
+    reportFirstPublish();
+}
 
-            MQTT::Message message;
-            message.retained = false;
-            message.dup = false;
-
-            const size_t len = 128;
-            char buf[len];
-            snprintf(buf, len, "Message #%d from %s.", count, DEVICE_ID);
-            message.payload = (void*)buf;
-
-            message.qos = MQTT::QOS0;
-            message.id = id++;
-            message.payloadlen = strlen(buf);
-            // Publish a message.
-            printf("\r\nPublishing message to the topic %s:\r\n%s\r\n", mqtt_topic_pub, buf);
-            int rc = mqttClient->publish(mqtt_topic_pub, message);
-            if(rc != MQTT::SUCCESS) {
-                printf("ERROR: rc from MQTT publish is %d\r\n", rc);
-            }
-            printf("Message published.\r\n");
+#if MBED_CONF_APP_GATEWAY
+/*
+ * Publishes a leaf device's telemetry batch for the gateway at QoS0. Leaf
+ * records are not kept in the outbox, a failed publish loses them.
+ */
+static int publishLeafTelemetry(const char *topic, const char *payload, size_t length)
+{
+    if (!mqttClient) {
+        return MQTT::FAILURE;
+    }
+    MQTT::Message message;
+    message.qos = MQTT::QOS0;
+    message.retained = false;
+    message.dup = false;
+    message.payload = (void *)payload;
+    message.payloadlen = length;
+    return mqttClient->publish(topic, message);
+}
+#endif
 
-            count++;
+/*
+ * Prints the startup timeline once, after the first telemetry batch was published.
+ */
+static void reportFirstPublish()
+{
+    static bool isReported = false;
+    if (!isReported && profiler.runs(PHASE_PUBLISH) > 0) {
+        isReported = true;
+        profiler.printTimeline();
+    }
+}
 
-            led_blue = LED_OFF;
+/*
+ * Adds the time since `startUs` to the main loop's busy time.
+ */
+static void addBusyTime(uint32_t startUs)
+{
+    const uint32_t elapsed = us_ticker_read() - startUs;
+    loopBusySumUs += elapsed;
+    if (elapsed > loopBusyMaxUs) {
+        loopBusyMaxUs = elapsed;
+    }
+}
+
+/*
+ * Prints main loop wake-ups per minute, the pick-up latency of telemetry
+ * records and the busy time per wake-up, once a minute or immediately if
+ * `force` is set.
+ */
+static void reportLoopStats(bool force)
+{
+    static uint64_t lastReportMs = 0;
+    const uint64_t now = Kernel::get_ms_count();
+    if (!force && now - lastReportMs < 60 * 1000) {
+        return;
+    }
+    lastReportMs = now;
+
+    const uint64_t elapsed = now - loopStartMs;
+    printf("Main loop: %lu wake-ups/min", elapsed ? (unsigned long)(loopWakeups * 60000ULL / elapsed) : 0UL);
+    if (pickupCount > 0) {
+        printf(", record pick-up latency avg %lu us, max %lu us",
+               (unsigned long)(pickupLatencySumUs / pickupCount), (unsigned long)pickupLatencyMaxUs);
+    }
+    if (loopWakeups > 0) {
+        printf(", busy avg %lu us per wake-up, longest step %lu us",
+               (unsigned long)(loopBusySumUs / loopWakeups), (unsigned long)loopBusyMaxUs);
+    }
+    printf("\r\n");
+}
+
+/*
+ * True if the SAS token expires within the renewal margin.
+ */
+static bool isTokenRenewalDue()
+{
+    return sasToken && time(NULL) + MBED_CONF_APP_SAS_TOKEN_RENEW_MARGIN_S >= sasToken->expiry();
+}
+
+/*
+ * Appends a record to the outbox.
+ */
+static void storeRecord(const TelemetryRecord &record)
+{
+    int ret = outbox->append(record);
+    if (ret != 0) {
+        printf("WARNING: telemetry record lost, outbox write failed (%d).\r\n", ret);
+    }
+}
+
+/*
+ * Moves queued telemetry records into the outbox while disconnected.
+ */
+static void storeTelemetry()
+{
+    TelemetryRecord record;
+    while (telemetryQueue.pop(record)) {
+        storeRecord(record);
+    }
+}
+
+#if MBED_CONF_APP_OUTBOX_ENABLED
+/*
+ * Stores the records of a batch whose publish failed, e.g. while the
+ * connection was dying, and replays them with the other stored records.
+ */
+static void storeFailedBatch(const TelemetryRecord *records, unsigned int count)
+{
+    if (isReplaying) {
+        // Still in the outbox, replayOutbox() rewinds to them.
+        return;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        storeRecord(records[i]);
+    }
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+    // The connection may still be up, replay does not wait for the next session.
+    if (outboxReplayEvent == 0) {
+        outboxReplayEvent = eventQueue.call_in(OUTBOX_REPLAY_INTERVAL_MS, handleOutboxReplay);
+    }
+#endif
+}
+#endif
+
+#if MBED_CONF_APP_OUTBOX_ENABLED && MBED_CONF_APP_PUBLISH_QOS1
+/*
+ * Remembers a batch published by replayOutbox() until its PUBACK arrives.
+ */
+static void handleBatchPublished(uint16_t packetId)
+{
+    if (!isReplaying) {
+        return;
+    }
+    if (replayedCount == MBED_CONF_APP_QOS1_WINDOW) {
+        // Not tracked, its records are replayed again.
+        isReplayRewindNeeded = true;
+        return;
+    }
+    replayedBatches[replayedCount].packetId = packetId;
+    replayedBatches[replayedCount].isAcked = false;
+    replayedBatches[replayedCount].lastId = replayLastId;
+    replayedCount++;
+}
+
+/*
+ * Marks a replayed batch as delivered. Called from inside publish and yield,
+ * so the outbox is updated by the next replayOutbox() instead.
+ */
+static void handleDelivery(uint16_t packetId, bool isAcked)
+{
+    for (size_t i = 0; i < replayedCount; i++) {
+        if (replayedBatches[i].packetId == packetId) {
+            if (isAcked) {
+                replayedBatches[i].isAcked = true;
+            } else {
+                isReplayRewindNeeded = true;
+            }
+            return;
         }
     }
+}
+#endif
+
+/*
+ * Reads the outbox again from the oldest record not acknowledged.
+ */
+static void rewindReplay()
+{
+    outbox->rewind();
+#if MBED_CONF_APP_PUBLISH_QOS1
+    // Batches still in flight are replayed again, so their PUBACKs no longer matter.
+    replayedCount = 0;
+    isReplayRewindNeeded = false;
+#endif
+}
 
-    printf("The client has disconnected.\r\n");
+/*
+ * Acknowledges the stored records up to `lastId` in the outbox.
+ */
+static void acknowledgeReplayed(uint32_t lastId)
+{
+    int ret = outbox->acknowledge(lastId);
+    if (ret != 0) {
+        printf("WARNING: outbox acknowledgement not stored (%d), records are sent again after a reset.\r\n", ret);
+    }
+}
 
-    if(mqttClient) {
-        if(isSubscribed) {
-            mqttClient->unsubscribe(mqtt_topic_sub);
-            mqttClient->setMessageHandler(mqtt_topic_sub, 0);
+/*
+ * Publishes the next outbox-replay-rate share of stored records, oldest
+ * first. Records are acknowledged once published, or with publish-qos1 once
+ * the PUBACK of their batch arrived. After a failed publish they are sent
+ * again on the next call, so a record may arrive twice.
+ */
+static void replayOutbox()
+{
+    const uint32_t perStep = MBED_CONF_APP_OUTBOX_REPLAY_RATE * OUTBOX_REPLAY_INTERVAL_MS / 1000;
+    const uint32_t limit = (perStep > 0) ? perStep : 1;
+    TelemetryRecord record;
+#if MBED_CONF_APP_PUBLISH_QOS1
+    if (isReplayRewindNeeded) {
+        rewindReplay();
+    }
+    // Acknowledged in publish order, up to the first batch still waiting for its PUBACK.
+    size_t acked = 0;
+    while (acked < replayedCount && replayedBatches[acked].isAcked) {
+        acked++;
+    }
+    if (acked > 0) {
+        acknowledgeReplayed(replayedBatches[acked - 1].lastId);
+        replayedCount -= acked;
+        memmove(replayedBatches, replayedBatches + acked, replayedCount * sizeof(replayedBatches[0]));
+    }
+#endif
+    led_blue = LED_ON;
+    // A batch left from before the disconnect goes first, so a batch holds only stored records.
+    int rc = batcher->flush();
+    isReplaying = true;
+    for (uint32_t n = 0; n < limit && rc == MQTT::SUCCESS && outbox->readNext(record); n++) {
+        // Published before the record is added, so every batch ends with a known record.
+        if (!batcher->fits(record)) {
+            rc = batcher->flush();
+        }
+        if (rc == MQTT::SUCCESS) {
+            replayLastId = outbox->lastReadId();
+            rc = batcher->add(record);
         }
-        if(mqttClient->isConnected())
-            mqttClient->disconnect();
-        delete mqttClient;
     }
-    if(socket) {
-        socket->close();
-        delete socket;
+    if (rc == MQTT::SUCCESS) {
+        rc = batcher->flush();
     }
-    if(network) {
-        network->disconnect();
-        // network is not created by new.
+    isReplaying = false;
+    led_blue = LED_OFF;
+    if (rc != MQTT::SUCCESS) {
+        rewindReplay();
+        return;
     }
+#if !MBED_CONF_APP_PUBLISH_QOS1
+    acknowledgeReplayed(outbox->lastReadId());
+#endif
+    if (outbox->empty()) {
+        printf("Outbox replayed.\r\n");
+        outbox->printStats();
+    }
+}
 
-    // Turn on the red LED when the program is done.
-    led_red = LED_ON;
+/*
+ * Sleeps for `delayMs` while disconnected, moving telemetry records into the
+ * outbox as they are queued.
+ */
+static void waitDisconnected(uint32_t delayMs)
+{
+    if (!outbox) {
+        ThisThread::sleep_for(delayMs);
+        return;
+    }
+    for (uint32_t slept = 0; slept < delayMs; slept += OUTBOX_REPLAY_INTERVAL_MS) {
+        storeTelemetry();
+        ThisThread::sleep_for(delayMs - slept < OUTBOX_REPLAY_INTERVAL_MS ? delayMs - slept : OUTBOX_REPLAY_INTERVAL_MS);
+    }
+    storeTelemetry();
 }
 
+#if MBED_CONF_APP_DEVICE_TWIN
 /*
- * Callback function called when a message arrived from server.
+ * Applies a desired twin property and reports the value in effect.
  */
-void handleMqttMessage(MQTT::MessageData& md)
+static void handleDesiredChange(size_t index)
 {
-    // Copy payload to the buffer.
-    MQTT::Message &message = md.message;
-    memcpy(messageBuffer, message.payload, message.payloadlen);
-    messageBuffer[message.payloadlen] = '\0';
+    if (index == DESIRED_TELEMETRY_MAX_AGE_MS) {
+        const TwinProperty &property = desiredProperties[index];
+        // Back to the configured value when the property is removed.
+        const uint32_t maxAgeMs = (property.present && property.number >= 0)
+                                  ? (uint32_t)property.number : MBED_CONF_APP_TELEMETRY_BATCH_MAX_AGE_MS;
+        batcher->setMaxAgeMs(maxAgeMs);
+        twin->reportInt(REPORTED_TELEMETRY_MAX_AGE_MS, (int32_t)maxAgeMs);
+        printf("Twin: telemetry batch age deadline is now %lu ms.\r\n", (unsigned long)maxAgeMs);
+    }
+}
+#endif
 
-    isMessageArrived = true;
+#if MBED_CONF_APP_EVENT_DRIVEN_LOOP
+/*
+ * Socket state changed. Called from the network stack, so only posts an event.
+ */
+static void handleSocketSigio()
+{
+    if (!core_util_atomic_flag_test_and_set(&isReadPosted)) {
+        eventQueue.call(handleSocketReadable);
+    }
+}
+
+static void handleSocketReadable()
+{
+    core_util_atomic_flag_clear(&isReadPosted);
+    loopWakeups++;
+    if (!serviceClient(MBED_CONF_APP_EVENT_READ_TIMEOUT_MS)) {
+        eventQueue.break_dispatch();
+        return;
+    }
+    // A desired property may have changed a reported one.
+    scheduleTwinReport();
+}
+
+static void handleKeepalive()
+{
+    loopWakeups++;
+    // Sends PINGREQ if the keepalive interval has elapsed.
+    if (!serviceClient(1)) {
+        eventQueue.break_dispatch();
+        return;
+    }
+    scheduleTwinReport();
+    reportLoopStats(false);
+}
+
+static void handleTelemetryQueued()
+{
+    core_util_atomic_flag_clear(&isPublishPosted);
+    loopWakeups++;
+    publishTelemetry();
+    if (gateway && gateway->pending() && !core_util_atomic_flag_test_and_set(&isPublishPosted)) {
+        // Give the socket a turn before the leaves' next messages.
+        eventQueue.call(handleTelemetryQueued);
+    }
+    if (!batcher->empty() && batchDeadlineEvent == 0) {
+        batchDeadlineEvent = eventQueue.call_in(batcher->maxAge(), handleBatchDeadline);
+    }
+    scheduleRetransmit();
+    scheduleTwinReport();
 }
 
 /*
- * Callback function called when button is pushed.
+ * Publishes the batch. Scheduled when the first record was added, so no
+ * record waits longer than the age deadline.
  */
-void handleButtonRise() {
-    isPublish = true;
+static void handleBatchDeadline()
+{
+    batchDeadlineEvent = 0;
+    loopWakeups++;
+    const uint32_t startUs = us_ticker_read();
+    led_blue = LED_ON;
+    batcher->flush();
+    led_blue = LED_OFF;
+    addBusyTime(startUs);
+    reportFirstPublish();
+    scheduleRetransmit();
 }
+
+/*
+ * Schedules a check for the QoS1 packet in flight that expires first.
+ */
+static void scheduleRetransmit()
+{
+    if (qos1Publisher && qos1Publisher->inFlight() > 0 && retransmitEvent == 0) {
+        retransmitEvent = eventQueue.call_in(qos1Publisher->nextTimeoutMs(), handleRetransmit);
+    }
+}
+
+static void handleRetransmit()
+{
+    retransmitEvent = 0;
+    loopWakeups++;
+    qos1Publisher->poll();
+    scheduleRetransmit();
+}
+
+/*
+ * Ends the main loop once the SAS token is due for renewal. Checks the RTC
+ * periodically rather than setting one long timer, which NTP corrections
+ * or a token lifetime beyond the timer range would throw off.
+ */
+static void handleTokenRenewal()
+{
+    renewalEvent = 0;
+    if (isTokenRenewalDue()) {
+        isTokenRenewalRequested = true;
+        eventQueue.break_dispatch();
+    } else {
+        renewalEvent = eventQueue.call_in(MBED_CONF_APP_SAS_TOKEN_CHECK_INTERVAL_MS, handleTokenRenewal);
+    }
+}
+
+/*
+ * Schedules sending the changed reported twin properties at the end of the
+ * report window, or sending a GET or a PATCH again once its response is overdue.
+ */
+static void scheduleTwinReport()
+{
+    if (!twin) {
+        return;
+    }
+    const uint32_t delayMs = twin->nextPollMs();
+    if (delayMs == 0) {
+        return;
+    }
+    const uint64_t dueMs = Kernel::get_ms_count() + delayMs;
+    if (twinReportEvent) {
+        // A new change may be due before the response timeout already scheduled.
+        if (twinReportDueMs <= dueMs) {
+            return;
+        }
+        eventQueue.cancel(twinReportEvent);
+    }
+    twinReportEvent = eventQueue.call_in(delayMs, handleTwinReport);
+    twinReportDueMs = dueMs;
+}
+
+static void handleTwinReport()
+{
+    twinReportEvent = 0;
+    loopWakeups++;
+    twin->poll();
+    // Changes that did not fit, or wait for the response to the previous PATCH.
+    scheduleTwinReport();
+}
+
+/*
+ * Replays the next records from the outbox and schedules itself again until
+ * the outbox is empty.
+ */
+static void handleOutboxReplay()
+{
+    outboxReplayEvent = 0;
+    loopWakeups++;
+    replayOutbox();
+    scheduleRetransmit();
+    if (!outbox->empty()) {
+        outboxReplayEvent = eventQueue.call_in(OUTBOX_REPLAY_INTERVAL_MS, handleOutboxReplay);
+    }
+}
+#endif
+
+#endif /* !MBED_CONF_APP_BENCHMARK_APP */
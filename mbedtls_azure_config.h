@@ -61,18 +61,21 @@
     #define MBEDTLS_SSL_EXPORT_KEYS
 #endif //MBEDTLS_SSL_EXPORT_KEYS
 
+// Lets a reconnect resume the previous session with a ticket, see tls_session_cache.h
+#ifndef MBEDTLS_SSL_SESSION_TICKETS
+    #define MBEDTLS_SSL_SESSION_TICKETS
+#endif //MBEDTLS_SSL_SESSION_TICKETS
+
 /* mbed TLS modules */
 #ifndef MBEDTLS_AES_C
     #define MBEDTLS_AES_C
 #endif //MBEDTLS_AES_C
 
-/* Disable some of the speed optimizations on AES code to save
- * ~6200 bytes of ROM. According to comments on the mbedtls PR 394,
- * the speed on Cortex M4 is not even reduced by this. */
-#ifndef MBEDTLS_AES_FEWER_TABLES
-    #define MBEDTLS_AES_FEWER_TABLES
-#endif // MBEDTLS_AES_FEWER_TABLES
 
+// Decodes DEVICE_KEY and encodes the SAS token signature, see sas_token.h
+#ifndef MBEDTLS_BASE64_C
+    #define MBEDTLS_BASE64_C
+#endif //MBEDTLS_BASE64_C
 
 #ifndef MBEDTLS_BIGNUM_C
     #define MBEDTLS_BIGNUM_C
@@ -114,12 +117,6 @@
     #define MBEDTLS_SHA256_C
 #endif //MBEDTLS_SHA256_C
 
-// Disable the speed optimizations of SHA256, makes binary size smaller
-// on Cortex-M by 1800B with ARMCC5 and 1384B with GCC 6.3.
-#ifndef MBEDTLS_SHA256_SMALLER
-    #define MBEDTLS_SHA256_SMALLER
-#endif // MBEDTLS_SHA256_SMALLER
-
 #ifndef MBEDTLS_SSL_COOKIE_C
     #define MBEDTLS_SSL_COOKIE_C
 #endif //MBEDTLS_SSL_COOKIE_C
@@ -173,6 +170,52 @@
 // *   the binary footprint and the memory usage
 // */
 
+/* Performance profiles, selected with tls-profile in mbed_app.json.
+ * TLS_PROFILE_MIN_RAM trades speed for RAM and ROM everywhere it can.
+ * TLS_PROFILE_BALANCED keeps the RAM savings but uses the fast AES and SHA-256
+ *   code and larger exponentiation windows.
+ * TLS_PROFILE_MAX_SPEED uses the mbed TLS defaults: AES tables in RAM, full
+ *   16KB records and the largest windows.
+ * Measure them on your board with crypto-benchmark. */
+#define TLS_PROFILE_MIN_RAM     1
+#define TLS_PROFILE_BALANCED    2
+#define TLS_PROFILE_MAX_SPEED   3
+
+#ifndef MBED_CONF_APP_TLS_PROFILE
+    #define MBED_CONF_APP_TLS_PROFILE TLS_PROFILE_MIN_RAM
+#endif //MBED_CONF_APP_TLS_PROFILE
+
+#if MBED_CONF_APP_TLS_PROFILE == TLS_PROFILE_MIN_RAM
+#define TLS_PROFILE_NAME "min-ram"
+
+/* Disable some of the speed optimizations on AES code to save
+ * ~6200 bytes of ROM. According to comments on the mbedtls PR 394,
+ * the speed on Cortex M4 is not even reduced by this. */
+#ifndef MBEDTLS_AES_FEWER_TABLES
+    #define MBEDTLS_AES_FEWER_TABLES
+#endif // MBEDTLS_AES_FEWER_TABLES
+
+// Disable the speed optimizations of SHA256, makes binary size smaller
+// on Cortex-M by 1800B with ARMCC5 and 1384B with GCC 6.3.
+#ifndef MBEDTLS_SHA256_SMALLER
+    #define MBEDTLS_SHA256_SMALLER
+#endif // MBEDTLS_SHA256_SMALLER
+
+// define to save 8KB RAM at the expense of ROM
+#ifndef MBEDTLS_AES_ROM_TABLES
+    #define MBEDTLS_AES_ROM_TABLES
+#endif //MBEDTLS_AES_ROM_TABLES
+
+// Reduce IO buffer to save RAM, default is 16KB
+#ifndef MBEDTLS_SSL_MAX_CONTENT_LEN
+    #define MBEDTLS_SSL_MAX_CONTENT_LEN (5*1024)
+#endif //MBEDTLS_SSL_MAX_CONTENT_LEN
+
+#define MBEDTLS_MPI_WINDOW_SIZE 1
+
+#elif MBED_CONF_APP_TLS_PROFILE == TLS_PROFILE_BALANCED
+#define TLS_PROFILE_NAME "balanced"
+
 // define to save 8KB RAM at the expense of ROM
 #ifndef MBEDTLS_AES_ROM_TABLES
     #define MBEDTLS_AES_ROM_TABLES
@@ -183,9 +226,53 @@
     #define MBEDTLS_SSL_MAX_CONTENT_LEN (5*1024)
 #endif //MBEDTLS_SSL_MAX_CONTENT_LEN
 
+// Fewer multiplications per RSA operation for a few KB of heap during the handshake
+#define MBEDTLS_MPI_WINDOW_SIZE 3
+#define MBEDTLS_ECP_WINDOW_SIZE 4
+
+#elif MBED_CONF_APP_TLS_PROFILE == TLS_PROFILE_MAX_SPEED
+#define TLS_PROFILE_NAME "max-speed"
+
+#define MBEDTLS_MPI_WINDOW_SIZE 6
+#define MBEDTLS_ECP_WINDOW_SIZE 6
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM 1
+
+#else
+#error "tls-profile must be TLS_PROFILE_MIN_RAM, TLS_PROFILE_BALANCED or TLS_PROFILE_MAX_SPEED"
+#endif // MBED_CONF_APP_TLS_PROFILE
+
 // Multiple Precision Integers when using RSA can be smaller
 #define MBEDTLS_MPI_MAX_SIZE 512
-#define MBEDTLS_MPI_WINDOW_SIZE 1
+
+/* Session pool, selected with session-pool in mbed_app.json. Lets the
+ * sample replace calloc and free of mbed TLS at runtime, see session_pool.h. */
+#if defined(MBED_CONF_APP_SESSION_POOL) && MBED_CONF_APP_SESSION_POOL
+#ifndef MBEDTLS_PLATFORM_MEMORY
+    #define MBEDTLS_PLATFORM_MEMORY
+#endif //MBEDTLS_PLATFORM_MEMORY
+#endif // MBED_CONF_APP_SESSION_POOL
+
+/* ECC only mode, selected with tls-ecc-only in mbed_app.json. Offers only
+ * ECDHE-ECDSA with AES-128-GCM and removes the RSA code, which takes the
+ * RSA signature checks and the large RSA numbers out of the handshake.
+ * Needs an IoT Hub with an ECC server certificate, and a P-256 client key
+ * when authenticating with an X.509 certificate. */
+#if defined(MBED_CONF_APP_TLS_ECC_ONLY) && MBED_CONF_APP_TLS_ECC_ONLY
+#undef MBEDTLS_KEY_EXCHANGE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_DHE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDH_RSA_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_RSA_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_DHE_PSK_ENABLED
+#undef MBEDTLS_X509_RSASSA_PSS_SUPPORT
+#undef MBEDTLS_RSA_C
+#undef MBEDTLS_PKCS1_V15
+#undef MBEDTLS_PKCS1_V21
+#undef MBEDTLS_DHM_C
+#undef MBEDTLS_GENPRIME
+
+#define MBEDTLS_SSL_CIPHERSUITES MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256
+#endif // MBED_CONF_APP_TLS_ECC_ONLY
 
 // Remove error messages, save 10KB of ROM
 // #undef MBEDTLS_ERROR_C
@@ -0,0 +1,169 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "method_benchmark.h"
+#include "direct_methods.h"
+#include "inbound_message_pool.h"
+
+/* Request topic, the request id is filled in per call. */
+#define METHOD_BENCHMARK_REQUEST_FORMAT  "$iothub/methods/POST/echo/?$rid=%lx"
+#define METHOD_BENCHMARK_PAYLOAD         "{\"value\":42}"
+#define METHOD_BENCHMARK_RESPONSE_OK     "$iothub/methods/res/200/"
+
+/* Holds a request from the client's read buffer while it is handled, as in main.cpp. */
+static InboundMessagePool<1, 128> requestPool;
+static DirectMethods *benchmarkMethods;
+
+/* Records written by DirectMethods, so the console does not slow down the calls. */
+static DeferredLogRecord logRecords[16];
+static DeferredLog methodLog(logRecords, sizeof(logRecords) / sizeof(logRecords[0]), false);
+
+static int compareSample(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int handleEcho(const char *payload, size_t payloadLength, char *response, size_t responseSize)
+{
+    if (payloadLength >= responseSize) {
+        return 413;
+    }
+    memcpy(response, payload, payloadLength + 1);
+    return 200;
+}
+
+static constexpr DirectMethod methodTable[] = {
+    { "echo", handleEcho },
+};
+static_assert(isDirectMethodTableSorted(methodTable), "methodTable must be sorted by name");
+
+/* Handles a request from within the client's yield(), as handleMethodMessage() in main.cpp does. */
+static void handleRequest(MQTT::MessageData &md)
+{
+    if (!requestPool.store(md)) {
+        return;
+    }
+    InboundMessagePool<1, 128>::Message *request = requestPool.acquire();
+    benchmarkMethods->handleMessage(request->topic(), request->payload(), request->payloadLength, request->receivedUs);
+    requestPool.release(request);
+}
+
+MethodBenchmark::MethodBenchmark(uint32_t calls, uint32_t budgetMs, LoopbackBroker *broker)
+    : broker(broker), calls(calls), budgetMs(budgetMs), answered(0), roundTripUs(0), samples(NULL), sampleCount(0),
+      isAnswered(false)
+{
+}
+
+MethodBenchmark::~MethodBenchmark()
+{
+    delete[] samples;
+}
+
+uint32_t MethodBenchmark::percentile(unsigned int p) const
+{
+    if (sampleCount == 0) {
+        return 0;
+    }
+    const uint32_t index = (sampleCount * p + 99) / 100;
+    return samples[index > 0 ? index - 1 : 0];
+}
+
+/*
+ * Called by the broker with every PUBLISH from the client. Stops the clock
+ * when the response comes in, before DirectMethods logs the call.
+ */
+void MethodBenchmark::handleResponse(LoopbackSocket *client, const char *topic)
+{
+    timer.stop();
+    isAnswered = true;
+    if (strncmp(topic, METHOD_BENCHMARK_RESPONSE_OK, sizeof(METHOD_BENCHMARK_RESPONSE_OK) - 1) == 0) {
+        answered++;
+    }
+}
+
+int MethodBenchmark::run()
+{
+    char response[128];
+    DirectMethods methods(methodTable, sizeof(methodTable) / sizeof(methodTable[0]), response, sizeof(response),
+                          budgetMs);
+    benchmarkMethods = &methods;
+    methodLog.start();
+    methods.setLog(&methodLog);
+
+    LoopbackSocket socket;
+    socket.connectBroker(broker);
+    MQTTClient *client = new MQTTClient(&socket);
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = (char*)"benchmark";
+    data.cleansession = 1;
+    int ret = 0;
+    if (client->connect(data) != MQTT::SUCCESS
+            || client->subscribe(DIRECT_METHODS_TOPIC, MQTT::QOS0, handleRequest) != MQTT::SUCCESS) {
+        ret = -1;
+    }
+    methods.setClient(client);
+    broker->onPublish(callback(this, &MethodBenchmark::handleResponse));
+
+    char topic[64];
+    answered = 0;
+    roundTripUs = 0;
+    delete[] samples;
+    samples = new uint32_t[calls];
+    sampleCount = 0;
+    for (uint32_t i = 0; ret == 0 && i < calls; i++) {
+        snprintf(topic, sizeof(topic), METHOD_BENCHMARK_REQUEST_FORMAT, (unsigned long)(i + 1));
+        isAnswered = false;
+        timer.reset();
+        timer.start();
+        // yield() reads nothing with a timeout of 0. The clock stops when the response arrives, not after 1 ms.
+        if (!socket.publish(topic, METHOD_BENCHMARK_PAYLOAD, sizeof(METHOD_BENCHMARK_PAYLOAD) - 1)
+                || client->yield(1) != MQTT::SUCCESS || !isAnswered) {
+            ret = -1;
+        }
+        timer.stop();
+        const uint32_t us = timer.read_us();
+        roundTripUs += us;
+        samples[sampleCount++] = us;
+    }
+    qsort(samples, sampleCount, sizeof(samples[0]), compareSample);
+    if (answered != calls) {
+        ret = -1;
+    }
+
+    broker->onPublish(LoopbackPublishHandler());
+    methods.setClient(NULL);
+    methods.setLog(DeferredLog::immediate());
+    benchmarkMethods = NULL;
+    client->disconnect();
+    delete client;
+    return ret;
+}
+
+void MethodBenchmark::print() const
+{
+    printf("----- Method benchmark -----\r\n");
+    printf("Calls:       %lu, %lu answered with 200\r\n", (unsigned long)calls, (unsigned long)answered);
+    printf("Round trip:  %lu us average, %lu us p50, %lu us p99, %lu us max\r\n",
+           sampleCount ? (unsigned long)(roundTripUs / sampleCount) : 0UL, (unsigned long)percentile(50),
+           (unsigned long)percentile(99), (unsigned long)percentile(100));
+    printf("----------------------------\r\n\r\n");
+}
@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __METHOD_BENCHMARK_H__
+#define __METHOD_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+#include "loopback_broker.h"
+
+/*
+ * Times direct method calls from the moment a LoopbackBroker sends the
+ * request until it receives the response.
+ *
+ * Each request goes through the client, the inbound message pool and
+ * DirectMethods as in the sample, calling an echo handler, and the next one
+ * is sent once the response arrived. The service side of IoT Hub and the
+ * network are not part of the figures.
+ */
+class MethodBenchmark : public Benchmark {
+public:
+    /* Calls the echo method `calls` times through `broker`, with `budgetMs` as response budget. */
+    MethodBenchmark(uint32_t calls, uint32_t budgetMs, LoopbackBroker *broker);
+
+    virtual ~MethodBenchmark();
+
+    virtual const char *name() const { return "method benchmark"; }
+
+    /* Returns -1 if a call was not answered with 200, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    void handleResponse(LoopbackSocket *client, const char *topic);
+    /* The `p` percentile of the round trips of the last run(), 0 if there were none. */
+    uint32_t percentile(unsigned int p) const;
+
+    LoopbackBroker *broker;
+    uint32_t calls;
+    uint32_t budgetMs;
+    uint32_t answered;      // Responses with status 200.
+    uint32_t roundTripUs;   // Total, request sent until its response arrived.
+    uint32_t *samples;      // Round trip of each call in microseconds, sorted after run().
+    uint32_t sampleCount;
+    Timer timer;
+    bool isAnswered;
+};
+
+#endif /* __METHOD_BENCHMARK_H__ */
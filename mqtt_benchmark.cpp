@@ -0,0 +1,308 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include "mqtt_benchmark.h"
+#include "qos1_publisher.h"
+
+/*
+ * Longest wait for a message to come back before the benchmark gives up. A
+ * PUBACK is waited for as long as qos1-ack-timeout-ms and qos1-max-retries allow.
+ */
+#define MQTT_BENCHMARK_WAIT_MS  10000
+
+/* State of the one timed message, for the handlers, which get no context. */
+static volatile bool isDelivered;
+static volatile bool isAcked;
+static volatile bool isEchoed;
+static unsigned int echoSequence;
+
+static void handleDelivery(uint16_t packetId, bool acked)
+{
+    isAcked = acked;
+    isDelivered = true;
+}
+
+static void handleEcho(MQTT::MessageData &md)
+{
+    char head[12];
+    const size_t n = md.message.payloadlen < sizeof(head) - 1 ? md.message.payloadlen : sizeof(head) - 1;
+    memcpy(head, md.message.payload, n);
+    head[n] = '\0';
+    if (strtoul(head, NULL, 10) == echoSequence) {
+        isEchoed = true;
+    }
+}
+
+static int compareSample(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+MqttBenchmark::MqttBenchmark(MQTTClient *client, const char *topic, unsigned int count, size_t payloadSize)
+    : client(client), broker(NULL), topic(topic), count(count), tlsConnectUs(0), mqttConnectUs(0), sasSignUs(0),
+      qos1Publisher(NULL), isRoundTrip(false), samples(NULL), sampleCount(0), ackSamples(NULL), ackCount(0),
+      echoSamples(NULL), echoCount(0), totalUs(0), payloadSize(payloadSize)
+{
+}
+
+MqttBenchmark::MqttBenchmark(LoopbackBroker *broker, const char *topic, unsigned int count, size_t payloadSize)
+    : client(NULL), broker(broker), topic(topic), count(count), tlsConnectUs(0), mqttConnectUs(0), sasSignUs(0),
+      qos1Publisher(NULL), isRoundTrip(false), samples(NULL), sampleCount(0), ackSamples(NULL), ackCount(0),
+      echoSamples(NULL), echoCount(0), totalUs(0), payloadSize(payloadSize)
+{
+}
+
+MqttBenchmark::~MqttBenchmark()
+{
+    delete[] samples;
+    delete[] ackSamples;
+    delete[] echoSamples;
+}
+
+int MqttBenchmark::run()
+{
+    if (!broker) {
+        int rc = publishAll();
+        if (rc == MQTT::SUCCESS && qos1Publisher) {
+            rc = publishAcked();
+        }
+        if (rc == MQTT::SUCCESS && isRoundTrip) {
+            rc = publishEchoed();
+        }
+        return rc;
+    }
+
+    LoopbackSocket socket;
+    socket.connectBroker(broker);
+    client = new MQTTClient(&socket);
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = (char*)"benchmark";
+    data.cleansession = 1;
+    Timer timer;
+    timer.start();
+    int rc = client->connect(data);
+    mqttConnectUs = timer.read_us();
+    if (rc == MQTT::SUCCESS) {
+        rc = publishAll();
+        client->disconnect();
+    }
+    delete client;
+    client = NULL;
+    return rc;
+}
+
+void MqttBenchmark::stampSequence(char *buf, unsigned int sequence) const
+{
+    // Stamp the sequence number at the head so that the messages can be
+    // told apart on the service side.
+    int n = snprintf(buf, payloadSize + 1, "%u", sequence);
+    if (n > 0 && (size_t)n < payloadSize) {
+        buf[n] = ' ';
+    }
+}
+
+int MqttBenchmark::publishAll()
+{
+    const size_t size = payloadSize;
+    delete[] samples;
+    samples = new uint32_t[count];
+    sampleCount = 0;
+    totalUs = 0;
+
+    char *buf = new char[size + 1];
+    memset(buf, 'x', size);
+    buf[size] = '\0';
+
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.payload = (void*)buf;
+    message.payloadlen = size;
+
+    int rc = MQTT::SUCCESS;
+    Timer total;
+    Timer each;
+    total.start();
+    for (unsigned int i = 0; i < count; i++) {
+        stampSequence(buf, i);
+        message.id = i;
+
+        each.reset();
+        each.start();
+        rc = client->publish(topic, message);
+        each.stop();
+        if (rc != MQTT::SUCCESS) {
+            break;
+        }
+        samples[sampleCount++] = each.read_us();
+        // Keep the keepalive timer and inbound traffic serviced during long runs.
+        client->yield(1);
+    }
+    total.stop();
+    totalUs = total.read_us();
+
+    delete[] buf;
+    qsort(samples, sampleCount, sizeof(samples[0]), compareSample);
+    return rc;
+}
+
+int MqttBenchmark::publishAcked()
+{
+    delete[] ackSamples;
+    ackSamples = new uint32_t[count];
+    ackCount = 0;
+    qos1Publisher->onDelivery(handleDelivery);
+
+    char *buf = new char[payloadSize + 1];
+    memset(buf, 'x', payloadSize);
+    buf[payloadSize] = '\0';
+
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS1;
+    message.payload = (void*)buf;
+    message.payloadlen = payloadSize;
+
+    int rc = MQTT::SUCCESS;
+    Timer timer;
+    for (unsigned int i = 0; i < count && rc == MQTT::SUCCESS; i++) {
+        stampSequence(buf, i);
+        isDelivered = false;
+        timer.reset();
+        timer.start();
+        rc = qos1Publisher->publish(topic, message);
+        // Resends are part of the time, as they are for the sample.
+        while (rc == MQTT::SUCCESS && !isDelivered) {
+            rc = client->yield(1);
+            qos1Publisher->poll();
+        }
+        timer.stop();
+        if (rc == MQTT::SUCCESS && isAcked) {
+            ackSamples[ackCount++] = timer.read_us();
+        } else if (rc == MQTT::SUCCESS) {
+            rc = MQTT::FAILURE;
+        }
+    }
+
+    delete[] buf;
+    qsort(ackSamples, ackCount, sizeof(ackSamples[0]), compareSample);
+    return rc;
+}
+
+int MqttBenchmark::publishEchoed()
+{
+    delete[] echoSamples;
+    echoSamples = new uint32_t[count];
+    echoCount = 0;
+    int rc = client->subscribe(topic, MQTT::QOS0, handleEcho);
+    if (rc != MQTT::SUCCESS) {
+        return rc;
+    }
+
+    char *buf = new char[payloadSize + 1];
+    memset(buf, 'x', payloadSize);
+    buf[payloadSize] = '\0';
+
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.payload = (void*)buf;
+    message.payloadlen = payloadSize;
+
+    Timer timer;
+    for (unsigned int i = 0; i < count && rc == MQTT::SUCCESS; i++) {
+        stampSequence(buf, i);
+        message.id = i;
+        echoSequence = i;
+        isEchoed = false;
+        timer.reset();
+        timer.start();
+        rc = client->publish(topic, message);
+        while (rc == MQTT::SUCCESS && !isEchoed) {
+            rc = (timer.read_ms() < MQTT_BENCHMARK_WAIT_MS) ? client->yield(1) : MQTT::FAILURE;
+        }
+        timer.stop();
+        if (rc == MQTT::SUCCESS) {
+            echoSamples[echoCount++] = timer.read_us();
+        }
+    }
+    client->unsubscribe(topic);
+
+    delete[] buf;
+    qsort(echoSamples, echoCount, sizeof(echoSamples[0]), compareSample);
+    return rc;
+}
+
+uint32_t MqttBenchmark::percentile(const uint32_t *samples, unsigned int count, unsigned int p)
+{
+    if (count == 0) {
+        return 0;
+    }
+    unsigned int index = (count * p + 99) / 100;
+    return samples[index > 0 ? index - 1 : 0];
+}
+
+void MqttBenchmark::printPercentiles(const char *name, const uint32_t *samples, unsigned int count)
+{
+    if (count == 0) {
+        return;
+    }
+    char label[20];
+    snprintf(label, sizeof(label), "%s p50:", name);
+    printf("%-18s%lu us\r\n", label, (unsigned long)percentile(samples, count, 50));
+    snprintf(label, sizeof(label), "%s p99:", name);
+    printf("%-18s%lu us\r\n", label, (unsigned long)percentile(samples, count, 99));
+    snprintf(label, sizeof(label), "%s max:", name);
+    printf("%-18s%lu us\r\n", label, (unsigned long)samples[count - 1]);
+}
+
+void MqttBenchmark::print() const
+{
+    printf("\r\n----- MQTT benchmark -----\r\n");
+    if (broker) {
+        printf("Broker:           loopback, %lu publishes received\r\n", (unsigned long)broker->publishes());
+    } else {
+        printf("TLS connect:      %lu us\r\n", (unsigned long)tlsConnectUs);
+    }
+    printf("MQTT connect:     %lu us\r\n", (unsigned long)mqttConnectUs);
+    if (sasSignUs > 0) {
+        printf("SAS token sign:   %lu us\r\n", (unsigned long)sasSignUs);
+    }
+    printf("Messages:         %u x %u bytes\r\n", sampleCount, (unsigned int)payloadSize);
+    if (sampleCount > 0 && totalUs > 0) {
+        printf("Throughput:       %lu msg/s\r\n",
+               (unsigned long)((uint64_t)sampleCount * 1000000 / totalUs));
+        printPercentiles("Publish", samples, sampleCount);
+    }
+    if (qos1Publisher) {
+        printf("QoS1 messages:    %u acknowledged\r\n", ackCount);
+        printPercentiles("PUBACK", ackSamples, ackCount);
+    }
+    if (isRoundTrip) {
+        printf("Round trips:      %u\r\n", echoCount);
+        printPercentiles("Round trip", echoSamples, echoCount);
+    }
+    printf("--------------------------\r\n\r\n");
+}
@@ -0,0 +1,104 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __MQTT_BENCHMARK_H__
+#define __MQTT_BENCHMARK_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "benchmark.h"
+#include "loopback_broker.h"
+
+class Qos1Publisher;
+
+/*
+ * Publishes a burst of messages and reports throughput and per-publish
+ * latency, together with the connect timings.
+ *
+ * The sample runs it on its connection to IoT Hub, with the timings main()
+ * recorded while connecting. The benchmark app runs it against a
+ * LoopbackBroker, which shows the cost of the client and its packet path
+ * without the network. The host build runs it on a TLS connection to a
+ * local broker, which can also send the messages back for round trips.
+ */
+class MqttBenchmark : public Benchmark {
+public:
+    /* Publishes `count` QoS0 messages of `payloadSize` bytes back-to-back on `client`. */
+    MqttBenchmark(MQTTClient *client, const char *topic, unsigned int count, size_t payloadSize);
+
+    /* Connects a client of its own to `broker` in run() and times the CONNECT/CONNACK round trip. */
+    MqttBenchmark(LoopbackBroker *broker, const char *topic, unsigned int count, size_t payloadSize);
+
+    virtual ~MqttBenchmark();
+
+    /* Time of the TCP connect and the TLS handshake, without the DNS lookup. */
+    void setTlsConnectTime(uint32_t us) { tlsConnectUs = us; }
+    /* Time spent in MQTTClient::connect(), i.e. the CONNECT/CONNACK round trip. */
+    void setMqttConnectTime(uint32_t us) { mqttConnectUs = us; }
+    /* Time spent generating the SAS token, if it was generated on the device. */
+    void setSasSignTime(uint32_t us) { sasSignUs = us; }
+
+    /*
+     * Also times `count` QoS1 publishes through `publisher`, one at a time,
+     * from publish() until their PUBACK arrived. Replaces the delivery
+     * handler of `publisher`.
+     */
+    void setQos1Publisher(Qos1Publisher *publisher) { qos1Publisher = publisher; }
+
+    /*
+     * Also times `count` messages, one at a time, from publish() until the
+     * broker sent them back, by subscribing to the topic. IoT Hub does not
+     * allow that, a local broker does.
+     */
+    void setRoundTrip(bool isEnabled) { isRoundTrip = isEnabled; }
+
+    virtual const char *name() const { return "MQTT benchmark"; }
+
+    /* Returns MQTT::SUCCESS or the first failing return code of connect() or publish(). */
+    virtual int run();
+
+    virtual void print() const;
+
+private:
+    int publishAll();
+    int publishAcked();
+    int publishEchoed();
+    void stampSequence(char *buf, unsigned int sequence) const;
+    static uint32_t percentile(const uint32_t *samples, unsigned int count, unsigned int p);
+    static void printPercentiles(const char *name, const uint32_t *samples, unsigned int count);
+
+    MQTTClient *client;
+    LoopbackBroker *broker;     // NULL when publishing on a connection of main().
+    const char *topic;
+    unsigned int count;
+    uint32_t tlsConnectUs;
+    uint32_t mqttConnectUs;
+    uint32_t sasSignUs;
+    Qos1Publisher *qos1Publisher;
+    bool isRoundTrip;
+    uint32_t *samples;      // Latency of each publish in microseconds, sorted after run().
+    unsigned int sampleCount;
+    uint32_t *ackSamples;   // Of each QoS1 publish until its PUBACK, sorted after run().
+    unsigned int ackCount;
+    uint32_t *echoSamples;  // Of each round trip, sorted after run().
+    unsigned int echoCount;
+    uint32_t totalUs;
+    size_t payloadSize;
+};
+
+#endif /* __MQTT_BENCHMARK_H__ */
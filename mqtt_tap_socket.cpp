@@ -0,0 +1,211 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "mqtt_tap_socket.h"
+
+/* Control packet type in the upper nibble of the fixed header. */
+#define MQTT_PACKET_TYPE_CONNECT    1
+#define MQTT_PACKET_TYPE_PUBACK     4
+#define MQTT_PACKET_TYPE_SUBACK     9
+
+MqttTapSocket::MqttTapSocket()
+    : transport(this), tls(&transport, NULL, TLSSocketWrapper::TRANSPORT_CLOSE), sessionCache(NULL),
+      sessionOffered(false), sessionResumed(false), afterConnect(NULL), afterConnectLength(0),
+      isAfterConnectSent(false)
+{
+    resetParser();
+}
+
+MqttTapSocket::~MqttTapSocket()
+{
+    close();
+}
+
+nsapi_error_t MqttTapSocket::open(NetworkInterface *net)
+{
+    return transport.open(net);
+}
+
+nsapi_error_t MqttTapSocket::connectTransport(const SocketAddress &address)
+{
+    nsapi_error_t ret = transport.connect(address);
+    return (ret == NSAPI_ERROR_IS_CONNECTED) ? NSAPI_ERROR_OK : ret;
+}
+
+nsapi_error_t MqttTapSocket::handshake(const char *host)
+{
+    tls.set_hostname(host);
+
+    // The wrapper does not connect the transport itself (TRANSPORT_CLOSE),
+    // so the address is ignored and this only runs the handshake.
+    sessionOffered = false;
+    sessionResumed = false;
+    nsapi_error_t ret = tls.connect(SocketAddress());
+    if (ret == NSAPI_ERROR_OK && sessionCache) {
+        sessionResumed = sessionOffered && sessionCache->wasResumed(tls.get_ssl_context());
+        sessionCache->save(tls.get_ssl_context());
+    }
+    return ret;
+}
+
+void MqttTapSocket::applySession()
+{
+    mbedtls_ssl_context *ssl = tls.get_ssl_context();
+    // Only once per handshake, and only after mbedtls_ssl_setup().
+    if (sessionCache && !sessionOffered && ssl->conf != NULL) {
+        sessionOffered = sessionCache->apply(ssl);
+    }
+}
+
+void MqttTapSocket::Transport::set_blocking(bool blocking)
+{
+    if (!blocking) {
+        owner->applySession();
+    }
+    TCPSocket::set_blocking(blocking);
+}
+
+nsapi_size_or_error_t MqttTapSocket::send(const void *data, nsapi_size_t size)
+{
+    nsapi_size_or_error_t rc = tls.send(data, size);
+    // Only behind a CONNECT sent in one piece, so the packets cannot split it.
+    if (afterConnectLength > 0 && rc == (nsapi_size_or_error_t)size
+            && (((const uint8_t*)data)[0] >> 4) == MQTT_PACKET_TYPE_CONNECT) {
+        const uint8_t *packets = afterConnect;
+        size_t length = afterConnectLength;
+        afterConnect = NULL;
+        afterConnectLength = 0;
+        while (length > 0) {
+            nsapi_size_or_error_t sent = tls.send(packets, length);
+            if (sent < 0) {
+                return sent;
+            }
+            packets += sent;
+            length -= sent;
+        }
+        isAfterConnectSent = true;
+    }
+    return rc;
+}
+
+void MqttTapSocket::set_blocking(bool blocking)
+{
+    tls.set_blocking(blocking);
+}
+
+void MqttTapSocket::set_timeout(int timeout)
+{
+    tls.set_timeout(timeout);
+}
+
+void MqttTapSocket::sigio(mbed::Callback<void()> func)
+{
+    tls.sigio(func);
+}
+
+nsapi_error_t MqttTapSocket::close()
+{
+    return tls.close();
+}
+
+void MqttTapSocket::resetParser()
+{
+    state = STATE_HEADER;
+    packetType = 0;
+    remaining = 0;
+    multiplier = 1;
+    packetId = 0;
+    returnCode = 0;
+    bodyOffset = 0;
+}
+
+nsapi_size_or_error_t MqttTapSocket::recv(void *data, nsapi_size_t size)
+{
+    nsapi_size_or_error_t rc = tls.recv(data, size);
+    if (rc > 0) {
+        parse((const uint8_t*)data, rc);
+    }
+    return rc;
+}
+
+void MqttTapSocket::parse(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t b = data[i];
+        switch (state) {
+            case STATE_HEADER:
+                packetType = b >> 4;
+                remaining = 0;
+                multiplier = 1;
+                state = STATE_LENGTH;
+                break;
+            case STATE_LENGTH:
+                remaining += (b & 0x7F) * multiplier;
+                multiplier *= 128;
+                if ((b & 0x80) == 0) {
+                    bodyOffset = 0;
+                    packetId = 0;
+                    returnCode = 0;
+                    state = (remaining > 0) ? STATE_BODY : STATE_HEADER;
+                }
+                break;
+            case STATE_BODY: {
+                // Skip whatever part of the body is in this chunk in one go.
+                size_t n = length - i;
+                if (n > remaining) {
+                    n = remaining;
+                }
+                if (packetType == MQTT_PACKET_TYPE_PUBACK || packetType == MQTT_PACKET_TYPE_SUBACK) {
+                    for (size_t j = 0; j < n && bodyOffset + j < 3; j++) {
+                        if (bodyOffset + j < 2) {
+                            packetId = (packetId << 8) | data[i + j];
+                        } else {
+                            returnCode = data[i + j];
+                        }
+                    }
+                }
+                bodyOffset += n;
+                remaining -= n;
+                i += n - 1;
+                if (remaining == 0) {
+                    if (packetType == MQTT_PACKET_TYPE_PUBACK && bodyOffset >= 2 && pubackHandler) {
+                        pubackHandler(packetId);
+                    } else if (packetType == MQTT_PACKET_TYPE_SUBACK && bodyOffset >= 3 && subackHandler) {
+                        subackHandler(packetId, returnCode);
+                    }
+                    state = STATE_HEADER;
+                }
+                break;
+            }
+        }
+    }
+}
+
+nsapi_error_t MqttTapSocket::sendPacket(const uint8_t *packet, size_t length, int timeout)
+{
+    set_timeout(timeout);
+    while (length > 0) {
+        nsapi_size_or_error_t rc = send(packet, length);
+        if (rc < 0) {
+            return rc;
+        }
+        packet += rc;
+        length -= rc;
+    }
+    return NSAPI_ERROR_OK;
+}
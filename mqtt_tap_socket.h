@@ -0,0 +1,156 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __MQTT_TAP_SOCKET_H__
+#define __MQTT_TAP_SOCKET_H__
+
+#include "mbed.h"
+#include "TLSSocketWrapper.h"
+#include "tls_session_cache.h"
+
+/*
+ * TLS socket to the MQTT broker, used in place of TLSSocket.
+ *
+ * It follows the MQTT packet framing of the decrypted inbound stream while
+ * MQTTClient reads it, and reports the packet id of every PUBACK. The stock
+ * client discards PUBACKs it is not waiting for, which would otherwise make
+ * pipelined QoS1 publishing impossible.
+ *
+ * It can send packets right behind the CONNECT, before the CONNACK arrives,
+ * e.g. the SUBSCRIBEs of the session, and reports every SUBACK.
+ *
+ * It also offers the session kept in a TlsSessionCache in the handshake so
+ * that a reconnect can skip the full key exchange. TLSSocketWrapper has no
+ * hook between mbedtls_ssl_setup() and the first handshake message, but it
+ * switches the transport to non-blocking mode right there, so the transport
+ * applies the session from set_blocking().
+ *
+ * MQTTClient only takes a TCPSocket or a TLSSocket, neither of which lets the
+ * transport be replaced, so this class derives from TCPSocket and routes all
+ * I/O through its own TLSSocketWrapper. The inherited socket is never opened.
+ */
+class MqttTapSocket : public TCPSocket {
+public:
+    MqttTapSocket();
+    virtual ~MqttTapSocket();
+
+    nsapi_error_t open(NetworkInterface *net);
+
+    nsapi_error_t set_root_ca_cert(const char *root_ca_pem) { return tls.set_root_ca_cert(root_ca_pem); }
+    nsapi_error_t set_client_cert_key(const char *client_cert_pem, const char *client_private_key_pem)
+    {
+        return tls.set_client_cert_key(client_cert_pem, client_private_key_pem);
+    }
+    /* Uses already parsed certificates and key, which must outlive the socket. */
+    void set_ca_chain(mbedtls_x509_crt *crt) { tls.set_ca_chain(crt); }
+    nsapi_error_t set_own_cert_key(mbedtls_x509_crt *crt, mbedtls_pk_context *key)
+    {
+        return mbedtls_ssl_conf_own_cert(tls.get_ssl_config(), crt, key) == 0 ? NSAPI_ERROR_OK : NSAPI_ERROR_PARAMETER;
+    }
+
+    /* Connects the transport to the broker at the already resolved `address`. */
+    nsapi_error_t connectTransport(const SocketAddress &address);
+
+    /* Runs the TLS handshake with `host` over the connected transport. */
+    nsapi_error_t handshake(const char *host);
+
+    /* Resumes the session in `cache` if there is one, and saves the new one after the handshake. */
+    void setSessionCache(TlsSessionCache *cache) { sessionCache = cache; }
+    /* True if the last handshake resumed the cached session. */
+    bool isSessionResumed() const { return sessionResumed; }
+
+    mbedtls_ssl_context *get_ssl_context() const { return tls.get_ssl_context(); }
+    mbedtls_ssl_config *get_ssl_config() const { return tls.get_ssl_config(); }
+
+    /* Called with the packet id of every PUBACK read from the socket. */
+    void setPubackHandler(Callback<void(uint16_t)> handler) { pubackHandler = handler; }
+
+    /* Called with the packet id and the first return code of every SUBACK read from the socket. */
+    void setSubackHandler(Callback<void(uint16_t, uint8_t)> handler) { subackHandler = handler; }
+
+    /*
+     * Sends `length` bytes of serialized packets right after the next
+     * CONNECT, without waiting for the CONNACK. `packets` must stay valid
+     * until then.
+     */
+    void sendAfterConnect(const uint8_t *packets, size_t length)
+    {
+        afterConnect = packets;
+        afterConnectLength = length;
+        isAfterConnectSent = false;
+    }
+    /* True if the packets given to sendAfterConnect() went out behind the CONNECT. */
+    bool afterConnectSent() const { return isAfterConnectSent; }
+
+    /*
+     * Writes a complete, already serialized MQTT packet, waiting up to
+     * `timeout` ms for the transport. Returns NSAPI_ERROR_OK or the error of
+     * the failing send().
+     */
+    nsapi_error_t sendPacket(const uint8_t *packet, size_t length, int timeout);
+
+    /* Forgets a partially parsed packet, e.g. after reconnecting. */
+    void resetParser();
+
+    virtual nsapi_size_or_error_t send(const void *data, nsapi_size_t size);
+    virtual nsapi_size_or_error_t recv(void *data, nsapi_size_t size);
+    virtual void set_blocking(bool blocking);
+    virtual void set_timeout(int timeout);
+    virtual void sigio(mbed::Callback<void()> func);
+    virtual nsapi_error_t close();
+
+private:
+    class Transport : public TCPSocket {
+    public:
+        Transport(MqttTapSocket *owner) : owner(owner) {}
+        virtual void set_blocking(bool blocking);
+    private:
+        MqttTapSocket *owner;
+    };
+
+    enum ParserState {
+        STATE_HEADER,
+        STATE_LENGTH,
+        STATE_BODY,
+    };
+
+    void applySession();
+    void parse(const uint8_t *data, size_t length);
+
+    Transport transport;
+    TLSSocketWrapper tls;
+    TlsSessionCache *sessionCache;
+    bool sessionOffered;
+    bool sessionResumed;
+
+    Callback<void(uint16_t)> pubackHandler;
+    Callback<void(uint16_t, uint8_t)> subackHandler;
+    const uint8_t *afterConnect;
+    size_t afterConnectLength;
+    bool isAfterConnectSent;
+
+    ParserState state;
+    uint8_t packetType;
+    uint32_t remaining;     // Body bytes left in the current packet.
+    uint32_t multiplier;    // Weight of the next remaining length byte.
+    uint16_t packetId;      // PUBACK or SUBACK variable header being collected.
+    uint8_t returnCode;     // First return code of a SUBACK.
+    uint32_t bodyOffset;
+};
+
+#endif /* __MQTT_TAP_SOCKET_H__ */
@@ -0,0 +1,171 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "outbox_benchmark.h"
+#include "HeapBlockDevice.h"
+#include "telemetry_outbox.h"
+#include "telemetry_batcher.h"
+
+/* Geometry of a SPI NOR flash: byte programmable, 4 KiB sectors. */
+#define OUTBOX_BENCHMARK_PROGRAM_SIZE   1
+#define OUTBOX_BENCHMARK_ERASE_SIZE     4096
+#define OUTBOX_BENCHMARK_DEVICE_SIZE    (8 * OUTBOX_BENCHMARK_ERASE_SIZE)
+
+/* Topic of the replayed batches, and their payload buffer as in main.cpp. */
+#define OUTBOX_BENCHMARK_TOPIC          "devices/benchmark/messages/events/"
+#define OUTBOX_BENCHMARK_BATCH_SIZE     (1024 - 5 - 2 - (sizeof(OUTBOX_BENCHMARK_TOPIC) - 1) - 2)
+
+/* Records per second from a record count and microseconds. */
+static unsigned long rate(uint32_t count, uint32_t us)
+{
+    return us ? (unsigned long)((uint64_t)count * 1000000 / us) : 0;
+}
+
+OutboxBenchmark::OutboxBenchmark(uint32_t records, LoopbackBroker *broker)
+    : broker(broker), records(records), appendUs(0), replayUs(0), replayed(0), publishes(0), recoverUs(0),
+      writeAmplificationX100(0)
+{
+}
+
+int OutboxBenchmark::run()
+{
+    HeapBlockDevice device(OUTBOX_BENCHMARK_DEVICE_SIZE, 1, OUTBOX_BENCHMARK_PROGRAM_SIZE,
+                           OUTBOX_BENCHMARK_ERASE_SIZE);
+    TelemetryOutbox outbox(&device);
+    int ret = outbox.init();
+    if (ret != 0) {
+        return ret;
+    }
+
+    Timer timer;
+    timer.start();
+    TelemetryRecord record;
+    record.timestamp = 0;
+    record.source = TELEMETRY_SOURCE_BUTTON;
+    for (uint32_t i = 0; ret == 0 && i < records; i++) {
+        record.sequence = i;
+        record.value = (int32_t)i;
+        ret = outbox.append(record);
+    }
+    timer.stop();
+    appendUs = timer.read_us();
+    if (ret != 0) {
+        return ret;
+    }
+
+    LoopbackSocket socket;
+    socket.connectBroker(broker);
+    MQTTClient *client = new MQTTClient(&socket);
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = (char*)"benchmark";
+    data.cleansession = 1;
+    if (client->connect(data) != MQTT::SUCCESS) {
+        delete client;
+        return -1;
+    }
+    const uint32_t publishesBefore = broker->publishes();
+    timer.reset();
+    timer.start();
+    ret = replay(outbox, client);
+    timer.stop();
+    replayUs = timer.read_us();
+    publishes = broker->publishes() - publishesBefore;
+    client->disconnect();
+    delete client;
+    writeAmplificationX100 = outbox.writeAmplificationX100();
+    outbox.printStats();
+    if (ret != 0) {
+        return ret;
+    }
+
+    // Recover from the device contents as after a reset.
+    TelemetryOutbox recovered(&device);
+    timer.reset();
+    timer.start();
+    ret = recovered.init();
+    timer.stop();
+    recoverUs = timer.read_us();
+    if (ret == 0 && !recovered.empty()) {
+        printf("ERROR: recovered outbox has %lu records pending, expected none.\r\n",
+               (unsigned long)recovered.pending());
+        ret = -1;
+    }
+    return ret;
+}
+
+/*
+ * Replays every record of `outbox` through a batcher on `client`,
+ * acknowledging the records of each batch once it was published. Returns 0,
+ * a BlockDevice or MQTT error code, or -1 if a record came back wrong.
+ */
+int OutboxBenchmark::replay(TelemetryOutbox &outbox, MQTTClient *client)
+{
+    char *buffer = new char[OUTBOX_BENCHMARK_BATCH_SIZE];
+    TelemetryBatcher batcher(client, OUTBOX_BENCHMARK_TOPIC, buffer, OUTBOX_BENCHMARK_BATCH_SIZE,
+                             TELEMETRY_BATCH_FORMAT_BINARY, 0xFFFFFFFF);
+
+    // Records overwritten because the ring was full come back first as the
+    // oldest ones left, so only check that sequence numbers increase.
+    replayed = 0;
+    uint32_t lastSequence = 0;
+    int ret = 0;
+    TelemetryRecord record;
+    while (ret == 0 && outbox.readNext(record)) {
+        if (replayed > 0 && record.sequence <= lastSequence) {
+            ret = -1;
+            break;
+        }
+        lastSequence = record.sequence;
+        replayed++;
+        if (!batcher.fits(record)) {
+            // The records before this one are in the published batch.
+            ret = batcher.flush();
+            if (ret == 0) {
+                ret = outbox.acknowledge(outbox.lastReadId() - 1);
+            }
+        }
+        if (ret == 0) {
+            ret = batcher.add(record);
+        }
+    }
+    if (ret == 0) {
+        ret = batcher.flush();
+    }
+    if (ret == 0) {
+        ret = outbox.acknowledge();
+    }
+    delete[] buffer;
+    if (ret == 0 && records > 0 && lastSequence != records - 1) {
+        ret = -1;
+    }
+    return ret;
+}
+
+void OutboxBenchmark::print() const
+{
+    printf("\r\n----- Outbox benchmark -----\r\n");
+    printf("Records:            %lu\r\n", (unsigned long)records);
+    printf("Append:             %lu records/s\r\n", rate(records, appendUs));
+    printf("Replay:             %lu records/s (%lu replayed in %lu publishes)\r\n", rate(replayed, replayUs),
+           (unsigned long)replayed, (unsigned long)publishes);
+    printf("Write amplification: %lu.%02lu\r\n",
+           (unsigned long)(writeAmplificationX100 / 100), (unsigned long)(writeAmplificationX100 % 100));
+    printf("Recovery:           %lu us\r\n", (unsigned long)recoverUs);
+    printf("----------------------------\r\n\r\n");
+}
@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __OUTBOX_BENCHMARK_H__
+#define __OUTBOX_BENCHMARK_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "benchmark.h"
+#include "loopback_broker.h"
+#include "telemetry_outbox.h"
+
+/*
+ * Measures the telemetry outbox on a HeapBlockDevice, so it runs on any
+ * board without wearing its flash: append throughput, replay rate, write
+ * amplification, and recovery of the outbox from the device contents as
+ * after a reset. The figures exclude the flash itself, they show the cost
+ * of the outbox format and bookkeeping.
+ *
+ * Records are replayed as the sample does after reconnecting: batched by a
+ * TelemetryBatcher, published to a LoopbackBroker and acknowledged once
+ * their batch was published.
+ */
+class OutboxBenchmark : public Benchmark {
+public:
+    /*
+     * Appends `records` records to a fresh outbox, replays and acknowledges
+     * them, and checks that a second outbox recovered from the same device
+     * sees none pending. Replayed batches go to `broker`.
+     */
+    OutboxBenchmark(uint32_t records, LoopbackBroker *broker);
+
+    virtual const char *name() const { return "outbox benchmark"; }
+
+    /* Returns 0, a BlockDevice error code, or -1 if a record came back wrong. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    int replay(TelemetryOutbox &outbox, MQTTClient *client);
+
+    LoopbackBroker *broker;
+    uint32_t records;
+    uint32_t appendUs;
+    uint32_t replayUs;
+    uint32_t replayed;
+    uint32_t publishes;
+    uint32_t recoverUs;
+    uint32_t writeAmplificationX100;
+};
+
+#endif /* __OUTBOX_BENCHMARK_H__ */
@@ -0,0 +1,117 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "phase_profiler.h"
+
+/* Upper bound of threads looked through for the caller's stack statistics. */
+#define PHASE_PROFILER_MAX_THREADS  8
+
+static const char *const phaseNames[PHASE_COUNT] = {
+    "network_connect",
+    "ntp_sync",
+    "socket_open",
+    "ca_load",
+    "dns_lookup",
+    "tcp_connect",
+    "time_wait",
+    "tls_handshake",
+    "mqtt_connect",
+    "subscribe",
+    "publish",
+};
+
+/* Stack high-water mark of the calling thread in bytes, 0 if stack statistics are disabled. */
+static uint32_t currentThreadStackPeak()
+{
+    mbed_stats_stack_t stats[PHASE_PROFILER_MAX_THREADS];
+    const size_t count = mbed_stats_stack_get_each(stats, PHASE_PROFILER_MAX_THREADS);
+    const uint32_t self = (uint32_t)(uintptr_t)ThisThread::get_id();
+    for (size_t i = 0; i < count; i++) {
+        if (stats[i].thread_id == self) {
+            return stats[i].max_size;
+        }
+    }
+    return 0;
+}
+
+PhaseProfiler::PhaseProfiler()
+{
+    memset(records, 0, sizeof(records));
+}
+
+void PhaseProfiler::begin(Phase phase)
+{
+    records[phase].startUs = us_ticker_read();
+}
+
+void PhaseProfiler::end(Phase phase)
+{
+    Record &r = records[phase];
+    const uint32_t elapsed = us_ticker_read() - r.startUs;
+    if (r.runs == 0) {
+        r.firstStartUs = r.startUs;
+        r.firstEndUs = r.startUs + elapsed;
+    }
+    r.runs++;
+    r.totalUs += elapsed;
+    if (elapsed > r.maxUs) {
+        r.maxUs = elapsed;
+    }
+
+    mbed_stats_heap_t heap;
+    mbed_stats_heap_get(&heap);
+    r.heapCurrent = heap.current_size;
+    r.heapPeak = heap.max_size;
+    const uint32_t stack = currentThreadStackPeak();
+    if (stack > r.stackPeak) {
+        r.stackPeak = stack;
+    }
+}
+
+void PhaseProfiler::printReport() const
+{
+    printf("PHASE_REPORT {\"phases\":[");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Record &r = records[i];
+        printf("%s{\"name\":\"%s\",\"runs\":%lu,\"total_us\":%lu,\"max_us\":%lu,"
+               "\"heap_current\":%lu,\"heap_peak\":%lu,\"stack_peak\":%lu}",
+               (i == 0) ? "" : ",", phaseNames[i], (unsigned long)r.runs, (unsigned long)r.totalUs,
+               (unsigned long)r.maxUs, (unsigned long)r.heapCurrent, (unsigned long)r.heapPeak,
+               (unsigned long)r.stackPeak);
+    }
+    printf("]}\r\n");
+}
+
+void PhaseProfiler::printTimeline() const
+{
+    printf("\r\n----- Startup timeline -----\r\n");
+    printf("Phase              start ms    end ms\r\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Record &r = records[i];
+        if (r.runs > 0 && i != PHASE_PUBLISH) {
+            printf("%-16s %10lu %9lu\r\n", phaseNames[i], (unsigned long)(r.firstStartUs / 1000),
+                   (unsigned long)(r.firstEndUs / 1000));
+        }
+    }
+    if (records[PHASE_PUBLISH].runs > 0) {
+        printf("First publish:   %10lu ms after boot\r\n", (unsigned long)(records[PHASE_PUBLISH].firstEndUs / 1000));
+    } else {
+        printf("First publish:   not yet\r\n");
+    }
+    printf("----------------------------\r\n\r\n");
+}
@@ -0,0 +1,91 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __PHASE_PROFILER_H__
+#define __PHASE_PROFILER_H__
+
+#include "mbed.h"
+
+/* Phases of main() recorded by PhaseProfiler, in report order. */
+enum Phase {
+    PHASE_NETWORK_CONNECT,
+    PHASE_NTP_SYNC,
+    PHASE_SOCKET_OPEN,
+    PHASE_CA_LOAD,
+    PHASE_DNS_LOOKUP,
+    PHASE_TCP_CONNECT,
+    PHASE_TIME_WAIT,        // Waiting for NTP before the TLS handshake.
+    PHASE_TLS_HANDSHAKE,
+    PHASE_MQTT_CONNECT,
+    PHASE_SUBSCRIBE,
+    PHASE_PUBLISH,
+    PHASE_COUNT
+};
+
+/*
+ * Records elapsed time, heap usage and the stack high-water mark of the
+ * calling thread for each phase of main().
+ *
+ * A phase may run several times, e.g. once per reconnect or once per
+ * PUBLISH. Its time is then summed and the largest single run is kept as
+ * well. Heap and stack figures are sampled when the phase ends. mbed OS
+ * only tracks peaks since boot, so a phase's peak includes every phase
+ * before it; the first phase whose peak is higher than the previous one's
+ * is the one that raised it.
+ *
+ * printReport() writes everything as a single line of JSON prefixed with
+ * PHASE_REPORT, so it can be picked out of the console log by a script.
+ *
+ * The first run of each phase is also kept as a timeline, in microseconds
+ * since boot, since startup phases may overlap, e.g. NTP runs on its own
+ * thread. begin() and end() of different phases may be called from
+ * different threads.
+ */
+class PhaseProfiler {
+public:
+    PhaseProfiler();
+
+    void begin(Phase phase);
+    void end(Phase phase);
+
+    void printReport() const;
+
+    /* Prints when the first run of each phase started and ended, and the time to the first publish. */
+    void printTimeline() const;
+
+    uint32_t runs(Phase phase) const { return records[phase].runs; }
+    /* us_ticker_read() at the end of the first run of `phase`. */
+    uint32_t firstEndUs(Phase phase) const { return records[phase].firstEndUs; }
+
+private:
+    struct Record {
+        uint32_t runs;
+        uint64_t totalUs;
+        uint32_t maxUs;
+        uint32_t startUs;
+        uint32_t firstStartUs;
+        uint32_t firstEndUs;
+        uint32_t heapCurrent;
+        uint32_t heapPeak;
+        uint32_t stackPeak;
+    };
+
+    Record records[PHASE_COUNT];
+};
+
+#endif /* __PHASE_PROFILER_H__ */
@@ -0,0 +1,203 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "qos1_publisher.h"
+
+/* DUP flag in the fixed header of a PUBLISH. */
+#define MQTT_PUBLISH_DUP    0x08
+
+Qos1Publisher::Qos1Publisher(uint32_t ackTimeoutMs, unsigned int maxRetries)
+    : client(NULL), socket(NULL), ackTimeoutMs(ackTimeoutMs), maxRetries(maxRetries),
+      lastPacketId(0), inFlightCount(0), publishedCount(0), ackedCount(0), retransmitCount(0),
+      failedCount(0), unknownAckCount(0), maxInFlight(0)
+{
+    for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+        slots[i].used = false;
+    }
+}
+
+void Qos1Publisher::attach(MQTTClient *client, MqttTapSocket *socket)
+{
+    this->client = client;
+    this->socket = socket;
+    if (socket) {
+        socket->setPubackHandler(callback(this, &Qos1Publisher::handlePuback));
+    }
+}
+
+Qos1Publisher::Slot *Qos1Publisher::freeSlot()
+{
+    for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+        if (!slots[i].used) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+uint16_t Qos1Publisher::nextPacketId()
+{
+    // Skip 0, which is not a valid packet id, and ids still in flight.
+    for (;;) {
+        if (++lastPacketId == 0) {
+            lastPacketId = 1;
+        }
+        bool inUse = false;
+        for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+            if (slots[i].used && slots[i].packetId == lastPacketId) {
+                inUse = true;
+                break;
+            }
+        }
+        if (!inUse) {
+            return lastPacketId;
+        }
+    }
+}
+
+int Qos1Publisher::send(Slot &slot)
+{
+    slot.sentMs = Kernel::get_ms_count();
+    if (socket == NULL || socket->sendPacket(slot.packet, slot.length, ackTimeoutMs) != NSAPI_ERROR_OK) {
+        return MQTT::FAILURE;
+    }
+    return MQTT::SUCCESS;
+}
+
+int Qos1Publisher::publish(const char *topic, MQTT::Message &message)
+{
+    Slot *slot = freeSlot();
+    if (slot == NULL) {
+        // Window is full. Read PUBACKs until one frees a slot.
+        const uint64_t start = Kernel::get_ms_count();
+        while ((slot = freeSlot()) == NULL) {
+            if (Kernel::get_ms_count() - start >= ackTimeoutMs) {
+                return MQTT::FAILURE;
+            }
+            if (client == NULL || client->yield(10) != MQTT::SUCCESS) {
+                return MQTT::FAILURE;
+            }
+            poll();
+        }
+    }
+
+    MQTTString topicString = MQTTString_initializer;
+    topicString.cstring = (char*)topic;
+    const uint16_t packetId = nextPacketId();
+    int len = MQTTSerialize_publish(slot->packet, sizeof(slot->packet), 0, MQTT::QOS1, message.retained,
+                                    packetId, topicString, (unsigned char*)message.payload, message.payloadlen);
+    if (len <= 0) {
+        return MQTT::BUFFER_OVERFLOW;
+    }
+    slot->used = true;
+    slot->packetId = packetId;
+    slot->retries = 0;
+    slot->length = len;
+    message.id = packetId;
+    if (++inFlightCount > maxInFlight) {
+        maxInFlight = inFlightCount;
+    }
+    publishedCount++;
+
+    // The packet belongs to the window now. A failed write is resent by
+    // poll() or retransmitAll(), so it must not count as a failed publish,
+    // or the caller would publish the same records again.
+    send(*slot);
+    return MQTT::SUCCESS;
+}
+
+void Qos1Publisher::handlePuback(uint16_t packetId)
+{
+    for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+        if (slots[i].used && slots[i].packetId == packetId) {
+            slots[i].used = false;
+            inFlightCount--;
+            ackedCount++;
+            if (deliveryHandler) {
+                deliveryHandler(packetId, true);
+            }
+            return;
+        }
+    }
+    unknownAckCount++;
+}
+
+unsigned int Qos1Publisher::poll()
+{
+    const uint64_t now = Kernel::get_ms_count();
+    for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+        Slot &slot = slots[i];
+        if (!slot.used || now - slot.sentMs < ackTimeoutMs) {
+            continue;
+        }
+        if (slot.retries >= maxRetries) {
+            printf("ERROR: no PUBACK for packet %u, giving up.\r\n", slot.packetId);
+            slot.used = false;
+            inFlightCount--;
+            failedCount++;
+            if (deliveryHandler) {
+                deliveryHandler(slot.packetId, false);
+            }
+            continue;
+        }
+        slot.retries++;
+        slot.packet[0] |= MQTT_PUBLISH_DUP;
+        retransmitCount++;
+        send(slot);
+    }
+    return inFlightCount;
+}
+
+void Qos1Publisher::retransmitAll()
+{
+    for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+        Slot &slot = slots[i];
+        if (slot.used) {
+            slot.packet[0] |= MQTT_PUBLISH_DUP;
+            retransmitCount++;
+            send(slot);
+        }
+    }
+}
+
+uint32_t Qos1Publisher::nextTimeoutMs() const
+{
+    const uint64_t now = Kernel::get_ms_count();
+    uint32_t next = 0;
+    for (size_t i = 0; i < MBED_CONF_APP_QOS1_WINDOW; i++) {
+        if (!slots[i].used) {
+            continue;
+        }
+        const uint64_t age = now - slots[i].sentMs;
+        const uint32_t left = (age >= ackTimeoutMs) ? 1 : (uint32_t)(ackTimeoutMs - age);
+        if (next == 0 || left < next) {
+            next = left;
+        }
+    }
+    return next;
+}
+
+void Qos1Publisher::printStats() const
+{
+    printf("QoS1: %lu published, %lu acked, %lu retransmitted, %lu failed, %u in flight (max %u of %u)\r\n",
+           (unsigned long)publishedCount, (unsigned long)ackedCount, (unsigned long)retransmitCount,
+           (unsigned long)failedCount, inFlightCount, maxInFlight, (unsigned int)MBED_CONF_APP_QOS1_WINDOW);
+    if (unknownAckCount > 0) {
+        printf("QoS1: %lu PUBACKs for unknown packet ids\r\n", (unsigned long)unknownAckCount);
+    }
+}
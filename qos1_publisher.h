@@ -0,0 +1,106 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __QOS1_PUBLISHER_H__
+#define __QOS1_PUBLISHER_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "mqtt_tap_socket.h"
+
+/*
+ * Publishes at QoS1 with up to qos1-window PUBLISH packets waiting for
+ * their PUBACK at the same time.
+ *
+ * publish() serializes the packet into a free window slot, writes it to the
+ * socket and returns without waiting for the PUBACK. PUBACKs are matched by
+ * packet id in any order as MqttTapSocket sees them go by. poll() resends
+ * packets, with the DUP flag set, whose PUBACK did not arrive in time and
+ * gives up after `maxRetries` resends. The window survives a reconnect.
+ */
+class Qos1Publisher {
+public:
+    Qos1Publisher(uint32_t ackTimeoutMs, unsigned int maxRetries);
+
+    /*
+     * Sends through `client` and `socket` of a new connection from now on.
+     * Packets in flight are kept, call retransmitAll() to resend them.
+     */
+    void attach(MQTTClient *client, MqttTapSocket *socket);
+
+    /*
+     * Sends a QoS1 PUBLISH. If the window is full, services the client until
+     * a PUBACK frees a slot, for up to the ack timeout. Returns MQTT::SUCCESS
+     * once the packet is in the window, even if writing it failed, since it
+     * is resent from there. Returns MQTT::BUFFER_OVERFLOW if the packet does
+     * not fit into a slot, or MQTT::FAILURE if no slot became free.
+     */
+    int publish(const char *topic, MQTT::Message &message);
+
+    /*
+     * Calls `handler` with the packet id of every PUBLISH that got its PUBACK,
+     * or with `isAcked` false when it was given up after `maxRetries` resends.
+     */
+    void onDelivery(Callback<void(uint16_t packetId, bool isAcked)> handler) { deliveryHandler = handler; }
+
+    /* Resends expired packets. Returns the number of packets still in flight. */
+    unsigned int poll();
+
+    /* Resends every packet in flight, e.g. after the connection was re-established. */
+    void retransmitAll();
+
+    unsigned int inFlight() const { return inFlightCount; }
+    /* Time until the oldest packet in flight expires, 0 if none is in flight. */
+    uint32_t nextTimeoutMs() const;
+
+    void printStats() const;
+
+private:
+    struct Slot {
+        bool used;
+        uint16_t packetId;
+        uint8_t retries;
+        uint64_t sentMs;
+        uint16_t length;
+        uint8_t packet[MBED_CONF_APP_QOS1_SLOT_SIZE];
+    };
+
+    void handlePuback(uint16_t packetId);
+    Slot *freeSlot();
+    uint16_t nextPacketId();
+    int send(Slot &slot);
+
+    MQTTClient *client;
+    MqttTapSocket *socket;
+    Callback<void(uint16_t, bool)> deliveryHandler;
+    uint32_t ackTimeoutMs;
+    unsigned int maxRetries;
+    uint16_t lastPacketId;
+    unsigned int inFlightCount;
+    Slot slots[MBED_CONF_APP_QOS1_WINDOW];
+
+    // Statistics
+    uint32_t publishedCount;
+    uint32_t ackedCount;
+    uint32_t retransmitCount;
+    uint32_t failedCount;
+    uint32_t unknownAckCount;
+    unsigned int maxInFlight;
+};
+
+#endif /* __QOS1_PUBLISHER_H__ */
@@ -0,0 +1,60 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __RECONNECT_BACKOFF_H__
+#define __RECONNECT_BACKOFF_H__
+
+#include "mbed.h"
+
+/*
+ * Exponential backoff with jitter between reconnect attempts.
+ *
+ * The n-th delay is drawn from [d/2, d] where d = min(maxMs, minMs * 2^n), so
+ * that a fleet of devices losing the connection at the same time does not
+ * reconnect in lockstep.
+ */
+class ReconnectBackoff {
+public:
+    ReconnectBackoff(uint32_t minMs, uint32_t maxMs) : minMs(minMs), maxMs(maxMs), attempt(0)
+    {
+        srand(us_ticker_read());
+    }
+
+    /* Delay before the next attempt. Each call doubles the base delay up to maxMs. */
+    uint32_t nextDelayMs()
+    {
+        uint32_t delay = maxMs;
+        if (attempt < 31 && (minMs << attempt) >> attempt == minMs && (minMs << attempt) < maxMs) {
+            delay = minMs << attempt;
+        }
+        attempt++;
+        return delay / 2 + (uint32_t)rand() % (delay / 2 + 1);
+    }
+
+    /* Starts over from minMs, e.g. after a successful connection. */
+    void reset() { attempt = 0; }
+
+    unsigned int attempts() const { return attempt; }
+
+private:
+    uint32_t minMs;
+    uint32_t maxMs;
+    unsigned int attempt;
+};
+
+#endif /* __RECONNECT_BACKOFF_H__ */
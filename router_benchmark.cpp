@@ -0,0 +1,151 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "router_benchmark.h"
+#include "topic_router.h"
+
+/* Devices subscribed besides the sample's own filters. */
+#define ROUTER_BENCHMARK_DEVICES    16
+#define ROUTER_BENCHMARK_FILTERS    (4 + ROUTER_BENCHMARK_DEVICES)
+
+typedef TopicRouter<96, 768> BenchmarkRouter;
+
+/* Routed topics, from the first filter to no filter at all. */
+static const char *const routedTopics[] = {
+    "devices/sample/messages/devicebound/%24.to=%2Fdevices%2Fsample%2Fmessages%2Fdevicebound",
+    "$iothub/twin/res/200/?$rid=12",
+    "$iothub/twin/PATCH/properties/desired/?$version=41",
+    "$iothub/methods/POST/echo/?$rid=3",
+    "devices/child-15/messages/devicebound/%24.to=%2Fdevices%2Fchild-15%2Fmessages%2Fdevicebound",
+    "devices/unknown/messages/devicebound/%24.to=%2Fdevices%2Funknown%2Fmessages%2Fdevicebound",
+};
+
+static void handleRoutedMessage(MQTT::MessageData &md)
+{
+}
+
+/* How the client matches a filter, a copy of isTopicMatched() in MQTTClient.h. */
+static bool isTopicMatched(const char *filter, const char *topic, size_t length)
+{
+    const char *curf = filter;
+    const char *curn = topic;
+    const char *curnEnd = topic + length;
+    while (*curf && curn < curnEnd) {
+        if (*curn == '/' && *curf != '/') {
+            break;
+        }
+        if (*curf != '+' && *curf != '#' && *curf != *curn) {
+            break;
+        }
+        if (*curf == '+') {
+            // Skip until the next separator or the end of the topic.
+            const char *nextpos = curn + 1;
+            while (nextpos < curnEnd && *nextpos != '/') {
+                nextpos = ++curn + 1;
+            }
+        } else if (*curf == '#') {
+            curn = curnEnd - 1;
+        }
+        curf++;
+        curn++;
+    }
+    return (curn == curnEnd) && (*curf == '\0');
+}
+
+/* The client's handler lookup: an exact compare, then the wildcard match, filter by filter. */
+static int findLinear(char filters[][48], size_t count, const char *topic, size_t length)
+{
+    for (size_t i = 0; i < count; i++) {
+        if ((strlen(filters[i]) == length && memcmp(filters[i], topic, length) == 0)
+                || isTopicMatched(filters[i], topic, length)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+RouterBenchmark::RouterBenchmark(uint32_t iterations)
+    : iterations(iterations), routes(0), trieUs(0), linearUs(0), nodes(0), arenaBytes(0)
+{
+}
+
+int RouterBenchmark::run()
+{
+    const size_t topicCount = sizeof(routedTopics) / sizeof(routedTopics[0]);
+    routes = iterations * topicCount;
+
+    static char filters[ROUTER_BENCHMARK_FILTERS][48];
+    size_t filterCount = 0;
+    strcpy(filters[filterCount++], "devices/sample/messages/devicebound/#");
+    strcpy(filters[filterCount++], "$iothub/twin/res/#");
+    strcpy(filters[filterCount++], "$iothub/twin/PATCH/properties/desired/#");
+    strcpy(filters[filterCount++], "$iothub/methods/POST/#");
+    for (int i = 0; i < ROUTER_BENCHMARK_DEVICES; i++) {
+        snprintf(filters[filterCount++], sizeof(filters[0]), "devices/child-%02d/messages/devicebound/#", i);
+    }
+
+    static BenchmarkRouter router;
+    for (size_t i = 0; i < filterCount; i++) {
+        if (!router.add(filters[i], handleRoutedMessage)) {
+            return -1;
+        }
+    }
+    nodes = router.nodesUsed();
+    arenaBytes = router.arenaBytesUsed();
+
+    size_t lengths[topicCount];
+    for (size_t t = 0; t < topicCount; t++) {
+        lengths[t] = strlen(routedTopics[t]);
+    }
+
+    // Both ways must find a filter for the same topics.
+    volatile size_t trieMatches = 0;
+    volatile size_t linearMatches = 0;
+    BenchmarkRouter::Handler matches[TOPIC_ROUTER_MAX_ACTIVE];
+    Timer timer;
+    timer.start();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (size_t t = 0; t < topicCount; t++) {
+            trieMatches += router.match(routedTopics[t], lengths[t], matches, TOPIC_ROUTER_MAX_ACTIVE);
+        }
+    }
+    timer.stop();
+    trieUs = timer.read_us();
+
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (size_t t = 0; t < topicCount; t++) {
+            linearMatches += findLinear(filters, filterCount, routedTopics[t], lengths[t]) >= 0 ? 1 : 0;
+        }
+    }
+    timer.stop();
+    linearUs = timer.read_us();
+
+    return trieMatches == linearMatches ? 0 : -1;
+}
+
+void RouterBenchmark::print() const
+{
+    printf("\r\n----- Router benchmark -----\r\n");
+    printf("Filters:  %u, %u trie nodes, %u arena bytes\r\n", (unsigned int)ROUTER_BENCHMARK_FILTERS,
+           (unsigned int)nodes, (unsigned int)arenaBytes);
+    printf("Trie:     %lu ns/topic\r\n", routes ? (unsigned long)((uint64_t)trieUs * 1000 / routes) : 0UL);
+    printf("Linear:   %lu ns/topic\r\n", routes ? (unsigned long)((uint64_t)linearUs * 1000 / routes) : 0UL);
+    printf("----------------------------\r\n\r\n");
+}
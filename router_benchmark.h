@@ -0,0 +1,51 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __ROUTER_BENCHMARK_H__
+#define __ROUTER_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+
+/*
+ * Measures what matching a received topic costs with the topic router and
+ * with the client's own handler list, which compares the topic with every
+ * filter in turn. The filters are those of the sample plus the devicebound
+ * topics of a number of other devices, as a gateway would subscribe.
+ */
+class RouterBenchmark : public Benchmark {
+public:
+    /* Matches every test topic `iterations` times each way. */
+    RouterBenchmark(uint32_t iterations);
+
+    virtual const char *name() const { return "router benchmark"; }
+
+    /* Returns -1 if the two ways disagree, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    uint32_t iterations;
+    uint32_t routes;        // Topics matched per way.
+    uint32_t trieUs;
+    uint32_t linearUs;
+    size_t nodes;
+    size_t arenaBytes;
+};
+
+#endif /* __ROUTER_BENCHMARK_H__ */
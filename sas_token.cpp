@@ -0,0 +1,179 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "sas_token.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/platform_util.h"
+
+#define SHA256_BLOCK_SIZE   64
+#define SHA256_DIGEST_SIZE  32
+
+/*
+ * Appends `src` to `dst` with every character but the RFC 3986 unreserved
+ * ones percent-encoded. Returns the new length of `dst`, or 0 if it does not
+ * fit into `size` bytes including the terminating NUL.
+ */
+static size_t urlEncode(char *dst, size_t length, size_t size, const char *src, size_t srcLength)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < srcLength; i++) {
+        const char c = src[i];
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+                || c == '-' || c == '_' || c == '.' || c == '~') {
+            if (length + 1 >= size) {
+                return 0;
+            }
+            dst[length++] = c;
+        } else {
+            if (length + 3 >= size) {
+                return 0;
+            }
+            dst[length++] = '%';
+            dst[length++] = hex[(uint8_t)c >> 4];
+            dst[length++] = hex[(uint8_t)c & 0x0F];
+        }
+    }
+    dst[length] = '\0';
+    return length;
+}
+
+SasToken::SasToken(const char *hostName, const char *deviceId)
+    : hasKey(false), resourceLength(0), expiresAt(0), lastSignUs(0)
+{
+    mbedtls_sha256_init(&innerPad);
+    mbedtls_sha256_init(&outerPad);
+    tokenBuffer[0] = '\0';
+
+    char uri[sizeof(resource)];
+    int n = snprintf(uri, sizeof(uri), "%s/devices/%s", hostName, deviceId);
+    if (n > 0 && (size_t)n < sizeof(uri)) {
+        resourceLength = urlEncode(resource, 0, sizeof(resource), uri, n);
+    }
+    if (resourceLength == 0) {
+        printf("ERROR: SAS token resource URI is too long.\r\n");
+    }
+}
+
+SasToken::~SasToken()
+{
+    mbedtls_sha256_free(&innerPad);
+    mbedtls_sha256_free(&outerPad);
+}
+
+int SasToken::setKey(const char *base64Key)
+{
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    size_t keyLength = 0;
+    hasKey = false;
+
+    // Device keys are 16 to 64 bytes, so the key always fits into one block unhashed.
+    int ret = mbedtls_base64_decode(pad, sizeof(pad), &keyLength,
+                                    (const unsigned char*)base64Key, strlen(base64Key));
+    if (ret != 0) {
+        mbedtls_platform_zeroize(pad, sizeof(pad));
+        return ret;
+    }
+    memset(pad + keyLength, 0, sizeof(pad) - keyLength);
+
+    for (size_t i = 0; i < sizeof(pad); i++) {
+        pad[i] ^= 0x36;
+    }
+    if ((ret = mbedtls_sha256_starts_ret(&innerPad, 0)) != 0
+            || (ret = mbedtls_sha256_update_ret(&innerPad, pad, sizeof(pad))) != 0) {
+        mbedtls_platform_zeroize(pad, sizeof(pad));
+        return ret;
+    }
+    // (key ^ 0x36) ^ (0x36 ^ 0x5C) == key ^ 0x5C
+    for (size_t i = 0; i < sizeof(pad); i++) {
+        pad[i] ^= 0x36 ^ 0x5C;
+    }
+    if ((ret = mbedtls_sha256_starts_ret(&outerPad, 0)) == 0) {
+        ret = mbedtls_sha256_update_ret(&outerPad, pad, sizeof(pad));
+    }
+    mbedtls_platform_zeroize(pad, sizeof(pad));
+
+    hasKey = (ret == 0);
+    return ret;
+}
+
+int SasToken::generate(time_t expiry)
+{
+    if (!hasKey || resourceLength == 0) {
+        return -1;
+    }
+    Timer timer;
+    timer.start();
+
+    char expiryString[12];
+    const int expiryLength = snprintf(expiryString, sizeof(expiryString), "%lu", (unsigned long)expiry);
+
+    // HMAC-SHA256 of "{resource}\n{expiry}", starting from the precomputed pad states.
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_clone(&ctx, &innerPad);
+    int ret = mbedtls_sha256_update_ret(&ctx, (const unsigned char*)resource, resourceLength);
+    if (ret == 0) {
+        ret = mbedtls_sha256_update_ret(&ctx, (const unsigned char*)"\n", 1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_sha256_update_ret(&ctx, (const unsigned char*)expiryString, expiryLength);
+    }
+    if (ret == 0) {
+        ret = mbedtls_sha256_finish_ret(&ctx, digest);
+    }
+    if (ret == 0) {
+        mbedtls_sha256_clone(&ctx, &outerPad);
+        ret = mbedtls_sha256_update_ret(&ctx, digest, sizeof(digest));
+    }
+    if (ret == 0) {
+        ret = mbedtls_sha256_finish_ret(&ctx, digest);
+    }
+    mbedtls_sha256_free(&ctx);
+    if (ret != 0) {
+        return ret;
+    }
+
+    unsigned char signature[48];    // base64 of 32 bytes is 44 characters.
+    size_t signatureLength = 0;
+    ret = mbedtls_base64_encode(signature, sizeof(signature), &signatureLength, digest, sizeof(digest));
+    if (ret != 0) {
+        return ret;
+    }
+
+    int n = snprintf(tokenBuffer, sizeof(tokenBuffer), "SharedAccessSignature sr=%s&sig=", resource);
+    size_t length = (n > 0 && (size_t)n < sizeof(tokenBuffer)) ? n : 0;
+    if (length > 0) {
+        length = urlEncode(tokenBuffer, length, sizeof(tokenBuffer), (const char*)signature, signatureLength);
+    }
+    if (length > 0) {
+        n = snprintf(tokenBuffer + length, sizeof(tokenBuffer) - length, "&se=%s", expiryString);
+        if (n <= 0 || (size_t)n >= sizeof(tokenBuffer) - length) {
+            length = 0;
+        }
+    }
+    if (length == 0) {
+        tokenBuffer[0] = '\0';
+        return -1;
+    }
+
+    timer.stop();
+    lastSignUs = timer.read_us();
+    expiresAt = expiry;
+    return 0;
+}
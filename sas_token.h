@@ -0,0 +1,73 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __SAS_TOKEN_H__
+#define __SAS_TOKEN_H__
+
+#include "mbed.h"
+#include "mbedtls/sha256.h"
+
+/* Longest token generate() can build, including the terminating NUL. */
+#define SAS_TOKEN_MAX_LENGTH    512
+
+/*
+ * Generates IoT Hub SAS tokens for a device from its symmetric key.
+ *
+ * The token is
+ *   SharedAccessSignature sr={resource}&sig={signature}&se={expiry}
+ * where the signature is the base64 encoded HMAC-SHA256 of
+ * "{resource}\n{expiry}" under the decoded device key, and resource is the
+ * URL encoded "{host}/devices/{device id}".
+ *
+ * setKey() hashes the inner and outer HMAC pads once and keeps the SHA-256
+ * states, so generate() only hashes the string to sign and the inner digest.
+ * The decoded key itself is not kept.
+ */
+class SasToken {
+public:
+    SasToken(const char *hostName, const char *deviceId);
+    ~SasToken();
+
+    /* Sets the base64 encoded device key. Returns 0 or an mbedtls error code. */
+    int setKey(const char *base64Key);
+
+    /*
+     * Builds a token valid until `expiry`, in seconds since the epoch.
+     * Returns 0, or a negative value if there is no key or the token does
+     * not fit.
+     */
+    int generate(time_t expiry);
+
+    /* The last generated token, empty if generate() never succeeded. */
+    const char *token() const { return tokenBuffer; }
+    time_t expiry() const { return expiresAt; }
+    /* Time the last generate() took. */
+    uint32_t signTimeUs() const { return lastSignUs; }
+
+private:
+    mbedtls_sha256_context innerPad;    // SHA-256 state after (key ^ ipad).
+    mbedtls_sha256_context outerPad;    // SHA-256 state after (key ^ opad).
+    bool hasKey;
+    char resource[SAS_TOKEN_MAX_LENGTH / 2];
+    size_t resourceLength;
+    char tokenBuffer[SAS_TOKEN_MAX_LENGTH];
+    time_t expiresAt;
+    uint32_t lastSignUs;
+};
+
+#endif /* __SAS_TOKEN_H__ */
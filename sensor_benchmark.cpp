@@ -0,0 +1,143 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include <math.h>
+#include "sensor_benchmark.h"
+#include "window_aggregator.h"
+
+/* Samples generated and aggregated at a time, as the pipeline hands over a block. */
+#define SENSOR_BENCHMARK_BLOCK      64
+/* Largest window that can be checked against its stored samples. */
+#define SENSOR_BENCHMARK_MAX_WINDOW 1024
+/* Bytes of one telemetry record in the binary batch format. */
+#define SENSOR_BENCHMARK_RECORD_SIZE 14
+
+static const char *const streamNames[] = { "Sine:", "Step:", "Sawtooth:" };
+
+/* Sample `i` of `stream`, a 12-bit ADC reading. */
+static int32_t syntheticSample(int stream, uint32_t i, uint32_t &noise)
+{
+    noise = noise * 1664525 + 1013904223;
+    const int32_t jitter = (int32_t)(noise >> 28) - 8;
+    switch (stream) {
+        case 0:
+            return 2048 + (int32_t)(1500.0f * sinf(i * 0.0314159f)) + jitter;
+        case 1:
+            return ((i / 500) & 1) ? 3500 + jitter : 500 + jitter;
+        default:
+            return (int32_t)(i % 4096);
+    }
+}
+
+/* Summary of `count` samples computed the plain way, for checking WindowAggregator. */
+static void referenceSummary(const int32_t *window, uint32_t count, uint32_t decimation, SensorSummary &summary)
+{
+    int64_t sum = 0;
+    summary.count = 0;
+    summary.min = INT32_MAX;
+    summary.max = INT32_MIN;
+    for (uint32_t i = 0; i + decimation <= count; i += decimation) {
+        int64_t decimated = 0;
+        for (uint32_t j = 0; j < decimation; j++) {
+            decimated += window[i + j];
+        }
+        const int32_t value = (int32_t)(decimated / (int32_t)decimation);
+        summary.min = value < summary.min ? value : summary.min;
+        summary.max = value > summary.max ? value : summary.max;
+        sum += value;
+        summary.count++;
+    }
+    summary.mean = summary.count ? (int32_t)(sum / (int64_t)summary.count) : 0;
+}
+
+SensorBenchmark::SensorBenchmark(uint32_t windowSamples, uint32_t decimation, uint32_t samples)
+    : windowSamples(windowSamples), decimation(decimation), samples(samples), mismatches(0)
+{
+    memset(windows, 0, sizeof(windows));
+    memset(aggregateUs, 0, sizeof(aggregateUs));
+}
+
+int SensorBenchmark::run()
+{
+    mismatches = 0;
+    static int32_t block[SENSOR_BENCHMARK_BLOCK];
+    static int32_t window[SENSOR_BENCHMARK_MAX_WINDOW];
+
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        // Timed pass, the samples are generated outside the measured part.
+        WindowAggregator aggregator(windowSamples, decimation);
+        SensorSummary summary;
+        uint32_t noise = 1;
+        windows[stream] = 0;
+        aggregateUs[stream] = 0;
+        for (uint32_t i = 0; i < samples; i += SENSOR_BENCHMARK_BLOCK) {
+            const uint32_t n = (samples - i < SENSOR_BENCHMARK_BLOCK) ? samples - i : SENSOR_BENCHMARK_BLOCK;
+            for (uint32_t j = 0; j < n; j++) {
+                block[j] = syntheticSample(stream, i + j, noise);
+            }
+            const uint32_t startUs = us_ticker_read();
+            for (uint32_t j = 0; j < n; j++) {
+                if (aggregator.add(block[j], summary)) {
+                    windows[stream]++;
+                }
+            }
+            aggregateUs[stream] += us_ticker_read() - startUs;
+        }
+
+        // Checking pass over the same stream, possible if a window fits the buffer.
+        WindowAggregator checked(windowSamples, decimation);
+        const uint32_t perWindow = checked.samplesPerWindow();
+        if (perWindow > SENSOR_BENCHMARK_MAX_WINDOW) {
+            continue;
+        }
+        noise = 1;
+        uint32_t filled = 0;
+        for (uint32_t i = 0; i < samples; i++) {
+            const int32_t sample = syntheticSample(stream, i, noise);
+            window[filled++] = sample;
+            if (checked.add(sample, summary)) {
+                SensorSummary expected;
+                referenceSummary(window, filled, decimation > 0 ? decimation : 1, expected);
+                if (filled != perWindow || summary.count != expected.count || summary.min != expected.min
+                        || summary.max != expected.max || summary.mean != expected.mean) {
+                    mismatches++;
+                }
+                filled = 0;
+            }
+        }
+    }
+    return mismatches == 0 ? 0 : -1;
+}
+
+void SensorBenchmark::print() const
+{
+    printf("\r\n----- Sensor benchmark -----\r\n");
+    printf("Samples:   %lu per stream, window of %lu, decimation %lu\r\n", (unsigned long)samples,
+           (unsigned long)windowSamples, (unsigned long)decimation);
+    for (int stream = 0; stream < STREAM_COUNT; stream++) {
+        printf("%-10s %lu ns/sample, %lu windows\r\n", streamNames[stream],
+               samples ? (unsigned long)((uint64_t)aggregateUs[stream] * 1000 / samples) : 0UL,
+               (unsigned long)windows[stream]);
+    }
+    // Each window is published as four records instead of one record per sample.
+    printf("Published: %lu of %lu bytes\r\n", (unsigned long)(windows[0] * 4 * SENSOR_BENCHMARK_RECORD_SIZE),
+           (unsigned long)(samples * SENSOR_BENCHMARK_RECORD_SIZE));
+    printf("Mismatches: %lu\r\n", (unsigned long)mismatches);
+    printf("----------------------------\r\n\r\n");
+}
@@ -0,0 +1,59 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __SENSOR_BENCHMARK_H__
+#define __SENSOR_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+
+/*
+ * Feeds synthetic sample streams, a noisy sine, a step and a sawtooth,
+ * through the WindowAggregator of the sensor pipeline. Measures the
+ * aggregation time per sample and checks every summary against min, max
+ * and mean computed from the stored samples of its window.
+ */
+class SensorBenchmark : public Benchmark {
+public:
+    /* Aggregates `samples` samples of each stream. */
+    SensorBenchmark(uint32_t windowSamples, uint32_t decimation, uint32_t samples);
+
+    virtual const char *name() const { return "sensor benchmark"; }
+
+    /* Returns -1 if a summary is wrong, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    enum {
+        STREAM_SINE,
+        STREAM_STEP,
+        STREAM_SAWTOOTH,
+        STREAM_COUNT,
+    };
+
+    uint32_t windowSamples;
+    uint32_t decimation;
+    uint32_t samples;
+    uint32_t windows[STREAM_COUNT];
+    uint32_t aggregateUs[STREAM_COUNT];
+    uint32_t mismatches;
+};
+
+#endif /* __SENSOR_BENCHMARK_H__ */
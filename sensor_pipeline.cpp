@@ -0,0 +1,105 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "sensor_pipeline.h"
+
+/* Stack of the pipeline thread, which aggregates and runs the summary handler. */
+#define SENSOR_PIPELINE_STACK_SIZE  1536
+
+SensorPipeline::SensorPipeline(SensorRead read, int32_t *blocks, uint32_t blockSamples, uint32_t windowSamples,
+                               uint32_t decimation)
+    : read(read), blocks(blocks), blockSamples(blockSamples), aggregator(windowSamples, decimation),
+      thread(NULL), ready(0, 1), fill(0), produced(0), consumed(0), samples(0), droppedSamples(0), windows(0),
+      blockUsTotal(0), blockUsMax(0)
+{
+}
+
+SensorPipeline::~SensorPipeline()
+{
+    ticker.detach();
+    if (thread) {
+        thread->terminate();
+        delete thread;
+    }
+}
+
+bool SensorPipeline::start(uint32_t periodUs)
+{
+    // Above the main loop, so that a long TLS write does not hold a block past its turn.
+    thread = new Thread(osPriorityAboveNormal, SENSOR_PIPELINE_STACK_SIZE, NULL, "sensor");
+    if (thread->start(callback(this, &SensorPipeline::run)) != osOK) {
+        delete thread;
+        thread = NULL;
+        return false;
+    }
+    ticker.attach_us(callback(this, &SensorPipeline::sample), periodUs);
+    return true;
+}
+
+void SensorPipeline::sample()
+{
+    samples++;
+    const uint32_t p = produced;
+    if (p - core_util_atomic_load_u32(&consumed) >= 2) {
+        // Both blocks wait for the thread.
+        droppedSamples++;
+        return;
+    }
+    blocks[(p & 1) * blockSamples + fill] = read();
+    if (++fill == blockSamples) {
+        fill = 0;
+        core_util_atomic_store_u32(&produced, p + 1);
+        ready.release();
+    }
+}
+
+void SensorPipeline::run()
+{
+    while (true) {
+        ready.acquire();
+        uint32_t c = consumed;
+        while (c != core_util_atomic_load_u32(&produced)) {
+            const uint32_t startUs = us_ticker_read();
+            const int32_t *block = blocks + (c & 1) * blockSamples;
+            SensorSummary summary;
+            for (uint32_t i = 0; i < blockSamples; i++) {
+                if (aggregator.add(block[i], summary)) {
+                    windows++;
+                    if (handler) {
+                        handler(summary);
+                    }
+                }
+            }
+            core_util_atomic_store_u32(&consumed, ++c);
+            const uint32_t elapsed = us_ticker_read() - startUs;
+            blockUsTotal += elapsed;
+            if (elapsed > blockUsMax) {
+                blockUsMax = elapsed;
+            }
+        }
+    }
+}
+
+void SensorPipeline::printStats() const
+{
+    const uint32_t blocksDone = consumed;
+    printf("Sensor: %lu samples, %lu dropped, %lu windows, block of %lu samples aggregated in avg %lu us max %lu us\r\n",
+           (unsigned long)samples, (unsigned long)droppedSamples, (unsigned long)windows, (unsigned long)blockSamples,
+           blocksDone ? (unsigned long)(blockUsTotal / blocksDone) : 0UL, (unsigned long)blockUsMax);
+}
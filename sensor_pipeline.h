@@ -0,0 +1,83 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __SENSOR_PIPELINE_H__
+#define __SENSOR_PIPELINE_H__
+
+#include "mbed.h"
+#include "window_aggregator.h"
+
+/* Reads one sample. Called from the Ticker interrupt, so it must not block or lock a mutex. */
+typedef int32_t (*SensorRead)();
+
+/*
+ * Samples a sensor at a fixed rate and hands only window summaries on.
+ *
+ * A Ticker interrupt stores each sample into one of two blocks and wakes the
+ * pipeline thread when a block is full. The thread runs the block through a
+ * WindowAggregator while the interrupt fills the other block, and calls the
+ * summary handler for every completed window. The interrupt does one read
+ * and one store per sample, and the thread a constant amount of work, so
+ * the CPU time per sample is bounded at any rate.
+ *
+ * The blocks are handed over like the records of TelemetryQueue: only the
+ * interrupt advances `produced` and only the thread advances `consumed`. If
+ * the thread falls two blocks behind, samples are dropped and counted until
+ * a block is free again.
+ */
+class SensorPipeline {
+public:
+    /* `blocks` holds two blocks of `blockSamples` samples each. */
+    SensorPipeline(SensorRead read, int32_t *blocks, uint32_t blockSamples, uint32_t windowSamples, uint32_t decimation);
+    ~SensorPipeline();
+
+    /* Called on the pipeline thread with every completed window. */
+    void setSummaryHandler(Callback<void(const SensorSummary &)> handler) { this->handler = handler; }
+
+    /* Starts the pipeline thread and samples every `periodUs`. Returns false if the thread cannot start. */
+    bool start(uint32_t periodUs);
+
+    void printStats() const;
+
+private:
+    void sample();
+    void run();
+
+    SensorRead read;
+    int32_t *blocks;
+    uint32_t blockSamples;
+    WindowAggregator aggregator;
+    Callback<void(const SensorSummary &)> handler;
+    Ticker ticker;
+    Thread *thread;
+    Semaphore ready;
+
+    uint32_t fill;                  // Samples in the block being filled, interrupt only.
+    volatile uint32_t produced;     // Blocks filled, written by the interrupt.
+    volatile uint32_t consumed;     // Blocks aggregated, written by the thread.
+
+    // Statistics
+    volatile uint32_t samples;
+    volatile uint32_t droppedSamples;
+    uint32_t windows;
+    uint64_t blockUsTotal;          // Aggregation time of all blocks.
+    uint32_t blockUsMax;
+};
+
+#endif /* __SENSOR_PIPELINE_H__ */
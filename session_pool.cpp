@@ -0,0 +1,221 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "session_pool.h"
+#include "mbedtls/platform.h"
+
+#define BLOCK_FREE  0xF5
+#define BLOCK_USED  0xA5
+
+volatile uint32_t SessionPool::heapScopes = 0;
+
+SessionPool::SessionPool(void *arena, size_t size, const SessionPoolClass *classes, size_t classCount)
+    : arena((uint8_t *)arena), size(size), classCount(0), allocations(0), failedAllocations(0),
+      heapAllocations(0), spilledAllocations(0), invalidReleases(0), blockBytes(0), peakBlockBytes(0),
+      requestedBytesTotal(0), blockBytesTotal(0)
+{
+    // Classes which do not fit the arena are left out.
+    uint32_t offset = 0;
+    for (size_t i = 0; i < classCount && this->classCount < SESSION_POOL_MAX_CLASSES; i++) {
+        const uint32_t blockSize = sessionPoolBlockSize(classes[i].size);
+        if (offset + (uint64_t)blockSize * classes[i].count > size) {
+            break;
+        }
+        Class &c = this->classes[this->classCount++];
+        c.blockSize = blockSize;
+        c.first = offset;
+        c.count = classes[i].count;
+        c.peak = 0;
+        offset += blockSize * c.count;
+    }
+    buildFreeLists();
+}
+
+void SessionPool::buildFreeLists()
+{
+    // In address order, so every session starts with the same layout.
+    for (size_t i = 0; i < classCount; i++) {
+        Class &c = classes[i];
+        c.used = 0;
+        c.freeHead = 0;
+        for (uint32_t n = c.count; n > 0; n--) {
+            const uint32_t offset = c.first + (n - 1) * c.blockSize;
+            Header *h = header(offset);
+            h->word = c.freeHead;
+            h->classIndex = i;
+            h->state = BLOCK_FREE;
+            c.freeHead = offset + 1;
+        }
+    }
+    blockBytes = 0;
+}
+
+void *SessionPool::allocate(size_t size)
+{
+    const uint32_t needed = sessionPoolBlockSize(size);
+    if (core_util_atomic_load_u32(&heapScopes) == 0) {
+        core_util_critical_section_enter();
+        allocations++;
+        bool isSpilled = false;
+        for (size_t i = 0; i < classCount; i++) {
+            Class &c = classes[i];
+            if (c.blockSize < needed) {
+                continue;
+            }
+            if (c.freeHead == 0) {
+                isSpilled = true;
+                continue;
+            }
+            const uint32_t offset = c.freeHead - 1;
+            Header *h = header(offset);
+            c.freeHead = h->word;
+            h->word = size;
+            h->state = BLOCK_USED;
+            if (++c.used > c.peak) {
+                c.peak = c.used;
+            }
+            if (isSpilled) {
+                spilledAllocations++;
+            }
+            blockBytes += c.blockSize;
+            if (blockBytes > peakBlockBytes) {
+                peakBlockBytes = blockBytes;
+            }
+            requestedBytesTotal += size;
+            blockBytesTotal += c.blockSize;
+            core_util_critical_section_exit();
+            return h + 1;
+        }
+        heapAllocations++;
+        core_util_critical_section_exit();
+    }
+    void *pointer = malloc(size);
+    if (!pointer) {
+        core_util_atomic_incr_u32(&failedAllocations, 1);
+    }
+    return pointer;
+}
+
+void SessionPool::release(void *pointer)
+{
+    const uint8_t *p = (const uint8_t *)pointer;
+    if (p < arena + SESSION_POOL_HEADER_SIZE || p >= arena + size) {
+        free(pointer);
+        return;
+    }
+    Header *h = (Header *)pointer - 1;
+    core_util_critical_section_enter();
+    if (h->state != BLOCK_USED || h->classIndex >= classCount) {
+        invalidReleases++;
+        core_util_critical_section_exit();
+        return;
+    }
+    Class &c = classes[h->classIndex];
+    h->word = c.freeHead;
+    h->state = BLOCK_FREE;
+    c.freeHead = (uint32_t)((uint8_t *)h - arena) + 1;
+    c.used--;
+    blockBytes -= c.blockSize;
+    core_util_critical_section_exit();
+}
+
+uint32_t SessionPool::reset()
+{
+    core_util_critical_section_enter();
+    const uint32_t inUse = blocksInUse();
+    buildFreeLists();
+    core_util_critical_section_exit();
+    return inUse;
+}
+
+uint32_t SessionPool::blocksInUse() const
+{
+    uint32_t used = 0;
+    for (size_t i = 0; i < classCount; i++) {
+        used += classes[i].used;
+    }
+    return used;
+}
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+/* The pool serving mbed TLS, see attachMbedTls(). */
+static SessionPool *mbedTlsPool = NULL;
+
+static void *mbedTlsCalloc(size_t count, size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *pointer = mbedTlsPool->allocate(count * size);
+    if (pointer) {
+        memset(pointer, 0, count * size);
+    }
+    return pointer;
+}
+
+static void mbedTlsFree(void *pointer)
+{
+    if (pointer) {
+        mbedTlsPool->release(pointer);
+    }
+}
+#endif
+
+bool SessionPool::attachMbedTls()
+{
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+    mbedTlsPool = this;
+    return mbedtls_platform_set_calloc_free(mbedTlsCalloc, mbedTlsFree) == 0;
+#else
+    return false;
+#endif
+}
+
+void SessionPool::clearStats()
+{
+    core_util_critical_section_enter();
+    allocations = 0;
+    failedAllocations = 0;
+    heapAllocations = 0;
+    spilledAllocations = 0;
+    invalidReleases = 0;
+    peakBlockBytes = blockBytes;
+    requestedBytesTotal = 0;
+    blockBytesTotal = 0;
+    for (size_t i = 0; i < classCount; i++) {
+        classes[i].peak = classes[i].used;
+    }
+    core_util_critical_section_exit();
+}
+
+void SessionPool::printStats() const
+{
+    printf("Session pool: %lu allocations, %lu failed, %lu from the heap, %lu from a larger class, "
+           "%lu released twice\r\n",
+           (unsigned long)allocations, (unsigned long)failedAllocations, (unsigned long)heapAllocations,
+           (unsigned long)spilledAllocations, (unsigned long)invalidReleases);
+    printf("Session pool: peak %lu of %lu bytes, %lu%% lost to headers and rounding\r\n",
+           (unsigned long)peakBlockBytes, (unsigned long)size,
+           blockBytesTotal ? (unsigned long)(100 - requestedBytesTotal * 100 / blockBytesTotal) : 0UL);
+    for (size_t i = 0; i < classCount; i++) {
+        const Class &c = classes[i];
+        printf("  %5lu bytes: %u of %u blocks in use, peak %u\r\n",
+               (unsigned long)(c.blockSize - SESSION_POOL_HEADER_SIZE), c.used, c.count, c.peak);
+    }
+}
@@ -0,0 +1,159 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __SESSION_POOL_H__
+#define __SESSION_POOL_H__
+
+#include "mbed.h"
+#include <new>
+
+/* Header in front of every block, holding its class and the requested size or the next free block. */
+#define SESSION_POOL_HEADER_SIZE  8
+#define SESSION_POOL_MAX_CLASSES  12
+
+/* `count` blocks of `size` bytes each. */
+struct SessionPoolClass {
+    uint16_t size;
+    uint16_t count;
+};
+
+/* Bytes a block of `size` takes in the arena. Sizes are rounded up to 8 bytes. */
+constexpr size_t sessionPoolBlockSize(size_t size)
+{
+    return SESSION_POOL_HEADER_SIZE + ((size + 7) & ~(size_t)7);
+}
+
+/* Arena size for `classes`, for sizing a static arena at compile time. */
+template<size_t N>
+constexpr size_t sessionPoolArenaSize(const SessionPoolClass (&classes)[N])
+{
+    size_t size = 0;
+    for (size_t i = 0; i < N; i++) {
+        size += sessionPoolBlockSize(classes[i].size) * classes[i].count;
+    }
+    return size;
+}
+
+/*
+ * Fixed-size block pool for what a connection allocates: mbed TLS contexts,
+ * record buffers, certificates and big numbers, and the socket and MQTT
+ * client objects.
+ *
+ * The arena is split once into classes of equally sized blocks, each with
+ * its own free list, so allocating and freeing take constant time and
+ * cannot fragment the arena however the sizes and lifetimes interleave. A
+ * request takes a block of the smallest class it fits; if that class is
+ * used up it takes one from the next larger class, and if none is left, or
+ * the request is larger than every class, it falls back to the heap. All
+ * three cases are counted, so the class table can be tuned from printStats().
+ *
+ * release() returns heap blocks to the heap, so memory allocated before the
+ * pool was attached to mbed TLS may be freed through it. reset() frees
+ * every block at once at the end of a session. Objects which must outlive
+ * the session, such as the saved TLS session, are allocated from the heap
+ * within a HeapScope.
+ */
+class SessionPool {
+public:
+    /* Splits `arena` of `size` bytes, 8-byte aligned, into the blocks of `classes`, in ascending size. */
+    SessionPool(void *arena, size_t size, const SessionPoolClass *classes, size_t classCount);
+
+    /* Returns a block of at least `size` bytes, NULL if neither the pool nor the heap has one. */
+    void *allocate(size_t size);
+    void release(void *pointer);
+
+    /* Makes every block free again, including those still allocated. Returns how many were. */
+    uint32_t reset();
+
+    /* Serves mbedtls_calloc() and mbedtls_free() from this pool. Returns false if mbed TLS lacks MBEDTLS_PLATFORM_MEMORY. */
+    bool attachMbedTls();
+
+    /* Constructs a T in the pool. */
+    template<typename T, typename... Args>
+    T *create(Args&&... args)
+    {
+        void *memory = allocate(sizeof(T));
+        return memory ? new (memory) T(args...) : NULL;
+    }
+
+    template<typename T>
+    void destroy(T *object)
+    {
+        if (object) {
+            object->~T();
+            release(object);
+        }
+    }
+
+    /* While one exists, allocate() takes every block from the heap. */
+    class HeapScope {
+    public:
+        HeapScope() { core_util_atomic_incr_u32(&heapScopes, 1); }
+        ~HeapScope() { core_util_atomic_decr_u32(&heapScopes, 1); }
+    };
+
+    uint32_t blocksInUse() const;
+    uint32_t peakBytes() const { return peakBlockBytes; }
+    uint32_t failures() const { return failedAllocations; }
+    uint32_t heapFallbacks() const { return heapAllocations; }
+
+    void printStats() const;
+    /* Zeroes the counters and peaks, e.g. after a soak test. */
+    void clearStats();
+
+private:
+    struct Class {
+        uint32_t blockSize;     // Including the header.
+        uint32_t first;         // Offset of the first block in the arena.
+        uint32_t freeHead;      // Offset of the first free block plus one, 0 if none.
+        uint16_t count;
+        uint16_t used;
+        uint16_t peak;
+    };
+
+    struct Header {
+        uint32_t word;          // Requested size while allocated, next free block while free.
+        uint8_t classIndex;
+        uint8_t state;
+        uint16_t reserved;
+    };
+
+    Header *header(uint32_t offset) const { return (Header *)(arena + offset); }
+    void buildFreeLists();
+
+    static volatile uint32_t heapScopes;
+
+    uint8_t *arena;
+    size_t size;
+    Class classes[SESSION_POOL_MAX_CLASSES];
+    size_t classCount;
+
+    // Statistics
+    uint32_t allocations;
+    uint32_t failedAllocations;     // Neither the pool nor the heap had a block.
+    uint32_t heapAllocations;       // Served by the heap.
+    uint32_t spilledAllocations;    // Served by a larger class.
+    uint32_t invalidReleases;       // Blocks released twice.
+    uint32_t blockBytes;            // In use, including the headers.
+    uint32_t peakBlockBytes;
+    uint64_t requestedBytesTotal;
+    uint64_t blockBytesTotal;
+};
+
+#endif /* __SESSION_POOL_H__ */
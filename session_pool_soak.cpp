@@ -0,0 +1,208 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#include "session_pool_soak.h"
+#include "MQTTClientMbedOs.h"
+#include "mbedtls/ssl.h"
+
+#ifndef MBEDTLS_SSL_MAX_CONTENT_LEN
+#define MBEDTLS_SSL_MAX_CONTENT_LEN 16384
+#endif
+
+/* Sizes mbed TLS allocates for the whole connection, roughly as on a Cortex-M with the sample's settings. */
+#define SOAK_RECORD_BUFFER_SIZE (MBEDTLS_SSL_MAX_CONTENT_LEN + 333)
+/* Handshake state, freed once the handshake is done. */
+#define SOAK_HANDSHAKE_SIZE     1800
+#define SOAK_CERTIFICATES       3
+#define SOAK_CERT_STRUCT_SIZE   560
+#define SOAK_CERT_DER_SIZE      1300
+/* Big numbers of 4 to 512 bytes for the key exchange and signature checks, SOAK_LIVE_NUMBERS alive at a time. */
+#define SOAK_NUMBERS            300
+#define SOAK_LIVE_NUMBERS       24
+#define SOAK_LIVE_OBJECTS       8
+
+struct PoolAllocator {
+    SessionPool *pool;
+    void *allocate(size_t size) { return pool->allocate(size); }
+    void release(void *p) { pool->release(p); }
+    template<typename T, typename... Args>
+    T *create(Args&&... args) { return pool->create<T>(args...); }
+    template<typename T>
+    void destroy(T *object) { pool->destroy(object); }
+};
+
+struct HeapAllocator {
+    void *allocate(size_t size) { return malloc(size); }
+    void release(void *p) { free(p); }
+    template<typename T, typename... Args>
+    T *create(Args&&... args) { return new T(args...); }
+    template<typename T>
+    void destroy(T *object) { delete object; }
+};
+
+/* Connects `client` on `socket` to `broker` and publishes one message. */
+static bool runSession(LoopbackBroker *broker, LoopbackSocket *socket, MQTTClient *client)
+{
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = (char*)"soak";
+    data.cleansession = 1;
+    char payload[] = "{}";
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.id = 0;
+    message.payload = (void*)payload;
+    message.payloadlen = sizeof(payload) - 1;
+    const bool isDone = socket->connectBroker(broker) == NSAPI_ERROR_OK && client->connect(data) == MQTT::SUCCESS
+                        && client->publish("devices/soak/messages/events/", message) == MQTT::SUCCESS;
+    client->disconnect();
+    return isDone;
+}
+
+/* One connect and disconnect. Returns the number of allocations, or -1 if one failed. */
+template<typename Allocator>
+static int runCycle(Allocator &allocator, uint32_t seed, LoopbackBroker *broker)
+{
+    void *live[SOAK_LIVE_OBJECTS];
+    size_t liveCount = 0;
+    int allocations = 0;
+    bool failed = false;
+    uint32_t random = seed;
+    auto next = [&random]() {
+        random = random * 1664525 + 1013904223;
+        return random >> 8;
+    };
+    auto take = [&](size_t size) -> void * {
+        void *p = allocator.allocate(size);
+        allocations++;
+        failed = failed || p == NULL;
+        return p;
+    };
+
+    // Socket, then the TLS setup.
+    LoopbackSocket *socket = allocator.template create<LoopbackSocket>();
+    allocations++;
+    failed = failed || socket == NULL;
+    live[liveCount++] = take(SOAK_RECORD_BUFFER_SIZE);
+    live[liveCount++] = take(SOAK_RECORD_BUFFER_SIZE);
+    void *handshake = take(SOAK_HANDSHAKE_SIZE);
+    void *certificates[2 * SOAK_CERTIFICATES];
+    for (int i = 0; i < SOAK_CERTIFICATES; i++) {
+        certificates[2 * i] = take(SOAK_CERT_STRUCT_SIZE);
+        certificates[2 * i + 1] = take(SOAK_CERT_DER_SIZE + (next() % 512));
+    }
+    // Big numbers, each replacing a random live one.
+    void *numbers[SOAK_LIVE_NUMBERS] = { NULL };
+    for (int i = 0; i < SOAK_NUMBERS; i++) {
+        const uint32_t slot = next() % SOAK_LIVE_NUMBERS;
+        if (numbers[slot]) {
+            allocator.release(numbers[slot]);
+        }
+        numbers[slot] = take(4 << (next() % 8));
+    }
+    for (int i = 0; i < SOAK_LIVE_NUMBERS; i++) {
+        if (numbers[i]) {
+            allocator.release(numbers[i]);
+        }
+    }
+    // The session keys stay, the handshake state and the certificates go.
+    live[liveCount++] = take(400);
+    live[liveCount++] = take(180);
+    allocator.release(handshake);
+    for (int i = 0; i < 2 * SOAK_CERTIFICATES; i++) {
+        allocator.release(certificates[i]);
+    }
+    MQTTClient *client = socket ? allocator.template create<MQTTClient>(socket) : NULL;
+    allocations++;
+    failed = failed || client == NULL;
+    if (client) {
+        failed = !runSession(broker, socket, client) || failed;
+    }
+
+    // Disconnect, freeing the rest in random order.
+    allocator.destroy(client);
+    allocator.destroy(socket);
+    while (liveCount > 0) {
+        const size_t i = next() % liveCount;
+        allocator.release(live[i]);
+        live[i] = live[--liveCount];
+    }
+    return failed ? -1 : allocations;
+}
+
+SessionPoolSoak::SessionPoolSoak(SessionPool *pool, uint32_t cycles, LoopbackBroker *broker)
+    : pool(pool), broker(broker), cycles(cycles), allocationsPerCycle(0), poolUs(0), heapUs(0), failures(0),
+      heapFallbacks(0), leaked(0), peakBytes(0), connects(0), publishes(0)
+{
+}
+
+int SessionPoolSoak::run()
+{
+    failures = 0;
+    leaked = 0;
+    const uint32_t fallbacksBefore = pool->heapFallbacks();
+    broker->clearStats();
+
+    PoolAllocator poolAllocator = { pool };
+    Timer timer;
+    timer.start();
+    for (uint32_t i = 0; i < cycles; i++) {
+        const int allocations = runCycle(poolAllocator, i, broker);
+        if (allocations < 0) {
+            failures++;
+        } else {
+            allocationsPerCycle = allocations;
+        }
+        leaked += pool->reset();
+    }
+    timer.stop();
+    poolUs = timer.read_us();
+    heapFallbacks = pool->heapFallbacks() - fallbacksBefore;
+    peakBytes = pool->peakBytes();
+
+    HeapAllocator heapAllocator;
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < cycles; i++) {
+        if (runCycle(heapAllocator, i, broker) < 0) {
+            failures++;
+        }
+    }
+    timer.stop();
+    heapUs = timer.read_us();
+    connects = broker->connects();
+    publishes = broker->publishes();
+
+    return (failures == 0 && leaked == 0) ? 0 : -1;
+}
+
+void SessionPoolSoak::print() const
+{
+    printf("\r\n----- Session pool soak -----\r\n");
+    printf("Cycles:   %lu, %lu allocations each\r\n", (unsigned long)cycles, (unsigned long)allocationsPerCycle);
+    printf("Pool:     %lu us/cycle, peak %lu bytes, %lu from the heap, %lu leaked\r\n",
+           cycles ? (unsigned long)(poolUs / cycles) : 0UL, (unsigned long)peakBytes,
+           (unsigned long)heapFallbacks, (unsigned long)leaked);
+    printf("Heap:     %lu us/cycle\r\n", cycles ? (unsigned long)(heapUs / cycles) : 0UL);
+    printf("Broker:   %lu sessions, %lu publishes\r\n", (unsigned long)connects, (unsigned long)publishes);
+    printf("Failed:   %lu cycles\r\n", (unsigned long)failures);
+    printf("-----------------------------\r\n\r\n");
+}
@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __SESSION_POOL_SOAK_H__
+#define __SESSION_POOL_SOAK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+#include "session_pool.h"
+#include "loopback_broker.h"
+
+/*
+ * Runs connect/disconnect cycles against a session pool. Each cycle
+ * constructs a socket and an MQTT client in the pool, connects them to a
+ * LoopbackBroker and publishes a message, as a session of the sample does.
+ * The record buffers, the handshake state, the server certificates and a
+ * few hundred short-lived big numbers of a full handshake are simulated,
+ * since the stand-in has no TLS. Everything is freed, the rest in random
+ * order, and the pool is reset at the end of each cycle as on a
+ * disconnect. The same cycles are then run on the heap to compare the
+ * time. Use it before the pool is attached to mbed TLS.
+ */
+class SessionPoolSoak : public Benchmark {
+public:
+    /* Runs `cycles` cycles on `pool` and on the heap, each with a session on `broker`. */
+    SessionPoolSoak(SessionPool *pool, uint32_t cycles, LoopbackBroker *broker);
+
+    virtual const char *name() const { return "session pool soak test"; }
+
+    /* Returns -1 if an allocation failed or a block leaked, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    SessionPool *pool;
+    LoopbackBroker *broker;
+    uint32_t cycles;
+    uint32_t allocationsPerCycle;
+    uint32_t poolUs;
+    uint32_t heapUs;
+    uint32_t failures;
+    uint32_t heapFallbacks;
+    uint32_t leaked;
+    uint32_t peakBytes;
+    uint32_t connects;      // Sessions the broker accepted, on the pool and on the heap.
+    uint32_t publishes;
+};
+
+#endif /* __SESSION_POOL_SOAK_H__ */
@@ -0,0 +1,153 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "startup_cache.h"
+
+/*
+ * Record layout, little endian:
+ *   magic(4) host_crc(4) address_version(1) reserved(1) port(2) address(16)
+ *   sync_time(4) drift_ppm(4) crc32(4), padded to the program size.
+ */
+#define STARTUP_CACHE_MAGIC         0x31435453  // "STC1"
+#define STARTUP_CACHE_RECORD_SIZE   40
+#define STARTUP_CACHE_CRC_OFFSET    36
+
+static void putLe32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t getLe32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t crc32(const void *data, size_t length)
+{
+    MbedCRC<POLY_32BIT_ANSI, 32> crc;
+    uint32_t result = 0;
+    crc.compute((void*)data, length, &result);
+    return result;
+}
+
+StartupCache::StartupCache(BlockDevice *device)
+    : device(device), buffer(NULL), bufferSize(0), dirty(false), hostCrc(0), port(0), syncTime(0), driftPpm(0)
+{
+    memset(&address, 0, sizeof(address));
+}
+
+StartupCache::~StartupCache()
+{
+    delete[] buffer;
+}
+
+int StartupCache::load()
+{
+    int ret = device->init();
+    if (ret != 0) {
+        return ret;
+    }
+    // The record is read and programmed as a whole number of units.
+    const bd_size_t unit = device->get_program_size() > device->get_read_size()
+                           ? device->get_program_size() : device->get_read_size();
+    bufferSize = (STARTUP_CACHE_RECORD_SIZE + unit - 1) / unit * unit;
+    delete[] buffer;
+    buffer = new uint8_t[bufferSize];
+
+    ret = device->read(buffer, 0, bufferSize);
+    if (ret != 0) {
+        return ret;
+    }
+    if (getLe32(buffer) != STARTUP_CACHE_MAGIC
+            || getLe32(buffer + STARTUP_CACHE_CRC_OFFSET) != crc32(buffer, STARTUP_CACHE_CRC_OFFSET)) {
+        return -1;
+    }
+    hostCrc = getLe32(buffer + 4);
+    address.version = (nsapi_version_t)buffer[8];
+    port = buffer[10] | (buffer[11] << 8);
+    memcpy(address.bytes, buffer + 12, sizeof(address.bytes));
+    syncTime = getLe32(buffer + 28);
+    driftPpm = (int32_t)getLe32(buffer + 32);
+    return 0;
+}
+
+void StartupCache::encode(uint8_t *buffer) const
+{
+    memset(buffer, 0xFF, bufferSize);
+    putLe32(buffer, STARTUP_CACHE_MAGIC);
+    putLe32(buffer + 4, hostCrc);
+    buffer[8] = (uint8_t)address.version;
+    buffer[9] = 0;
+    buffer[10] = (uint8_t)port;
+    buffer[11] = (uint8_t)(port >> 8);
+    memcpy(buffer + 12, address.bytes, sizeof(address.bytes));
+    putLe32(buffer + 28, syncTime);
+    putLe32(buffer + 32, (uint32_t)driftPpm);
+    putLe32(buffer + STARTUP_CACHE_CRC_OFFSET, crc32(buffer, STARTUP_CACHE_CRC_OFFSET));
+}
+
+int StartupCache::save()
+{
+    if (!dirty || !buffer) {
+        return 0;
+    }
+    encode(buffer);
+    int ret = device->erase(0, device->get_erase_size());
+    if (ret == 0) {
+        ret = device->program(buffer, 0, bufferSize);
+    }
+    if (ret == 0) {
+        dirty = false;
+    }
+    return ret;
+}
+
+bool StartupCache::brokerAddress(const char *host, SocketAddress &address) const
+{
+    if (this->address.version == NSAPI_UNSPEC || hostCrc != crc32(host, strlen(host))) {
+        return false;
+    }
+    address.set_addr(this->address);
+    address.set_port(port);
+    return true;
+}
+
+void StartupCache::setBrokerAddress(const char *host, const SocketAddress &address)
+{
+    const uint32_t crc = crc32(host, strlen(host));
+    const nsapi_addr_t addr = address.get_addr();
+    if (crc != hostCrc || address.get_port() != port || addr.version != this->address.version
+            || memcmp(addr.bytes, this->address.bytes, sizeof(addr.bytes)) != 0) {
+        hostCrc = crc;
+        this->address = addr;
+        port = address.get_port();
+        dirty = true;
+    }
+}
+
+void StartupCache::setTimeSync(time_t syncTime, int32_t driftPpm)
+{
+    if ((uint32_t)syncTime != this->syncTime || driftPpm != this->driftPpm) {
+        this->syncTime = (uint32_t)syncTime;
+        this->driftPpm = driftPpm;
+        dirty = true;
+    }
+}
@@ -0,0 +1,71 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __STARTUP_CACHE_H__
+#define __STARTUP_CACHE_H__
+
+#include "mbed.h"
+#include "BlockDevice.h"
+
+/*
+ * What a warm boot can reuse from the previous run: the broker address of
+ * the last successful connect, so the first connect skips the DNS lookup,
+ * and the time and RTC drift of the last NTP sync, so TLS can start on the
+ * RTC while NTP runs alongside.
+ *
+ * Kept as one CRC-protected record at the start of a BlockDevice. The
+ * address is stored with a CRC of the host name it belongs to, so changing
+ * MQTT_SERVER_HOST_NAME invalidates it.
+ */
+class StartupCache {
+public:
+    StartupCache(BlockDevice *device);
+    ~StartupCache();
+
+    /* Initializes the device and reads the record. Returns 0, -1 if there is no valid record, or a BlockDevice error code. */
+    int load();
+
+    /* Writes the record if it changed. Returns 0 or a BlockDevice error code. */
+    int save();
+
+    /* Broker address of `host` from the last run. Returns false if there is none. */
+    bool brokerAddress(const char *host, SocketAddress &address) const;
+    void setBrokerAddress(const char *host, const SocketAddress &address);
+
+    /* Time of the last NTP sync, 0 if none. */
+    time_t lastSyncTime() const { return (time_t)syncTime; }
+    /* How much the RTC ran fast between the last two syncs, in parts per million. */
+    int32_t rtcDriftPpm() const { return driftPpm; }
+    void setTimeSync(time_t syncTime, int32_t driftPpm);
+
+private:
+    void encode(uint8_t *buffer) const;
+
+    BlockDevice *device;
+    uint8_t *buffer;
+    bd_size_t bufferSize;
+    bool dirty;
+
+    uint32_t hostCrc;
+    nsapi_addr_t address;
+    uint16_t port;
+    uint32_t syncTime;
+    int32_t driftPpm;
+};
+
+#endif /* __STARTUP_CACHE_H__ */
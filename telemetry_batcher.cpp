@@ -0,0 +1,250 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "telemetry_batcher.h"
+#include "cbor_encoder.h"
+#include "topic_builder.h"
+
+/* TLS record header, explicit nonce and tag added by an AES-GCM record. */
+#define TLS_RECORD_OVERHEAD     (5 + 8 + 16)
+
+static void putLe32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* Size of the PUBLISH fixed and variable header, including the packet id for QoS1. */
+static size_t mqttPublishOverhead(size_t topicLength, size_t payloadLength, bool qos1)
+{
+    const size_t variableHeader = 2 + topicLength + (qos1 ? 2 : 0);
+    size_t remaining = variableHeader + payloadLength;
+    size_t lengthBytes = 1;
+    while (remaining >= 128 && lengthBytes < 4) {
+        remaining /= 128;
+        lengthBytes++;
+    }
+    return 1 + lengthBytes + variableHeader;
+}
+
+TelemetryBatcher::TelemetryBatcher(MQTTClient *client, const char *topic, char *buffer, size_t capacity,
+                                   int format, uint32_t maxAgeMs)
+    : client(client), qos1Publisher(NULL), profiler(NULL), log(DeferredLog::immediate()), topic(topic), topicLength(strlen(topic)),
+      topicBuffer(NULL), topicBufferSize(0), buffer(buffer), capacity(capacity), batchRecords(NULL),
+      maxBatchRecords(0), format(format),
+      maxAgeMs(maxAgeMs), length(0), count(0), firstAddedMs(0), firstSequence(0), messageId(0),
+      batchesSent(0), recordsSent(0), payloadBytesSent(0), wireBytesSent(0), publishErrors(0)
+{
+}
+
+bool TelemetryBatcher::append(const TelemetryRecord &record)
+{
+    if (batchRecords && count >= maxBatchRecords) {
+        return false;
+    }
+    const size_t newLength = encodeRecord(format, record, count, buffer, length, capacity);
+    if (newLength == 0) {
+        return false;
+    }
+    length = newLength;
+    if (batchRecords) {
+        batchRecords[count] = record;
+    }
+    return true;
+}
+
+bool TelemetryBatcher::fits(const TelemetryRecord &record) const
+{
+    if (batchRecords && count >= maxBatchRecords) {
+        return false;
+    }
+    // Encodes behind the batch without taking the bytes.
+    return encodeRecord(format, record, count, buffer, length, capacity) != 0;
+}
+
+size_t TelemetryBatcher::encodeRecord(int format, const TelemetryRecord &record, unsigned int count,
+                                      char *buffer, size_t length, size_t capacity)
+{
+    if (format == TELEMETRY_BATCH_FORMAT_BINARY) {
+        const size_t header = (count == 0) ? 1 : 0;
+        if (length + header + TELEMETRY_BINARY_RECORD_SIZE > capacity) {
+            return 0;
+        }
+        uint8_t *p = (uint8_t*)buffer + length;
+        if (header) {
+            *p++ = TELEMETRY_BINARY_VERSION;
+        }
+        putLe32(p, record.timestamp);
+        putLe32(p + 4, record.sequence);
+        putLe32(p + 8, (uint32_t)record.value);
+        p[12] = (uint8_t)record.source;
+        p[13] = (uint8_t)(record.source >> 8);
+        return length + header + TELEMETRY_BINARY_RECORD_SIZE;
+    }
+
+    if (format == TELEMETRY_BATCH_FORMAT_CBOR) {
+        // One byte is always kept for the break.
+        if (length + 1 >= capacity) {
+            return 0;
+        }
+        CborEncoder cbor((uint8_t*)buffer + length, capacity - length - 1);
+        if (count == 0) {
+            cbor.encodeIndefiniteArray();
+        }
+        cbor.encodeMap(4);
+        cbor.encodeText("seq", 3);
+        cbor.encodeUnsigned(record.sequence);
+        cbor.encodeText("ts", 2);
+        cbor.encodeUnsigned(record.timestamp);
+        cbor.encodeText("src", 3);
+        cbor.encodeUnsigned(record.source);
+        cbor.encodeText("v", 1);
+        cbor.encodeInt(record.value);
+        return cbor.overflowed() ? 0 : length + cbor.size();
+    }
+
+    // JSON array. One byte is always kept for the closing ']'.
+    char element[80];
+    int n = snprintf(element, sizeof(element), "%c{\"seq\":%lu,\"ts\":%lu,\"src\":%u,\"v\":%ld}",
+                     (count == 0) ? '[' : ',', (unsigned long)record.sequence,
+                     (unsigned long)record.timestamp, (unsigned int)record.source, (long)record.value);
+    if (n <= 0 || length + n + 1 > capacity) {
+        return 0;
+    }
+    memcpy(buffer + length, element, n);
+    return length + n;
+}
+
+size_t TelemetryBatcher::encodeEnd(int format, char *buffer, size_t length)
+{
+    if (format == TELEMETRY_BATCH_FORMAT_JSON) {
+        buffer[length++] = ']';
+    } else if (format == TELEMETRY_BATCH_FORMAT_CBOR) {
+        buffer[length++] = (char)CBOR_BREAK;
+    }
+    return length;
+}
+
+int TelemetryBatcher::add(const TelemetryRecord &record)
+{
+    int rc = MQTT::SUCCESS;
+    if (!append(record)) {
+        rc = flush();
+        if (!append(record)) {
+            // Does not fit even into an empty batch.
+            publishErrors++;
+            return MQTT::FAILURE;
+        }
+    }
+    if (count++ == 0) {
+        firstAddedMs = Kernel::get_ms_count();
+        firstSequence = record.sequence;
+    }
+    if (maxAgeMs == 0) {
+        int flushed = flush();
+        if (rc == MQTT::SUCCESS) {
+            rc = flushed;
+        }
+    }
+    return rc;
+}
+
+int TelemetryBatcher::poll()
+{
+    if (count == 0 || Kernel::get_ms_count() - firstAddedMs < maxAgeMs) {
+        return MQTT::SUCCESS;
+    }
+    return flush();
+}
+
+int TelemetryBatcher::flush()
+{
+    if (count == 0) {
+        return MQTT::SUCCESS;
+    }
+    length = encodeEnd(format, buffer, length);
+
+    MQTT::Message message;
+    message.retained = false;
+    message.dup = false;
+    message.qos = MQTT::QOS0;
+    message.id = messageId++;
+    message.payload = (void*)buffer;
+    message.payloadlen = length;
+
+    const char *publishTopic = topic;
+    size_t publishTopicLength = topicLength;
+    if (topicBuffer) {
+        TopicWriter writer(topicBuffer, topicBufferSize, topic, topicLength);
+        writer.property("$.mid", firstSequence);
+        if (!writer.overflowed()) {
+            publishTopic = writer.c_str();
+            publishTopicLength = writer.size();
+        }
+    }
+
+    log->write(LOG_PUBLISHING, count, length, firstSequence);
+    if (profiler) {
+        profiler->begin(PHASE_PUBLISH);
+    }
+    int rc;
+    if (qos1Publisher) {
+        rc = qos1Publisher->publish(publishTopic, message);
+    } else if (client) {
+        rc = client->publish(publishTopic, message);
+    } else {
+        rc = MQTT::FAILURE;
+    }
+    if (profiler) {
+        profiler->end(PHASE_PUBLISH);
+    }
+    if (rc == MQTT::SUCCESS) {
+        batchesSent++;
+        recordsSent += count;
+        payloadBytesSent += length;
+        wireBytesSent += length + mqttPublishOverhead(publishTopicLength, length, qos1Publisher != NULL) + TLS_RECORD_OVERHEAD;
+        log->write(LOG_PUBLISHED);
+        if (publishedHandler) {
+            publishedHandler(message.id);
+        }
+    } else {
+        publishErrors++;
+        log->write(LOG_PUBLISH_ERROR, (uint32_t)rc);
+        // Without a handler a failed batch is dropped, the same as a failed QoS0 publish.
+        if (batchRecords && failedBatchHandler) {
+            failedBatchHandler(batchRecords, count);
+        }
+    }
+
+    length = 0;
+    count = 0;
+    return rc;
+}
+
+void TelemetryBatcher::printStats() const
+{
+    printf("Batches: %lu, records: %lu, errors: %lu\r\n",
+           (unsigned long)batchesSent, (unsigned long)recordsSent, (unsigned long)publishErrors);
+    if (recordsSent > 0) {
+        printf("Bytes per record: %lu payload, %lu on wire\r\n",
+               (unsigned long)(payloadBytesSent / recordsSent),
+               (unsigned long)(wireBytesSent / recordsSent));
+    }
+}
@@ -0,0 +1,185 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TELEMETRY_BATCHER_H__
+#define __TELEMETRY_BATCHER_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+#include "telemetry_queue.h"
+#include "qos1_publisher.h"
+#include "phase_profiler.h"
+#include "deferred_log.h"
+
+/* Payload encodings of a batch, selected with telemetry-batch-format in mbed_app.json. */
+#define TELEMETRY_BATCH_FORMAT_JSON     1
+#define TELEMETRY_BATCH_FORMAT_BINARY   2
+#define TELEMETRY_BATCH_FORMAT_CBOR     3
+
+/*
+ * Content type ($.ct) of each format and content encoding ($.ce) of JSON, for
+ * the property bag of the events topic. Message routing can only query the
+ * body of JSON messages declared as UTF-8.
+ */
+#define TELEMETRY_BATCH_CONTENT_TYPE_JSON       "application/json"
+#define TELEMETRY_BATCH_CONTENT_TYPE_BINARY     "application/octet-stream"
+#define TELEMETRY_BATCH_CONTENT_TYPE_CBOR       "application/cbor"
+#define TELEMETRY_BATCH_CONTENT_ENCODING_JSON   "utf-8"
+
+/* Longest "&$.mid=<sequence>" added by enableMessageId(). */
+#define TELEMETRY_MESSAGE_ID_PROPERTY_SIZE      (7 + 10)
+
+/* First byte of a binary batch. Followed by TELEMETRY_BINARY_RECORD_SIZE bytes per record. */
+#define TELEMETRY_BINARY_VERSION        0x01
+/* timestamp(4) sequence(4) value(4) source(2), all little endian. */
+#define TELEMETRY_BINARY_RECORD_SIZE    14
+
+/*
+ * A CBOR batch is an indefinite-length array of maps with the keys of the
+ * JSON format, e.g. [_ {"seq": 0, "ts": 1234, "src": 1, "v": 1}].
+ */
+
+/* Called with the packet id of every batch handed to the client or the QoS1 window. */
+typedef Callback<void(uint16_t packetId)> TelemetryPublishedHandler;
+
+/* Called with the records of a batch whose publish failed. */
+typedef Callback<void(const TelemetryRecord *records, unsigned int count)> TelemetryFailedBatchHandler;
+
+/*
+ * Coalesces telemetry records into one MQTT PUBLISH.
+ *
+ * Records are appended to the caller-provided payload buffer until the next
+ * one would not fit, the oldest record in the batch gets older than the age
+ * deadline, or flush() is called. A deadline of 0 publishes every record on
+ * its own.
+ */
+class TelemetryBatcher {
+public:
+    TelemetryBatcher(MQTTClient *client, const char *topic, char *buffer, size_t capacity,
+                     int format, uint32_t maxAgeMs);
+
+    /*
+     * Appends a record, publishing the current batch first if the record does
+     * not fit. Returns MQTT::SUCCESS or the return code of a failed publish.
+     */
+    int add(const TelemetryRecord &record);
+
+    /* Publishes the batch if its age deadline has passed. */
+    int poll();
+
+    /* Publishes the batch if it holds any record. */
+    int flush();
+
+    bool empty() const { return count == 0; }
+
+    /* Publishes through `client` from now on, e.g. after reconnecting. */
+    void setClient(MQTTClient *client) { this->client = client; }
+
+    /* Publishes batches at QoS1 through `publisher` instead of QoS0 through the client. */
+    void setQos1Publisher(Qos1Publisher *publisher) { qos1Publisher = publisher; }
+
+    /* Changes the age deadline, e.g. from a desired twin property. Applies from the next record on. */
+    void setMaxAgeMs(uint32_t maxAgeMs) { this->maxAgeMs = maxAgeMs; }
+    uint32_t maxAge() const { return maxAgeMs; }
+
+    /* Records every publish as PHASE_PUBLISH in `profiler`. */
+    void setProfiler(PhaseProfiler *profiler) { this->profiler = profiler; }
+
+    /* Logs publishes through `log` instead of printing them right away. */
+    void setLog(DeferredLog *log) { this->log = log; }
+
+    /* Calls `handler` after every successful publish, e.g. to track its PUBACK. */
+    void onPublished(TelemetryPublishedHandler handler) { publishedHandler = handler; }
+
+    /* True if `record` fits into the current batch, so add() will not publish the batch first. */
+    bool fits(const TelemetryRecord &record) const;
+
+    /*
+     * Keeps a copy of the records of the current batch in `records`, at most
+     * `maxRecords` per batch, and hands them to `handler` if the batch cannot
+     * be published instead of dropping them, e.g. to store them in the outbox.
+     */
+    void onPublishFailed(TelemetryRecord *records, size_t maxRecords, TelemetryFailedBatchHandler handler)
+    {
+        batchRecords = records;
+        maxBatchRecords = maxRecords;
+        failedBatchHandler = handler;
+    }
+
+    /*
+     * Adds the sequence number of its first record to the topic of every
+     * batch as message id ($.mid), building the topic in `topicBuffer`. The
+     * buffer needs room for the topic, TELEMETRY_MESSAGE_ID_PROPERTY_SIZE
+     * and the terminating NUL. A batch replayed from the outbox keeps its id
+     * as long as it starts with the same record.
+     */
+    void enableMessageId(char *topicBuffer, size_t size)
+    {
+        this->topicBuffer = topicBuffer;
+        topicBufferSize = size;
+    }
+
+    /* Prints counters and average bytes on wire per record to the console. */
+    void printStats() const;
+
+    /*
+     * Encodes `record` in `format` after the `count` records taking `length`
+     * bytes of `buffer`, keeping room for encodeEnd(). Returns the new length,
+     * or 0 if the record does not fit into `capacity` bytes.
+     */
+    static size_t encodeRecord(int format, const TelemetryRecord &record, unsigned int count,
+                               char *buffer, size_t length, size_t capacity);
+
+    /* Completes a batch of `length` bytes written by encodeRecord(). Returns the new length. */
+    static size_t encodeEnd(int format, char *buffer, size_t length);
+
+private:
+    bool append(const TelemetryRecord &record);
+
+    MQTTClient *client;
+    Qos1Publisher *qos1Publisher;
+    PhaseProfiler *profiler;
+    DeferredLog *log;
+    const char *topic;
+    size_t topicLength;
+    char *topicBuffer;      // Topic with the message id, NULL if not enabled.
+    size_t topicBufferSize;
+    char *buffer;
+    size_t capacity;
+    TelemetryRecord *batchRecords;  // Copy of the records in the batch, NULL if not kept.
+    size_t maxBatchRecords;
+    TelemetryFailedBatchHandler failedBatchHandler;
+    TelemetryPublishedHandler publishedHandler;
+    int format;
+    uint32_t maxAgeMs;
+
+    size_t length;          // Bytes used in buffer.
+    unsigned int count;     // Records in the current batch.
+    uint64_t firstAddedMs;  // Kernel tick of the oldest record in the batch.
+    uint32_t firstSequence; // Sequence number of the oldest record in the batch.
+    unsigned short messageId;
+
+    // Statistics
+    uint32_t batchesSent;
+    uint32_t recordsSent;
+    uint32_t payloadBytesSent;
+    uint32_t wireBytesSent;  // Payload plus MQTT and TLS record overhead.
+    uint32_t publishErrors;
+};
+
+#endif /* __TELEMETRY_BATCHER_H__ */
@@ -0,0 +1,393 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "telemetry_outbox.h"
+
+/*
+ * Slot layout, all little endian:
+ *   magic(4) word1(4) word2(4) payload(16) crc32(4), padded to the program size.
+ * Block header: word1 = generation, word2 = id of the first record.
+ * Entry:        word1 = type,       word2 = id of the record, or of the next
+ *                                           record for an acknowledgement.
+ */
+#define OUTBOX_HEADER_MAGIC     0x4F425848  // "OBXH"
+#define OUTBOX_ENTRY_MAGIC      0x4F425845  // "OBXE"
+#define OUTBOX_SLOT_DATA_SIZE   32
+#define OUTBOX_PAYLOAD_OFFSET   12
+#define OUTBOX_PAYLOAD_SIZE     16
+#define OUTBOX_CRC_OFFSET       28
+
+#define OUTBOX_ENTRY_RECORD     1
+#define OUTBOX_ENTRY_ACK        2
+
+/* Bytes of a record as the batcher's binary format stores them. */
+#define OUTBOX_RECORD_SIZE      14
+
+static void putLe32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t getLe32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t crc32(const uint8_t *data, size_t length)
+{
+    MbedCRC<POLY_32BIT_ANSI, 32> crc;
+    uint32_t result = 0;
+    crc.compute((void*)data, length, &result);
+    return result;
+}
+
+TelemetryOutbox::TelemetryOutbox(BlockDevice *device)
+    : device(device), slotBuffer(NULL), slotSize(0), blockSize(0), blockCount(0), slotsPerBlock(0),
+      headBlock(0), headFirstId(1), tailBlock(0), tailSlot(0), tailGeneration(0), nextId(1), ackedId(0),
+      readId(1), appendedCount(0), readCount(0), droppedCount(0), eraseCount(0), bytesProgrammed(0)
+{
+    readPos.block = 0;
+    readPos.slot = 0;
+}
+
+TelemetryOutbox::~TelemetryOutbox()
+{
+    delete[] slotBuffer;
+}
+
+int TelemetryOutbox::writeSlot(uint32_t block, uint32_t slot, uint32_t magic, uint32_t word1, uint32_t word2,
+                               const uint8_t *payload)
+{
+    memset(slotBuffer, 0xFF, slotSize);
+    putLe32(slotBuffer, magic);
+    putLe32(slotBuffer + 4, word1);
+    putLe32(slotBuffer + 8, word2);
+    memset(slotBuffer + OUTBOX_PAYLOAD_OFFSET, 0, OUTBOX_PAYLOAD_SIZE);
+    if (payload) {
+        memcpy(slotBuffer + OUTBOX_PAYLOAD_OFFSET, payload, OUTBOX_PAYLOAD_SIZE);
+    }
+    putLe32(slotBuffer + OUTBOX_CRC_OFFSET, crc32(slotBuffer, OUTBOX_CRC_OFFSET));
+    bytesProgrammed += slotSize;
+    return device->program(slotBuffer, (bd_addr_t)block * blockSize + slot * slotSize, slotSize);
+}
+
+bool TelemetryOutbox::readSlot(uint32_t block, uint32_t slot, uint32_t magic, uint32_t &word1, uint32_t &word2,
+                               uint8_t *payload)
+{
+    if (device->read(slotBuffer, (bd_addr_t)block * blockSize + slot * slotSize, slotSize) != 0
+            || getLe32(slotBuffer) != magic
+            || getLe32(slotBuffer + OUTBOX_CRC_OFFSET) != crc32(slotBuffer, OUTBOX_CRC_OFFSET)) {
+        return false;
+    }
+    word1 = getLe32(slotBuffer + 4);
+    word2 = getLe32(slotBuffer + 8);
+    if (payload) {
+        memcpy(payload, slotBuffer + OUTBOX_PAYLOAD_OFFSET, OUTBOX_PAYLOAD_SIZE);
+    }
+    return true;
+}
+
+bool TelemetryOutbox::readBlockHeader(uint32_t block, uint32_t &generation, uint32_t &firstId)
+{
+    return readSlot(block, 0, OUTBOX_HEADER_MAGIC, generation, firstId, NULL);
+}
+
+bool TelemetryOutbox::readEntry(uint32_t block, uint32_t slot, uint32_t expectedId, uint8_t &type, uint8_t *payload)
+{
+    uint32_t word1, id;
+    if (!readSlot(block, slot + 1, OUTBOX_ENTRY_MAGIC, word1, id, payload) || id != expectedId) {
+        return false;
+    }
+    type = (uint8_t)word1;
+    return type == OUTBOX_ENTRY_RECORD || type == OUTBOX_ENTRY_ACK;
+}
+
+bool TelemetryOutbox::isBlank(uint32_t block, uint32_t slot)
+{
+    const int eraseValue = device->get_erase_value();
+    if (eraseValue < 0) {
+        // Programming over programmed bytes is allowed, e.g. on a HeapBlockDevice.
+        return true;
+    }
+    if (device->read(slotBuffer, (bd_addr_t)block * blockSize + (slot + 1) * slotSize, slotSize) != 0) {
+        return false;
+    }
+    for (bd_size_t i = 0; i < slotSize; i++) {
+        if (slotBuffer[i] != (uint8_t)eraseValue) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int TelemetryOutbox::startBlock(uint32_t block)
+{
+    int ret = device->erase((bd_addr_t)block * blockSize, blockSize);
+    eraseCount++;
+    if (ret == 0) {
+        ret = writeSlot(block, 0, OUTBOX_HEADER_MAGIC, tailGeneration + 1, nextId, NULL);
+    }
+    // The block is used even if this failed, the next block gets the next generation.
+    tailBlock = block;
+    tailGeneration++;
+    tailSlot = 0;
+    return ret;
+}
+
+int TelemetryOutbox::format()
+{
+    headBlock = 0;
+    headFirstId = nextId;
+    return startBlock(0);
+}
+
+int TelemetryOutbox::init()
+{
+    int ret = device->init();
+    if (ret != 0) {
+        return ret;
+    }
+    // One slot holds one entry and is a whole number of program units.
+    const bd_size_t unit = device->get_program_size() > device->get_read_size()
+                           ? device->get_program_size() : device->get_read_size();
+    slotSize = (OUTBOX_SLOT_DATA_SIZE + unit - 1) / unit * unit;
+    blockSize = device->get_erase_size();
+    blockCount = device->size() / blockSize;
+    slotsPerBlock = (blockSize / slotSize > 0) ? blockSize / slotSize - 1 : 0;
+    if (blockCount < 2 || slotsPerBlock == 0) {
+        printf("ERROR: outbox needs at least two erase blocks of two slots each.\r\n");
+        return -1;
+    }
+    delete[] slotBuffer;
+    slotBuffer = new uint8_t[slotSize];
+
+    // The tail is the block with the newest generation, the head the oldest
+    // one reachable by walking back through consecutive generations.
+    bool found = false;
+    uint32_t generation, firstId;
+    for (uint32_t b = 0; b < blockCount; b++) {
+        if (readBlockHeader(b, generation, firstId) && (!found || generation > tailGeneration)) {
+            found = true;
+            tailBlock = b;
+            tailGeneration = generation;
+        }
+    }
+    if (!found) {
+        return format();
+    }
+    headBlock = tailBlock;
+    uint32_t headGeneration = tailGeneration;
+    for (uint32_t i = 1; i < blockCount; i++) {
+        const uint32_t prev = (headBlock == 0) ? blockCount - 1 : headBlock - 1;
+        if (!readBlockHeader(prev, generation, firstId) || generation + 1 != headGeneration) {
+            break;
+        }
+        headBlock = prev;
+        headGeneration = generation;
+    }
+
+    // Replay the log to find the next record id, the last acknowledgement and the tail slot.
+    uint8_t payload[OUTBOX_PAYLOAD_SIZE];
+    uint8_t type;
+    uint32_t block = headBlock;
+    readBlockHeader(headBlock, generation, headFirstId);
+    nextId = headFirstId;
+    ackedId = 0;
+    for (;;) {
+        readBlockHeader(block, generation, firstId);
+        if (firstId > nextId) {
+            // Records lost to a failed write, carry on after them.
+            nextId = firstId;
+        }
+        uint32_t lastValid = 0;
+        bool any = false;
+        for (uint32_t s = 0; s < slotsPerBlock; s++) {
+            if (!readEntry(block, s, nextId, type, payload)) {
+                continue;
+            }
+            if (type == OUTBOX_ENTRY_RECORD) {
+                nextId++;
+            } else if (getLe32(payload) > ackedId) {
+                ackedId = getLe32(payload);
+            }
+            lastValid = s;
+            any = true;
+        }
+        if (block == tailBlock) {
+            tailSlot = any ? lastValid + 1 : 0;
+            // Never program over a torn write.
+            if (tailSlot < slotsPerBlock && !isBlank(tailBlock, tailSlot)) {
+                tailSlot = slotsPerBlock;
+            }
+            break;
+        }
+        block = next(block);
+    }
+    if (ackedId < headFirstId - 1) {
+        ackedId = headFirstId - 1;
+    }
+    if (ackedId > nextId - 1) {
+        ackedId = nextId - 1;
+    }
+    releaseAcknowledged();
+    rewind();
+    return 0;
+}
+
+void TelemetryOutbox::dropHead()
+{
+    uint32_t generation, firstId;
+    headBlock = next(headBlock);
+    if (!readBlockHeader(headBlock, generation, firstId)) {
+        firstId = nextId;
+    }
+    headFirstId = firstId;
+    if (firstId - 1 > ackedId) {
+        droppedCount += firstId - 1 - ackedId;
+        ackedId = firstId - 1;
+    }
+    if (readId <= headFirstId) {
+        rewind();
+    }
+}
+
+void TelemetryOutbox::releaseAcknowledged()
+{
+    uint32_t generation, firstId;
+    while (headBlock != tailBlock) {
+        const uint32_t candidate = next(headBlock);
+        if (!readBlockHeader(candidate, generation, firstId) || firstId - 1 > ackedId) {
+            break;
+        }
+        // Everything in the head block is acknowledged. It is erased when the ring comes round to it.
+        headBlock = candidate;
+        headFirstId = firstId;
+    }
+    if (readId <= headFirstId) {
+        rewind();
+    }
+}
+
+int TelemetryOutbox::appendEntry(uint8_t type, const uint8_t *payload)
+{
+    if (tailSlot >= slotsPerBlock) {
+        const uint32_t block = next(tailBlock);
+        if (block == headBlock) {
+            // Ring is full, give up the oldest records.
+            dropHead();
+        }
+        int ret = startBlock(block);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    const int ret = writeSlot(tailBlock, tailSlot + 1, OUTBOX_ENTRY_MAGIC, type, nextId, payload);
+    // A failed write leaves a hole, which readers skip.
+    tailSlot++;
+    return ret;
+}
+
+int TelemetryOutbox::append(const TelemetryRecord &record)
+{
+    uint8_t payload[OUTBOX_PAYLOAD_SIZE] = { 0 };
+    putLe32(payload, record.timestamp);
+    putLe32(payload + 4, record.sequence);
+    putLe32(payload + 8, (uint32_t)record.value);
+    payload[12] = (uint8_t)record.source;
+    payload[13] = (uint8_t)(record.source >> 8);
+
+    int ret = appendEntry(OUTBOX_ENTRY_RECORD, payload);
+    if (ret == 0) {
+        nextId++;
+        appendedCount++;
+    }
+    return ret;
+}
+
+bool TelemetryOutbox::readNext(TelemetryRecord &record)
+{
+    uint8_t payload[OUTBOX_PAYLOAD_SIZE];
+    uint8_t type;
+    while (readPos.block != tailBlock || readPos.slot < tailSlot) {
+        if (readPos.slot >= slotsPerBlock) {
+            uint32_t generation, firstId;
+            readPos.block = next(readPos.block);
+            readPos.slot = 0;
+            if (readBlockHeader(readPos.block, generation, firstId) && firstId > readId) {
+                readId = firstId;
+            }
+            continue;
+        }
+        const bool valid = readEntry(readPos.block, readPos.slot, readId, type, payload);
+        readPos.slot++;
+        if (!valid || type != OUTBOX_ENTRY_RECORD) {
+            continue;
+        }
+        if (readId++ <= ackedId) {
+            continue;
+        }
+        record.timestamp = getLe32(payload);
+        record.sequence = getLe32(payload + 4);
+        record.value = (int32_t)getLe32(payload + 8);
+        record.source = (uint16_t)(payload[12] | (payload[13] << 8));
+        readCount++;
+        return true;
+    }
+    return false;
+}
+
+int TelemetryOutbox::acknowledge(uint32_t lastId)
+{
+    const uint32_t lastRead = (lastId < readId - 1) ? lastId : readId - 1;
+    if (lastRead <= ackedId) {
+        return 0;
+    }
+    uint8_t payload[OUTBOX_PAYLOAD_SIZE] = { 0 };
+    putLe32(payload, lastRead);
+    // Acknowledged in RAM even if the marker cannot be written, they would only be sent again after a reboot.
+    ackedId = lastRead;
+    const int ret = appendEntry(OUTBOX_ENTRY_ACK, payload);
+    releaseAcknowledged();
+    return ret;
+}
+
+void TelemetryOutbox::rewind()
+{
+    readPos.block = headBlock;
+    readPos.slot = 0;
+    readId = headFirstId;
+}
+
+uint32_t TelemetryOutbox::writeAmplificationX100() const
+{
+    if (appendedCount == 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)bytesProgrammed * 100 / ((uint64_t)appendedCount * OUTBOX_RECORD_SIZE));
+}
+
+void TelemetryOutbox::printStats() const
+{
+    const uint32_t wa = writeAmplificationX100();
+    printf("Outbox: %lu appended, %lu replayed, %lu pending, %lu dropped, %lu erases, write amplification %lu.%02lu\r\n",
+           (unsigned long)appendedCount, (unsigned long)readCount, (unsigned long)pending(),
+           (unsigned long)droppedCount, (unsigned long)eraseCount, (unsigned long)(wa / 100), (unsigned long)(wa % 100));
+}
@@ -0,0 +1,130 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TELEMETRY_OUTBOX_H__
+#define __TELEMETRY_OUTBOX_H__
+
+#include "mbed.h"
+#include "BlockDevice.h"
+#include "telemetry_queue.h"
+
+/*
+ * Persistent store-and-forward queue of telemetry records on a BlockDevice.
+ *
+ * The device is used as a ring of erase blocks written strictly in order,
+ * so every block is erased equally often. Each block starts with a header
+ * slot holding the block's generation and the id of its first record,
+ * followed by fixed-size entry slots. An entry is either a record or an
+ * acknowledgement marker. Records are numbered consecutively, and every
+ * entry carries the id of the record it is or precedes plus a CRC, so a
+ * torn write or stale data from the previous use of the block ends the
+ * scan in init().
+ *
+ * Records are read back in order with readNext() and confirmed with
+ * acknowledge(), which appends a marker instead of rewriting anything.
+ * Blocks whose records are all acknowledged are released for reuse. When
+ * the ring is full the oldest block is overwritten and its unacknowledged
+ * records are counted as dropped.
+ */
+class TelemetryOutbox {
+public:
+    TelemetryOutbox(BlockDevice *device);
+    ~TelemetryOutbox();
+
+    /*
+     * Initializes the device and recovers the outbox from it, or formats it
+     * if it holds none. Returns 0 or a BlockDevice error code, -1 if the
+     * device is too small.
+     */
+    int init();
+
+    /* Appends a record. Returns 0 or a BlockDevice error code. */
+    int append(const TelemetryRecord &record);
+
+    /* Reads the record after the last one read. Returns false if every record has been read. */
+    bool readNext(TelemetryRecord &record);
+
+    /* Marks every record read so far as delivered. Returns 0 or a BlockDevice error code. */
+    int acknowledge() { return acknowledge(readId - 1); }
+
+    /*
+     * Marks the records up to id `lastId` as delivered, e.g. once the PUBACK
+     * of the batch ending with it arrived, see lastReadId(). Records not
+     * read yet are not acknowledged. Returns 0 or a BlockDevice error code.
+     */
+    int acknowledge(uint32_t lastId);
+
+    /* Id of the last record returned by readNext(). */
+    uint32_t lastReadId() const { return readId - 1; }
+
+    /* Reads again from the oldest unacknowledged record, e.g. after a failed publish. */
+    void rewind();
+
+    /* Number of records not acknowledged yet. */
+    uint32_t pending() const { return nextId - 1 - ackedId; }
+    bool empty() const { return pending() == 0; }
+
+    void printStats() const;
+
+    /* Bytes programmed to the device per byte of record appended, times 100. */
+    uint32_t writeAmplificationX100() const;
+
+private:
+    struct Position {
+        uint32_t block;
+        uint32_t slot;
+    };
+
+    int format();
+    int startBlock(uint32_t block);
+    int appendEntry(uint8_t type, const uint8_t *payload);
+    int writeSlot(uint32_t block, uint32_t slot, uint32_t magic, uint32_t word1, uint32_t word2, const uint8_t *payload);
+    bool readBlockHeader(uint32_t block, uint32_t &generation, uint32_t &firstId);
+    bool readSlot(uint32_t block, uint32_t slot, uint32_t magic, uint32_t &word1, uint32_t &word2, uint8_t *payload);
+    bool readEntry(uint32_t block, uint32_t slot, uint32_t expectedId, uint8_t &type, uint8_t *payload);
+    bool isBlank(uint32_t block, uint32_t slot);
+    void dropHead();
+    void releaseAcknowledged();
+    uint32_t next(uint32_t block) const { return (block + 1 == blockCount) ? 0 : block + 1; }
+
+    BlockDevice *device;
+    uint8_t *slotBuffer;
+    bd_size_t slotSize;
+    bd_size_t blockSize;
+    uint32_t blockCount;
+    uint32_t slotsPerBlock;     // Entry slots, not counting the header slot.
+
+    uint32_t headBlock;         // Oldest block still holding unacknowledged entries.
+    uint32_t headFirstId;       // Id of the first record in headBlock.
+    uint32_t tailBlock;         // Block being written.
+    uint32_t tailSlot;          // Next free entry slot in tailBlock.
+    uint32_t tailGeneration;
+    uint32_t nextId;            // Id of the next record to be written.
+    uint32_t ackedId;           // Every record up to this id is acknowledged.
+    Position readPos;           // Next slot readNext() looks at.
+    uint32_t readId;            // Id of the record at or after readPos.
+
+    // Statistics
+    uint32_t appendedCount;
+    uint32_t readCount;
+    uint32_t droppedCount;
+    uint32_t eraseCount;
+    uint32_t bytesProgrammed;
+};
+
+#endif /* __TELEMETRY_OUTBOX_H__ */
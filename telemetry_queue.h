@@ -0,0 +1,125 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TELEMETRY_QUEUE_H__
+#define __TELEMETRY_QUEUE_H__
+
+#include "mbed.h"
+
+/* A single telemetry event, sized so that it can be copied from an ISR. */
+struct TelemetryRecord {
+    uint32_t timestamp;     // us_ticker_read() at the time of the event.
+    uint32_t sequence;      // Incremented by the producer for every event, including dropped ones.
+    int32_t value;          // Sensor reading or event specific value.
+    uint16_t source;        // Identifies what produced the record, e.g. a button or a sensor.
+};
+
+/* Identifiers for TelemetryRecord::source. */
+enum TelemetrySource {
+    TELEMETRY_SOURCE_BUTTON = 1,
+    /* Summary of one window of the sensor pipeline, queued one after the other in this order. */
+    TELEMETRY_SOURCE_SENSOR_MIN = 2,
+    TELEMETRY_SOURCE_SENSOR_MAX = 3,
+    TELEMETRY_SOURCE_SENSOR_MEAN = 4,
+    TELEMETRY_SOURCE_SENSOR_COUNT = 5,
+};
+
+/*
+ * Fixed-capacity single-producer/single-consumer ring of TelemetryRecord.
+ *
+ * push() may be called from interrupt context and pop() from the main loop
+ * without any locking. Only the producer writes `head` and only the consumer
+ * writes `tail`; the atomic load/store pair orders the record copy against
+ * the index update. Capacity must be a power of two, one slot is kept free
+ * to tell a full ring from an empty one.
+ */
+template<uint32_t Capacity>
+class TelemetryQueue {
+public:
+    TelemetryQueue() : head(0), tail(0), overflowCount(0), sequence(0)
+    {
+        MBED_STATIC_ASSERT((Capacity & (Capacity - 1)) == 0 && Capacity >= 2,
+                           "TelemetryQueue capacity must be a power of two");
+    }
+
+    /*
+     * Producer side. Stamps the sequence number and timestamp and copies the
+     * record into the ring. Returns false and counts an overflow if the ring
+     * is full.
+     */
+    bool push(uint16_t source, int32_t value)
+    {
+        const uint32_t h = head;
+        const uint32_t next = (h + 1) & (Capacity - 1);
+        const uint32_t seq = sequence++;
+        if (next == core_util_atomic_load_u32(&tail)) {
+            overflowCount++;
+            return false;
+        }
+        TelemetryRecord &r = records[h];
+        r.timestamp = us_ticker_read();
+        r.sequence = seq;
+        r.value = value;
+        r.source = source;
+        core_util_atomic_store_u32(&head, next);
+        return true;
+    }
+
+    /* Consumer side. Copies the oldest record to `out`. Returns false if empty. */
+    bool pop(TelemetryRecord &out)
+    {
+        const uint32_t t = tail;
+        if (t == core_util_atomic_load_u32(&head)) {
+            return false;
+        }
+        out = records[t];
+        core_util_atomic_store_u32(&tail, (t + 1) & (Capacity - 1));
+        return true;
+    }
+
+    /* Consumer side. Copies the oldest record to `out` and leaves it queued. Returns false if empty. */
+    bool peek(TelemetryRecord &out) const
+    {
+        const uint32_t t = tail;
+        if (t == core_util_atomic_load_u32(&head)) {
+            return false;
+        }
+        out = records[t];
+        return true;
+    }
+
+    bool empty() const
+    {
+        return core_util_atomic_load_u32(&tail) == core_util_atomic_load_u32(&head);
+    }
+
+    /* Number of records dropped because the ring was full. */
+    uint32_t overflows() const
+    {
+        return core_util_atomic_load_u32(&overflowCount);
+    }
+
+private:
+    TelemetryRecord records[Capacity];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t overflowCount;
+    uint32_t sequence;
+};
+
+#endif /* __TELEMETRY_QUEUE_H__ */
@@ -0,0 +1,125 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "time_sync.h"
+#include "NTPClient.h"
+
+#define TIME_SYNC_STACK_SIZE            3072
+#define TIME_SYNC_NTP_PORT              123
+/* Delay before the first retry of a failed NTP query, doubled up to the maximum. */
+#define TIME_SYNC_RETRY_MIN_MS          1000
+#define TIME_SYNC_RETRY_MAX_MS          60000
+/* The RTC is not trusted if the last sync is older than this. */
+#define TIME_SYNC_MAX_RESTORE_AGE_S     (30 * 24 * 60 * 60)
+/* Drift is only measured over at least this long, the RTC has a resolution of one second. */
+#define TIME_SYNC_MIN_DRIFT_INTERVAL_S  (24 * 60 * 60)
+/* Measurements beyond this are taken as the RTC having been reset or set by hand. */
+#define TIME_SYNC_MAX_DRIFT_PPM         500
+
+TimeSync::TimeSync(NetworkInterface *network, const char *server, PhaseProfiler *profiler)
+    : network(network), server(server), profiler(profiler), thread(NULL), isRestored(false), lastSyncTime(0),
+      driftPpm(0), correctionS(0), syncTime(0)
+{
+}
+
+TimeSync::~TimeSync()
+{
+    if (thread) {
+        thread->terminate();
+        delete thread;
+    }
+}
+
+bool TimeSync::restore(const StartupCache &cache)
+{
+    lastSyncTime = cache.lastSyncTime();
+    driftPpm = cache.rtcDriftPpm();
+    const time_t now = time(NULL);
+    if (lastSyncTime == 0 || now < lastSyncTime || now - lastSyncTime > TIME_SYNC_MAX_RESTORE_AGE_S) {
+        return false;
+    }
+    // An RTC running fast is ahead by its drift times the time since the sync.
+    correctionS = -(int32_t)((int64_t)(now - lastSyncTime) * driftPpm / 1000000);
+    if (correctionS != 0) {
+        set_time(now + correctionS);
+    }
+    isRestored = true;
+    flags.set(FLAG_VALID);
+    return true;
+}
+
+bool TimeSync::start()
+{
+    if (thread) {
+        return true;
+    }
+    thread = new Thread(osPriorityNormal, TIME_SYNC_STACK_SIZE, NULL, "ntp");
+    if (thread->start(callback(this, &TimeSync::run)) != osOK) {
+        delete thread;
+        thread = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool TimeSync::waitValid(uint32_t timeoutMs)
+{
+    return (flags.wait_any(FLAG_VALID, timeoutMs, false) & osFlagsError) == 0;
+}
+
+void TimeSync::run()
+{
+    NTPClient ntp(network);
+    ntp.set_server(server, TIME_SYNC_NTP_PORT);
+    uint32_t retryMs = TIME_SYNC_RETRY_MIN_MS;
+    profiler->begin(PHASE_NTP_SYNC);
+    time_t now;
+    while ((now = ntp.get_timestamp()) <= 0) {
+        printf("WARNING: no time from %s:%d (%ld), retrying in %lu ms.\r\n", server, TIME_SYNC_NTP_PORT,
+               (long)now, (unsigned long)retryMs);
+        ThisThread::sleep_for(retryMs);
+        retryMs = (retryMs * 2 > TIME_SYNC_RETRY_MAX_MS) ? TIME_SYNC_RETRY_MAX_MS : retryMs * 2;
+    }
+    // What the RTC read without the correction of restore().
+    const time_t rtc = time(NULL) - correctionS;
+    set_time(now);
+    profiler->end(PHASE_NTP_SYNC);
+
+    if (isRestored && now - lastSyncTime >= TIME_SYNC_MIN_DRIFT_INTERVAL_S) {
+        const int64_t ppm = (int64_t)(rtc - now) * 1000000 / (now - lastSyncTime);
+        if (ppm >= -TIME_SYNC_MAX_DRIFT_PPM && ppm <= TIME_SYNC_MAX_DRIFT_PPM) {
+            driftPpm = (int32_t)ppm;
+        }
+    }
+    printf("Time is now %s", ctime(&now));
+    if (isRestored) {
+        printf("The time restored from the RTC was off by %ld s, RTC drift is %ld ppm.\r\n",
+               (long)(rtc + correctionS - now), (long)driftPpm);
+    }
+    syncTime = now;
+    flags.set(FLAG_VALID | FLAG_SYNCED);
+}
+
+bool TimeSync::store(StartupCache &cache) const
+{
+    if (!isSynced()) {
+        return false;
+    }
+    cache.setTimeSync(syncTime, driftPpm);
+    return true;
+}
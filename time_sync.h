@@ -0,0 +1,79 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TIME_SYNC_H__
+#define __TIME_SYNC_H__
+
+#include "mbed.h"
+#include "phase_profiler.h"
+#include "startup_cache.h"
+
+/*
+ * Sets the RTC over NTP on a thread of its own, so that the main thread can
+ * resolve and connect to the broker meanwhile. Only the TLS handshake and the
+ * SAS token need the time, and they wait for it in waitValid().
+ *
+ * If the RTC kept running since the last sync stored in StartupCache, e.g.
+ * after a reset, it is corrected by the drift measured then and taken as
+ * valid right away. NTP then only refines it, and the drift is measured
+ * again once at least TIME_SYNC_MIN_DRIFT_INTERVAL_S have passed.
+ *
+ * A failed NTP query is retried with a growing delay until it succeeds.
+ */
+class TimeSync {
+public:
+    TimeSync(NetworkInterface *network, const char *server, PhaseProfiler *profiler);
+    ~TimeSync();
+
+    /* Takes the RTC as valid if `cache` shows it kept running since the last sync. Call before start(). */
+    bool restore(const StartupCache &cache);
+
+    /* Starts querying NTP. Returns false if the thread cannot start. */
+    bool start();
+
+    /* Waits up to `timeoutMs` until the time is valid. Returns true if it is. */
+    bool waitValid(uint32_t timeoutMs);
+
+    /* True once NTP has set the RTC. */
+    bool isSynced() const { return (flags.get() & FLAG_SYNCED) != 0; }
+
+    /* Stores the time and drift of the NTP sync in `cache`. Returns false if NTP has not synced yet. */
+    bool store(StartupCache &cache) const;
+
+private:
+    enum {
+        FLAG_VALID = 1,
+        FLAG_SYNCED = 2,
+    };
+
+    void run();
+
+    NetworkInterface *network;
+    const char *server;
+    PhaseProfiler *profiler;
+    Thread *thread;
+    EventFlags flags;
+
+    bool isRestored;
+    time_t lastSyncTime;    // From the cache.
+    int32_t driftPpm;       // From the cache, replaced by a new measurement.
+    int32_t correctionS;    // Added to the RTC by restore().
+    time_t syncTime;        // NTP time of the sync.
+};
+
+#endif /* __TIME_SYNC_H__ */
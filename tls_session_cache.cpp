@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "tls_session_cache.h"
+#include "session_pool.h"
+
+TlsSessionCache::TlsSessionCache() : valid(false)
+{
+    mbedtls_ssl_session_init(&session);
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+    mbedtls_ssl_session_free(&session);
+}
+
+void TlsSessionCache::save(const mbedtls_ssl_context *ssl)
+{
+    clear();
+    // The copy outlives the connection, so it is kept out of the session pool.
+    SessionPool::HeapScope heapScope;
+    if (mbedtls_ssl_get_session(ssl, &session) == 0) {
+        valid = true;
+    }
+}
+
+bool TlsSessionCache::apply(mbedtls_ssl_context *ssl)
+{
+    if (!valid) {
+        return false;
+    }
+    return mbedtls_ssl_set_session(ssl, &session) == 0;
+}
+
+bool TlsSessionCache::wasResumed(const mbedtls_ssl_context *ssl) const
+{
+    // The server echoes the offered session id when it accepts the resumption.
+    if (!valid || ssl->session == NULL || session.id_len == 0) {
+        return false;
+    }
+    return ssl->session->id_len == session.id_len
+           && memcmp(ssl->session->id, session.id, session.id_len) == 0;
+}
+
+void TlsSessionCache::clear()
+{
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    valid = false;
+}
@@ -0,0 +1,58 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TLS_SESSION_CACHE_H__
+#define __TLS_SESSION_CACHE_H__
+
+#include "mbed.h"
+#include "mbedtls/ssl.h"
+
+/*
+ * Keeps the TLS session of the last connection, i.e. its session id or
+ * ticket and master secret, so that the next handshake can resume it
+ * instead of running the full key exchange again.
+ */
+class TlsSessionCache {
+public:
+    TlsSessionCache();
+    ~TlsSessionCache();
+
+    /* Copies the session of a completed handshake. */
+    void save(const mbedtls_ssl_context *ssl);
+
+    /*
+     * Offers the saved session in the next handshake. Must be called after
+     * mbedtls_ssl_setup() and before the handshake starts. Returns false if
+     * there is no saved session.
+     */
+    bool apply(mbedtls_ssl_context *ssl);
+
+    /* True if the completed handshake of `ssl` resumed the saved session. */
+    bool wasResumed(const mbedtls_ssl_context *ssl) const;
+
+    /* Forgets the saved session, e.g. after the server rejected it. */
+    void clear();
+
+    bool isValid() const { return valid; }
+
+private:
+    mbedtls_ssl_session session;
+    bool valid;
+};
+
+#endif /* __TLS_SESSION_CACHE_H__ */
@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+# ----------------------------------------------------------------------------
+# Copyright 2016-2019 ARM Ltd.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ----------------------------------------------------------------------------
+
+"""Decodes the binary console output of DeferredLog.
+
+With deferred-log-binary set, every log record is printed as one line of a
+'~' followed by hex bytes: timestamp and format index (little endian),
+argument count, text length, the 32-bit arguments (little endian) and the
+text. The formats are read from log_formats.h, in the order of LOG_FORMATS.
+Records are printed with their timestamp in microseconds. Other console
+lines are copied as they are.
+
+Save the console output to a file, or pipe it in:
+
+    python tools/decode_log.py log_formats.h console.log
+    python -m serial.tools.miniterm /dev/ttyACM0 115200 --raw | python tools/decode_log.py log_formats.h
+"""
+
+import re
+import struct
+import sys
+
+LOG_FORMAT = re.compile(r'X\(\s*(\w+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)')
+STRING_LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+CONVERSION = re.compile(r'%[-+ #0]*\d*(?:\.\d+)?(l*)([dusx%])')
+ESCAPES = {'n': '\n', 'r': '\r', 't': '\t', '\\': '\\', '"': '"'}
+MARKER = '~'
+
+
+def unescape(literal):
+    return re.sub(r'\\(.)', lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def read_formats(path):
+    with open(path) as f:
+        source = f.read()
+    return [''.join(unescape(s) for s in STRING_LITERAL.findall(m.group(2)))
+            for m in LOG_FORMAT.finditer(source)]
+
+
+def format_record(fmt, args, text):
+    values = list(args)
+
+    def convert(match):
+        kind = match.group(2)
+        if kind == '%':
+            return '%'
+        if kind == 's':
+            return text
+        value = values.pop(0) if values else 0
+        if kind == 'd':
+            value = struct.unpack('<i', struct.pack('<I', value))[0]
+            return str(value)
+        if kind == 'x':
+            return '%x' % value
+        return str(value)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode_line(line, formats):
+    data = bytearray.fromhex(line[1:].strip())
+    timestamp, index, arg_count, text_length = struct.unpack_from('<IHBB', data, 0)
+    args = struct.unpack_from('<%dI' % arg_count, data, 8)
+    start = 8 + 4 * arg_count
+    text = data[start:start + text_length].decode('utf-8', 'replace')
+    if index >= len(formats):
+        return '[%10u us] <unknown format %u>' % (timestamp, index)
+    message = format_record(formats[index], args, text).strip('\r\n')
+    return '[%10u us] %s' % (timestamp, message.replace('\r\n', '\n'))
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write('usage: %s log_formats.h [console.log]\n' % argv[0])
+        return 1
+    formats = read_formats(argv[1])
+    source = open(argv[2]) if len(argv) == 3 else sys.stdin
+    for line in source:
+        if line.startswith(MARKER):
+            try:
+                line = decode_line(line, formats) + '\n'
+            except (ValueError, struct.error):
+                line = '<corrupt log record> ' + line
+        sys.stdout.write(line.rstrip('\r\n') + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,101 @@
+#!/usr/bin/env python
+# ----------------------------------------------------------------------------
+# Copyright 2016-2019 ARM Ltd.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ----------------------------------------------------------------------------
+
+"""Converts the PEM strings of MQTT_server_setting.h into DER arrays.
+
+Every `static const char* const NAME_PEM = "..." ...;` definition becomes
+NAME_DER, a table of DerBlob entries with one entry per PEM block, and
+HAVE_NAME_DER is defined next to it. Conditional directives are copied as they are, so the
+arrays end up in the same #if branches as their PEM strings. Strings that hold no
+PEM block, e.g. the placeholders, produce no array.
+
+Run it again whenever a certificate or key in the settings file changes:
+
+    python tools/pem_to_der.py MQTT_server_setting.h trust_store_der.h
+"""
+
+import base64
+import re
+import sys
+
+PEM_DEFINITION = re.compile(r'(?:static\s+)?const\s+char\s*\*\s*(?:const\s+)?(\w+)_PEM\s*=\s*((?:\s*"(?:[^"\\]|\\.)*"|\s*/\*.*?\*/|\s*//[^\n]*)*)\s*;',
+                            re.S)
+STRING_LITERAL = re.compile(r'"((?:[^"\\]|\\.)*)"')
+DIRECTIVE = re.compile(r'\s*#\s*(if|ifdef|ifndef|elif|else|endif)\b|\s*#\s*define\s+__MQTT_SERVER_SETTING_H__\s*$')
+PEM_BLOCK = re.compile(r'-----BEGIN ([A-Z ]+)-----(.*?)-----END \1-----', re.S)
+ESCAPES = {'n': '\n', 'r': '\r', 't': '\t', '\\': '\\', '"': '"'}
+
+
+def unescape(literal):
+    return re.sub(r'\\(.)', lambda m: ESCAPES.get(m.group(1), m.group(1)), literal)
+
+
+def der_blocks(literals):
+    text = ''.join(unescape(s) for s in STRING_LITERAL.findall(literals))
+    return [base64.b64decode(''.join(body.split())) for _, body in PEM_BLOCK.findall(text)]
+
+
+def c_array(name, data):
+    lines = ['static const unsigned char %s[] = {' % name]
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join('0x%02x' % b for b in bytearray(data[i:i + 16])) + ',')
+    lines.append('};')
+    return lines
+
+
+def convert(source):
+    out = []
+    pos = 0
+    for match in PEM_DEFINITION.finditer(source):
+        out.extend(l for l in source[pos:match.start()].splitlines() if DIRECTIVE.match(l))
+        pos = match.end()
+        name = match.group(1)
+        blocks = der_blocks(match.group(2))
+        if not blocks:
+            out.append('// %s_PEM holds no PEM block, no DER generated.' % name)
+            continue
+        for i, der in enumerate(blocks):
+            out.extend(c_array('%s_DER_%d' % (name, i), der))
+        out.append('static const DerBlob %s_DER[] = {' % name)
+        out.extend('    { %s_DER_%d, sizeof(%s_DER_%d) },' % (name, i, name, i) for i in range(len(blocks)))
+        out.append('};')
+        out.append('#define HAVE_%s_DER' % name)
+    out.extend(l for l in source[pos:].splitlines() if DIRECTIVE.match(l))
+    return out
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write('usage: %s MQTT_server_setting.h trust_store_der.h\n' % argv[0])
+        return 1
+    with open(argv[1]) as f:
+        source = f.read()
+    body = convert(source)
+    # The include guard of the settings file is copied too, rename it.
+    body = [l.replace('__MQTT_SERVER_SETTING_H__', '__TRUST_STORE_DER_H__') for l in body]
+    with open(argv[2], 'w') as f:
+        f.write('// Generated by tools/pem_to_der.py from %s. Do not edit.\n\n' % argv[1])
+        guard = body.index('#define __TRUST_STORE_DER_H__')
+        f.write('\n'.join(body[:guard + 1]) + '\n\n#include "trust_store.h"\n\n')
+        f.write('\n'.join(body[guard + 1:]) + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
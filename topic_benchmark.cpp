@@ -0,0 +1,69 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "topic_benchmark.h"
+#include "topic_builder.h"
+
+/* A device id of typical length, the benchmark does not depend on the configured one. */
+#define TOPIC_BENCHMARK_DEVICE_ID  "benchmark-device-0001"
+
+static constexpr auto benchmarkTopic = makeTopic("devices/" TOPIC_BENCHMARK_DEVICE_ID "/messages/events/")
+                                           .property("$.ct", "application/json")
+                                           .property("$.ce", "utf-8");
+
+static char builderTopic[160];
+static char snprintfTopic[160];
+
+TopicBenchmark::TopicBenchmark(uint32_t iterations)
+    : iterations(iterations), builderUs(0), snprintfUs(0), topicLength(0)
+{
+}
+
+int TopicBenchmark::run()
+{
+    Timer timer;
+    timer.start();
+    for (uint32_t i = 0; i < iterations; i++) {
+        TopicWriter topic(builderTopic, sizeof(builderTopic), benchmarkTopic);
+        topic.property("$.mid", i).property("$.cid", i ^ 0x5A5A5A5A);
+        topicLength = topic.size();
+    }
+    timer.stop();
+    builderUs = timer.read_us();
+
+    timer.reset();
+    timer.start();
+    for (uint32_t i = 0; i < iterations; i++) {
+        snprintf(snprintfTopic, sizeof(snprintfTopic), "devices/%s/messages/events/$.ct=%s&$.ce=%s&$.mid=%lu&$.cid=%lu",
+                 TOPIC_BENCHMARK_DEVICE_ID, "application%2Fjson", "utf-8",
+                 (unsigned long)i, (unsigned long)(i ^ 0x5A5A5A5A));
+    }
+    timer.stop();
+    snprintfUs = timer.read_us();
+
+    return (strcmp(builderTopic, snprintfTopic) == 0) ? 0 : -1;
+}
+
+void TopicBenchmark::print() const
+{
+    printf("\r\n----- Topic benchmark -----\r\n");
+    printf("Topic:      %u bytes, e.g. %s\r\n", (unsigned int)topicLength, builderTopic);
+    printf("Builder:    %lu ns/topic\r\n", iterations ? (unsigned long)((uint64_t)builderUs * 1000 / iterations) : 0UL);
+    printf("snprintf:   %lu ns/topic\r\n", iterations ? (unsigned long)((uint64_t)snprintfUs * 1000 / iterations) : 0UL);
+    printf("---------------------------\r\n\r\n");
+}
@@ -0,0 +1,48 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TOPIC_BENCHMARK_H__
+#define __TOPIC_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+
+/*
+ * Compares building a publish topic with a message id and a correlation id
+ * from a compile-time TopicPrefix and a TopicWriter against formatting the
+ * whole topic with snprintf, as publishing code would otherwise do.
+ */
+class TopicBenchmark : public Benchmark {
+public:
+    /* Builds `iterations` topics each way. */
+    TopicBenchmark(uint32_t iterations);
+
+    virtual const char *name() const { return "topic benchmark"; }
+
+    /* Returns -1 if the two ways disagree, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    uint32_t iterations;
+    uint32_t builderUs;
+    uint32_t snprintfUs;
+    size_t topicLength;
+};
+
+#endif /* __TOPIC_BENCHMARK_H__ */
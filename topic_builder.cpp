@@ -0,0 +1,73 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "topic_builder.h"
+
+TopicWriter::TopicWriter(char *buffer, size_t capacity, const char *prefix, size_t prefixLength)
+    : buffer(buffer), capacity(capacity), length(0), overflow(capacity == 0)
+{
+    if (capacity > 0) {
+        buffer[0] = '\0';
+    }
+    put(prefix, prefixLength);
+}
+
+void TopicWriter::putKey(const char *key, size_t keyLength)
+{
+    if (length > 0 && !isTopicPropertyStart(buffer[length - 1])) {
+        put("&", 1);
+    }
+    put(key, keyLength);
+    put("=", 1);
+}
+
+void TopicWriter::putEncoded(const char *value)
+{
+    for (; *value; value++) {
+        const unsigned char c = (unsigned char)*value;
+        if (isTopicUnreserved(*value)) {
+            put(value, 1);
+        } else {
+            const char escaped[3] = { '%', topicHexDigit(c >> 4), topicHexDigit(c & 0x0F) };
+            put(escaped, sizeof(escaped));
+        }
+    }
+}
+
+void TopicWriter::putDecimal(uint32_t value)
+{
+    char digits[10];
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    put(digits + sizeof(digits) - n, n);
+}
+
+void TopicWriter::put(const char *s, size_t n)
+{
+    // One byte is always kept for the terminating NUL.
+    if (overflow || length + n + 1 > capacity) {
+        overflow = true;
+        return;
+    }
+    memcpy(buffer + length, s, n);
+    length += n;
+    buffer[length] = '\0';
+}
@@ -0,0 +1,190 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TOPIC_BUILDER_H__
+#define __TOPIC_BUILDER_H__
+
+#include "mbed.h"
+
+/*
+ * Topic names with an IoT Hub property bag, e.g.
+ * devices/{device_id}/messages/events/$.ct=application%2Fjson&$.mid=42
+ *
+ * The fixed part, a topic and properties known at build time, is a
+ * TopicPrefix built by constexpr functions, so its property values are
+ * URL-encoded by the compiler and it sits in flash like a string literal:
+ *
+ *     static constexpr auto topic = makeTopic("devices/" DEVICE_ID "/messages/events/")
+ *                                       .property("$.ct", "application/json");
+ *
+ * Properties known only at publish time are appended by a TopicWriter into a
+ * caller-provided buffer, which takes time linear in what is appended and
+ * never allocates. Keys are written as given, values are URL-encoded.
+ */
+
+/* True for the characters written as is in a property value, the RFC 3986 unreserved set. */
+constexpr bool isTopicUnreserved(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+           || c == '-' || c == '_' || c == '.' || c == '~';
+}
+
+/*
+ * True if the first property follows `c` without a separating '&', e.g. after
+ * messages/events/ or after $iothub/twin/GET/?
+ */
+constexpr bool isTopicPropertyStart(char c)
+{
+    return c == '/' || c == '?';
+}
+
+constexpr char topicHexDigit(unsigned int value)
+{
+    return (char)((value < 10) ? '0' + value : 'A' + value - 10);
+}
+
+/*
+ * A topic and its static properties, NUL-terminated. N is an upper bound of
+ * the size, which the compiler derives from the literals it was built from.
+ */
+template<size_t N>
+class TopicPrefix {
+public:
+    constexpr TopicPrefix() : text(), length(0)
+    {
+    }
+
+    /* This prefix followed by `key`=`value`, with `value` URL-encoded. */
+    template<size_t K, size_t V>
+    constexpr TopicPrefix<N + K + 3 * V> property(const char (&key)[K], const char (&value)[V]) const
+    {
+        TopicPrefix<N + K + 3 * V> result;
+        result.append(text, length);
+        if (length > 0 && !isTopicPropertyStart(text[length - 1])) {
+            result.append("&", 1);
+        }
+        result.append(key, K - 1);
+        result.append("=", 1);
+        for (size_t i = 0; i + 1 < V; i++) {
+            const unsigned char c = (unsigned char)value[i];
+            if (isTopicUnreserved(value[i])) {
+                result.text[result.length++] = value[i];
+            } else {
+                result.text[result.length++] = '%';
+                result.text[result.length++] = topicHexDigit(c >> 4);
+                result.text[result.length++] = topicHexDigit(c & 0x0F);
+            }
+        }
+        return result;
+    }
+
+    constexpr const char *c_str() const { return text; }
+
+    /* Length without the terminating NUL. */
+    constexpr size_t size() const { return length; }
+
+private:
+    template<size_t M> friend class TopicPrefix;
+    template<size_t M> friend constexpr TopicPrefix<M> makeTopic(const char (&topic)[M]);
+
+    constexpr void append(const char *s, size_t n)
+    {
+        for (size_t i = 0; i < n; i++) {
+            text[length++] = s[i];
+        }
+    }
+
+    // Zero-initialized, so the text is always terminated.
+    char text[N];
+    size_t length;
+};
+
+/* A TopicPrefix without properties. */
+template<size_t M>
+constexpr TopicPrefix<M> makeTopic(const char (&topic)[M])
+{
+    TopicPrefix<M> result;
+    result.append(topic, M - 1);
+    return result;
+}
+
+/*
+ * Builds a topic from a prefix plus properties in a caller-provided buffer.
+ * If something does not fit, the writer is marked as overflowed and appends
+ * nothing more. The text in the buffer is always terminated.
+ */
+class TopicWriter {
+public:
+    TopicWriter(char *buffer, size_t capacity, const char *prefix, size_t prefixLength);
+
+    template<size_t N>
+    TopicWriter(char *buffer, size_t capacity, const TopicPrefix<N> &prefix)
+        : TopicWriter(buffer, capacity, prefix.c_str(), prefix.size())
+    {
+    }
+
+    /* Appends `key`=`value`, with `value` URL-encoded. */
+    template<size_t K>
+    TopicWriter &property(const char (&key)[K], const char *value)
+    {
+        putKey(key, K - 1);
+        putEncoded(value);
+        return *this;
+    }
+
+    /* Appends `key`=`value` with `value` in decimal. */
+    template<size_t K>
+    TopicWriter &property(const char (&key)[K], uint32_t value)
+    {
+        putKey(key, K - 1);
+        putDecimal(value);
+        return *this;
+    }
+
+    /* Appends `value` in decimal as a topic level, e.g. the status in $iothub/methods/res/200/ */
+    TopicWriter &level(uint32_t value)
+    {
+        putDecimal(value);
+        put("/", 1);
+        return *this;
+    }
+
+    /* Appends the '?' that starts the properties of a $iothub topic. */
+    TopicWriter &query()
+    {
+        put("?", 1);
+        return *this;
+    }
+
+    const char *c_str() const { return buffer; }
+    size_t size() const { return length; }
+    bool overflowed() const { return overflow; }
+
+private:
+    void putKey(const char *key, size_t keyLength);
+    void putEncoded(const char *value);
+    void putDecimal(uint32_t value);
+    void put(const char *s, size_t n);
+
+    char *buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
+};
+
+#endif /* __TOPIC_BUILDER_H__ */
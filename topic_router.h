@@ -0,0 +1,223 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TOPIC_ROUTER_H__
+#define __TOPIC_ROUTER_H__
+
+#include "mbed.h"
+#include "MQTTClientMbedOs.h"
+
+/* Largest number of trie nodes a topic can be matching at the same level, i.e. overlapping '+' filters. */
+#define TOPIC_ROUTER_MAX_ACTIVE     8
+
+/*
+ * Routes received messages to handlers by topic filter, replacing the
+ * client's own handler list, which holds few filters and tries each one in
+ * turn with string compares.
+ *
+ * Filters are compiled into a trie with one node per topic level, kept in a
+ * fixed node array and a fixed text arena, so the router never allocates.
+ * A topic is matched in one pass over its levels, following every node the
+ * topic can still match: the literal level, '+' and '#'. Every matching
+ * filter's handler is called, as a broker would deliver the message once per
+ * matching subscription. As in MQTT, wildcards in the first level do not
+ * match topics starting with '$'.
+ *
+ * Filters are added once at startup. Subscribe them with a NULL handler and
+ * install dispatch() as the client's default message handler.
+ */
+template<size_t MaxNodes, size_t ArenaSize>
+class TopicRouter {
+public:
+    typedef void (*Handler)(MQTT::MessageData &md);
+
+    TopicRouter() : nodeCount(1), arenaUsed(0)
+    {
+        MBED_STATIC_ASSERT(MaxNodes < 0xFFFF && ArenaSize < 0xFFFF, "TopicRouter supports up to 65534 nodes and arena bytes");
+        memset(nodes, 0, sizeof(nodes));
+    }
+
+    /* Adds a filter. Returns false if it is not a valid filter or the router is full. */
+    bool add(const char *filter, Handler handler)
+    {
+        uint16_t node = 0;
+        const char *level = filter;
+        for (;;) {
+            const char *levelEnd = strchr(level, '/');
+            const size_t length = levelEnd ? (size_t)(levelEnd - level) : strlen(level);
+            uint8_t kind = KIND_LITERAL;
+            if (length == 1 && *level == '+') {
+                kind = KIND_SINGLE;
+            } else if (length == 1 && *level == '#') {
+                kind = KIND_MULTI;
+                if (levelEnd) {
+                    // '#' must be the last level.
+                    return false;
+                }
+            } else if (memchr(level, '+', length) || memchr(level, '#', length)) {
+                return false;
+            }
+            // Wildcards are told apart by kind, their text is not stored.
+            node = findOrAddChild(node, kind, level, kind == KIND_LITERAL ? length : 0);
+            if (node == 0) {
+                return false;
+            }
+            if (!levelEnd) {
+                break;
+            }
+            level = levelEnd + 1;
+        }
+        nodes[node].handler = handler;
+        return true;
+    }
+
+    /*
+     * Finds the handlers of the filters matching `topic` of `length` bytes.
+     * Stores up to `maxMatches` of them in `matches` and returns how many.
+     */
+    size_t match(const char *topic, size_t length, Handler *matches, size_t maxMatches) const
+    {
+        uint16_t active[TOPIC_ROUTER_MAX_ACTIVE];
+        uint16_t next[TOPIC_ROUTER_MAX_ACTIVE];
+        size_t activeCount = 1;
+        size_t found = 0;
+        active[0] = 0;
+        const bool isSystemTopic = length > 0 && topic[0] == '$';
+
+        const char *level = topic;
+        const char *end = topic + length;
+        for (;;) {
+            const char *levelEnd = (const char*)memchr(level, '/', end - level);
+            if (!levelEnd) {
+                levelEnd = end;
+            }
+            const size_t levelLength = levelEnd - level;
+            size_t nextCount = 0;
+            for (size_t i = 0; i < activeCount; i++) {
+                for (uint16_t c = nodes[active[i]].firstChild; c != 0; c = nodes[c].nextSibling) {
+                    const Node &child = nodes[c];
+                    if (child.kind != KIND_LITERAL && active[i] == 0 && isSystemTopic) {
+                        continue;
+                    }
+                    if (child.kind == KIND_MULTI) {
+                        addMatch(child.handler, matches, maxMatches, found);
+                    } else if ((child.kind == KIND_SINGLE
+                                || (child.length == levelLength && memcmp(arena + child.text, level, levelLength) == 0))
+                               && nextCount < TOPIC_ROUTER_MAX_ACTIVE) {
+                        next[nextCount++] = c;
+                    }
+                }
+            }
+            memcpy(active, next, nextCount * sizeof(next[0]));
+            activeCount = nextCount;
+            if (levelEnd == end || activeCount == 0) {
+                break;
+            }
+            level = levelEnd + 1;
+        }
+
+        // Filters ending at the last level, and "a/#", which also matches "a".
+        for (size_t i = 0; i < activeCount; i++) {
+            addMatch(nodes[active[i]].handler, matches, maxMatches, found);
+            for (uint16_t c = nodes[active[i]].firstChild; c != 0; c = nodes[c].nextSibling) {
+                if (nodes[c].kind == KIND_MULTI) {
+                    addMatch(nodes[c].handler, matches, maxMatches, found);
+                }
+            }
+        }
+        return found;
+    }
+
+    /* Calls the handler of every filter matching the message's topic. Returns how many were called. */
+    size_t dispatch(MQTT::MessageData &md)
+    {
+        const char *topic = md.topicName.lenstring.data;
+        size_t length = md.topicName.lenstring.len;
+        if (md.topicName.cstring) {
+            topic = md.topicName.cstring;
+            length = strlen(topic);
+        }
+        Handler matches[TOPIC_ROUTER_MAX_ACTIVE];
+        const size_t found = match(topic, length, matches, TOPIC_ROUTER_MAX_ACTIVE);
+        for (size_t i = 0; i < found; i++) {
+            matches[i](md);
+        }
+        return found;
+    }
+
+    /* Nodes and arena bytes in use, to size the template parameters. */
+    size_t nodesUsed() const { return nodeCount; }
+    size_t arenaBytesUsed() const { return arenaUsed; }
+
+private:
+    enum {
+        KIND_LITERAL,
+        KIND_SINGLE,    // '+'
+        KIND_MULTI,     // '#'
+    };
+
+    struct Node {
+        Handler handler;        // Handler of the filter ending here, NULL if none.
+        uint16_t firstChild;    // 0 if none, the root is never a child.
+        uint16_t nextSibling;   // 0 if none.
+        uint16_t text;          // Offset of the level text in the arena.
+        uint8_t length;         // Length of the level text, 0 for wildcards.
+        uint8_t kind;
+    };
+
+    static void addMatch(Handler handler, Handler *matches, size_t maxMatches, size_t &found)
+    {
+        if (handler && found < maxMatches) {
+            matches[found++] = handler;
+        }
+    }
+
+    /* Returns the child of `parent` for the level, adding it if needed, or 0 if the router is full. */
+    uint16_t findOrAddChild(uint16_t parent, uint8_t kind, const char *level, size_t length)
+    {
+        uint16_t *link = &nodes[parent].firstChild;
+        for (; *link != 0; link = &nodes[*link].nextSibling) {
+            const Node &child = nodes[*link];
+            if (child.kind == kind && child.length == length && memcmp(arena + child.text, level, length) == 0) {
+                return *link;
+            }
+        }
+        if (nodeCount == MaxNodes || length > 0xFF || arenaUsed + length > ArenaSize) {
+            return 0;
+        }
+        const uint16_t index = (uint16_t)nodeCount++;
+        Node &node = nodes[index];
+        node.handler = NULL;
+        node.firstChild = 0;
+        node.nextSibling = 0;
+        node.kind = kind;
+        node.length = (uint8_t)length;
+        node.text = (uint16_t)arenaUsed;
+        memcpy(arena + arenaUsed, level, length);
+        arenaUsed += length;
+        *link = index;
+        return index;
+    }
+
+    Node nodes[MaxNodes];
+    char arena[ArenaSize];
+    size_t nodeCount;
+    size_t arenaUsed;
+};
+
+#endif /* __TOPIC_ROUTER_H__ */
@@ -0,0 +1,58 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "trust_store.h"
+
+TrustStore::TrustStore()
+{
+    mbedtls_x509_crt_init(&ca);
+    mbedtls_x509_crt_init(&clientCertChain);
+    mbedtls_pk_init(&clientPrivateKey);
+}
+
+TrustStore::~TrustStore()
+{
+    mbedtls_x509_crt_free(&ca);
+    mbedtls_x509_crt_free(&clientCertChain);
+    mbedtls_pk_free(&clientPrivateKey);
+}
+
+int TrustStore::parseChain(mbedtls_x509_crt *chain, const DerBlob *certs, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        int ret = mbedtls_x509_crt_parse_der_nocopy(chain, certs[i].data, certs[i].length);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+int TrustStore::loadCaChain(const DerBlob *certs, size_t count)
+{
+    return parseChain(&ca, certs, count);
+}
+
+int TrustStore::loadClientCertKey(const DerBlob *certs, size_t count, const DerBlob &key)
+{
+    int ret = parseChain(&clientCertChain, certs, count);
+    if (ret != 0) {
+        return ret;
+    }
+    return mbedtls_pk_parse_key(&clientPrivateKey, key.data, key.length, NULL, 0);
+}
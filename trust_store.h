@@ -0,0 +1,65 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TRUST_STORE_H__
+#define __TRUST_STORE_H__
+
+#include "mbed.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+/* One DER encoded certificate or key, generated into trust_store_der.h by tools/pem_to_der.py. */
+struct DerBlob {
+    const unsigned char *data;
+    size_t length;
+};
+
+/*
+ * Certificates and the client key, parsed once at startup and shared by
+ * every connection.
+ *
+ * Certificates are parsed with mbedtls_x509_crt_parse_der_nocopy(), so the
+ * parsed structures point into the DER arrays in flash instead of holding a
+ * heap copy of each certificate, and no PEM decoding happens at all. The
+ * arrays must therefore stay valid for the lifetime of the store. The
+ * private key is always parsed into its own structure.
+ */
+class TrustStore {
+public:
+    TrustStore();
+    ~TrustStore();
+
+    /* Parses the root CA certificates. Returns 0 or an mbed TLS error code. */
+    int loadCaChain(const DerBlob *certs, size_t count);
+
+    /* Parses the client certificate chain and its key. Returns 0 or an mbed TLS error code. */
+    int loadClientCertKey(const DerBlob *certs, size_t count, const DerBlob &key);
+
+    mbedtls_x509_crt *caChain() { return &ca; }
+    mbedtls_x509_crt *clientCert() { return &clientCertChain; }
+    mbedtls_pk_context *clientKey() { return &clientPrivateKey; }
+
+private:
+    static int parseChain(mbedtls_x509_crt *chain, const DerBlob *certs, size_t count);
+
+    mbedtls_x509_crt ca;
+    mbedtls_x509_crt clientCertChain;
+    mbedtls_pk_context clientPrivateKey;
+};
+
+#endif /* __TRUST_STORE_H__ */
@@ -0,0 +1,175 @@
+// Generated by tools/pem_to_der.py from MQTT_server_setting.h. Do not edit.
+
+#ifndef __TRUST_STORE_DER_H__
+#define __TRUST_STORE_DER_H__
+
+#include "trust_store.h"
+
+#if IOTHUB_AUTH_METHOD == IOTHUB_AUTH_SYMMETRIC_KEY
+#endif // IOTHUB_AUTH_METHOD == IOTHUB_AUTH_SYMMETRIC_KEY
+#if !MBED_CONF_APP_TLS_ECC_ONLY
+static const unsigned char SSL_CA_DER_0[] = {
+    0x30, 0x82, 0x03, 0x77, 0x30, 0x82, 0x02, 0x5f, 0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x04, 0x02,
+    0x00, 0x00, 0xb9, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x05,
+    0x05, 0x00, 0x30, 0x5a, 0x31, 0x0b, 0x30, 0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13, 0x02, 0x49,
+    0x45, 0x31, 0x12, 0x30, 0x10, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x13, 0x09, 0x42, 0x61, 0x6c, 0x74,
+    0x69, 0x6d, 0x6f, 0x72, 0x65, 0x31, 0x13, 0x30, 0x11, 0x06, 0x03, 0x55, 0x04, 0x0b, 0x13, 0x0a,
+    0x43, 0x79, 0x62, 0x65, 0x72, 0x54, 0x72, 0x75, 0x73, 0x74, 0x31, 0x22, 0x30, 0x20, 0x06, 0x03,
+    0x55, 0x04, 0x03, 0x13, 0x19, 0x42, 0x61, 0x6c, 0x74, 0x69, 0x6d, 0x6f, 0x72, 0x65, 0x20, 0x43,
+    0x79, 0x62, 0x65, 0x72, 0x54, 0x72, 0x75, 0x73, 0x74, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x30, 0x1e,
+    0x17, 0x0d, 0x30, 0x30, 0x30, 0x35, 0x31, 0x32, 0x31, 0x38, 0x34, 0x36, 0x30, 0x30, 0x5a, 0x17,
+    0x0d, 0x32, 0x35, 0x30, 0x35, 0x31, 0x32, 0x32, 0x33, 0x35, 0x39, 0x30, 0x30, 0x5a, 0x30, 0x5a,
+    0x31, 0x0b, 0x30, 0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13, 0x02, 0x49, 0x45, 0x31, 0x12, 0x30,
+    0x10, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x13, 0x09, 0x42, 0x61, 0x6c, 0x74, 0x69, 0x6d, 0x6f, 0x72,
+    0x65, 0x31, 0x13, 0x30, 0x11, 0x06, 0x03, 0x55, 0x04, 0x0b, 0x13, 0x0a, 0x43, 0x79, 0x62, 0x65,
+    0x72, 0x54, 0x72, 0x75, 0x73, 0x74, 0x31, 0x22, 0x30, 0x20, 0x06, 0x03, 0x55, 0x04, 0x03, 0x13,
+    0x19, 0x42, 0x61, 0x6c, 0x74, 0x69, 0x6d, 0x6f, 0x72, 0x65, 0x20, 0x43, 0x79, 0x62, 0x65, 0x72,
+    0x54, 0x72, 0x75, 0x73, 0x74, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x30, 0x82, 0x01, 0x22, 0x30, 0x0d,
+    0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x82, 0x01,
+    0x0f, 0x00, 0x30, 0x82, 0x01, 0x0a, 0x02, 0x82, 0x01, 0x01, 0x00, 0xa3, 0x04, 0xbb, 0x22, 0xab,
+    0x98, 0x3d, 0x57, 0xe8, 0x26, 0x72, 0x9a, 0xb5, 0x79, 0xd4, 0x29, 0xe2, 0xe1, 0xe8, 0x95, 0x80,
+    0xb1, 0xb0, 0xe3, 0x5b, 0x8e, 0x2b, 0x29, 0x9a, 0x64, 0xdf, 0xa1, 0x5d, 0xed, 0xb0, 0x09, 0x05,
+    0x6d, 0xdb, 0x28, 0x2e, 0xce, 0x62, 0xa2, 0x62, 0xfe, 0xb4, 0x88, 0xda, 0x12, 0xeb, 0x38, 0xeb,
+    0x21, 0x9d, 0xc0, 0x41, 0x2b, 0x01, 0x52, 0x7b, 0x88, 0x77, 0xd3, 0x1c, 0x8f, 0xc7, 0xba, 0xb9,
+    0x88, 0xb5, 0x6a, 0x09, 0xe7, 0x73, 0xe8, 0x11, 0x40, 0xa7, 0xd1, 0xcc, 0xca, 0x62, 0x8d, 0x2d,
+    0xe5, 0x8f, 0x0b, 0xa6, 0x50, 0xd2, 0xa8, 0x50, 0xc3, 0x28, 0xea, 0xf5, 0xab, 0x25, 0x87, 0x8a,
+    0x9a, 0x96, 0x1c, 0xa9, 0x67, 0xb8, 0x3f, 0x0c, 0xd5, 0xf7, 0xf9, 0x52, 0x13, 0x2f, 0xc2, 0x1b,
+    0xd5, 0x70, 0x70, 0xf0, 0x8f, 0xc0, 0x12, 0xca, 0x06, 0xcb, 0x9a, 0xe1, 0xd9, 0xca, 0x33, 0x7a,
+    0x77, 0xd6, 0xf8, 0xec, 0xb9, 0xf1, 0x68, 0x44, 0x42, 0x48, 0x13, 0xd2, 0xc0, 0xc2, 0xa4, 0xae,
+    0x5e, 0x60, 0xfe, 0xb6, 0xa6, 0x05, 0xfc, 0xb4, 0xdd, 0x07, 0x59, 0x02, 0xd4, 0x59, 0x18, 0x98,
+    0x63, 0xf5, 0xa5, 0x63, 0xe0, 0x90, 0x0c, 0x7d, 0x5d, 0xb2, 0x06, 0x7a, 0xf3, 0x85, 0xea, 0xeb,
+    0xd4, 0x03, 0xae, 0x5e, 0x84, 0x3e, 0x5f, 0xff, 0x15, 0xed, 0x69, 0xbc, 0xf9, 0x39, 0x36, 0x72,
+    0x75, 0xcf, 0x77, 0x52, 0x4d, 0xf3, 0xc9, 0x90, 0x2c, 0xb9, 0x3d, 0xe5, 0xc9, 0x23, 0x53, 0x3f,
+    0x1f, 0x24, 0x98, 0x21, 0x5c, 0x07, 0x99, 0x29, 0xbd, 0xc6, 0x3a, 0xec, 0xe7, 0x6e, 0x86, 0x3a,
+    0x6b, 0x97, 0x74, 0x63, 0x33, 0xbd, 0x68, 0x18, 0x31, 0xf0, 0x78, 0x8d, 0x76, 0xbf, 0xfc, 0x9e,
+    0x8e, 0x5d, 0x2a, 0x86, 0xa7, 0x4d, 0x90, 0xdc, 0x27, 0x1a, 0x39, 0x02, 0x03, 0x01, 0x00, 0x01,
+    0xa3, 0x45, 0x30, 0x43, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04, 0x14, 0xe5,
+    0x9d, 0x59, 0x30, 0x82, 0x47, 0x58, 0xcc, 0xac, 0xfa, 0x08, 0x54, 0x36, 0x86, 0x7b, 0x3a, 0xb5,
+    0x04, 0x4d, 0xf0, 0x30, 0x12, 0x06, 0x03, 0x55, 0x1d, 0x13, 0x01, 0x01, 0xff, 0x04, 0x08, 0x30,
+    0x06, 0x01, 0x01, 0xff, 0x02, 0x01, 0x03, 0x30, 0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f, 0x01, 0x01,
+    0xff, 0x04, 0x04, 0x03, 0x02, 0x01, 0x06, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7,
+    0x0d, 0x01, 0x01, 0x05, 0x05, 0x00, 0x03, 0x82, 0x01, 0x01, 0x00, 0x85, 0x0c, 0x5d, 0x8e, 0xe4,
+    0x6f, 0x51, 0x68, 0x42, 0x05, 0xa0, 0xdd, 0xbb, 0x4f, 0x27, 0x25, 0x84, 0x03, 0xbd, 0xf7, 0x64,
+    0xfd, 0x2d, 0xd7, 0x30, 0xe3, 0xa4, 0x10, 0x17, 0xeb, 0xda, 0x29, 0x29, 0xb6, 0x79, 0x3f, 0x76,
+    0xf6, 0x19, 0x13, 0x23, 0xb8, 0x10, 0x0a, 0xf9, 0x58, 0xa4, 0xd4, 0x61, 0x70, 0xbd, 0x04, 0x61,
+    0x6a, 0x12, 0x8a, 0x17, 0xd5, 0x0a, 0xbd, 0xc5, 0xbc, 0x30, 0x7c, 0xd6, 0xe9, 0x0c, 0x25, 0x8d,
+    0x86, 0x40, 0x4f, 0xec, 0xcc, 0xa3, 0x7e, 0x38, 0xc6, 0x37, 0x11, 0x4f, 0xed, 0xdd, 0x68, 0x31,
+    0x8e, 0x4c, 0xd2, 0xb3, 0x01, 0x74, 0xee, 0xbe, 0x75, 0x5e, 0x07, 0x48, 0x1a, 0x7f, 0x70, 0xff,
+    0x16, 0x5c, 0x84, 0xc0, 0x79, 0x85, 0xb8, 0x05, 0xfd, 0x7f, 0xbe, 0x65, 0x11, 0xa3, 0x0f, 0xc0,
+    0x02, 0xb4, 0xf8, 0x52, 0x37, 0x39, 0x04, 0xd5, 0xa9, 0x31, 0x7a, 0x18, 0xbf, 0xa0, 0x2a, 0xf4,
+    0x12, 0x99, 0xf7, 0xa3, 0x45, 0x82, 0xe3, 0x3c, 0x5e, 0xf5, 0x9d, 0x9e, 0xb5, 0xc8, 0x9e, 0x7c,
+    0x2e, 0xc8, 0xa4, 0x9e, 0x4e, 0x08, 0x14, 0x4b, 0x6d, 0xfd, 0x70, 0x6d, 0x6b, 0x1a, 0x63, 0xbd,
+    0x64, 0xe6, 0x1f, 0xb7, 0xce, 0xf0, 0xf2, 0x9f, 0x2e, 0xbb, 0x1b, 0xb7, 0xf2, 0x50, 0x88, 0x73,
+    0x92, 0xc2, 0xe2, 0xe3, 0x16, 0x8d, 0x9a, 0x32, 0x02, 0xab, 0x8e, 0x18, 0xdd, 0xe9, 0x10, 0x11,
+    0xee, 0x7e, 0x35, 0xab, 0x90, 0xaf, 0x3e, 0x30, 0x94, 0x7a, 0xd0, 0x33, 0x3d, 0xa7, 0x65, 0x0f,
+    0xf5, 0xfc, 0x8e, 0x9e, 0x62, 0xcf, 0x47, 0x44, 0x2c, 0x01, 0x5d, 0xbb, 0x1d, 0xb5, 0x32, 0xd2,
+    0x47, 0xd2, 0x38, 0x2e, 0xd0, 0xfe, 0x81, 0xdc, 0x32, 0x6a, 0x1e, 0xb5, 0xee, 0x3c, 0xd5, 0xfc,
+    0xe7, 0x81, 0x1d, 0x19, 0xc3, 0x24, 0x42, 0xea, 0x63, 0x39, 0xa9,
+};
+static const unsigned char SSL_CA_DER_1[] = {
+    0x30, 0x82, 0x05, 0xb4, 0x30, 0x82, 0x04, 0x9c, 0xa0, 0x03, 0x02, 0x01, 0x02, 0x02, 0x10, 0x0f,
+    0x2c, 0x10, 0xc9, 0x5b, 0x06, 0xc0, 0x93, 0x7f, 0xb8, 0xd4, 0x49, 0xf8, 0x3e, 0x85, 0x69, 0x30,
+    0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00, 0x30, 0x5a,
+    0x31, 0x0b, 0x30, 0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13, 0x02, 0x49, 0x45, 0x31, 0x12, 0x30,
+    0x10, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x13, 0x09, 0x42, 0x61, 0x6c, 0x74, 0x69, 0x6d, 0x6f, 0x72,
+    0x65, 0x31, 0x13, 0x30, 0x11, 0x06, 0x03, 0x55, 0x04, 0x0b, 0x13, 0x0a, 0x43, 0x79, 0x62, 0x65,
+    0x72, 0x54, 0x72, 0x75, 0x73, 0x74, 0x31, 0x22, 0x30, 0x20, 0x06, 0x03, 0x55, 0x04, 0x03, 0x13,
+    0x19, 0x42, 0x61, 0x6c, 0x74, 0x69, 0x6d, 0x6f, 0x72, 0x65, 0x20, 0x43, 0x79, 0x62, 0x65, 0x72,
+    0x54, 0x72, 0x75, 0x73, 0x74, 0x20, 0x52, 0x6f, 0x6f, 0x74, 0x30, 0x1e, 0x17, 0x0d, 0x31, 0x36,
+    0x30, 0x35, 0x32, 0x30, 0x31, 0x32, 0x35, 0x31, 0x35, 0x37, 0x5a, 0x17, 0x0d, 0x32, 0x34, 0x30,
+    0x35, 0x32, 0x30, 0x31, 0x32, 0x35, 0x31, 0x35, 0x37, 0x5a, 0x30, 0x81, 0x8b, 0x31, 0x0b, 0x30,
+    0x09, 0x06, 0x03, 0x55, 0x04, 0x06, 0x13, 0x02, 0x55, 0x53, 0x31, 0x13, 0x30, 0x11, 0x06, 0x03,
+    0x55, 0x04, 0x08, 0x13, 0x0a, 0x57, 0x61, 0x73, 0x68, 0x69, 0x6e, 0x67, 0x74, 0x6f, 0x6e, 0x31,
+    0x10, 0x30, 0x0e, 0x06, 0x03, 0x55, 0x04, 0x07, 0x13, 0x07, 0x52, 0x65, 0x64, 0x6d, 0x6f, 0x6e,
+    0x64, 0x31, 0x1e, 0x30, 0x1c, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x13, 0x15, 0x4d, 0x69, 0x63, 0x72,
+    0x6f, 0x73, 0x6f, 0x66, 0x74, 0x20, 0x43, 0x6f, 0x72, 0x70, 0x6f, 0x72, 0x61, 0x74, 0x69, 0x6f,
+    0x6e, 0x31, 0x15, 0x30, 0x13, 0x06, 0x03, 0x55, 0x04, 0x0b, 0x13, 0x0c, 0x4d, 0x69, 0x63, 0x72,
+    0x6f, 0x73, 0x6f, 0x66, 0x74, 0x20, 0x49, 0x54, 0x31, 0x1e, 0x30, 0x1c, 0x06, 0x03, 0x55, 0x04,
+    0x03, 0x13, 0x15, 0x4d, 0x69, 0x63, 0x72, 0x6f, 0x73, 0x6f, 0x66, 0x74, 0x20, 0x49, 0x54, 0x20,
+    0x54, 0x4c, 0x53, 0x20, 0x43, 0x41, 0x20, 0x32, 0x30, 0x82, 0x02, 0x22, 0x30, 0x0d, 0x06, 0x09,
+    0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x82, 0x02, 0x0f, 0x00,
+    0x30, 0x82, 0x02, 0x0a, 0x02, 0x82, 0x02, 0x01, 0x00, 0x9e, 0xaa, 0x15, 0xc1, 0x1b, 0xa1, 0x63,
+    0x5f, 0xe6, 0x51, 0x18, 0xc5, 0x16, 0xbb, 0x11, 0xdc, 0x0b, 0x4d, 0x9b, 0x91, 0x0a, 0xba, 0x40,
+    0x49, 0x2b, 0xdc, 0xd6, 0x06, 0x0b, 0xc5, 0x77, 0x59, 0x2c, 0x34, 0x42, 0x45, 0x0b, 0x4e, 0xa8,
+    0xc9, 0x16, 0xf0, 0x28, 0xf3, 0x1f, 0x96, 0x95, 0xbf, 0x1e, 0xd3, 0x9f, 0xcc, 0x87, 0x81, 0x96,
+    0x21, 0xa4, 0xe7, 0xb3, 0x30, 0x66, 0xad, 0x7c, 0x6e, 0x00, 0x12, 0xaf, 0xbd, 0x2c, 0x3d, 0x45,
+    0xae, 0xa0, 0x3f, 0x75, 0xec, 0x75, 0x20, 0x05, 0xfc, 0x41, 0x62, 0x81, 0x7c, 0xcc, 0x0e, 0xd9,
+    0x21, 0xee, 0x73, 0x00, 0x73, 0x83, 0x15, 0xba, 0x09, 0x2f, 0xb1, 0x60, 0xfd, 0xaa, 0x60, 0x6d,
+    0x0b, 0x3f, 0x1a, 0x26, 0x59, 0x34, 0x28, 0xb4, 0x42, 0x44, 0x14, 0x5b, 0x3c, 0x34, 0x9d, 0x35,
+    0x26, 0x55, 0x23, 0x50, 0xd2, 0x6c, 0xfa, 0xa4, 0x2b, 0xbd, 0xe4, 0x3b, 0xf5, 0x58, 0xcb, 0x0b,
+    0x1b, 0x23, 0xc6, 0x7d, 0xd3, 0x7d, 0xcc, 0x3d, 0xd0, 0xfd, 0x01, 0x03, 0xc8, 0x9e, 0xbd, 0xe5,
+    0x08, 0x23, 0x44, 0x8c, 0x58, 0x03, 0x50, 0xd4, 0x13, 0xee, 0x78, 0xb6, 0x2d, 0xa4, 0xea, 0xbd,
+    0x32, 0x70, 0xa1, 0x50, 0x62, 0x4c, 0x96, 0xc1, 0x9d, 0xb9, 0x1c, 0x3d, 0x61, 0xda, 0x46, 0x2d,
+    0xde, 0x8b, 0xd6, 0xf3, 0x9b, 0xc5, 0xeb, 0x2e, 0xed, 0x8d, 0x3a, 0x94, 0x11, 0xc2, 0xdb, 0x80,
+    0xa5, 0x02, 0x07, 0xcd, 0x7f, 0xf7, 0x9e, 0x61, 0x74, 0xb2, 0xec, 0x6c, 0x57, 0x7a, 0x7f, 0xda,
+    0x36, 0x3e, 0x45, 0x3c, 0xc6, 0xe3, 0x9c, 0xdd, 0x4f, 0x9b, 0x51, 0xe7, 0x6f, 0xbf, 0xa4, 0x9b,
+    0xb6, 0xf1, 0xa3, 0x04, 0x46, 0x5e, 0x17, 0x21, 0xfc, 0xfc, 0x26, 0x90, 0x87, 0x39, 0x6c, 0x28,
+    0xc1, 0xf4, 0xf8, 0xe3, 0xce, 0x16, 0xff, 0xdb, 0x32, 0xa7, 0x0b, 0x6a, 0xb3, 0xf0, 0xd5, 0x5d,
+    0x6c, 0x39, 0x5d, 0x5b, 0x97, 0x85, 0xbd, 0xbe, 0x2d, 0xb6, 0xef, 0xc9, 0xe2, 0x6e, 0x5c, 0xc8,
+    0x6c, 0x41, 0xed, 0xee, 0x73, 0x7c, 0xf3, 0xca, 0x78, 0x28, 0xd2, 0x30, 0xa8, 0x27, 0x17, 0x68,
+    0x68, 0x5b, 0xb5, 0x2e, 0x2d, 0x8e, 0x7d, 0xcd, 0x28, 0x8e, 0xaf, 0xd5, 0xdd, 0x97, 0x47, 0x2c,
+    0x48, 0xbc, 0x22, 0x43, 0x8e, 0x0a, 0x19, 0xd3, 0xdc, 0xc5, 0xdf, 0xd3, 0xf2, 0xa1, 0xef, 0x76,
+    0xb1, 0x24, 0x62, 0x91, 0x98, 0x7b, 0xc6, 0x7b, 0x38, 0xb5, 0x01, 0x10, 0xf0, 0x10, 0xac, 0xe2,
+    0x8e, 0x4d, 0x05, 0x2c, 0x7c, 0x53, 0x11, 0x2c, 0x83, 0x2c, 0xcd, 0x4a, 0xc9, 0x16, 0x18, 0x45,
+    0xaa, 0xb0, 0x88, 0xed, 0xfb, 0xbf, 0x80, 0xd6, 0xc9, 0x03, 0x0d, 0x9b, 0xfa, 0x93, 0x6a, 0x3c,
+    0x54, 0x21, 0xcd, 0x6d, 0x32, 0xc5, 0x29, 0x2e, 0xdd, 0xef, 0x6c, 0x0c, 0x23, 0x81, 0x2b, 0xa7,
+    0x35, 0x6c, 0x04, 0x88, 0x9c, 0xc5, 0xa1, 0xb6, 0x7b, 0x3b, 0x8c, 0x04, 0x1b, 0xaa, 0x4e, 0x1c,
+    0x48, 0x88, 0x9f, 0x86, 0xf7, 0x37, 0xe8, 0x3f, 0xd9, 0x71, 0x8a, 0x6f, 0xfd, 0xae, 0xf2, 0x40,
+    0xc5, 0xb8, 0x77, 0x9e, 0xe8, 0xc0, 0xd5, 0x52, 0x5f, 0x90, 0xe6, 0x13, 0x24, 0x8a, 0x23, 0x10,
+    0x06, 0x02, 0xc5, 0x1d, 0xd0, 0x8c, 0x4a, 0x06, 0x75, 0xaa, 0x49, 0x98, 0x19, 0x5e, 0xf7, 0xb0,
+    0x1f, 0xa8, 0x40, 0x67, 0xc2, 0x82, 0x6c, 0xbb, 0x6c, 0x1a, 0xbf, 0xc8, 0x7d, 0xbf, 0xea, 0x68,
+    0x0c, 0xbe, 0x21, 0xe9, 0xd4, 0x73, 0x45, 0x4c, 0x58, 0xd4, 0x31, 0xf2, 0xa5, 0xc1, 0x65, 0x5c,
+    0x6a, 0x07, 0xbb, 0xf4, 0x44, 0x42, 0x01, 0x4b, 0xab, 0x62, 0x0d, 0xdf, 0x4f, 0xc0, 0x85, 0x02,
+    0xcd, 0xf7, 0x43, 0xe3, 0xf5, 0x34, 0xf6, 0x45, 0x01, 0x02, 0x03, 0x01, 0x00, 0x01, 0xa3, 0x82,
+    0x01, 0x42, 0x30, 0x82, 0x01, 0x3e, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04,
+    0x14, 0x91, 0x9e, 0x3b, 0x44, 0x6c, 0x3d, 0x57, 0x9c, 0x42, 0x77, 0x2a, 0x34, 0xd7, 0x4f, 0xd1,
+    0xcc, 0x4a, 0x97, 0x2c, 0xda, 0x30, 0x1f, 0x06, 0x03, 0x55, 0x1d, 0x23, 0x04, 0x18, 0x30, 0x16,
+    0x80, 0x14, 0xe5, 0x9d, 0x59, 0x30, 0x82, 0x47, 0x58, 0xcc, 0xac, 0xfa, 0x08, 0x54, 0x36, 0x86,
+    0x7b, 0x3a, 0xb5, 0x04, 0x4d, 0xf0, 0x30, 0x12, 0x06, 0x03, 0x55, 0x1d, 0x13, 0x01, 0x01, 0xff,
+    0x04, 0x08, 0x30, 0x06, 0x01, 0x01, 0xff, 0x02, 0x01, 0x00, 0x30, 0x0e, 0x06, 0x03, 0x55, 0x1d,
+    0x0f, 0x01, 0x01, 0xff, 0x04, 0x04, 0x03, 0x02, 0x01, 0x86, 0x30, 0x27, 0x06, 0x03, 0x55, 0x1d,
+    0x25, 0x04, 0x20, 0x30, 0x1e, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07, 0x03, 0x01, 0x06,
+    0x08, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07, 0x03, 0x02, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05,
+    0x07, 0x03, 0x09, 0x30, 0x34, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07, 0x01, 0x01, 0x04,
+    0x28, 0x30, 0x26, 0x30, 0x24, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x05, 0x05, 0x07, 0x30, 0x01, 0x86,
+    0x18, 0x68, 0x74, 0x74, 0x70, 0x3a, 0x2f, 0x2f, 0x6f, 0x63, 0x73, 0x70, 0x2e, 0x64, 0x69, 0x67,
+    0x69, 0x63, 0x65, 0x72, 0x74, 0x2e, 0x63, 0x6f, 0x6d, 0x30, 0x3a, 0x06, 0x03, 0x55, 0x1d, 0x1f,
+    0x04, 0x33, 0x30, 0x31, 0x30, 0x2f, 0xa0, 0x2d, 0xa0, 0x2b, 0x86, 0x29, 0x68, 0x74, 0x74, 0x70,
+    0x3a, 0x2f, 0x2f, 0x63, 0x72, 0x6c, 0x33, 0x2e, 0x64, 0x69, 0x67, 0x69, 0x63, 0x65, 0x72, 0x74,
+    0x2e, 0x63, 0x6f, 0x6d, 0x2f, 0x4f, 0x6d, 0x6e, 0x69, 0x72, 0x6f, 0x6f, 0x74, 0x32, 0x30, 0x32,
+    0x35, 0x2e, 0x63, 0x72, 0x6c, 0x30, 0x3d, 0x06, 0x03, 0x55, 0x1d, 0x20, 0x04, 0x36, 0x30, 0x34,
+    0x30, 0x32, 0x06, 0x04, 0x55, 0x1d, 0x20, 0x00, 0x30, 0x2a, 0x30, 0x28, 0x06, 0x08, 0x2b, 0x06,
+    0x01, 0x05, 0x05, 0x07, 0x02, 0x01, 0x16, 0x1c, 0x68, 0x74, 0x74, 0x70, 0x73, 0x3a, 0x2f, 0x2f,
+    0x77, 0x77, 0x77, 0x2e, 0x64, 0x69, 0x67, 0x69, 0x63, 0x65, 0x72, 0x74, 0x2e, 0x63, 0x6f, 0x6d,
+    0x2f, 0x43, 0x50, 0x53, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01,
+    0x0b, 0x05, 0x00, 0x03, 0x82, 0x01, 0x01, 0x00, 0x6c, 0x7f, 0xea, 0x6a, 0x6f, 0xcf, 0x6b, 0x5b,
+    0xc1, 0x34, 0xac, 0xff, 0xdc, 0x0e, 0xe0, 0x7d, 0x8b, 0x13, 0x17, 0xe0, 0x2f, 0x4e, 0x59, 0x0e,
+    0xc4, 0x03, 0xb9, 0xf4, 0x05, 0x29, 0x65, 0x47, 0xae, 0x19, 0x9a, 0xe8, 0x54, 0xf6, 0x64, 0xd5,
+    0xd8, 0xbd, 0x06, 0xe0, 0x71, 0x22, 0x19, 0x7b, 0xce, 0x9a, 0xdd, 0x79, 0x8b, 0xdf, 0x70, 0x27,
+    0x48, 0x68, 0xdb, 0xf7, 0x6f, 0x33, 0x19, 0xb5, 0x65, 0xeb, 0x9f, 0x90, 0x07, 0xcc, 0xb8, 0x47,
+    0x39, 0x7d, 0x0f, 0x51, 0x13, 0x91, 0x0d, 0x80, 0xd4, 0x76, 0x50, 0x2b, 0x85, 0x07, 0x60, 0x6d,
+    0x6d, 0x59, 0x9a, 0x29, 0x40, 0x16, 0xc6, 0xc7, 0x0d, 0xe0, 0x6a, 0x57, 0x4b, 0x80, 0x09, 0xbf,
+    0xef, 0xc7, 0x4b, 0x45, 0x57, 0xb3, 0x94, 0xae, 0xd7, 0xd2, 0x74, 0x0c, 0x0f, 0x01, 0x83, 0xe9,
+    0x68, 0xf1, 0xe9, 0x02, 0x97, 0x87, 0x6a, 0xd8, 0x6d, 0x66, 0xd5, 0x6b, 0x02, 0xbc, 0x50, 0x48,
+    0xa0, 0xb2, 0x23, 0x77, 0x89, 0xde, 0x08, 0xb9, 0x46, 0xa3, 0x14, 0xf6, 0x8c, 0x0e, 0x37, 0x96,
+    0x3d, 0x89, 0xa5, 0x0f, 0xd2, 0x32, 0x42, 0xe4, 0x2f, 0x2f, 0x43, 0x5e, 0x3f, 0xc9, 0x1d, 0xdb,
+    0x2a, 0x24, 0x34, 0x79, 0xa2, 0x07, 0x22, 0x8f, 0x85, 0x48, 0x5f, 0xc5, 0x7e, 0x6d, 0x50, 0xf4,
+    0x34, 0x2c, 0x3b, 0x91, 0x06, 0xba, 0x52, 0x5a, 0xbd, 0x66, 0x8d, 0x23, 0x0c, 0x4a, 0xb5, 0x6a,
+    0xde, 0x33, 0x49, 0xe1, 0xf8, 0x99, 0x5d, 0x8f, 0x30, 0xcd, 0xcb, 0xc0, 0x85, 0xc1, 0x03, 0x6c,
+    0x68, 0xe6, 0xc7, 0x5a, 0xd5, 0xc9, 0xd4, 0x58, 0x9a, 0x37, 0x3e, 0xae, 0x2e, 0x32, 0x07, 0x0b,
+    0x7b, 0x4b, 0x7e, 0x7c, 0x2b, 0xad, 0xdf, 0xc3, 0x4c, 0x91, 0x39, 0x7c, 0x17, 0x46, 0xab, 0x7e,
+    0x5b, 0x29, 0x6a, 0xa5, 0x15, 0x55, 0x4a, 0x2f,
+};
+static const DerBlob SSL_CA_DER[] = {
+    { SSL_CA_DER_0, sizeof(SSL_CA_DER_0) },
+    { SSL_CA_DER_1, sizeof(SSL_CA_DER_1) },
+};
+#define HAVE_SSL_CA_DER
+#else
+// SSL_CA_PEM holds no PEM block, no DER generated.
+#endif // !MBED_CONF_APP_TLS_ECC_ONLY
+#if IOTHUB_AUTH_METHOD == IOTHUB_AUTH_CLIENT_SIDE_CERT
+// SSL_CLIENT_CERT_PEM holds no PEM block, no DER generated.
+// SSL_CLIENT_PRIVATE_KEY_PEM holds no PEM block, no DER generated.
+#endif // IOTHUB_AUTH_METHOD == IOTHUB_AUTH_CLIENT_SIDE_CERT
+#endif /* __TRUST_STORE_DER_H__ */
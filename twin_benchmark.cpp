@@ -0,0 +1,226 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#include "twin_benchmark.h"
+#include "device_twin.h"
+#include "inbound_message_pool.h"
+
+/* Shaped like the response to a twin GET, with the desired properties after the reported ones. */
+static const char twinDocument[] =
+    "{\"reported\":{\"telemetryMaxAgeMs\":1000,\"buttonPresses\":12,"
+    "\"$metadata\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\","
+    "\"telemetryMaxAgeMs\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\"},"
+    "\"buttonPresses\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\"}},\"$version\":57},"
+    "\"desired\":{\"telemetryMaxAgeMs\":2000,\"ledOn\":true,\"label\":\"line 3 \\\"north\\\"\","
+    "\"schedule\":{\"start\":\"08:00\",\"stop\":\"18:00\",\"days\":[1,2,3,4,5]},"
+    "\"$metadata\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\","
+    "\"telemetryMaxAgeMs\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\",\"$lastUpdatedVersion\":40},"
+    "\"ledOn\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\",\"$lastUpdatedVersion\":40},"
+    "\"label\":{\"$lastUpdated\":\"2019-12-02T10:00:00.0000000Z\",\"$lastUpdatedVersion\":40}},"
+    "\"$version\":40}}";
+
+/* A patch changing one property, the version is filled in per iteration. */
+#define TWIN_BENCHMARK_PATCH_FORMAT  "{\"telemetryMaxAgeMs\":%lu,\"$version\":%lu}"
+
+/* Topics of a patch sent by the broker, and of a reported PATCH it answers. */
+#define TWIN_BENCHMARK_DESIRED_FORMAT   "$iothub/twin/PATCH/properties/desired/?$version=%lu"
+#define TWIN_BENCHMARK_REPORTED_PREFIX  "$iothub/twin/PATCH/properties/reported/"
+
+/* Holds a message from the client's read buffer until the benchmark hands it to the twin, as in main.cpp. */
+static InboundMessagePool<1, 128> messagePool;
+static uint32_t reportedVersion;
+/* Paused when a message arrives, so the rest of the yield() is not counted. */
+static Timer *arrivalTimer;
+
+static void storeMessage(MQTT::MessageData &md)
+{
+    if (arrivalTimer) {
+        arrivalTimer->stop();
+    }
+    messagePool.store(md);
+}
+
+/*
+ * Answers a reported properties PATCH as IoT Hub does, with 204 and the new
+ * version of the reported properties.
+ */
+static void answerPatch(LoopbackSocket *client, const char *topic)
+{
+    const char *rid = strstr(topic, "$rid=");
+    if (strncmp(topic, TWIN_BENCHMARK_REPORTED_PREFIX, sizeof(TWIN_BENCHMARK_REPORTED_PREFIX) - 1) != 0 || !rid) {
+        return;
+    }
+    char response[64];
+    snprintf(response, sizeof(response), "$iothub/twin/res/204/?$rid=%lu&$version=%lu",
+             strtoul(rid + 5, NULL, 10), (unsigned long)++reportedVersion);
+    client->publish(response, "", 0);
+}
+
+/* Hands every message waiting in the pool to `twin`. Returns how many there were. */
+static int handleMessages(DeviceTwin &twin)
+{
+    int count = 0;
+    InboundMessagePool<1, 128>::Message *message;
+    while ((message = messagePool.acquire()) != NULL) {
+        twin.handleMessage(message->topic(), message->payload(), message->payloadLength);
+        messagePool.release(message);
+        count++;
+    }
+    return count;
+}
+
+TwinBenchmark::TwinBenchmark(uint32_t iterations, LoopbackBroker *broker)
+    : broker(broker), iterations(iterations), twinUs(0), patchUs(0), receivedPatchUs(0), reportUs(0),
+      twinLength(sizeof(twinDocument) - 1), patchLength(0)
+{
+}
+
+int TwinBenchmark::run()
+{
+    char label[24];
+    TwinProperty desired[] = {
+        TWIN_PROPERTY_INT("telemetryMaxAgeMs"),
+        TWIN_PROPERTY_BOOL("ledOn"),
+        TWIN_PROPERTY_STRING("label", label),
+    };
+    char buffer[64];
+    DeviceTwin twin(desired, sizeof(desired) / sizeof(desired[0]), NULL, 0, buffer, sizeof(buffer), 0);
+
+    Timer timer;
+    timer.start();
+    for (uint32_t i = 0; i < iterations; i++) {
+        twin.applyTwin(twinDocument, sizeof(twinDocument) - 1);
+    }
+    timer.stop();
+    twinUs = timer.read_us();
+    if (iterations > 0 && (desired[0].number != 2000 || !desired[1].number || strcmp(label, "line 3 \"north\"") != 0)) {
+        return -1;
+    }
+
+    // Patches are formatted up front so that only applying them is measured.
+    char patch[64];
+    patchUs = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        patchLength = snprintf(patch, sizeof(patch), TWIN_BENCHMARK_PATCH_FORMAT,
+                               (unsigned long)(i % 1000), (unsigned long)(41 + i));
+        timer.reset();
+        timer.start();
+        twin.applyDesiredPatch(patch, patchLength);
+        timer.stop();
+        patchUs += timer.read_us();
+    }
+    if (iterations > 0 && (desired[0].number != (int32_t)((iterations - 1) % 1000) || twin.desiredVersion() != 40 + iterations)) {
+        return -1;
+    }
+    return runThroughBroker();
+}
+
+/*
+ * Sends `iterations` patches from the broker and as many reported PATCHes
+ * to it, each handled before the next one is sent.
+ */
+int TwinBenchmark::runThroughBroker()
+{
+    TwinProperty desired[] = {
+        TWIN_PROPERTY_INT("telemetryMaxAgeMs"),
+    };
+    TwinProperty reported[] = {
+        TWIN_PROPERTY_INT("buttonPresses"),
+    };
+    char buffer[64];
+    DeviceTwin twin(desired, 1, reported, 1, buffer, sizeof(buffer), 0);
+
+    LoopbackSocket socket;
+    socket.connectBroker(broker);
+    MQTTClient *client = new MQTTClient(&socket);
+    MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
+    data.MQTTVersion = 4;
+    data.clientID.cstring = (char*)"benchmark";
+    data.cleansession = 1;
+    int ret = 0;
+    if (client->connect(data) != MQTT::SUCCESS
+            || client->subscribe(DEVICE_TWIN_DESIRED_TOPIC, MQTT::QOS0, storeMessage) != MQTT::SUCCESS
+            || client->subscribe(DEVICE_TWIN_RESPONSE_TOPIC, MQTT::QOS0, storeMessage) != MQTT::SUCCESS) {
+        ret = -1;
+    }
+    twin.setClient(client);
+    broker->onPublish(answerPatch);
+
+    char topic[64];
+    char patch[64];
+    Timer timer;
+    arrivalTimer = &timer;
+    receivedPatchUs = 0;
+    for (uint32_t i = 0; ret == 0 && i < iterations; i++) {
+        snprintf(topic, sizeof(topic), TWIN_BENCHMARK_DESIRED_FORMAT, (unsigned long)(i + 1));
+        const int length = snprintf(patch, sizeof(patch), TWIN_BENCHMARK_PATCH_FORMAT,
+                                    (unsigned long)(i % 1000), (unsigned long)(i + 1));
+        timer.reset();
+        timer.start();
+        // yield() reads nothing with a timeout of 0. storeMessage() pauses the clock, it resumes for handling.
+        if (!socket.publish(topic, patch, length) || client->yield(1) != MQTT::SUCCESS) {
+            ret = -1;
+        }
+        timer.start();
+        if (handleMessages(twin) != 1) {
+            ret = -1;
+        }
+        timer.stop();
+        receivedPatchUs += timer.read_us();
+    }
+    if (ret == 0 && iterations > 0 && desired[0].number != (int32_t)((iterations - 1) % 1000)) {
+        ret = -1;
+    }
+
+    reportUs = 0;
+    for (uint32_t i = 0; ret == 0 && i < iterations; i++) {
+        twin.reportInt(0, (int32_t)i);
+        timer.reset();
+        timer.start();
+        if (twin.flush() != MQTT::SUCCESS || client->yield(1) != MQTT::SUCCESS) {
+            ret = -1;
+        }
+        timer.start();
+        if (handleMessages(twin) != 1 || twin.reportInFlight()) {
+            ret = -1;
+        }
+        timer.stop();
+        reportUs += timer.read_us();
+    }
+
+    arrivalTimer = NULL;
+    broker->onPublish(LoopbackPublishHandler());
+    twin.setClient(NULL);
+    client->disconnect();
+    delete client;
+    return ret;
+}
+
+void TwinBenchmark::print() const
+{
+    printf("\r\n----- Twin benchmark -----\r\n");
+    printf("Full twin:  %u bytes, %lu us/apply\r\n", (unsigned int)twinLength,
+           iterations ? (unsigned long)(twinUs / iterations) : 0UL);
+    printf("Patch:      %u bytes, %lu us/apply\r\n", (unsigned int)patchLength,
+           iterations ? (unsigned long)(patchUs / iterations) : 0UL);
+    printf("Received:   %lu us/patch from the broker until applied\r\n",
+           iterations ? (unsigned long)(receivedPatchUs / iterations) : 0UL);
+    printf("Reported:   %lu us/PATCH until the response was handled\r\n",
+           iterations ? (unsigned long)(reportUs / iterations) : 0UL);
+    printf("--------------------------\r\n\r\n");
+}
@@ -0,0 +1,61 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __TWIN_BENCHMARK_H__
+#define __TWIN_BENCHMARK_H__
+
+#include "mbed.h"
+#include "benchmark.h"
+#include "loopback_broker.h"
+
+/*
+ * Measures how long DeviceTwin takes to apply a full twin document as IoT Hub
+ * returns it, with metadata and properties the table does not hold, and a
+ * desired properties patch.
+ *
+ * Patches are then sent by a LoopbackBroker and go through the client, the
+ * message handler and the inbound message pool as in the sample, and a
+ * reported properties PATCH is timed until the broker's response was
+ * handled. The full twin does not fit the broker's receive buffer and is
+ * only applied directly.
+ */
+class TwinBenchmark : public Benchmark {
+public:
+    /* Applies the twin and a patch `iterations` times each, and sends as many patches and PATCHes through `broker`. */
+    TwinBenchmark(uint32_t iterations, LoopbackBroker *broker);
+
+    virtual const char *name() const { return "twin benchmark"; }
+
+    /* Returns -1 if a value came out wrong or a message was lost, otherwise 0. */
+    virtual int run();
+    virtual void print() const;
+
+private:
+    int runThroughBroker();
+
+    LoopbackBroker *broker;
+    uint32_t iterations;
+    uint32_t twinUs;
+    uint32_t patchUs;
+    uint32_t receivedPatchUs;   // Sent by the broker until applied.
+    uint32_t reportUs;          // PATCH sent until its response was handled.
+    size_t twinLength;
+    size_t patchLength;
+};
+
+#endif /* __TWIN_BENCHMARK_H__ */
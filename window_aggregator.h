@@ -0,0 +1,111 @@
+// ----------------------------------------------------------------------------
+// Copyright 2016-2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+
+#ifndef __WINDOW_AGGREGATOR_H__
+#define __WINDOW_AGGREGATOR_H__
+
+#include "mbed.h"
+
+/* What is published for one window of sensor samples. */
+struct SensorSummary {
+    uint32_t window;        // Number of the window, counting from 0.
+    uint32_t count;         // Values aggregated, one per `decimation` samples.
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+};
+
+/*
+ * Min, max, mean and count of a sample stream over consecutive windows of a
+ * fixed number of samples, updated in constant time per sample and without
+ * keeping the samples.
+ *
+ * With a decimation of N, every N samples are averaged into one value first
+ * and the window aggregates those values, so min and max are taken after a
+ * simple low-pass filter at the decimated rate. A window then holds
+ * windowSamples / N values, at least one.
+ */
+class WindowAggregator {
+public:
+    WindowAggregator(uint32_t windowSamples, uint32_t decimation)
+        : decimation(decimation > 0 ? decimation : 1), windowValues(0), window(0)
+    {
+        windowValues = windowSamples / this->decimation;
+        if (windowValues == 0) {
+            windowValues = 1;
+        }
+        reset();
+    }
+
+    /* Adds a sample. Returns true and fills `summary` when it completes a window. */
+    bool add(int32_t sample, SensorSummary &summary)
+    {
+        decimationSum += sample;
+        if (++decimationCount < decimation) {
+            return false;
+        }
+        const int32_t value = (int32_t)(decimationSum / (int32_t)decimation);
+        decimationSum = 0;
+        decimationCount = 0;
+
+        if (value < min) {
+            min = value;
+        }
+        if (value > max) {
+            max = value;
+        }
+        sum += value;
+        if (++count < windowValues) {
+            return false;
+        }
+        summary.window = window++;
+        summary.count = count;
+        summary.min = min;
+        summary.max = max;
+        summary.mean = (int32_t)(sum / (int64_t)count);
+        reset();
+        return true;
+    }
+
+    uint32_t samplesPerWindow() const { return windowValues * decimation; }
+
+private:
+    void reset()
+    {
+        decimationSum = 0;
+        decimationCount = 0;
+        sum = 0;
+        count = 0;
+        min = INT32_MAX;
+        max = INT32_MIN;
+    }
+
+    uint32_t decimation;
+    uint32_t windowValues;
+    uint32_t window;
+
+    int64_t decimationSum;
+    uint32_t decimationCount;
+    int64_t sum;
+    uint32_t count;
+    int32_t min;
+    int32_t max;
+};
+
+#endif /* __WINDOW_AGGREGATOR_H__ */